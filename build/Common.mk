@@ -1,4 +1,4 @@
-DEF_FLAGS := -D USE_FRAMEBUFFER=$(USE_FRAMEBUFFER)  -D SMALL_PAGES=$(SMALL_PAGES)
+DEF_FLAGS := -D USE_FRAMEBUFFER=$(USE_FRAMEBUFFER)  -D SMALL_PAGES=$(SMALL_PAGES) -D LOG_MIN_LEVEL=$(LOG_MIN_LEVEL)
 
 CFLAGS := -std=gnu99 \
         -ffreestanding \
@@ -45,4 +45,6 @@ TESTFLAGS := -std=gnu99 \
         -D_TEST_=1
 
 PRJ_FOLDERS := src
+USER_FOLDER := userspace
+USER_LOAD_ADDRESS := 0x400000
 TEST_FOLDER := tests
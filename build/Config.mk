@@ -4,6 +4,8 @@
 
 USE_FRAMEBUFFER ?= 1
 SMALL_PAGES ?= 0
+# Log messages below this level are removed at compile time (0 = Debug, 1 = Verbose, 2 = Info, 3 = Error)
+LOG_MIN_LEVEL ?= 0
 
 # Build Configuration
 
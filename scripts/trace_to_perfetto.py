@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Convert the trace dumped by the kernel on the serial port (see trace_dump() in src/kernel/trace.c)
+into the Chrome trace event json format, that can be opened with https://ui.perfetto.dev or chrome://tracing
+
+Usage: trace_to_perfetto.py dreamos64.log [output.json]
+"""
+import json
+import sys
+
+CONTEXT_SWITCH = 1
+THREAD_STATE = 2
+PMM_ALLOC = 3
+PMM_FREE = 4
+KMALLOC = 5
+KFREE = 6
+PAGE_FAULT = 7
+IRQ_ENTER = 8
+IRQ_EXIT = 9
+SYSCALL_ENTER = 10
+SYSCALL_EXIT = 11
+
+THREAD_STATUS = {0: "NEW", 1: "INIT", 2: "RUN", 3: "READY", 4: "SLEEP", 5: "WAIT", 6: "DEAD"}
+INSTANT_EVENTS = {
+    PMM_ALLOC: ("pmm_alloc", lambda a0, a1: {"address": hex(a0)}),
+    PMM_FREE: ("pmm_free", lambda a0, a1: {"address": hex(a0)}),
+    KMALLOC: ("kmalloc", lambda a0, a1: {"address": hex(a0), "size": a1}),
+    KFREE: ("kfree", lambda a0, a1: {"address": hex(a0)}),
+    PAGE_FAULT: ("page_fault", lambda a0, a1: {"address": hex(a0), "error_code": hex(a1)}),
+    THREAD_STATE: ("thread_state", lambda a0, a1: {"tid": a0, "status": THREAD_STATUS.get(a1, str(a1))}),
+}
+NO_THREAD = 0xFFFFFFFF
+KERNEL_PID = 0
+IRQ_PID = 1
+
+
+def parse_trace(lines):
+    header = None
+    events = []
+    lost = 0
+    for line in lines:
+        # The serial log can contain other messages, and the lines end with \r\n
+        line = line.strip()
+        if line.startswith("TRACE_BEGIN"):
+            fields = line.split()[1:]
+            header = {
+                "version": int(fields[0], 16),
+                "ticks_per_ms": int(fields[1], 16),
+                "boot_tsc": int(fields[2], 16),
+                "cpus": int(fields[3], 16),
+            }
+            events = []
+        elif line.startswith("TRACE_END") and header is not None:
+            lost = int(line.split()[1], 16)
+            break
+        elif line.startswith("T ") and header is not None:
+            cpu, tsc, event_id, tid, arg0, arg1 = (int(field, 16) for field in line.split()[1:7])
+            events.append((tsc, cpu, event_id, tid, arg0, arg1))
+    if header is None:
+        raise ValueError("No TRACE_BEGIN marker found")
+    events.sort()
+    return header, events, lost
+
+
+def to_chrome_trace(header, events, lost):
+    ticks_per_us = max(header["ticks_per_ms"], 1000) / 1000.0
+    boot_tsc = header["boot_tsc"]
+    output = []
+
+    def timestamp(tsc):
+        return (tsc - boot_tsc) / ticks_per_us
+
+    # Which thread is running on every cpu, so context switches can be drawn as slices
+    running = {}
+    threads = set()
+    for tsc, cpu, event_id, tid, arg0, arg1 in events:
+        ts = timestamp(tsc)
+        if tid != NO_THREAD:
+            threads.add(tid)
+        if event_id == CONTEXT_SWITCH:
+            previous = running.get(cpu)
+            if previous is not None:
+                output.append({"name": "thread %d" % previous[0], "ph": "X", "pid": KERNEL_PID, "tid": cpu,
+                               "ts": previous[1], "dur": ts - previous[1], "args": {"tid": previous[0]}})
+            running[cpu] = (arg1, ts)
+            threads.add(arg1)
+        elif event_id in (IRQ_ENTER, IRQ_EXIT):
+            output.append({"name": "irq 0x%x" % arg0, "ph": "B" if event_id == IRQ_ENTER else "E",
+                           "pid": IRQ_PID, "tid": cpu, "ts": ts})
+        elif event_id in (SYSCALL_ENTER, SYSCALL_EXIT):
+            event = {"name": "syscall %d" % arg0, "ph": "B" if event_id == SYSCALL_ENTER else "E",
+                     "pid": KERNEL_PID, "tid": 1000 + tid, "ts": ts}
+            if event_id == SYSCALL_EXIT:
+                event["args"] = {"return": arg1}
+            output.append(event)
+        elif event_id in INSTANT_EVENTS:
+            name, arguments = INSTANT_EVENTS[event_id]
+            track = 1000 + tid if tid != NO_THREAD else cpu
+            output.append({"name": name, "ph": "i", "s": "t", "pid": KERNEL_PID, "tid": track, "ts": ts,
+                           "args": arguments(arg0, arg1)})
+
+    for cpu in range(header["cpus"]):
+        output.append({"name": "thread_name", "ph": "M", "pid": KERNEL_PID, "tid": cpu, "args": {"name": "cpu %d" % cpu}})
+        output.append({"name": "thread_name", "ph": "M", "pid": IRQ_PID, "tid": cpu, "args": {"name": "irq cpu %d" % cpu}})
+    for tid in sorted(threads):
+        output.append({"name": "thread_name", "ph": "M", "pid": KERNEL_PID, "tid": 1000 + tid, "args": {"name": "thread %d" % tid}})
+    output.append({"name": "process_name", "ph": "M", "pid": KERNEL_PID, "args": {"name": "DreamOs64"}})
+    output.append({"name": "process_name", "ph": "M", "pid": IRQ_PID, "args": {"name": "Interrupts"}})
+    return {"traceEvents": output, "displayTimeUnit": "ns", "otherData": {"lost_events": lost, "version": header["version"]}}
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        return 1
+    with open(sys.argv[1], errors="replace") as log_file:
+        header, events, lost = parse_trace(log_file)
+    trace = to_chrome_trace(header, events, lost)
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], "w") as output_file:
+            json.dump(trace, output_file)
+    else:
+        json.dump(trace, sys.stdout)
+    print("%d events converted, %d lost" % (len(events), lost), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -89,4 +89,5 @@ interrupt_service_routine 32
 interrupt_service_routine 33
 interrupt_service_routine 34
 interrupt_service_routine 128
+interrupt_service_routine 129
 interrupt_service_routine 255
@@ -2,19 +2,314 @@
 #include <string.h>
 #include <ustar.h>
 
+#define FNV_OFFSET_BASIS    0x811C9DC5
+#define FNV_PRIME   0x01000193
+
+ustar_fs_t ustar_fs;
+
+static size_t ustar_octal_to_size(const char *field, size_t length) {
+    size_t value = 0;
+    for (size_t i = 0; i < length && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) + (field[i] - '0');
+    }
+    return value;
+}
+
+static size_t ustar_field_length(const char *field, size_t max_length) {
+    size_t length = 0;
+    while ( length < max_length && field[length] != '\0' ) {
+        length++;
+    }
+    return length;
+}
+
+/**
+ * The checksum is the sum of all the header bytes, with the checksum field considered as filled with spaces
+ */
+static bool ustar_checksum_valid(const ustar_item *header) {
+    const uint8_t *bytes = (const uint8_t *) header;
+    size_t checksum_start = offsetof(ustar_item, checksum);
+    size_t sum = 0;
+    for (size_t i = 0; i < HEADER_SIZE; i++) {
+        if ( i >= checksum_start && i < checksum_start + sizeof(header->checksum) ) {
+            sum += ' ';
+        } else {
+            sum += bytes[i];
+        }
+    }
+    return sum == ustar_octal_to_size(header->checksum, sizeof(header->checksum));
+}
+
+static bool ustar_is_zero_block(const uint8_t *block) {
+    for (size_t i = 0; i < HEADER_SIZE; i++) {
+        if ( block[i] != 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Remove the leading "/" and "./" and the trailing "/" from a path, without copying it.
+ *
+ * @param path the path to normalize
+ * @param length the length of path, updated with the length of the normalized path
+ * @return a pointer to the first character of the normalized path
+ */
+static const char *ustar_normalize(const char *path, size_t *length) {
+    size_t path_length = *length;
+    while ( path_length > 0 ) {
+        if ( path[0] == '/' ) {
+            path++;
+            path_length--;
+        } else if ( path_length > 1 && path[0] == '.' && path[1] == '/' ) {
+            path += 2;
+            path_length -= 2;
+        } else {
+            break;
+        }
+    }
+    while ( path_length > 0 && path[path_length - 1] == '/' ) {
+        path_length--;
+    }
+    *length = path_length;
+    return path;
+}
+
+static uint32_t ustar_hash_step(uint32_t hash, const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * The full name of an entry is prefix + "/" + filename, where the prefix is optional.
+ * When the prefix is present it is the normalized part, otherwise the filename is.
+ */
+static void ustar_entry_name(const ustar_item *header, const char **prefix, size_t *prefix_length, const char **name, size_t *name_length) {
+    *prefix_length = ustar_field_length(header->prefix, USTAR_PREFIX_SIZE);
+    *name_length = ustar_field_length(header->filename, USTAR_FILENAME_SIZE);
+    *name = header->filename;
+    *prefix = header->prefix;
+    if ( *prefix_length > 0 ) {
+        *prefix = ustar_normalize(header->prefix, prefix_length);
+        // The trailing / of a directory name is never part of the lookup path
+        while ( *name_length > 0 && (*name)[*name_length - 1] == '/' ) {
+            (*name_length)--;
+        }
+    }
+    if ( *prefix_length == 0 ) {
+        *name = ustar_normalize(header->filename, name_length);
+    }
+}
+
+static uint32_t ustar_entry_hash(const ustar_item *header) {
+    const char *prefix, *name;
+    size_t prefix_length, name_length;
+    ustar_entry_name(header, &prefix, &prefix_length, &name, &name_length);
+    uint32_t hash = FNV_OFFSET_BASIS;
+    if ( prefix_length > 0 ) {
+        hash = ustar_hash_step(hash, prefix, prefix_length);
+        hash = ustar_hash_step(hash, "/", 1);
+    }
+    return ustar_hash_step(hash, name, name_length);
+}
+
+static bool ustar_entry_matches(const ustar_item *header, const char *path, size_t path_length) {
+    const char *prefix, *name;
+    size_t prefix_length, name_length;
+    ustar_entry_name(header, &prefix, &prefix_length, &name, &name_length);
+    if ( prefix_length > 0 ) {
+        if ( path_length != prefix_length + 1 + name_length || strncmp(path, prefix, prefix_length) != 0 || path[prefix_length] != '/' ) {
+            return false;
+        }
+        path += prefix_length + 1;
+        path_length -= prefix_length + 1;
+    }
+    return path_length == name_length && strncmp(path, name, name_length) == 0;
+}
+
+/**
+ * Parse the archive in place and build the path index, the archive memory must stay mapped
+ * since read is served directly from it. Entries are read until the end of archive marker
+ * (a zero block), the end of the buffer or the first invalid header.
+ *
+ * @param archive the address of the archive
+ * @param archive_size the size of the archive in bytes
+ * @return true if the archive is valid and at least the first header has been parsed
+ */
+bool ustar_mount(const void *archive, size_t archive_size) {
+    ustar_fs.archive = archive;
+    ustar_fs.archive_size = archive_size;
+    ustar_fs.entries_count = 0;
+    for (size_t i = 0; i < USTAR_HASH_BUCKETS; i++) {
+        ustar_fs.buckets[i] = -1;
+    }
+    for (size_t i = 0; i < USTAR_MAX_OPENED_FILES; i++) {
+        ustar_fs.opened_files[i].entry = -1;
+        ustar_fs.opened_files[i].offset = 0;
+    }
+
+    if ( archive == NULL ) {
+        return false;
+    }
+
+    size_t offset = 0;
+    while ( offset + HEADER_SIZE <= archive_size ) {
+        const ustar_item *header = (const ustar_item *) (ustar_fs.archive + offset);
+        if ( ustar_is_zero_block((const uint8_t *) header) ) {
+            break;
+        }
+        if ( strncmp(header->magic, USTAR_MAGIC, 5) != 0 || !ustar_checksum_valid(header) ) {
+            pretty_logf(Error, "Invalid ustar header at offset: 0x%x", offset);
+            return offset > 0;
+        }
+        size_t size = ustar_octal_to_size(header->size, sizeof(header->size));
+        if ( size > archive_size - offset - HEADER_SIZE ) {
+            pretty_logf(Error, "Truncated ustar entry at offset: 0x%x", offset);
+            return offset > 0;
+        }
+        if ( ustar_fs.entries_count == USTAR_MAX_FILES ) {
+            pretty_logf(Error, "Too many files in the archive, only the first %d are available", USTAR_MAX_FILES);
+            break;
+        }
+
+        ustar_index_entry_t *entry = &ustar_fs.entries[ustar_fs.entries_count];
+        entry->header = header;
+        entry->data = (const char *) header + HEADER_SIZE;
+        entry->size = size;
+        entry->hash = ustar_entry_hash(header);
+        uint32_t bucket = entry->hash & (USTAR_HASH_BUCKETS - 1);
+        entry->next = ustar_fs.buckets[bucket];
+        ustar_fs.buckets[bucket] = ustar_fs.entries_count;
+        ustar_fs.entries_count++;
+
+        // The content is padded to a multiple of the header size
+        offset += HEADER_SIZE + ((size + HEADER_SIZE - 1) & ~((size_t) HEADER_SIZE - 1));
+    }
+    pretty_logf(Verbose, "Ustar archive mounted with %d entries", ustar_fs.entries_count);
+    return true;
+}
+
+/**
+ * Find an entry in the archive, the cost depends only on the path length.
+ *
+ * @param path the path relative to the mountpoint, leading and trailing "/" are ignored
+ * @return the index entry, or NULL if the path is not in the archive
+ */
+const ustar_index_entry_t *ustar_lookup(const char *path) {
+    if ( path == NULL || ustar_fs.entries_count == 0 ) {
+        return NULL;
+    }
+    size_t path_length = strlen(path);
+    path = ustar_normalize(path, &path_length);
+    uint32_t hash = ustar_hash_step(FNV_OFFSET_BASIS, path, path_length);
+    int32_t index = ustar_fs.buckets[hash & (USTAR_HASH_BUCKETS - 1)];
+    while ( index != -1 ) {
+        const ustar_index_entry_t *entry = &ustar_fs.entries[index];
+        if ( entry->hash == hash && ustar_entry_matches(entry->header, path, path_length) ) {
+            return entry;
+        }
+        index = entry->next;
+    }
+    return NULL;
+}
+
+static ustar_opened_file_t *ustar_get_opened_file(int ustar_fildes) {
+    int slot = ustar_fildes - USTAR_FD_BASE;
+    if ( slot < 0 || slot >= USTAR_MAX_OPENED_FILES || ustar_fs.opened_files[slot].entry == -1 ) {
+        return NULL;
+    }
+    return &ustar_fs.opened_files[slot];
+}
+
+/**
+ * The vfs lookup function, the returned node is an entry of the index
+ */
+const void *ustar_lookup_node(const char *path) {
+    return ustar_lookup(path);
+}
+
+/**
+ * Open an entry already found by ustar_lookup_node, the path is not parsed again
+ *
+ * @param node the entry of the index
+ * @param flags the open flags
+ * @return the driver file descriptor, or -1 if there are too many opened files
+ */
+int ustar_open_node(const void *node, int flags) {
+    (void) flags;
+    const ustar_index_entry_t *entry = node;
+    if ( entry == NULL ) {
+        return -1;
+    }
+    for (int i = 0; i < USTAR_MAX_OPENED_FILES; i++) {
+        if ( ustar_fs.opened_files[i].entry == -1 ) {
+            ustar_fs.opened_files[i].entry = entry - ustar_fs.entries;
+            ustar_fs.opened_files[i].offset = 0;
+            return i + USTAR_FD_BASE;
+        }
+    }
+    pretty_log(Error, "Too many opened files");
+    return -1;
+}
+
 int ustar_open(const char *path, int flags, ...) {
     pretty_logf(Verbose, "called with path: %s and flags: %d", path, flags);
-    return 3;
+    return ustar_open_node(ustar_lookup(path), flags);
 }
 
 int ustar_close(int ustar_fildes) {
     pretty_logf(Verbose, "called with fildes: %d", ustar_fildes);
+    ustar_opened_file_t *file = ustar_get_opened_file(ustar_fildes);
+    if ( file == NULL ) {
+        return -1;
+    }
+    file->entry = -1;
+    file->offset = 0;
     return 0;
 }
 
+/**
+ * Read from a given offset of the file, the data is copied straight from the archive memory.
+ * The driver file position is not changed.
+ *
+ * @param ustar_fildes the descriptor returned by ustar_open
+ * @param buf the destination buffer
+ * @param nbytes the maximum number of bytes to read
+ * @param offset the position in the file
+ * @return the number of bytes read, 0 at or after the end of the file, -1 if the descriptor is not valid
+ */
+ssize_t ustar_pread(int ustar_fildes, char *buf, size_t nbytes, size_t offset) {
+    ustar_opened_file_t *file = ustar_get_opened_file(ustar_fildes);
+    if ( file == NULL || buf == NULL ) {
+        return -1;
+    }
+    const ustar_index_entry_t *entry = &ustar_fs.entries[file->entry];
+    if ( entry->header->type == USTAR_TYPE_DIRECTORY ) {
+        return -1;
+    }
+    if ( offset >= entry->size ) {
+        return 0;
+    }
+    size_t available = entry->size - offset;
+    if ( nbytes > available ) {
+        nbytes = available;
+    }
+    memcpy(buf, (void *) (entry->data + offset), nbytes);
+    return nbytes;
+}
+
 ssize_t ustar_read(int ustar_fildes, char *buf, size_t nbytes) {
-    (void)ustar_fildes;
-    (void)nbytes;
-    strcpy(buf, "Test string");
-    return 12;
+    ustar_opened_file_t *file = ustar_get_opened_file(ustar_fildes);
+    if ( file == NULL ) {
+        return -1;
+    }
+    ssize_t read_bytes = ustar_pread(ustar_fildes, buf, nbytes, file->offset);
+    if ( read_bytes > 0 ) {
+        file->offset += read_bytes;
+    }
+    return read_bytes;
 }
@@ -0,0 +1,197 @@
+#include <dcache.h>
+#include <logging.h>
+#include <string.h>
+#include <vfs.h>
+
+#define FNV_OFFSET_BASIS    0x811C9DC5
+#define FNV_PRIME   0x01000193
+
+vfs_dcache_t vfs_dcache;
+
+static uint32_t vfs_dcache_hash(uint32_t parent_id, const char *name, size_t name_length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < sizeof(uint32_t); i++) {
+        hash ^= (parent_id >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+    for (size_t i = 0; i < name_length; i++) {
+        hash ^= (uint8_t) name[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void vfs_dcache_init() {
+    memset(&vfs_dcache.stats, 0, sizeof(vfs_dcache_stats_t));
+    spinlock_init(&vfs_dcache.lock);
+    vfs_dcache_invalidate();
+}
+
+/**
+ * Drop all the cached entries, it must be called every time the tree changes (i.e. when a filesystem is mounted)
+ */
+void vfs_dcache_invalidate() {
+    spinlock_acquire(&vfs_dcache.lock);
+    for (size_t i = 0; i < VFS_DCACHE_SIZE; i++) {
+        vfs_dcache.dentries[i].flags = 0;
+        vfs_dcache.dentries[i].next = VFS_DCACHE_NONE;
+    }
+    for (size_t i = 0; i < VFS_DCACHE_BUCKETS; i++) {
+        vfs_dcache.buckets[i] = VFS_DCACHE_NONE;
+    }
+    vfs_dentry_t *root = &vfs_dcache.root;
+    root->name[0] = '\0';
+    root->name_length = 0;
+    root->id = VFS_DENTRY_ROOT_ID;
+    root->parent_id = 0;
+    root->hash = 0;
+    root->flags = VFS_DENTRY_USED | VFS_DENTRY_MOUNT_ROOT;
+    root->mount_node = 0;
+    root->mountpoint_id = vfs_mount_trie[0].mountpoint_id >= 0 ? vfs_mount_trie[0].mountpoint_id : 0;
+    root->node = NULL;
+    root->next = VFS_DCACHE_NONE;
+    vfs_dcache.next_id = VFS_DENTRY_ROOT_ID + 1;
+    vfs_dcache.clock_hand = 0;
+    spinlock_release(&vfs_dcache.lock);
+}
+
+static vfs_dentry_t *vfs_dcache_find(uint32_t parent_id, const char *name, size_t name_length, uint32_t hash) {
+    int32_t index = vfs_dcache.buckets[hash & (VFS_DCACHE_BUCKETS - 1)];
+    while ( index != VFS_DCACHE_NONE ) {
+        vfs_dentry_t *dentry = &vfs_dcache.dentries[index];
+        if ( dentry->hash == hash && dentry->parent_id == parent_id && dentry->name_length == name_length && strncmp(dentry->name, name, name_length) == 0 ) {
+            return dentry;
+        }
+        index = dentry->next;
+    }
+    return NULL;
+}
+
+static void vfs_dcache_unlink(int32_t index) {
+    int32_t *link = &vfs_dcache.buckets[vfs_dcache.dentries[index].hash & (VFS_DCACHE_BUCKETS - 1)];
+    while ( *link != VFS_DCACHE_NONE ) {
+        if ( *link == index ) {
+            *link = vfs_dcache.dentries[index].next;
+            return;
+        }
+        link = &vfs_dcache.dentries[*link].next;
+    }
+}
+
+/**
+ * Get a free entry, if the cache is full the first entry not referenced since the last pass of the clock is replaced.
+ */
+static int32_t vfs_dcache_alloc() {
+    while ( true ) {
+        int32_t index = vfs_dcache.clock_hand;
+        vfs_dentry_t *dentry = &vfs_dcache.dentries[index];
+        vfs_dcache.clock_hand = (vfs_dcache.clock_hand + 1) % VFS_DCACHE_SIZE;
+        if ( !(dentry->flags & VFS_DENTRY_USED) ) {
+            return index;
+        }
+        if ( dentry->flags & VFS_DENTRY_REFERENCED ) {
+            dentry->flags &= ~VFS_DENTRY_REFERENCED;
+            continue;
+        }
+        vfs_dcache_unlink(index);
+        vfs_dcache.stats.evictions++;
+        return index;
+    }
+}
+
+static vfs_dentry_t *vfs_dcache_create(const vfs_dentry_t *parent, const char *name, size_t name_length, uint32_t hash) {
+    // The parent itself can be replaced by the allocation, so its fields are read before
+    uint32_t parent_id = parent->id;
+    int parent_mountpoint_id = parent->mountpoint_id;
+    int mountpoint_id = -1;
+    int mount_node = parent->mount_node != VFS_MOUNT_TRIE_NONE ? vfs_mount_trie_step(parent->mount_node, name, name_length, &mountpoint_id) : VFS_MOUNT_TRIE_NONE;
+
+    int32_t index = vfs_dcache_alloc();
+    vfs_dentry_t *dentry = &vfs_dcache.dentries[index];
+    memcpy(dentry->name, (void *) name, name_length);
+    dentry->name[name_length] = '\0';
+    dentry->name_length = name_length;
+    dentry->id = vfs_dcache.next_id++;
+    dentry->parent_id = parent_id;
+    dentry->hash = hash;
+    dentry->flags = VFS_DENTRY_USED;
+    dentry->mount_node = mount_node;
+    dentry->mountpoint_id = parent_mountpoint_id;
+    if ( mountpoint_id >= 0 ) {
+        dentry->mountpoint_id = mountpoint_id;
+        dentry->flags |= VFS_DENTRY_MOUNT_ROOT;
+    }
+    dentry->node = NULL;
+    dentry->next = vfs_dcache.buckets[hash & (VFS_DCACHE_BUCKETS - 1)];
+    vfs_dcache.buckets[hash & (VFS_DCACHE_BUCKETS - 1)] = index;
+    return dentry;
+}
+
+/**
+ * Resolve a path to its mountpoint and driver node. Every component is searched in the cache by (parent, name),
+ * so a hot path is resolved without scanning the mountpoints and without calling the driver lookup.
+ * Paths that don't exist are cached too (negative entries).
+ * The cache lock is held for the whole walk, driver lookup included.
+ *
+ * @param path an absolute path
+ * @param resolved the result of the resolution
+ * @return the mountpoint id
+ */
+int vfs_resolve_path(const char *path, vfs_resolved_path_t *resolved) {
+    spinlock_acquire(&vfs_dcache.lock);
+    vfs_dentry_t *dentry = &vfs_dcache.root;
+    resolved->mountpoint_id = dentry->mountpoint_id;
+    resolved->relative_path = path;
+    resolved->negative = false;
+    resolved->node = NULL;
+
+    size_t component_length;
+    const char *component = vfs_next_component(path, &component_length);
+    while ( component != NULL ) {
+        if ( component_length >= VFS_DENTRY_NAME_LEN ) {
+            // Not cacheable, the driver will parse the path
+            spinlock_release(&vfs_dcache.lock);
+            resolved->mountpoint_id = vfs_find_mountpoint(path, &resolved->relative_path);
+            return resolved->mountpoint_id;
+        }
+        uint32_t hash = vfs_dcache_hash(dentry->id, component, component_length);
+        vfs_dentry_t *child = vfs_dcache_find(dentry->id, component, component_length, hash);
+        if ( child != NULL ) {
+            vfs_dcache.stats.hits++;
+        } else {
+            vfs_dcache.stats.misses++;
+            child = vfs_dcache_create(dentry, component, component_length, hash);
+        }
+        child->flags |= VFS_DENTRY_REFERENCED;
+        dentry = child;
+        if ( dentry->flags & VFS_DENTRY_MOUNT_ROOT ) {
+            resolved->mountpoint_id = dentry->mountpoint_id;
+            resolved->relative_path = component + component_length;
+        }
+        if ( dentry->flags & VFS_DENTRY_NEGATIVE ) {
+            // Nothing can exist below a missing component
+            vfs_dcache.stats.negative_hits++;
+            resolved->negative = true;
+            spinlock_release(&vfs_dcache.lock);
+            return resolved->mountpoint_id;
+        }
+        component = vfs_next_component(component + component_length, &component_length);
+    }
+
+    if ( !(dentry->flags & VFS_DENTRY_RESOLVED) ) {
+        fs_file_operations_t *file_operations = &mountpoints[resolved->mountpoint_id].file_operations;
+        if ( file_operations->lookup != NULL ) {
+            vfs_dcache.stats.driver_lookups++;
+            dentry->node = file_operations->lookup(resolved->relative_path);
+            // The directories containing a mountpoint exist even if the driver doesn't know them
+            if ( dentry->node == NULL && dentry->mount_node == VFS_MOUNT_TRIE_NONE ) {
+                dentry->flags |= VFS_DENTRY_NEGATIVE;
+            }
+        }
+        dentry->flags |= VFS_DENTRY_RESOLVED;
+    }
+    resolved->negative = (dentry->flags & VFS_DENTRY_NEGATIVE) != 0;
+    resolved->node = dentry->node;
+    spinlock_release(&vfs_dcache.lock);
+    return resolved->mountpoint_id;
+}
@@ -1,38 +1,55 @@
+#include <dcache.h>
 #include <fcntl.h>
+#include <fd_table.h>
 #include <logging.h>
 #include <string.h>
 #include <vfs.h>
 
-vfs_file_descriptor_t vfs_opened_files[OPENEDFILES_MAX];
-
 int open(const char *path, int flags) {
     pretty_logf(Verbose, "(open) Try to open file: %s", path);
-    int mountpoint_id = get_mountpoint_id(path);
-    if (mountpoint_id < 0) {
+    vfs_resolved_path_t resolved;
+    int mountpoint_id = vfs_resolve_path(path, &resolved);
+    if (mountpoint_id < 0 || resolved.negative) {
         return -1;
     }
 
     pretty_logf(Verbose, "(open) --- mountpoint id for file: %d and flags: %d ", mountpoint_id, flags);
-    mountpoint_t mountpoint = mountpoints[mountpoint_id];
-    pretty_logf(Verbose, "(open) --- mountpoint id for file: %s", mountpoint.mountpoint);
-    char *relative_path = get_relative_path(mountpoint.mountpoint, path);
-    pretty_logf(Verbose, "(open) --- relative path is: %s", relative_path);
-    if (mountpoint.file_operations.open == NULL) {
+    mountpoint_t *mountpoint = &mountpoints[mountpoint_id];
+    pretty_logf(Verbose, "(open) --- mountpoint id for file: %s", mountpoint->mountpoint);
+    pretty_logf(Verbose, "(open) --- relative path is: %s", resolved.relative_path);
+
+    int driver_fd;
+    if (resolved.node != NULL && mountpoint->file_operations.open_node != NULL) {
+        // The cache already has the driver node, the driver doesn't need to parse the path
+        driver_fd = mountpoint->file_operations.open_node(resolved.node, flags);
+    } else if (mountpoint->file_operations.open != NULL) {
+        driver_fd = mountpoint->file_operations.open(resolved.relative_path, flags);
+    } else {
         return -1;
     }
-
-    int driver_fd = mountpoint.file_operations.open(relative_path, flags);
     if (driver_fd < 0) {
         return -1;
     }
 
-    if ( vfs_fd_index > OPENEDFILES_MAX ) {
+    fd_table_t *fd_table = get_current_fd_table();
+    int fd = fd_table_alloc(fd_table);
+    if ( fd < 0 ) {
+        pretty_log(Error, "(open) Too many opened files");
+        if (mountpoint->file_operations.close != NULL) {
+            mountpoint->file_operations.close(driver_fd);
+        }
         return -1;
     }
 
-    vfs_opened_files[vfs_fd_index].fs_specific_id = driver_fd;
-    vfs_opened_files[vfs_fd_index].mountpoint_id = mountpoint_id;
-    vfs_opened_files[vfs_fd_index].buffer_read_pos = 0;
-    strcpy(vfs_opened_files[vfs_fd_index].filename, path);
-    return vfs_fd_index++;
+    // Another thread of the task can grow the table between the allocation and here, so the descriptor is fetched again
+    rwlock_read_acquire(&fd_table->lock);
+    vfs_file_descriptor_t *file = fd_table_get(fd_table, fd);
+    file->fs_specific_id = driver_fd;
+    file->mountpoint_id = mountpoint_id;
+    file->node = resolved.node;
+    file->offset = 0;
+    strncpy(file->filename, path, MAX_FILENAME_LEN - 1);
+    file->filename[MAX_FILENAME_LEN - 1] = '\0';
+    rwlock_read_release(&fd_table->lock);
+    return fd;
 }
@@ -0,0 +1,202 @@
+#include <fd_table.h>
+#include <kheap.h>
+#include <logging.h>
+#include <page_cache.h>
+#include <string.h>
+#ifndef _TEST_
+#include <scheduler.h>
+#include <task.h>
+#endif
+
+// Used when there is no task running (i.e. during the kernel initialization)
+fd_table_t kernel_fd_table;
+
+/**
+ * Initialize an empty table, the memory is allocated on the first open.
+ *
+ * @param table the table to initialize
+ */
+void fd_table_init(fd_table_t *table) {
+    table->files = NULL;
+    table->used_rows = NULL;
+    table->full_rows = 0;
+    table->size = 0;
+    table->opened_files = 0;
+    rwlock_init(&table->lock);
+}
+
+/**
+ * Release the table memory, the files still opened are not closed.
+ *
+ * @param table the table to destroy
+ */
+void fd_table_destroy(fd_table_t *table) {
+    if ( table->files != NULL ) {
+        kfree(table->files);
+    }
+    if ( table->used_rows != NULL ) {
+        kfree(table->used_rows);
+    }
+    fd_table_init(table);
+}
+
+static bool fd_table_grow(fd_table_t *table) {
+    size_t new_size = table->size == 0 ? FD_TABLE_INITIAL_SIZE : table->size * 2;
+    if ( new_size > FD_TABLE_MAX_SIZE ) {
+        return false;
+    }
+    vfs_file_descriptor_t *files = kmalloc(new_size * sizeof(vfs_file_descriptor_t));
+    uint64_t *used_rows = kmalloc((new_size / FD_TABLE_ROW_BITS) * sizeof(uint64_t));
+    if ( files == NULL || used_rows == NULL ) {
+        if ( files != NULL ) {
+            kfree(files);
+        }
+        if ( used_rows != NULL ) {
+            kfree(used_rows);
+        }
+        return false;
+    }
+    size_t old_rows = table->size / FD_TABLE_ROW_BITS;
+    if ( table->size > 0 ) {
+        memcpy(files, table->files, table->size * sizeof(vfs_file_descriptor_t));
+        memcpy(used_rows, table->used_rows, old_rows * sizeof(uint64_t));
+        kfree(table->files);
+        kfree(table->used_rows);
+    }
+    memset(used_rows + old_rows, 0, (new_size / FD_TABLE_ROW_BITS - old_rows) * sizeof(uint64_t));
+    table->files = files;
+    table->used_rows = used_rows;
+    table->size = new_size;
+    return true;
+}
+
+/**
+ * Allocate the lowest free descriptor, the table grows if it is full.
+ *
+ * @param table the table of the task
+ * @return the descriptor, or -1 if the table can't grow anymore
+ */
+int fd_table_alloc(fd_table_t *table) {
+    rwlock_write_acquire(&table->lock);
+    size_t rows = table->size / FD_TABLE_ROW_BITS;
+    uint64_t rows_mask = rows == FD_TABLE_ROW_BITS ? ~0ULL : (1ULL << rows) - 1;
+    uint64_t free_rows = ~table->full_rows & rows_mask;
+    if ( free_rows == 0 ) {
+        if ( !fd_table_grow(table) ) {
+            rwlock_write_release(&table->lock);
+            return -1;
+        }
+        // The first new row is free
+        free_rows = 1ULL << rows;
+    }
+    size_t row = __builtin_ctzll(free_rows);
+    size_t column = __builtin_ctzll(~table->used_rows[row]);
+    table->used_rows[row] |= 1ULL << column;
+    if ( table->used_rows[row] == ~0ULL ) {
+        table->full_rows |= 1ULL << row;
+    }
+    table->opened_files++;
+    int fd = row * FD_TABLE_ROW_BITS + column;
+    vfs_file_descriptor_t *file = &table->files[fd];
+    file->fs_specific_id = -1;
+    file->mountpoint_id = -1;
+    file->filename[0] = '\0';
+    file->offset = 0;
+    file->node = NULL;
+    file->readahead_last_page = PAGE_CACHE_NO_PAGE;
+    file->readahead_window = 0;
+    rwlock_write_release(&table->lock);
+    return fd;
+}
+
+/**
+ * Get an allocated descriptor. The caller must hold the table lock (for reading is enough) as long as it uses the
+ * descriptor: another thread of the task can grow the table and move it meanwhile.
+ *
+ * @param table the table of the task
+ * @param fd the descriptor number
+ * @return the descriptor, or NULL if fd is not allocated
+ */
+vfs_file_descriptor_t *fd_table_get(fd_table_t *table, int fd) {
+    if ( fd < 0 || (size_t) fd >= table->size ) {
+        return NULL;
+    }
+    if ( !(table->used_rows[fd / FD_TABLE_ROW_BITS] & (1ULL << (fd % FD_TABLE_ROW_BITS))) ) {
+        return NULL;
+    }
+    return &table->files[fd];
+}
+
+/**
+ * Release a descriptor, it will be the first one returned by fd_table_alloc if it's the lowest free.
+ *
+ * @param table the table of the task
+ * @param fd the descriptor number
+ * @return false if fd was not allocated
+ */
+static void fd_table_clear(fd_table_t *table, int fd) {
+    table->used_rows[fd / FD_TABLE_ROW_BITS] &= ~(1ULL << (fd % FD_TABLE_ROW_BITS));
+    table->full_rows &= ~(1ULL << (fd / FD_TABLE_ROW_BITS));
+    table->opened_files--;
+}
+
+bool fd_table_release(fd_table_t *table, int fd) {
+    rwlock_write_acquire(&table->lock);
+    if ( fd_table_get(table, fd) == NULL ) {
+        rwlock_write_release(&table->lock);
+        return false;
+    }
+    fd_table_clear(table, fd);
+    rwlock_write_release(&table->lock);
+    return true;
+}
+
+/**
+ * Close a file through its driver and release its descriptor, both with the table lock held for writing,
+ * so two threads closing the same descriptor can't both call the driver.
+ *
+ * @param table the table of the task
+ * @param fd the descriptor number
+ * @return false if fd was not allocated
+ */
+bool fd_table_close(fd_table_t *table, int fd) {
+    rwlock_write_acquire(&table->lock);
+    vfs_file_descriptor_t *file = fd_table_get(table, fd);
+    if ( file == NULL ) {
+        rwlock_write_release(&table->lock);
+        return false;
+    }
+    vfs_close_file(file);
+    fd_table_clear(table, fd);
+    rwlock_write_release(&table->lock);
+    return true;
+}
+
+/**
+ * Close all the files still opened through their drivers, and release the descriptors (i.e. when the task is destroyed).
+ *
+ * @param table the table to empty
+ */
+void fd_table_close_all(fd_table_t *table) {
+    for (size_t row = 0; row < table->size / FD_TABLE_ROW_BITS; row++) {
+        uint64_t used = table->used_rows[row];
+        while ( used != 0 ) {
+            int fd = row * FD_TABLE_ROW_BITS + __builtin_ctzll(used);
+            used &= used - 1;
+            vfs_close_file(&table->files[fd]);
+            fd_table_release(table, fd);
+        }
+    }
+}
+
+#ifndef _TEST_
+/**
+ * Return the table of the task currently running, or the kernel one if there are no tasks yet
+ */
+fd_table_t *get_current_fd_table() {
+    if ( current_executing_thread != NULL && current_executing_thread->parent_task != NULL ) {
+        return &current_executing_thread->parent_task->fd_table;
+    }
+    return &kernel_fd_table;
+}
+#endif
@@ -0,0 +1,342 @@
+#include <page_cache.h>
+#include <hh_direct_map.h>
+#include <logging.h>
+#include <pmm.h>
+#include <string.h>
+
+page_cache_t page_cache;
+
+static uint32_t page_cache_hash(int mountpoint_id, const void *node, size_t page_index) {
+    uint64_t key = ((uint64_t) (uintptr_t) node) ^ ((uint64_t) mountpoint_id << 56) ^ (page_index * 0x9E3779B97F4A7C15ULL);
+    key ^= key >> 33;
+    key *= 0xFF51AFD7ED558CCDULL;
+    key ^= key >> 33;
+    return (uint32_t) key & (PAGE_CACHE_BUCKETS - 1);
+}
+
+/**
+ * Initialize the empty cache, the frames are taken from the pmm only when needed,
+ * and they are given back when the pmm runs out of memory.
+ */
+void init_page_cache() {
+    for (size_t i = 0; i < PAGE_CACHE_BUCKETS; i++) {
+        page_cache.buckets[i] = PAGE_CACHE_NONE;
+    }
+    for (size_t i = 0; i < PAGE_CACHE_MAX_PAGES; i++) {
+        page_cache.pages[i].used = false;
+        page_cache.pages[i].data = NULL;
+    }
+    page_cache.lru_head = PAGE_CACHE_NONE;
+    page_cache.lru_tail = PAGE_CACHE_NONE;
+    page_cache.free_pages = PAGE_CACHE_NONE;
+    for (size_t i = 0; i < PAGE_CACHE_MAX_FRAMES; i++) {
+        page_cache.frames[i] = NULL;
+        page_cache.frame_used_pages[i] = 0;
+    }
+    page_cache.frames_count = 0;
+    memset(&page_cache.stats, 0, sizeof(page_cache_stats_t));
+    spinlock_init(&page_cache.lock);
+    pmm_set_reclaim(page_cache_shrink);
+    pretty_logf(Verbose, "Page cache initialized: page size: 0x%x - max pages: %d", PAGE_CACHE_PAGE_SIZE, PAGE_CACHE_MAX_PAGES);
+}
+
+static void page_cache_lru_unlink(int32_t index) {
+    page_cache_page_t *page = &page_cache.pages[index];
+    if ( page->lru_prev != PAGE_CACHE_NONE ) {
+        page_cache.pages[page->lru_prev].lru_next = page->lru_next;
+    } else {
+        page_cache.lru_head = page->lru_next;
+    }
+    if ( page->lru_next != PAGE_CACHE_NONE ) {
+        page_cache.pages[page->lru_next].lru_prev = page->lru_prev;
+    } else {
+        page_cache.lru_tail = page->lru_prev;
+    }
+}
+
+static void page_cache_lru_push(int32_t index) {
+    page_cache_page_t *page = &page_cache.pages[index];
+    page->lru_prev = PAGE_CACHE_NONE;
+    page->lru_next = page_cache.lru_head;
+    if ( page_cache.lru_head != PAGE_CACHE_NONE ) {
+        page_cache.pages[page_cache.lru_head].lru_prev = index;
+    } else {
+        page_cache.lru_tail = index;
+    }
+    page_cache.lru_head = index;
+}
+
+static void page_cache_hash_unlink(int32_t index) {
+    page_cache_page_t *page = &page_cache.pages[index];
+    int32_t *link = &page_cache.buckets[page_cache_hash(page->mountpoint_id, page->node, page->page_index)];
+    while ( *link != PAGE_CACHE_NONE ) {
+        if ( *link == index ) {
+            *link = page->hash_next;
+            return;
+        }
+        link = &page_cache.pages[*link].hash_next;
+    }
+}
+
+/**
+ * Remove a page from the cache, its memory goes in the free list
+ */
+static void page_cache_evict(int32_t index) {
+    page_cache_hash_unlink(index);
+    page_cache_lru_unlink(index);
+    page_cache.pages[index].used = false;
+    page_cache.pages[index].hash_next = page_cache.free_pages;
+    page_cache.free_pages = index;
+    page_cache.frame_used_pages[index / PAGE_CACHE_PAGES_PER_FRAME]--;
+}
+
+static int32_t page_cache_find(int mountpoint_id, const void *node, size_t page_index) {
+    int32_t index = page_cache.buckets[page_cache_hash(mountpoint_id, node, page_index)];
+    while ( index != PAGE_CACHE_NONE ) {
+        page_cache_page_t *page = &page_cache.pages[index];
+        if ( page->node == node && page->page_index == page_index && page->mountpoint_id == mountpoint_id ) {
+            return index;
+        }
+        index = page->hash_next;
+    }
+    return PAGE_CACHE_NONE;
+}
+
+/**
+ * Take a frame from the pmm for an empty slot, and put all its pages in the free list.
+ *
+ * @return true if the cache has grown
+ */
+static bool page_cache_grow() {
+    for (size_t frame = 0; frame < PAGE_CACHE_MAX_FRAMES; frame++) {
+        if ( page_cache.frames[frame] != NULL ) {
+            continue;
+        }
+        void *frame_address = pmm_alloc_frame();
+        if ( frame_address == NULL ) {
+            return false;
+        }
+        page_cache.frames[frame] = frame_address;
+        page_cache.frame_used_pages[frame] = 0;
+        page_cache.frames_count++;
+        uint8_t *frame_data = hhdm_get_variable((uintptr_t) frame_address);
+        for (size_t i = PAGE_CACHE_PAGES_PER_FRAME; i > 0; i--) {
+            int32_t index = frame * PAGE_CACHE_PAGES_PER_FRAME + i - 1;
+            page_cache.pages[index].data = frame_data + (i - 1) * PAGE_CACHE_PAGE_SIZE;
+            page_cache.pages[index].hash_next = page_cache.free_pages;
+            page_cache.free_pages = index;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Give a frame without used pages back to the pmm, its pages are removed from the free list.
+ */
+static void page_cache_release_frame(size_t frame) {
+    int32_t *link = &page_cache.free_pages;
+    while ( *link != PAGE_CACHE_NONE ) {
+        if ( (size_t) *link / PAGE_CACHE_PAGES_PER_FRAME == frame ) {
+            page_cache.pages[*link].data = NULL;
+            *link = page_cache.pages[*link].hash_next;
+        } else {
+            link = &page_cache.pages[*link].hash_next;
+        }
+    }
+    pmm_free_frame(page_cache.frames[frame]);
+    page_cache.frames[frame] = NULL;
+    page_cache.frames_count--;
+}
+
+/**
+ * Get a page to be filled: a free one, a new one carved from a pmm frame, or the least recently used.
+ */
+static int32_t page_cache_alloc_page() {
+    // If the pmm is out of memory the cache can't grow, and the old pages are replaced
+    if ( page_cache.free_pages == PAGE_CACHE_NONE && !page_cache_grow() ) {
+        if ( page_cache.lru_tail == PAGE_CACHE_NONE ) {
+            return PAGE_CACHE_NONE;
+        }
+        page_cache_evict(page_cache.lru_tail);
+        page_cache.stats.evictions++;
+    }
+    int32_t index = page_cache.free_pages;
+    page_cache.free_pages = page_cache.pages[index].hash_next;
+    page_cache.frame_used_pages[index / PAGE_CACHE_PAGES_PER_FRAME]++;
+    return index;
+}
+
+/**
+ * Read a page of the file from the driver and add it to the cache
+ *
+ * @return the page index in the cache, or PAGE_CACHE_NONE if the driver read failed or there is no memory
+ */
+static int32_t page_cache_fill(vfs_file_descriptor_t *file, size_t page_index) {
+    int32_t index = page_cache_alloc_page();
+    if ( index == PAGE_CACHE_NONE ) {
+        return PAGE_CACHE_NONE;
+    }
+    page_cache_page_t *page = &page_cache.pages[index];
+    fs_file_operations_t *file_operations = &mountpoints[file->mountpoint_id].file_operations;
+    ssize_t length = file_operations->pread(file->fs_specific_id, (char *) page->data, PAGE_CACHE_PAGE_SIZE, page_index * PAGE_CACHE_PAGE_SIZE);
+    if ( length < 0 ) {
+        page->hash_next = page_cache.free_pages;
+        page_cache.free_pages = index;
+        page_cache.frame_used_pages[index / PAGE_CACHE_PAGES_PER_FRAME]--;
+        return PAGE_CACHE_NONE;
+    }
+    page->mountpoint_id = file->mountpoint_id;
+    page->node = file->node;
+    page->page_index = page_index;
+    page->length = length;
+    page->used = true;
+    uint32_t bucket = page_cache_hash(page->mountpoint_id, page->node, page_index);
+    page->hash_next = page_cache.buckets[bucket];
+    page_cache.buckets[bucket] = index;
+    page_cache_lru_push(index);
+    return index;
+}
+
+static int32_t page_cache_get(vfs_file_descriptor_t *file, size_t page_index) {
+    int32_t index = page_cache_find(file->mountpoint_id, file->node, page_index);
+    if ( index != PAGE_CACHE_NONE ) {
+        page_cache.stats.hits++;
+        page_cache_lru_unlink(index);
+        page_cache_lru_push(index);
+        return index;
+    }
+    page_cache.stats.misses++;
+    return page_cache_fill(file, page_index);
+}
+
+/**
+ * Read the pages following a sequential read, so the next read will find them in the cache.
+ */
+static void page_cache_readahead(vfs_file_descriptor_t *file, size_t page_index) {
+    for (size_t i = 0; i < file->readahead_window; i++) {
+        int32_t index = page_cache_find(file->mountpoint_id, file->node, page_index + i);
+        if ( index == PAGE_CACHE_NONE ) {
+            index = page_cache_fill(file, page_index + i);
+            if ( index == PAGE_CACHE_NONE ) {
+                return;
+            }
+            page_cache.stats.readahead_pages++;
+        }
+        // A partial page is the end of the file
+        if ( page_cache.pages[index].length < PAGE_CACHE_PAGE_SIZE ) {
+            return;
+        }
+    }
+}
+
+/**
+ * Read from a file through the page cache. The missing pages are read with the driver pread function,
+ * and if the reads on the descriptor are sequential the next pages are read in advance.
+ * The file must have a driver node, and the driver must implement pread.
+ *
+ * @param file the file descriptor
+ * @param buf the destination buffer
+ * @param nbytes the number of bytes to read
+ * @param offset the position in the file
+ * @return the number of bytes read, 0 at the end of the file, -1 if the driver read failed
+ */
+ssize_t page_cache_read(vfs_file_descriptor_t *file, void *buf, size_t nbytes, size_t offset) {
+    size_t first_page = offset / PAGE_CACHE_PAGE_SIZE;
+    size_t read_bytes = 0;
+    spinlock_acquire(&page_cache.lock);
+
+    // A read starting where the previous one stopped is sequential
+    if ( first_page == file->readahead_last_page || first_page == file->readahead_last_page + 1 ) {
+        if ( file->readahead_window == 0 ) {
+            file->readahead_window = PAGE_CACHE_READAHEAD_MIN;
+        } else if ( first_page != file->readahead_last_page && file->readahead_window < PAGE_CACHE_READAHEAD_MAX ) {
+            file->readahead_window *= 2;
+        }
+    } else {
+        file->readahead_window = 0;
+    }
+
+    size_t page_index = first_page;
+    bool end_of_file = false;
+    while ( read_bytes < nbytes ) {
+        int32_t index = page_cache_get(file, page_index);
+        if ( index == PAGE_CACHE_NONE ) {
+            spinlock_release(&page_cache.lock);
+            return read_bytes > 0 ? (ssize_t) read_bytes : -1;
+        }
+        page_cache_page_t *page = &page_cache.pages[index];
+        size_t page_offset = (offset + read_bytes) % PAGE_CACHE_PAGE_SIZE;
+        if ( page_offset >= page->length ) {
+            end_of_file = true;
+            break;
+        }
+        size_t count = page->length - page_offset;
+        if ( count > nbytes - read_bytes ) {
+            count = nbytes - read_bytes;
+        }
+        memcpy((uint8_t *) buf + read_bytes, page->data + page_offset, count);
+        read_bytes += count;
+        if ( page->length < PAGE_CACHE_PAGE_SIZE ) {
+            end_of_file = true;
+            break;
+        }
+        if ( read_bytes < nbytes ) {
+            page_index++;
+        }
+    }
+    file->readahead_last_page = page_index;
+
+    if ( !end_of_file && file->readahead_window > 0 ) {
+        page_cache_readahead(file, page_index + 1);
+    }
+    spinlock_release(&page_cache.lock);
+    return read_bytes;
+}
+
+/**
+ * Drop all the cached pages, the memory is kept for the next reads (until the pmm asks it back).
+ * It must be called when the cached files are not valid anymore (i.e. when a driver is mounted again).
+ */
+void page_cache_invalidate() {
+    spinlock_acquire(&page_cache.lock);
+    while ( page_cache.lru_head != PAGE_CACHE_NONE ) {
+        page_cache_evict(page_cache.lru_head);
+    }
+    spinlock_release(&page_cache.lock);
+}
+
+/**
+ * Give frames back to the pmm, it's called by pmm_alloc_frame when the memory runs out.
+ * The frames without cached pages go first, then the frame of the least recently used page is emptied.
+ * If the cache is busy nothing is freed: the allocation can come from the cache itself.
+ *
+ * @param frames the number of frames to free
+ * @return the number of frames freed
+ */
+size_t page_cache_shrink(size_t frames) {
+    size_t released = 0;
+    if ( !spinlock_try_acquire(&page_cache.lock) ) {
+        return 0;
+    }
+    for (size_t frame = 0; frame < PAGE_CACHE_MAX_FRAMES && released < frames; frame++) {
+        if ( page_cache.frames[frame] != NULL && page_cache.frame_used_pages[frame] == 0 ) {
+            page_cache_release_frame(frame);
+            released++;
+        }
+    }
+    while ( released < frames && page_cache.lru_tail != PAGE_CACHE_NONE ) {
+        size_t frame = page_cache.lru_tail / PAGE_CACHE_PAGES_PER_FRAME;
+        for (size_t i = 0; i < PAGE_CACHE_PAGES_PER_FRAME; i++) {
+            int32_t index = frame * PAGE_CACHE_PAGES_PER_FRAME + i;
+            if ( page_cache.pages[index].used ) {
+                page_cache_evict(index);
+                page_cache.stats.evictions++;
+            }
+        }
+        page_cache_release_frame(frame);
+        released++;
+    }
+    spinlock_release(&page_cache.lock);
+    return released;
+}
@@ -1,59 +1,229 @@
+#include <dcache.h>
 #include <logging.h>
+#include <rcu.h>
+#include <spinlock.h>
 #include <string.h>
 #include <ustar.h>
 #include <vfs.h>
 
 mountpoint_t mountpoints[MOUNTPOINTS_MAX];
-unsigned int vfs_fd_index;
+vfs_mount_node_t vfs_mount_trie[VFS_MOUNT_TRIE_NODES];
 
+size_t vfs_mount_trie_size;
+
+// The path resolutions walk the trie without locks, inside an rcu read section: the lock only serializes mount_fs.
+// The nodes are never removed, so nothing waits for a grace period: a new node is initialized before being linked.
+spinlock_t vfs_mount_lock;
+
+static void vfs_init_mount_node(int node, const char *name, size_t name_length) {
+    memcpy(vfs_mount_trie[node].name, (void *) name, name_length);
+    vfs_mount_trie[node].name[name_length] = '\0';
+    vfs_mount_trie[node].name_length = name_length;
+    vfs_mount_trie[node].mountpoint_id = -1;
+    vfs_mount_trie[node].first_child = VFS_MOUNT_TRIE_NONE;
+    vfs_mount_trie[node].next_sibling = VFS_MOUNT_TRIE_NONE;
+}
 
 void vfs_init() {
     pretty_log(Verbose, "Initializiing VFS layer");
+    spinlock_init(&vfs_mount_lock);
     for (int i=0; i < MOUNTPOINTS_MAX; i++) {
         strcpy(mountpoints[i].name, "");
         strcpy(mountpoints[i].mountpoint, "");
-        mountpoints[i].file_operations.open = NULL;
-        mountpoints[i].file_operations.close = NULL;
+        memset(&mountpoints[i].file_operations, 0, sizeof(fs_file_operations_t));
     }
+    // Node 0 is always the root of the trie
+    vfs_init_mount_node(0, "", 0);
+    vfs_mount_trie_size = 1;
+    vfs_dcache_init();
 
-    vfs_fd_index=0;
-
+    fs_file_operations_t no_operations;
+    memset(&no_operations, 0, sizeof(fs_file_operations_t));
+    fs_file_operations_t ustar_operations = {
+        .open = ustar_open,
+        .close = ustar_close,
+        .read = ustar_read,
+        .write = NULL,
+        .pread = ustar_pread,
+        .lookup = ustar_lookup_node,
+        .open_node = ustar_open_node
+    };
     // The first item will always be the root!
-    strcpy(mountpoints[0].name, "ArrayFS");
-    strcpy(mountpoints[0].mountpoint, "/");
-    // Adding some fake fs
-    strcpy(mountpoints[1].name, "ArrayFS");
-    strcpy(mountpoints[1].mountpoint, "/home/mount");
+    mount_fs("/", "ArrayFS", no_operations);
     // Adding some fake fs
-    strcpy(mountpoints[2].name, "ArrayFS");
-    strcpy(mountpoints[2].mountpoint, "/usr");
+    mount_fs("/home/mount", "ArrayFS", no_operations);
     // Adding some fake fs
-    strcpy(mountpoints[3].name, "ustar");
-    strcpy(mountpoints[3].mountpoint, "/home");
-    mountpoints[3].file_operations.open = ustar_open;
-    mountpoints[3].file_operations.close = ustar_close;
-    mountpoints[3].file_operations.read = ustar_read;
+    mount_fs("/usr", "ArrayFS", no_operations);
+    mount_fs("/home", "ustar", ustar_operations);
 }
 
-int get_mountpoint_id(const char *path) {
-    size_t last = 0;
-    int lastlen = 0;
-    if (strlen(path) == 0) {
-        return last;
-    }
-    for(int i=1; i < MOUNTPOINTS_MAX; i++) {
-        int result = strncmp(path, mountpoints[i].mountpoint, strlen(mountpoints[i].mountpoint));
-        //pretty_logf(Verbose,"%d\n", i);
-        if(mountpoints[i].mountpoint[0] != '\0' &&  result == 0) {
-            if(strlen(mountpoints[i].mountpoint) > lastlen) {
-                lastlen = strlen(mountpoints[i].mountpoint);
-                last = i;
+/**
+ * Return the next component of a path, skipping the separators.
+ *
+ * @param path the current position in the path
+ * @param length the length of the component found
+ * @return the first character of the component, or NULL if there are no more components
+ */
+const char *vfs_next_component(const char *path, size_t *length) {
+    while ( *path == '/' ) {
+        path++;
+    }
+    if ( *path == '\0' ) {
+        return NULL;
+    }
+    size_t component_length = 0;
+    while ( path[component_length] != '\0' && path[component_length] != '/' ) {
+        component_length++;
+    }
+    *length = component_length;
+    return path;
+}
+
+/**
+ * Search a component between the children of a trie node
+ *
+ * @param node the parent node
+ * @param name the component name (not null terminated)
+ * @param name_length the length of the component
+ * @return the child node, or VFS_MOUNT_TRIE_NONE if no mountpoint goes through it
+ */
+int vfs_mount_trie_child(int node, const char *name, size_t name_length) {
+    int child = rcu_dereference(vfs_mount_trie[node].first_child);
+    while ( child != VFS_MOUNT_TRIE_NONE ) {
+        if ( vfs_mount_trie[child].name_length == name_length && strncmp(vfs_mount_trie[child].name, name, name_length) == 0 ) {
+            return child;
+        }
+        child = vfs_mount_trie[child].next_sibling;
+    }
+    return VFS_MOUNT_TRIE_NONE;
+}
+
+/**
+ * Move one component down the mountpoints trie, in an rcu read section: used by the path cache,
+ * that walks the trie one component at a time.
+ *
+ * @param node the parent node
+ * @param name the component name (not null terminated)
+ * @param name_length the length of the component
+ * @param mountpoint_id set to the mountpoint ending in the child node, or -1
+ * @return the child node, or VFS_MOUNT_TRIE_NONE if no mountpoint goes through it
+ */
+int vfs_mount_trie_step(int node, const char *name, size_t name_length, int *mountpoint_id) {
+    rcu_read_lock();
+    int child = vfs_mount_trie_child(node, name, name_length);
+    *mountpoint_id = child != VFS_MOUNT_TRIE_NONE ? rcu_dereference(vfs_mount_trie[child].mountpoint_id) : -1;
+    rcu_read_unlock();
+    return child;
+}
+
+/**
+ * Add a filesystem to the mountpoints, and insert its path in the trie.
+ * The path lookup cache is flushed, since the new mountpoint hides part of the old tree.
+ *
+ * @param mountpoint the absolute path of the mountpoint
+ * @param name the filesystem name
+ * @param file_operations the driver functions
+ * @return the mountpoint id, or -1 if there is no space left
+ */
+int mount_fs(char *mountpoint, char* name, fs_file_operations_t file_operations) {
+    int id = -1;
+    spinlock_acquire(&vfs_mount_lock);
+    for (int i=0; i < MOUNTPOINTS_MAX; i++) {
+        if (mountpoints[i].mountpoint[0] == '\0') {
+            id = i;
+            break;
+        }
+    }
+    if ( id < 0 || strlen(mountpoint) >= MAX_MOUNTPOINT_LEN ) {
+        spinlock_release(&vfs_mount_lock);
+        pretty_logf(Error, "Cannot mount %s on: %s", name, mountpoint);
+        return -1;
+    }
+
+    int node = 0;
+    size_t component_length;
+    const char *component = vfs_next_component(mountpoint, &component_length);
+    while ( component != NULL ) {
+        int child = vfs_mount_trie_child(node, component, component_length);
+        if ( child == VFS_MOUNT_TRIE_NONE ) {
+            if ( vfs_mount_trie_size == VFS_MOUNT_TRIE_NODES ) {
+                spinlock_release(&vfs_mount_lock);
+                pretty_logf(Error, "Mountpoints trie is full, cannot mount: %s", mountpoint);
+                return -1;
             }
+            child = vfs_mount_trie_size++;
+            vfs_init_mount_node(child, component, component_length);
+            vfs_mount_trie[child].next_sibling = vfs_mount_trie[node].first_child;
+            rcu_assign_pointer(vfs_mount_trie[node].first_child, child);
         }
+        node = child;
+        component = vfs_next_component(component + component_length, &component_length);
+    }
+    strcpy(mountpoints[id].name, name);
+    strcpy(mountpoints[id].mountpoint, mountpoint);
+    mountpoints[id].file_operations = file_operations;
+    // The mountpoint is complete before a reader can find it
+    rcu_assign_pointer(vfs_mount_trie[node].mountpoint_id, id);
+    spinlock_release(&vfs_mount_lock);
+    vfs_dcache_invalidate();
+    return id;
+}
+
+/**
+ * Close the driver file of a descriptor, the descriptor is left empty but still allocated in its table.
+ *
+ * @param file the descriptor to close
+ */
+void vfs_close_file(vfs_file_descriptor_t *file) {
+    if (file->fs_specific_id >= 0 && file->mountpoint_id >= 0) {
+        mountpoint_t *mountpoint = &mountpoints[file->mountpoint_id];
+        if (mountpoint->file_operations.close != NULL) {
+            mountpoint->file_operations.close(file->fs_specific_id);
+        }
+    }
+    file->fs_specific_id = -1;
+    file->mountpoint_id = -1;
+    file->node = NULL;
+}
+
+/**
+ * Find the mountpoint of a path walking the mountpoints trie, one step per path component.
+ *
+ * @param path an absolute path
+ * @param relative_path if not NULL it is set to the part of path after the mountpoint
+ * @return the id of the deepest mountpoint containing the path
+ */
+int vfs_find_mountpoint(const char *path, const char **relative_path) {
+    rcu_read_lock();
+    int root_id = rcu_dereference(vfs_mount_trie[0].mountpoint_id);
+    int last = root_id >= 0 ? root_id : 0;
+    const char *last_relative_path = path;
+    int node = 0;
+    size_t component_length;
+    const char *component = vfs_next_component(path, &component_length);
+    while ( component != NULL ) {
+        node = vfs_mount_trie_child(node, component, component_length);
+        if ( node == VFS_MOUNT_TRIE_NONE ) {
+            break;
+        }
+        int mountpoint_id = rcu_dereference(vfs_mount_trie[node].mountpoint_id);
+        if ( mountpoint_id >= 0 ) {
+            last = mountpoint_id;
+            last_relative_path = component + component_length;
+        }
+        component = vfs_next_component(component + component_length, &component_length);
+    }
+    rcu_read_unlock();
+    if ( relative_path != NULL ) {
+        *relative_path = last_relative_path;
     }
     return last;
 }
 
+int get_mountpoint_id(const char *path) {
+    return vfs_find_mountpoint(path, NULL);
+}
+
 char *get_relative_path (char *root_prefix, char *absolute_path) {
     int root_len = strlen(root_prefix);
     pretty_logf(Verbose, "Removing prefix: %s (len: %d) from absolute path: %s it should be: %s", root_prefix, root_len, absolute_path, &absolute_path[root_len]);
@@ -2,23 +2,90 @@
 #define __USTAR_H_
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
 #define HEADER_SIZE 512
 #define PADDING_BYTE    0
 #define USTAR_VERSION   "00"
+#define USTAR_MAGIC "ustar"
 #define USTAR_FILENAME_SIZE 100
+#define USTAR_PREFIX_SIZE   155
 
+// Command line given to the archive module in grub.cfg
+#define USTAR_MODULE_NAME   "initrd"
+
+// The index is static: the archive can't contain more than USTAR_MAX_FILES entries
+#define USTAR_MAX_FILES 256
+// Must be a power of 2, twice the number of files keeps the chains short
+#define USTAR_HASH_BUCKETS  512
+#define USTAR_MAX_OPENED_FILES  16
+// Driver file descriptors start from 1, since the vfs considers 0 as not valid
+#define USTAR_FD_BASE   1
+
+#define USTAR_TYPE_FILE '0'
+#define USTAR_TYPE_FILE_OLD '\0'
+#define USTAR_TYPE_DIRECTORY    '5'
+
+/**
+ * The header of an archive entry, it's always HEADER_SIZE bytes long, all the numbers are octal strings
+ */
 struct ustar_item {
     char filename[USTAR_FILENAME_SIZE];
     char file_mode[8];
     char    uid[8];
     char    gid[8];
+    char size[12];
+    char mtime[12];
+    char checksum[8];
+    char type;
+    char linked_filename[USTAR_FILENAME_SIZE];
+    char magic[6];
     char version[2];
-};
+    char user_name[32];
+    char group_name[32];
+    char device_major[8];
+    char device_minor[8];
+    char prefix[USTAR_PREFIX_SIZE];
+    char padding[12];
+} __attribute__((__packed__));
 
 typedef struct ustar_item ustar_item;
+
+/**
+ * An entry of the path index, it points directly in the archive memory
+ */
+typedef struct {
+    const ustar_item *header;
+    const char *data; /**< The file content, it follows the header */
+    size_t size;
+    uint32_t hash; /**< Hash of the normalized path (prefix/filename, without leading ./ and trailing /) */
+    int32_t next; /**< Next entry in the same hash bucket, -1 if last */
+} ustar_index_entry_t;
+
+typedef struct {
+    int32_t entry; /**< Index of the entry, -1 if the slot is free */
+    size_t offset;
+} ustar_opened_file_t;
+
+typedef struct {
+    const uint8_t *archive;
+    size_t archive_size;
+    size_t entries_count;
+    ustar_index_entry_t entries[USTAR_MAX_FILES];
+    int32_t buckets[USTAR_HASH_BUCKETS];
+    ustar_opened_file_t opened_files[USTAR_MAX_OPENED_FILES];
+} ustar_fs_t;
+
+extern ustar_fs_t ustar_fs;
+
+bool ustar_mount(const void *archive, size_t archive_size);
+const ustar_index_entry_t *ustar_lookup(const char *path);
+const void *ustar_lookup_node(const char *path);
+int ustar_open_node(const void *node, int flags);
 int ustar_open(const char *path, int flags, ...);
 int ustar_close(int fildes);
 ssize_t ustar_read(int fildes, char *buf, size_t nbytes);
+ssize_t ustar_pread(int fildes, char *buf, size_t nbytes, size_t offset);
 #endif
@@ -0,0 +1,75 @@
+#ifndef _DCACHE_H
+#define _DCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <spinlock.h>
+
+// Number of path components that can be cached, when the cache is full the least recently used are replaced
+#define VFS_DCACHE_SIZE 128
+// Must be a power of 2
+#define VFS_DCACHE_BUCKETS  256
+// Longer components are not cached, their paths are resolved every time
+#define VFS_DENTRY_NAME_LEN 32
+#define VFS_DCACHE_NONE -1
+#define VFS_DENTRY_ROOT_ID  1
+
+#define VFS_DENTRY_USED 0x1
+#define VFS_DENTRY_RESOLVED 0x2 /**< The driver lookup has been done for this entry */
+#define VFS_DENTRY_NEGATIVE 0x4 /**< The path doesn't exist */
+#define VFS_DENTRY_MOUNT_ROOT   0x8 /**< A filesystem is mounted on this entry */
+#define VFS_DENTRY_REFERENCED   0x10 /**< Used since the last pass of the replacement clock */
+
+/**
+ * A cached path component, it is identified by the id of its parent and its name.
+ * Ids are never reused, so the children of a replaced entry can't be found anymore.
+ */
+typedef struct {
+    char name[VFS_DENTRY_NAME_LEN];
+    size_t name_length;
+    uint32_t id;
+    uint32_t parent_id;
+    uint32_t hash;
+    uint8_t flags;
+    int mountpoint_id; /**< The mountpoint containing the component */
+    int mount_node; /**< The node in the mountpoints trie, VFS_MOUNT_TRIE_NONE if no mountpoint goes through it */
+    const void *node; /**< The node returned by the driver lookup */
+    int32_t next; /**< Next entry in the same hash bucket */
+} vfs_dentry_t;
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t negative_hits;
+    size_t driver_lookups;
+    size_t evictions;
+} vfs_dcache_stats_t;
+
+typedef struct {
+    vfs_dentry_t root;
+    vfs_dentry_t dentries[VFS_DCACHE_SIZE];
+    int32_t buckets[VFS_DCACHE_BUCKETS];
+    uint32_t next_id;
+    size_t clock_hand;
+    vfs_dcache_stats_t stats;
+    spinlock_t lock; /**< Held by the resolutions too: a lookup can replace entries and update the stats */
+} vfs_dcache_t;
+
+/**
+ * The result of a path resolution
+ */
+typedef struct {
+    int mountpoint_id;
+    const char *relative_path; /**< The part of the path after the mountpoint (it points inside the resolved path) */
+    bool negative; /**< True if the path is known to not exist */
+    const void *node; /**< The driver node, NULL if the driver has no lookup function */
+} vfs_resolved_path_t;
+
+extern vfs_dcache_t vfs_dcache;
+
+void vfs_dcache_init();
+void vfs_dcache_invalidate();
+int vfs_resolve_path(const char *path, vfs_resolved_path_t *resolved);
+
+#endif
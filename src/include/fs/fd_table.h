@@ -0,0 +1,39 @@
+#ifndef _FD_TABLE_H
+#define _FD_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <rwlock.h>
+#include <vfs.h>
+
+#define FD_TABLE_ROW_BITS   64
+// The table starts with one row of the bitmap, and doubles every time it is full
+#define FD_TABLE_INITIAL_SIZE   FD_TABLE_ROW_BITS
+// The summary of the full rows is a single word, so there can't be more than 64 rows
+#define FD_TABLE_MAX_SIZE   (FD_TABLE_ROW_BITS * FD_TABLE_ROW_BITS)
+
+/**
+ * The opened files of a task. Free descriptors are tracked with a two level bitmap:
+ * a bit for every descriptor, and a summary word with a bit for every full row,
+ * so the lowest free descriptor is found with two bit scans.
+ */
+typedef struct {
+    vfs_file_descriptor_t *files;
+    uint64_t *used_rows; /**< A bit is set if the descriptor is allocated */
+    uint64_t full_rows; /**< A bit is set if the corresponding row has no free descriptors */
+    size_t size; /**< Number of descriptors allocated, it's always a multiple of FD_TABLE_ROW_BITS */
+    size_t opened_files;
+    rwlock_t lock; /**< Taken for writing when the descriptors are allocated or released, since the table can move */
+} fd_table_t;
+
+void fd_table_init(fd_table_t *table);
+void fd_table_destroy(fd_table_t *table);
+int fd_table_alloc(fd_table_t *table);
+vfs_file_descriptor_t *fd_table_get(fd_table_t *table, int fd);
+bool fd_table_release(fd_table_t *table, int fd);
+bool fd_table_close(fd_table_t *table, int fd);
+void fd_table_close_all(fd_table_t *table);
+fd_table_t *get_current_fd_table();
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _PAGE_CACHE_H
+#define _PAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <bitmap.h>
+#include <spinlock.h>
+#include <sys/types.h>
+#include <vfs.h>
+
+// The cache pages are smaller than the pmm frames: every frame is split in PAGE_CACHE_PAGES_PER_FRAME pages
+#define PAGE_CACHE_PAGE_SIZE    0x1000
+#define PAGE_CACHE_PAGES_PER_FRAME  (PAGE_SIZE_IN_BYTES / PAGE_CACHE_PAGE_SIZE)
+#define PAGE_CACHE_MAX_PAGES    1024
+#define PAGE_CACHE_MAX_FRAMES   (PAGE_CACHE_MAX_PAGES / PAGE_CACHE_PAGES_PER_FRAME)
+// Must be a power of 2
+#define PAGE_CACHE_BUCKETS  1024
+#define PAGE_CACHE_NONE -1
+#define PAGE_CACHE_NO_PAGE  ((size_t) -1)
+// The readahead window starts from PAGE_CACHE_READAHEAD_MIN pages and doubles on every sequential read
+#define PAGE_CACHE_READAHEAD_MIN    2
+#define PAGE_CACHE_READAHEAD_MAX    16
+
+/**
+ * A cached page of a file, the file is identified by its mountpoint and its driver node
+ */
+typedef struct {
+    int mountpoint_id;
+    const void *node;
+    size_t page_index; /**< Position of the page in the file, in PAGE_CACHE_PAGE_SIZE units */
+    size_t length; /**< Valid bytes, less than PAGE_CACHE_PAGE_SIZE only in the last page of the file */
+    uint8_t *data; /**< The page memory (through the hhdm) */
+    bool used;
+    int32_t hash_next; /**< Next page in the hash bucket, or in the free list */
+    int32_t lru_prev;
+    int32_t lru_next;
+} page_cache_page_t;
+
+typedef struct {
+    size_t hits;
+    size_t misses;
+    size_t readahead_pages;
+    size_t evictions;
+} page_cache_stats_t;
+
+typedef struct {
+    page_cache_page_t pages[PAGE_CACHE_MAX_PAGES];
+    int32_t buckets[PAGE_CACHE_BUCKETS];
+    int32_t lru_head; /**< The most recently used page */
+    int32_t lru_tail; /**< The first page to be evicted */
+    int32_t free_pages; /**< Pages with memory assigned, but not caching anything */
+    void *frames[PAGE_CACHE_MAX_FRAMES]; /**< The frame of the pages from i * PAGE_CACHE_PAGES_PER_FRAME, NULL if it was not allocated */
+    size_t frame_used_pages[PAGE_CACHE_MAX_FRAMES]; /**< Pages caching a file in every frame, the frame can go back to the pmm when it's 0 */
+    size_t frames_count;
+    page_cache_stats_t stats;
+    spinlock_t lock;
+} page_cache_t;
+
+extern page_cache_t page_cache;
+
+void init_page_cache();
+void page_cache_invalidate();
+size_t page_cache_shrink(size_t frames);
+ssize_t page_cache_read(vfs_file_descriptor_t *file, void *buf, size_t nbytes, size_t offset);
+
+#endif
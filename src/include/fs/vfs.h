@@ -2,19 +2,26 @@
 #define _VFS_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <sys/types.h>
 
 #define MOUNTPOINTS_MAX 5
-#define OPENEDFILES_MAX 5
 #define FILESYSTEM_NAME_LEN 32
 #define MAX_MOUNTPOINT_LEN  64
 #define MAX_FILENAME_LEN 32
+// Every component of every mountpoint path is a node of the mountpoints trie
+#define VFS_MOUNT_TRIE_NODES    32
+#define VFS_MOUNT_TRIE_NONE -1
 
 struct fs_file_operations_t{ 
 	int (*open)(const char *, int, ... );
 	int (*close)(int);
 	ssize_t (*read)(int, char*, size_t);
 	ssize_t (*write)(int,const void*, size_t);
+	ssize_t (*pread)(int, char*, size_t, size_t); /**< Optional: read at the given offset, without using the driver file position */
+	const void *(*lookup)(const char *); /**< Optional: return the driver node of a path, NULL if it doesn't exist */
+	int (*open_node)(const void *, int); /**< Optional: open a node returned by lookup, without parsing the path again */
 };
 
 struct vfs_file_descriptor_t {
@@ -22,9 +29,11 @@ struct vfs_file_descriptor_t {
     int fs_specific_id;
     int mountpoint_id;
     char filename[MAX_FILENAME_LEN];
+    size_t offset; /**< The file position, every descriptor has its own */
 
-    int buffer_read_pos;
-    char *buffer;
+    const void *node; /**< The driver node, it identifies the file in the page cache (NULL if the file is not cached) */
+    size_t readahead_last_page; /**< Last page read, used to detect sequential reads */
+    size_t readahead_window; /**< Number of pages read in advance, 0 if the reads are not sequential */
 
 };
 
@@ -40,14 +49,28 @@ typedef struct {
 
 } mountpoint_t;
 
+/**
+ * A node of the mountpoints trie, every node is a path component (the root node has no name)
+ */
+typedef struct {
+    char name[MAX_MOUNTPOINT_LEN];
+    size_t name_length;
+    int mountpoint_id; /**< The mountpoint ending in this node, -1 if the node is only an intermediate component */
+    int first_child;
+    int next_sibling;
+} vfs_mount_node_t;
 
-extern mountpoint_t mountpoints[MOUNTPOINTS_MAX];
-extern vfs_file_descriptor_t vfs_opened_files[OPENEDFILES_MAX];
 
-extern unsigned int vfs_fd_index;
+extern mountpoint_t mountpoints[MOUNTPOINTS_MAX];
+extern vfs_mount_node_t vfs_mount_trie[VFS_MOUNT_TRIE_NODES];
 
 void vfs_init();
 int get_mountpoint_id(const char *path);
+int vfs_find_mountpoint(const char *path, const char **relative_path);
+const char *vfs_next_component(const char *path, size_t *length);
+int vfs_mount_trie_child(int node, const char *name, size_t name_length);
+int vfs_mount_trie_step(int node, const char *name, size_t name_length, int *mountpoint_id);
 int mount_fs(char *mountpoint, char* name, fs_file_operations_t file_operations);
+void vfs_close_file(vfs_file_descriptor_t *file);
 char *get_relative_path (char *root_prefix, char *absolute_path);
 #endif
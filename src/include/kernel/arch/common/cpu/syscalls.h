@@ -5,7 +5,20 @@
 
 #define SYSCALL_VECTOR_NUMBER 0x80
 
+// The syscall number is passed in rsi, the first argument in rdi, the return value is in rax
+#define SYSCALL_PMU_READ    3
+#define SYSCALL_VMM_FAULTS  4
+#define SYSCALL_EXIT    5
+#define SYSCALL_LOCK_STATS  6
+#define SYSCALL_SCHED_STATS 7
+#define SYSCALL_TRACE_DUMP  8
+
 #define E_NO_SYSCALL    -1
+#define E_INVALID_ARGUMENT  -2
+#define E_NOT_SUPPORTED -3
+
+// Pointers passed by user space must be below this address, and the buffers written by a syscall must be writable by the task
+#define SYSCALL_USER_ADDRESS_LIMIT  0x0000800000000000
 
 bool _syscalls_init();
 cpu_status_t *syscall_dispatch(cpu_status_t* regs);
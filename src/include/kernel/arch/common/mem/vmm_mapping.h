@@ -1,10 +1,12 @@
 #ifndef _VMM_MAPPING_H_
 #define _VMM_MAPPING_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
 void *map_phys_to_virt_addr_hh(void* physical_address, void* address, size_t flags, uint64_t *pml4_root);
 void *map_phys_to_virt_addr(void* physical_address, void* address, size_t flags);
+void *map_page_table_hh(void *page_table, void *address, uint64_t *pml4_root);
 
 void identity_map_phys_address(void *pyhysical_address, size_t flags);
 void map_vaddress_range(void *virtual_address, size_t flags, size_t required_pages, uint64_t *pml4_root);
@@ -13,6 +15,10 @@ void *map_vaddress(void *address, size_t flags, uint64_t *pml4_root);
 int unmap_vaddress(void *address);
 int unmap_vaddress_hh(void *address, uint64_t *pml4_root);
 
+uint64_t get_page_entry_hh(void *address, uint64_t *pml4_root);
+void *translate_virt_address_hh(void *address, uint64_t *pml4_root);
+size_t free_user_page_tables(uint64_t *pml4_root);
+
 uint8_t is_phyisical_address_mapped(uintptr_t physical_address, uintptr_t virtual_address);
 
 #endif
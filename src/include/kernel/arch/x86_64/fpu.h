@@ -0,0 +1,73 @@
+#ifndef __FPU_H__
+#define __FPU_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <thread.h>
+
+// If set to 1 the fpu state is saved/restored only when a thread actually use the fpu (trapping on #NM)
+// If set to 0 the state of the last fpu user is saved on every context switch.
+#ifndef FPU_LAZY_SWITCH
+#define FPU_LAZY_SWITCH 1
+#endif
+
+#define CPUID_FEAT_EDX_FXSR (1 << 24)
+#define CPUID_FEAT_EDX_SSE  (1 << 25)
+#define CPUID_FEAT_EDX_SSE2 (1 << 26)
+#define CPUID_FEAT_ECX_XSAVE    (1 << 26)
+#define CPUID_FEAT_ECX_AVX  (1 << 28)
+#define CPUID_XSAVE_LEAF    0xD
+#define CPUID_XSAVE_EAX_XSAVEOPT    (1 << 0)
+#define CPUID_EXT_FEATURES_LEAF 0x7
+#define CPUID_EXT_FEAT_EBX_AVX2 (1 << 5)
+#define CPUID_EXT_FEAT_EBX_ERMS (1 << 9)
+#define CPUID_EXT_FEAT_EDX_FSRM (1 << 4)
+#define CPUID_EXT_FEAT_1_EAX_FSRS   (1 << 11)
+
+#define CR0_MP  (1 << 1)
+#define CR0_EM  (1 << 2)
+#define CR0_TS  (1 << 3)
+#define CR0_NE  (1 << 5)
+#define CR4_OSFXSR  (1 << 9)
+#define CR4_OSXMMEXCPT  (1 << 10)
+#define CR4_OSXSAVE (1 << 18)
+
+#define XCR0_X87    (1 << 0)
+#define XCR0_SSE    (1 << 1)
+#define XCR0_AVX    (1 << 2)
+
+#define FXSAVE_AREA_SIZE    512
+#define FPU_STATE_ALIGNMENT 64
+#define MXCSR_DEFAULT_VALUE 0x1F80
+
+typedef enum {
+    FPU_SAVE_FXSAVE,
+    FPU_SAVE_XSAVE,
+    FPU_SAVE_XSAVEOPT
+} fpu_save_mode_t;
+
+/**
+ * This struct contains the fpu capabilities detected at boot
+ */
+typedef struct {
+    bool initialized; /**< True once init_fpu has enabled the fpu/sse units */
+    fpu_save_mode_t save_mode; /**< Instruction used to save the extended state */
+    uint64_t xcr0_features; /**< State components enabled in XCR0 */
+    size_t state_size; /**< Size of the extended state area (from cpuid leaf 0xD) */
+    bool has_sse2;
+    bool has_avx;
+} fpu_info_t;
+
+extern fpu_info_t fpu_info;
+extern thread_t *fpu_owner;
+
+void init_fpu();
+void fpu_switch_thread(thread_t *next);
+void fpu_handle_device_not_available();
+void fpu_release_thread(thread_t *thread);
+
+void kernel_fpu_begin();
+void kernel_fpu_end();
+
+#endif
@@ -40,6 +40,8 @@
 
 #define KEYBOARD_INTERRUPT 33
 #define PIT_INTERRUPT 34
+// Raised by scheduler_yield, it only runs the scheduler: no clock tick, no profiler sample and no EOI
+#define SCHEDULER_YIELD_INTERRUPT 129
 
 typedef struct IDT_desc {
     uint16_t offset_low;
@@ -91,6 +93,7 @@ extern void interrupt_service_routine_32();
 extern void interrupt_service_routine_33();
 extern void interrupt_service_routine_34();
 extern void interrupt_service_routine_128();
+extern void interrupt_service_routine_129();
 extern void interrupt_service_routine_255();
 
 #endif
@@ -4,7 +4,11 @@
 #include <stdint.h>
 
 #define IA32_APIC_BASE 0x1b
+#define IA32_TSC_AUX 0xC0000103
 
 uint64_t rdmsr(uint32_t address);
 void wrmsr(uint32_t address, uint64_t value);
+uint64_t rdtsc();
+uint64_t rdtscp(uint32_t *aux);
+uint64_t rdpmc(uint32_t counter);
 #endif
@@ -0,0 +1,13 @@
+#ifndef _PAGE_OPS_H
+#define _PAGE_OPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// page_zero/page_copy work on blocks of this size, every page size is a multiple of it
+#define PAGE_OPS_BLOCK_SIZE 64
+
+void page_zero(void *page, size_t size);
+void page_copy(void *dest, const void *src, size_t size);
+
+#endif
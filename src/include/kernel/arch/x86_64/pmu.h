@@ -0,0 +1,66 @@
+#ifndef __PMU_H__
+#define __PMU_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CPUID_PMU_LEAF  0xA
+
+#define IA32_PMC0   0xC1
+#define IA32_PERFEVTSEL0    0x186
+#define IA32_PERF_GLOBAL_CTRL   0x38F
+
+#define PERFEVTSEL_USR  (1 << 16)
+#define PERFEVTSEL_OS   (1 << 17)
+#define PERFEVTSEL_EN   (1 << 22)
+
+// Architectural events (intel sdm vol. 3 chapter 20), and their bit in cpuid 0xA ebx: it is set if the event is NOT available
+#define PMU_ARCH_EVENT_CYCLES   0x003C
+#define PMU_ARCH_EVENT_INSTRUCTIONS 0x00C0
+#define PMU_ARCH_EVENT_LLC_MISSES   0x412E
+#define PMU_ARCH_EVENT_BRANCH_MISSES    0x00C5
+
+#define PMU_ARCH_EBX_CYCLES 0
+#define PMU_ARCH_EBX_INSTRUCTIONS   1
+#define PMU_ARCH_EBX_LLC_MISSES 4
+#define PMU_ARCH_EBX_BRANCH_MISSES  6
+
+typedef enum {
+    PMU_CYCLES,
+    PMU_INSTRUCTIONS,
+    PMU_LLC_MISSES,
+    PMU_BRANCH_MISSES,
+    PMU_MAX_COUNTERS
+} pmu_counter_t;
+
+/**
+ * The counters of a thread, this is also the layout returned by the SYSCALL_PMU_READ syscall
+ */
+typedef struct {
+    uint64_t values[PMU_MAX_COUNTERS];
+    uint32_t available; /**< Bitmask of the counters programmed, the others are always 0 */
+    uint32_t reserved;
+} pmu_counters_t;
+
+/**
+ * The pmu capabilities detected at boot
+ */
+typedef struct {
+    bool initialized;
+    uint8_t version; /**< Architectural perfmon version, 0 if not supported */
+    uint8_t general_counters; /**< Number of IA32_PMCx registers */
+    uint8_t counter_width;
+    uint32_t available; /**< Bitmask of the pmu_counter_t programmed in the general purpose counters */
+    uint8_t counter_index[PMU_MAX_COUNTERS]; /**< The IA32_PMCx used for each event */
+} pmu_info_t;
+
+extern pmu_info_t pmu_info;
+
+struct thread_t;
+
+void init_pmu();
+void pmu_account_thread(struct thread_t *thread);
+void pmu_read_thread(struct thread_t *thread, pmu_counters_t *counters);
+
+#endif
@@ -7,6 +7,10 @@
 #define TSS_ENTRY_LOW 5
 #define TSS_ENTRY_HIGH 6
 
+// The double fault runs on its own stack, so it can be handled even when it's caused by a kernel stack overflow
+#define TSS_DOUBLE_FAULT_IST    1
+#define TSS_IST_STACK_SIZE  0x4000
+
 /** This structure is copied from OSDev Notes, Part 6: Userspace.
    * https://github.com/dreamos82/Osdev-Notes/blob/master/06_Userspace/03_Handling_Interrupts.md
    */
@@ -0,0 +1,40 @@
+#ifndef _KBENCH_H_
+#define _KBENCH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Command line options: "bench" runs all the benchmarks, "bench=pmm,kmalloc" only the listed ones,
+// "bench_halt" stops the cpu once the report is written
+#define KBENCH_CMDLINE_OPTION   "bench"
+#define KBENCH_CMDLINE_HALT "bench_halt"
+
+#define KBENCH_MAX_SAMPLES  256
+#define KBENCH_SWITCH_ROUNDS    4
+#define KBENCH_LOG_BATCH    64
+#define KBENCH_SPAWN_ROUNDS 100000
+// Every user spawn round waits for the task to run and exit, so they are fewer
+#define KBENCH_SPAWN_USER_ROUNDS    1000
+// Built from userspace/kbench_exit.s, it exits as soon as it starts
+#define KBENCH_SPAWN_USER_PATH  "bin/kbench_exit"
+#define KBENCH_REPORT_VERSION   2
+
+/**
+ * The statistics of a single benchmark, all the times are in nanoseconds
+ */
+typedef struct {
+    const char *name;
+    size_t ops;
+    uint64_t min_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t mean_ns;
+    int64_t frames_delta; /**< Physical frames used after the benchmark minus the ones used before (when measured) */
+} kbench_result_t;
+
+bool kbench_requested();
+void kbench_start();
+void kbench_run(void *arg);
+
+#endif
@@ -6,6 +6,7 @@
 #include <stddef.h>
 
 #define _HIGHER_HALF_KERNEL_MEM_START   0xffffffff80000000
+#define KERNEL_CMDLINE_MAX_LEN  256
 
 struct keyboard_status_t {
     uint8_t scancode_set;
@@ -17,6 +18,14 @@ struct apic_timer_parameters {
     uint8_t timer_divisor;
 };
 
+/**
+ * This struct contains the time stamp counter calibration values
+ */
+struct tsc_parameters {
+    uint64_t ticks_per_ms; /**< Number of tsc ticks in 1ms, computed while calibrating the apic timer */
+    uint64_t boot_tsc; /**< Tsc value read when the calibration was done */
+};
+
 
 /**
  * This struct contains the arch paging root table references
@@ -30,10 +39,14 @@ struct paging_status_t {
 typedef struct kernel_status_t {
     struct keyboard_status_t keyboard;
     struct apic_timer_parameters apic_timer;
+    struct tsc_parameters tsc;
     struct paging_status_t paging;
     bool use_x2_apic;
 
     uint64_t kernel_uptime; // Kernel uptime in millisec.
+    uint64_t kernel_uptime_tsc; // Tsc value when kernel_uptime was updated
+    uint64_t boot_epoch; // Unix timestamp read from the rtc during boot
+    char cmdline[KERNEL_CMDLINE_MAX_LEN]; // The command line passed by the bootloader
 } kernel_status_t;
 
 extern kernel_status_t kernel_settings;
@@ -45,4 +58,8 @@ extern uint64_t elf_module_start_hh;
 
 void init_kernel_settings();
 uint64_t get_kernel_uptime();
+void kernel_clock_tick();
+void kernel_clock_read(uint64_t *uptime_ms, uint64_t *uptime_tsc);
+void kernel_set_cmdline(const char *cmdline);
+bool kernel_cmdline_option(const char *name, const char **value, size_t *value_length);
 #endif
@@ -0,0 +1,37 @@
+#ifndef _KSYMS_H_
+#define _KSYMS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Command line given to the kernel.map module in grub.cfg, used to recognize it between the multiboot modules
+#define KSYMS_MODULE_NAME   "kernel.map"
+// Symbols below this address are not kernel functions (absolute symbols, linker script values, ...)
+#define KSYMS_MIN_ADDRESS   0xFFFFFFFF80000000
+
+/**
+ * A kernel symbol, the name is not null terminated: it points inside the map file
+ */
+typedef struct {
+    uintptr_t address;
+    const char *name;
+    size_t name_length;
+} ksym_t;
+
+/**
+ * The symbols table, sorted by address
+ */
+typedef struct {
+    ksym_t *symbols;
+    size_t count;
+} ksyms_table_t;
+
+extern ksyms_table_t kernel_symbols;
+
+size_t ksyms_parse(const char *map, size_t map_size, uintptr_t min_address, ksym_t *symbols, size_t max_symbols);
+void ksyms_sort(ksym_t *symbols, size_t count);
+const ksym_t *ksyms_lookup(const ksyms_table_t *table, uintptr_t address);
+bool init_ksyms(uintptr_t map_address, size_t map_size);
+
+#endif
@@ -3,6 +3,7 @@
 
 #define X86_64
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -23,6 +24,8 @@
 
 #define EV_CURRENT      1
 
+#define ET_EXEC 2
+
 #define PT_LOAD 1
 
 #ifdef X86_64
@@ -77,15 +80,37 @@ typedef struct {
 
 #define PT_LOAD 1
 
-#define FF_X    1
-#define FF_R    2
-#define FF_W    4
+#define PF_X    1
+#define PF_W    2
+#define PF_R    4
+
+// Maximum number of pages of a loaded executable (the pages are PAGE_SIZE_IN_BYTES long)
+#define ELF_MAX_PAGES   64
+#define ELF_USER_ADDRESS_LIMIT  0x0000800000000000
 
-void load_elf(uintptr_t elf_start, uint64_t size);
+/**
+ * A page of the executable image, as it will be mapped in the task address space
+ */
+typedef struct {
+    uintptr_t vaddr;
+    uint64_t phys; /**< The module frame mapped by a shared page, 0 for private pages */
+    bool shared; /**< The page is mapped straight from the module, all the tasks running the binary share it until they write it */
+    bool writable;
+} elf_page_t;
+
+bool load_elf(uintptr_t elf_start, uint64_t size);
+bool elf_validate_executable(Elf64_Ehdr *elf_header, uint64_t size);
+size_t elf_plan_pages(Elf64_Ehdr *elf_header, uint64_t module_phys, uint64_t module_size, elf_page_t *pages, size_t max_pages);
+void elf_copy_page(Elf64_Ehdr *elf_header, uintptr_t page_vaddr, uint8_t *destination);
+#ifndef _TEST_
+struct task_t *elf_create_task(char *name, uint64_t module_phys, uint64_t size);
+struct task_t *elf_create_task_from_initrd(char *path);
+#endif
 
 // This function maybe will  change, and it will be a wrapper for supporting different executable formats. This is the reasaon of the type parameter
 bool parse_section_header(Elf64_Ehdr *elf_start, uint64_t size, executable_loader_type type);
 
 Elf64_Half loop_phdrs(Elf64_Ehdr* e_phdr, Elf64_Half phdr_entries);
+Elf64_Phdr *read_phdr(Elf64_Ehdr* e_hdr, Elf64_Half phdr_entry_number);
 
 #endif
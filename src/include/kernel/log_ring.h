@@ -0,0 +1,46 @@
+#ifndef _LOG_RING_H
+#define _LOG_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <logging.h>
+
+// Must be a power of 2
+#define LOG_RING_SIZE   128
+#define LOG_RECORD_MESSAGE_LEN  256
+#define LOG_RECORD_MAX_VALUES   (LOG_RECORD_MESSAGE_LEN / sizeof(uint64_t))
+
+/**
+ * A single log record, the sequence field tells who owns it:
+ * sequence == position means free for the producer, sequence == position + 1 means ready for the consumer.
+ */
+typedef struct {
+    size_t sequence;
+    log_level_t level;
+    const char *format; /**< NULL for text records, otherwise the format string of a binary record */
+    size_t values_count; /**< Number of raw arguments of a binary record */
+    union {
+        char message[LOG_RECORD_MESSAGE_LEN];
+        uint64_t values[LOG_RECORD_MAX_VALUES];
+    };
+} log_record_t;
+
+/**
+ * Bounded lock-free ring of log records: any number of producers (threads, interrupt handlers) and one consumer.
+ * When it is full the record is dropped and counted, producers never wait.
+ */
+typedef struct {
+    log_record_t records[LOG_RING_SIZE];
+    size_t enqueue_position;
+    size_t dequeue_position;
+    uint64_t dropped;
+} log_ring_t;
+
+void log_ring_init(log_ring_t *ring);
+bool log_ring_push(log_ring_t *ring, log_level_t level, const char *message);
+bool log_ring_push_binary(log_ring_t *ring, log_level_t level, const char *format, const uint64_t *values, size_t values_count);
+bool log_ring_pop(log_ring_t *ring, log_record_t *record);
+uint64_t log_ring_dropped(log_ring_t *ring);
+
+#endif
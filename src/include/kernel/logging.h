@@ -19,8 +19,29 @@ typedef enum {
     Fatal = 4,
 } log_level_t;
 
-#define pretty_logf(level, msg, ...)  loglinef(level, "(%s): "msg,  __FUNCTION__, __VA_ARGS__);
-#define pretty_log(level, msg)  loglinef(level, "(%s): "msg,  __FUNCTION__);
+// Messages below this level are removed at compile time (Fatal messages are always kept)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_DEBUG
+#endif
+
+// If 1, when logging is asynchronous the messages are stored unformatted, and formatted by log_drain
+#ifndef LOG_BINARY_MODE
+#define LOG_BINARY_MODE 1
+#endif
+
+extern size_t logTrimLevel;
+
+#define log_level_enabled(level) ((level) == Fatal || ((level) >= LOG_MIN_LEVEL && (size_t) (level) >= logTrimLevel))
+
+// The level is checked before evaluating the arguments, so a suppressed message costs only a comparison
+#define pretty_logf(level, msg, ...) do { \
+        if (log_level_enabled(level)) \
+            loglinef(level, "(%s): "msg,  __FUNCTION__, __VA_ARGS__); \
+    } while (0)
+#define pretty_log(level, msg) do { \
+        if (log_level_enabled(level)) \
+            loglinef(level, "(%s): "msg,  __FUNCTION__); \
+    } while (0)
 
 #define LOG_OUTPUT_DONT_CARE (size_t)-1
 #define LOG_OUTPUT_SERIAL (1 << 0)
@@ -28,8 +49,14 @@ typedef enum {
 #define LOG_OUTPUT_FRAMEBUFFER (1 << 2)
 #define LOG_OUTPUT_COUNT 3
 
+// Records written by the idle thread on every iteration
+#define LOG_DRAIN_BATCH 16
+
 void init_log(size_t defaultOutputs, log_level_t trimBelowLevel, bool useVgaVideo);
 void set_log_trim_level(size_t newTrim);
+void set_log_async(bool enabled);
+void set_log_binary(bool enabled);
+size_t log_drain(size_t max_records);
 void logline(log_level_t level, const char* msg);
 void loglinef(log_level_t level, const char* msg, ...);
 
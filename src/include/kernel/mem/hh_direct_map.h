@@ -11,6 +11,7 @@
 void early_map_physical_memory(uint64_t end_of_reserved_area);
 
 void *hhdm_get_variable ( uintptr_t phys_address );
+uintptr_t hhdm_get_phys_address ( void *variable );
 void hhdm_map_physical_memory();
 
 #endif
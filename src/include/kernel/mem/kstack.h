@@ -0,0 +1,56 @@
+#ifndef _KSTACK_H
+#define _KSTACK_H
+
+#include <bitmap.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread.h>
+
+// The stacks range is mapped with 4k pages also when the kernel uses 2mb pages, so the stacks don't take a frame each
+#define KSTACK_PAGE_SIZE    0x1000
+// Every stack is preceded by an unmapped guard page, so an overflow is a page fault instead of a silent corruption
+#define KSTACK_GUARD_SIZE   KSTACK_PAGE_SIZE
+#define KSTACK_MAPPED_SIZE  ((THREAD_DEFAULT_STACK_SIZE + KSTACK_PAGE_SIZE - 1) & ~(KSTACK_PAGE_SIZE - 1))
+#define KSTACK_SLOT_SIZE    (KSTACK_GUARD_SIZE + KSTACK_MAPPED_SIZE)
+#define KSTACK_PAGES    (KSTACK_MAPPED_SIZE / KSTACK_PAGE_SIZE)
+
+#define KSTACK_POOL_MAX_STACKS  256
+
+#if SMALL_PAGES == 0
+// Every pmm frame holds the memory of KSTACK_STACKS_PER_FRAME stacks
+#define KSTACK_STACKS_PER_FRAME (PAGE_SIZE_IN_BYTES / KSTACK_MAPPED_SIZE)
+// The page tables of the range (one every 2mb), they take the place of the first stack of the first frame
+#define KSTACK_PAGE_TABLES  ((KSTACK_POOL_MAX_STACKS * KSTACK_SLOT_SIZE + PAGE_SIZE_IN_BYTES - 1) / PAGE_SIZE_IN_BYTES)
+#define KSTACK_POOL_MAX_FRAMES  (KSTACK_POOL_MAX_STACKS / KSTACK_STACKS_PER_FRAME + 1)
+// Released stacks stay mapped for the next threads, up to a frame of stacks, the others give their memory back
+#define KSTACK_POOL_MAX_CACHED  KSTACK_STACKS_PER_FRAME
+// Stacks mapped at boot, ready for the first threads: they fill the frame of the page tables
+#define KSTACK_POOL_PREFILL (KSTACK_STACKS_PER_FRAME - 1)
+#else
+// Released stacks stay mapped for the next threads, up to this number, the others give their frames back to the pmm
+#define KSTACK_POOL_MAX_CACHED  16
+// Stacks mapped at boot, ready for the first threads
+#define KSTACK_POOL_PREFILL 4
+#endif
+
+#define KSTACK_NO_SLOT  0xFFFF
+
+typedef struct {
+    size_t allocations; /**< Stacks handed out */
+    size_t cache_hits; /**< Stacks handed out already mapped */
+    size_t mapped; /**< Stacks with their frames mapped, in use or cached */
+    size_t in_use;
+    size_t cached;
+    size_t frames; /**< pmm frames used by the pool, for the stacks and their page tables */
+} kstack_stats_t;
+
+extern kstack_stats_t kstack_stats;
+
+void init_kstack_pool();
+void *kstack_alloc();
+void kstack_free(void *stack_top);
+bool kstack_is_guard(uintptr_t address);
+bool kstack_is_pool_address(uintptr_t address);
+
+#endif
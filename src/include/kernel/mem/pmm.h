@@ -5,15 +5,34 @@
 #include <stdbool.h>
 #include <stddef.h>
 
+// Number of pre-zeroed frames kept by the idle thread (with 2mb pages they are 16mb of memory)
+#ifndef PMM_ZEROED_POOL_SIZE
+#if SMALL_PAGES == 0
+#define PMM_ZEROED_POOL_SIZE 8
+#else
+#define PMM_ZEROED_POOL_SIZE 64
+#endif
+#endif
+
+/**
+ * Called when there are no free frames, to ask a cache to give back some of its frames.
+ * It must not block, and it returns the number of frames freed.
+ */
+typedef size_t (*pmm_reclaim_t)(size_t frames);
+
 extern bool pmm_initialized;
+extern size_t pmm_zeroed_pool_count;
 
 void pmm_setup(uint64_t addr, uint32_t size);
 void _map_pmm();
 void *pmm_prepare_new_pagetable();
 void *pmm_alloc_frame();
+void *pmm_alloc_zeroed_frame();
+size_t pmm_refill_zeroed_pool(size_t max_frames);
 void *pmm_alloc_area(size_t size);
 void pmm_free_frame(void *address);
 bool pmm_check_frame_availability();
+void pmm_set_reclaim(pmm_reclaim_t reclaim);
 
 void pmm_reserve_area(uint64_t starting_address, size_t size);
 void pmm_free_area(uint64_t starting_address, size_t size);
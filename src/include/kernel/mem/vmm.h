@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <bitmap.h>
+#include <vmm_region.h>
 
 //#define NONE 0
 //#define PRESENT 0b1
@@ -72,6 +73,8 @@ typedef struct VmmInfo {
         VmmContainer *vmm_container_root; /**< Root node of the vmmContainer */
         VmmContainer *vmm_cur_container; /**< Current pointer */
     } status;
+
+    vmm_region_table_t regions; /**< The areas populated by the page fault handler */
 } VmmInfo;
 
 //uint64_t memory_size_in_bytes;
@@ -85,6 +88,7 @@ void vmm_init(vmm_level_t vmm_level, VmmInfo *vmm_info);
 void *vmm_alloc(size_t size, size_t flags, VmmInfo *vmm_info);
 void *vmm_alloc_at(uint64_t base_address, size_t size, size_t flags, VmmInfo *vmm_info);
 void vmm_free(void *address);
+size_t vmm_destroy(VmmInfo *vmm_info);
 
 uint8_t is_phyisical_address_mapped(uintptr_t physical_address, uintptr_t virtual_address);
 uint8_t check_virt_address_status(uint64_t virtual_address);
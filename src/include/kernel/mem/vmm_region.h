@@ -0,0 +1,68 @@
+#ifndef __VMM_REGION_H
+#define __VMM_REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define VMM_MAX_REGIONS 16
+#define VMM_SHARED_FRAMES_MAX   256
+
+typedef enum {
+    VMM_REGION_NONE = 0,
+    VMM_REGION_WRITE = (1 << 0), /**< The pages can be written */
+    VMM_REGION_FILE_SHARED = (1 << 1), /**< The pages are mapped straight from the file frames, if writable they are copied on the first write */
+} vmm_region_flags_t;
+
+/**
+ * Fill a private page of a region, the page is already zeroed.
+ */
+typedef void (*vmm_region_fill_t)(void *source, uintptr_t page_address, uint8_t *destination);
+
+/**
+ * A range of the task address space whose pages are populated on the first access (by the page fault handler)
+ */
+typedef struct {
+    uintptr_t start;
+    uintptr_t end;
+    size_t flags;
+    uint64_t file_phys; /**< The physical address of the file data mapped at start, used by the shared regions */
+    void *source; /**< Passed to fill */
+    vmm_region_fill_t fill;
+} vmm_region_t;
+
+typedef struct {
+    size_t faults;
+    size_t shared_maps; /**< Pages mapped from the file frames */
+    size_t private_fills; /**< Pages allocated and filled */
+    size_t cow_copies; /**< Shared pages copied on the first write */
+    size_t invalid; /**< Faults outside of the regions, or not allowed by the region flags */
+} vmm_fault_stats_t;
+
+typedef struct {
+    vmm_region_t regions[VMM_MAX_REGIONS]; /**< Sorted by start address */
+    size_t count;
+    vmm_fault_stats_t stats;
+} vmm_region_table_t;
+
+typedef enum {
+    VMM_FAULT_INVALID,
+    VMM_FAULT_MAP_SHARED,
+    VMM_FAULT_FILL_PRIVATE,
+    VMM_FAULT_COPY_ON_WRITE
+} vmm_fault_action_t;
+
+void vmm_regions_init(vmm_region_table_t *table);
+bool vmm_region_add(vmm_region_table_t *table, uintptr_t start, uintptr_t end, size_t flags, uint64_t file_phys, void *source, vmm_region_fill_t fill);
+vmm_region_t *vmm_region_find(vmm_region_table_t *table, uintptr_t address);
+vmm_fault_action_t vmm_region_fault_action(vmm_region_t *region, uint64_t error_code);
+
+size_t vmm_frame_ref(uint64_t phys);
+size_t vmm_frame_unref(uint64_t phys);
+size_t vmm_frame_refcount(uint64_t phys);
+
+#ifndef _TEST_
+bool vmm_region_handle_fault(uintptr_t address, uint64_t error_code);
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <cpu.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// If set to 1 the profiler starts sampling at boot, otherwise profiler_start has to be called
+#ifndef PROFILER_AUTOSTART
+#define PROFILER_AUTOSTART 0
+#endif
+
+#define PROFILER_MAX_CPUS   4
+// Number of samples kept for every cpu, when the buffer is full it's written on the serial by the idle thread
+#define PROFILER_BUFFER_SIZE    512
+// Frames saved for every sample, the interrupted rip included
+#define PROFILER_STACK_DEPTH    8
+#define PROFILER_LINE_LEN   512
+
+#define PROFILER_SAMPLE_USER    (1 << 0)
+
+/**
+ * A single sample, stack[0] is the interrupted rip, the other entries are the return addresses of its callers
+ */
+typedef struct {
+    uint32_t tid;
+    uint16_t depth;
+    uint16_t flags;
+    uint64_t stack[PROFILER_STACK_DEPTH];
+} profiler_sample_t;
+
+/**
+ * The samples of a single cpu. Only the timer interrupt writes it, until count reaches PROFILER_BUFFER_SIZE:
+ * after that the buffer belongs to profiler_flush, that writes it out and sets count back to 0.
+ */
+typedef struct {
+    size_t count;
+    uint64_t dropped; /**< Samples lost because the buffer was full */
+    profiler_sample_t samples[PROFILER_BUFFER_SIZE];
+} profiler_buffer_t;
+
+extern bool profiler_active;
+
+void init_profiler();
+void profiler_start();
+void profiler_stop();
+void profiler_sample(cpu_status_t *status);
+size_t profiler_flush(bool partial);
+
+#endif
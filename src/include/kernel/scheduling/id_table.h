@@ -0,0 +1,47 @@
+#ifndef _ID_TABLE_H
+#define _ID_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// An id is made of the index of its slot (low bits) and of the slot generation (high bits)
+#define ID_TABLE_INDEX_BITS 16
+#define ID_TABLE_GENERATION_BITS    15
+#define ID_TABLE_MAX_OBJECTS    (1 << ID_TABLE_INDEX_BITS)
+#define ID_TABLE_INDEX_MASK (ID_TABLE_MAX_OBJECTS - 1)
+#define ID_TABLE_GENERATION_MASK    ((1 << ID_TABLE_GENERATION_BITS) - 1)
+
+// The slots are stored in a two level radix tree, the leaves are allocated when the first of their slots is used
+#define ID_TABLE_LEAF_BITS  8
+#define ID_TABLE_LEAF_SIZE  (1 << ID_TABLE_LEAF_BITS)
+#define ID_TABLE_LEAVES (ID_TABLE_MAX_OBJECTS / ID_TABLE_LEAF_SIZE)
+
+#define ID_TABLE_INVALID_ID 0xFFFFFFFF
+#define ID_TABLE_NO_INDEX   0xFFFFFFFF
+
+typedef struct {
+    void *object; /**< NULL if the slot is free */
+    uint32_t next_free; /**< The next slot of the free list, valid only when the slot is free */
+    uint16_t generation; /**< Incremented every time the slot is released, so an old id doesn't find the new object */
+} id_table_entry_t;
+
+/**
+ * Map ids to objects, allocation, release and lookup are O(1).
+ * The released slots are reused first (the last released is the first reused), the generation makes the ids unique
+ * until a slot has been reused 2^ID_TABLE_GENERATION_BITS times.
+ * The table has no lock: the updates must be serialized by the caller, the lookups can run at any time.
+ */
+typedef struct {
+    id_table_entry_t *leaves[ID_TABLE_LEAVES];
+    uint32_t free_head; /**< The last released slot, or ID_TABLE_NO_INDEX */
+    uint32_t next_index; /**< The slots from this index on have never been used */
+    size_t count; /**< Number of objects in the table */
+} id_table_t;
+
+void id_table_init(id_table_t *table);
+uint32_t id_table_alloc(id_table_t *table, void *object);
+void *id_table_lookup(id_table_t *table, uint32_t id);
+bool id_table_release(id_table_t *table, uint32_t id);
+
+#endif
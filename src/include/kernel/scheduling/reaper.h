@@ -0,0 +1,24 @@
+#ifndef _REAPER_H_
+#define _REAPER_H_
+
+#include <stddef.h>
+#include <thread.h>
+
+// The reaper thread sleeps this long between two batches
+#define REAPER_SLEEP_MS 20
+
+typedef struct {
+    size_t queued; /**< Dead threads pushed by the scheduler */
+    size_t reaped; /**< Threads freed */
+    size_t tasks_destroyed; /**< Tasks released with their last thread */
+    size_t batches; /**< Non empty batches processed */
+} reaper_stats_t;
+
+extern reaper_stats_t reaper_stats;
+
+void init_reaper();
+void reaper_start();
+void reaper_push(thread_t *thread);
+size_t reaper_collect();
+
+#endif
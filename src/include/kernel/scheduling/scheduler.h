@@ -9,6 +9,17 @@
 #define SCHEDULER_NUMBER_OF_TICKS   0x200
 #define SCHEDULER_MAX_THREAD_NUMBER 0x10
 
+/**
+ * Scheduler counters, they are published with a seqlock so they can be read at any time without stopping the scheduler
+ */
+typedef struct {
+    uint64_t context_switches; /**< Times a different thread got the cpu */
+    uint64_t idle_switches; /**< Times the idle thread got the cpu because nothing else was ready */
+    uint64_t wakeups; /**< Sleeping threads woken up */
+    uint64_t dead_threads; /**< Dead threads removed from the run list and handed to the reaper */
+    uint64_t threads; /**< Threads in the run list */
+} scheduler_stats_t;
+
 extern uint16_t scheduler_ticks;
 extern thread_t* current_executing_thread;
 extern thread_t* idle_thread;
@@ -20,10 +31,12 @@ cpu_status_t* schedule(cpu_status_t* cur_status);
 
 void scheduler_add_thread(thread_t* thread);
 void scheduler_add_task(task_t* task);
+void scheduler_remove_task(task_t* task);
 
 thread_t* scheduler_get_next_thread();
 
 size_t scheduler_get_queue_size();
-void scheduler_delete_thread(size_t tid);
+bool scheduler_remove_thread(thread_t *thread);
 void scheduler_yield();
+void scheduler_get_stats(scheduler_stats_t *stats);
 #endif
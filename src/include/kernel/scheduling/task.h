@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <fd_table.h>
 #include <thread.h>
 #include <vmm.h>
 
@@ -23,12 +24,17 @@ struct task_t {
     struct thread_t* threads;
     task_t* parent;
     task_t* next;
+
+    fd_table_t fd_table;
+    rcu_head_t rcu; // The struct is freed after a grace period, when no reader can reach it anymore
 };
 
-extern size_t next_task_id;
+extern id_table_t task_ids;
 
 task_t* create_task( char *name, void (*_entry_point)(void *), void *args, bool is_supervisor );
+task_t* prepare_task( char *name, bool is_supervisor );
 task_t* get_task( size_t task_id );
+void task_destroy( task_t* task );
 
 bool add_thread_to_task_by_id( size_t task_id, thread_t* thread );
 bool add_thread_to_task( task_t* task, thread_t* thread );
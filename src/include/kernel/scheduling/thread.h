@@ -2,11 +2,14 @@
 #define _THREAD_H_
 
 #include <cpu.h>
+#include <id_table.h>
+#include <pmu.h>
+#include <rcu.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 #define THREAD_NAME_MAX_LEN 32
-#define THREAD_MAX_ID (uint16_t-1)
 
 #define THREAD_DEFAULT_STACK_SIZE   0x10000
 
@@ -25,7 +28,7 @@ typedef struct thread_t thread_t;
 #include <task.h>
 
 struct thread_t {
-    uint16_t tid;
+    uint32_t tid;
     char thread_name[THREAD_NAME_MAX_LEN];
     uintptr_t stack;
     struct task_t* parent_task;
@@ -34,15 +37,26 @@ struct thread_t {
     cpu_status_t *execution_frame;
     size_t wakeup_time;
     thread_t* next_sibling;
-    thread_t* next;
+    thread_t* prev_sibling;
+    thread_t* next; // The scheduler list, walked by rcu readers: a removed thread keeps its next until it is freed
+    thread_t* prev;
+    thread_t* reaper_next; // The reaper queue of the dead threads
+    thread_t* wait_next; // The wait queue the thread is blocked on, when its status is WAIT
     uintptr_t* rsp0;
+    uint8_t* fpu_state; // Extended (fpu/sse/avx) state area, 64 bytes aligned, allocated on first fpu use
+    void* fpu_state_allocation;
+    bool fpu_used;
+    pmu_counters_t pmu_counters; // Events counted by the pmu while the thread was running
+    rcu_head_t rcu; // The struct is freed after a grace period, when no reader can reach it anymore
 };
 
 
-extern size_t next_thread_id;
+extern id_table_t thread_ids;
 
 
 thread_t* create_thread(char* thread_name, void (*_entry_point)(void *) , void* arg, struct task_t* parent_task, bool is_supervisor);
+void thread_free(thread_t *thread);
+thread_t* get_thread(uint32_t tid);
 void thread_execution_wrapper( void (*)(void *), void*);
 void thread_suicide_trap();
 void thread_sleep(size_t millis);
@@ -0,0 +1,32 @@
+#ifndef _WAIT_QUEUE_H_
+#define _WAIT_QUEUE_H_
+
+#include <spinlock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <thread.h>
+
+/**
+ * A FIFO of the threads blocked on something (a mutex, a semaphore, an I/O completion...), linked with their wait_next field.
+ * A blocked thread is in the WAIT state: the scheduler skips it until it is woken, so it doesn't use any cpu time.
+ * The lock is always taken with the interrupts disabled, so an interrupt handler can wake the waiters.
+ */
+typedef struct {
+    spinlock_t lock;
+    thread_t *head;
+    thread_t *tail;
+} wait_queue_t;
+
+void wait_queue_init(wait_queue_t *queue);
+void wait_queue_sleep_locked(wait_queue_t *queue, uint64_t flags);
+thread_t *wait_queue_wake_one_locked(wait_queue_t *queue);
+size_t wait_queue_wake_all_locked(wait_queue_t *queue);
+void wait_queue_sleep(wait_queue_t *queue);
+thread_t *wait_queue_wake_one(wait_queue_t *queue);
+size_t wait_queue_wake_all(wait_queue_t *queue);
+
+static inline bool wait_queue_is_empty(wait_queue_t *queue) {
+    return __atomic_load_n(&queue->head, __ATOMIC_RELAXED) == NULL;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// If set to 0 all the TRACE calls are removed at compile time
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 1
+#endif
+
+#define TRACE_MAX_CPUS  4
+// Number of events kept for every cpu, must be a power of 2. When full the oldest events are overwritten.
+#define TRACE_BUFFER_SIZE   2048
+#define TRACE_FORMAT_VERSION    1
+
+#define CPUID_EXT_FEAT_EDX_RDTSCP   (1 << 27)
+
+typedef enum {
+    TRACE_CONTEXT_SWITCH = 1, /**< arg0: previous tid, arg1: next tid */
+    TRACE_THREAD_STATE, /**< arg0: tid, arg1: new status */
+    TRACE_PMM_ALLOC, /**< arg0: physical address */
+    TRACE_PMM_FREE, /**< arg0: physical address */
+    TRACE_KMALLOC, /**< arg0: address, arg1: size */
+    TRACE_KFREE, /**< arg0: address */
+    TRACE_PAGE_FAULT, /**< arg0: faulting address, arg1: error code */
+    TRACE_IRQ_ENTER, /**< arg0: vector */
+    TRACE_IRQ_EXIT, /**< arg0: vector */
+    TRACE_SYSCALL_ENTER, /**< arg0: syscall number */
+    TRACE_SYSCALL_EXIT, /**< arg0: syscall number, arg1: return value */
+    TRACE_EVENT_COUNT
+} trace_event_id_t;
+
+/**
+ * A single trace event, 32 bytes
+ */
+typedef struct {
+    uint64_t tsc;
+    uint16_t event_id;
+    uint16_t cpu_id;
+    uint32_t tid; /**< Thread running when the event happened (0xFFFFFFFF before the scheduler starts) */
+    uint64_t arg0;
+    uint64_t arg1;
+} __attribute__((__packed__)) trace_event_t;
+
+/**
+ * The trace ring of a single cpu, only that cpu writes it (interrupts included), so a fetch-add on head is enough.
+ */
+typedef struct {
+    uint64_t head; /**< Total number of events written, the next one goes at head % TRACE_BUFFER_SIZE */
+    trace_event_t events[TRACE_BUFFER_SIZE];
+} trace_buffer_t;
+
+extern bool trace_active;
+
+void init_trace();
+void trace_set_active(bool active);
+void trace_record(uint16_t event_id, uint64_t arg0, uint64_t arg1);
+void trace_dump();
+
+#if TRACE_ENABLED == 1 && !defined(_TEST_)
+#define TRACE(event_id, arg0, arg1) do { \
+        if (trace_active) \
+            trace_record(event_id, (uint64_t) (arg0), (uint64_t) (arg1)); \
+    } while (0)
+#else
+#define TRACE(event_id, arg0, arg1) do { } while (0)
+#endif
+
+#endif
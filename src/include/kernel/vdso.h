@@ -0,0 +1,91 @@
+#ifndef _VDSO_H_
+#define _VDSO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <seqlock.h>
+#include <task.h>
+
+// The vdso page is mapped read-only at the same address in every task, far away from the vmm bump allocator.
+#if SMALL_PAGES == 0
+#define VDSO_USER_ADDRESS   0x7FFFFFE00000
+#elif SMALL_PAGES == 1
+#define VDSO_USER_ADDRESS   0x7FFFFFFFF000
+#endif
+
+#define VDSO_VERSION    1
+
+/**
+ * This struct is the content of the vdso shared page.
+ * It is written only by the kernel, userspace can only read it.
+ * Every update is wrapped by the sequence counter (odd while the kernel is writing),
+ * so a reader has to retry if the sequence is odd or changed while reading (see seqlock.h).
+ * All the fields are naturally aligned, so there is no padding and the layout doesn't depend on the compiler.
+ */
+typedef struct {
+    seqcount_t sequence; /**< Odd while an update is in progress */
+    uint32_t version; /**< Layout version of this struct */
+    uint32_t cpu_id; /**< Id of the cpu that did the last update */
+    uint32_t reserved;
+    uint64_t uptime_ms; /**< Kernel uptime in millisec at the last timer tick */
+    uint64_t tsc_at_update; /**< Tsc value when uptime_ms was updated */
+    uint64_t tsc_ticks_per_ms; /**< Tsc calibration: number of tsc ticks in 1ms */
+    uint64_t boot_tsc; /**< Tsc value at calibration time */
+    uint64_t epoch_base; /**< Unix timestamp read from the rtc during boot */
+} vdso_data_t;
+
+/**
+ * A consistent copy of the vdso clock fields
+ */
+typedef struct {
+    uint64_t uptime_ms;
+    uint64_t tsc_at_update;
+    uint64_t tsc_ticks_per_ms;
+    uint64_t epoch_base;
+    uint32_t cpu_id;
+} vdso_snapshot_t;
+
+extern vdso_data_t *vdso_data;
+
+void init_vdso(uint64_t epoch_base);
+void vdso_map(task_t *task);
+void vdso_update_clock();
+
+/**
+ * Read a consistent snapshot of the vdso page. It doesn't use any kernel symbol so it can be used by userspace code too.
+ *
+ * @param vdso the address of the vdso page (VDSO_USER_ADDRESS from userspace)
+ * @param snapshot where to copy the vdso values
+ */
+static inline void vdso_read_snapshot(const volatile vdso_data_t *vdso, vdso_snapshot_t *snapshot) {
+    uint32_t sequence;
+    do {
+        sequence = seqcount_read_begin((const seqcount_t *) &vdso->sequence);
+        snapshot->uptime_ms = vdso->uptime_ms;
+        snapshot->tsc_at_update = vdso->tsc_at_update;
+        snapshot->tsc_ticks_per_ms = vdso->tsc_ticks_per_ms;
+        snapshot->epoch_base = vdso->epoch_base;
+        snapshot->cpu_id = vdso->cpu_id;
+    } while ( seqcount_read_retry((const seqcount_t *) &vdso->sequence, sequence) );
+}
+
+/**
+ * Return the current unix timestamp in milliseconds, using only the vdso page and the tsc.
+ *
+ * @param vdso the address of the vdso page
+ * @return milliseconds since the epoch
+ */
+static inline uint64_t vdso_get_epoch_ms(const volatile vdso_data_t *vdso) {
+    vdso_snapshot_t snapshot;
+    uint32_t low, high;
+    vdso_read_snapshot(vdso, &snapshot);
+    asm volatile("rdtsc" : "=a" (low), "=d" (high));
+    uint64_t now = ((uint64_t) high << 32) | low;
+    uint64_t elapsed_ms = 0;
+    if ( snapshot.tsc_ticks_per_ms != 0 && now > snapshot.tsc_at_update ) {
+        elapsed_ms = (now - snapshot.tsc_at_update) / snapshot.tsc_ticks_per_ms;
+    }
+    return (snapshot.epoch_base * 1000) + snapshot.uptime_ms + elapsed_ms;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _MEMOPS_H
+#define _MEMOPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Below this size the simd variants are not worth the cost of kernel_fpu_begin/end
+#define MEMOPS_SIMD_THRESHOLD   0x400
+
+typedef void* (*memcpy_function_t)(void *dest, const void *src, size_t count);
+typedef void* (*memset_function_t)(void *dest, int ch, size_t count);
+
+/**
+ * This struct contains the memory functions selected at boot, depending on the cpu features
+ */
+typedef struct {
+    memcpy_function_t memcpy_small; /**< Used for copies smaller than MEMOPS_SIMD_THRESHOLD */
+    memcpy_function_t memcpy_large;
+    memset_function_t memset_small; /**< Used for fills smaller than MEMOPS_SIMD_THRESHOLD */
+    memset_function_t memset_large;
+    bool has_erms;
+    bool has_fsrm; /**< Fast short rep movsb */
+    bool has_fsrs; /**< Fast short rep stosb */
+    bool has_sse2;
+    bool has_avx2;
+} memops_dispatch_t;
+
+extern memops_dispatch_t memops;
+
+void memops_init();
+
+void* memcpy_bytes(void *dest, const void *src, size_t count);
+void* memcpy_qwords(void *dest, const void *src, size_t count);
+void* memcpy_erms(void *dest, const void *src, size_t count);
+void* memcpy_sse2(void *dest, const void *src, size_t count);
+void* memcpy_avx2(void *dest, const void *src, size_t count);
+void* memcpy_backward(void *dest, const void *src, size_t count);
+
+void* memset_bytes(void *dest, int ch, size_t count);
+void* memset_qwords(void *dest, int ch, size_t count);
+void* memset_erms(void *dest, int ch, size_t count);
+void* memset_sse2(void *dest, int ch, size_t count);
+void* memset_avx2(void *dest, int ch, size_t count);
+
+int memcmp_bytes(const void *a, const void *b, size_t limit);
+int memcmp_qwords(const void *a, const void *b, size_t limit);
+
+#endif
@@ -2,7 +2,11 @@
 #define _STDIO_H
 
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 
 int printf(const char *fmt, ...);
 int vsprintf(char *buffer, const char *fmt, va_list args);
+int vsprintf_capture(const char *fmt, va_list args, uint64_t *values, size_t max_values, uint32_t *string_mask);
+int vsprintf_values(char *buffer, const char *fmt, const uint64_t *values, size_t values_count);
 #endif
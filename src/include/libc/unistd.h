@@ -6,5 +6,6 @@
 
 int close (int fildes);
 ssize_t read(int fildes, void *buf, size_t nbyte);
+ssize_t pread(int fildes, void *buf, size_t nbyte, off_t offset);
 
 #endif
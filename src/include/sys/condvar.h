@@ -0,0 +1,21 @@
+#ifndef _CONDVAR_H
+#define _CONDVAR_H
+
+#include <mutex.h>
+#include <wait_queue.h>
+
+/**
+ * A condition variable, used with a mutex protecting the condition: condvar_wait releases the mutex and blocks
+ * atomically, so a signal sent after the condition is changed under the mutex can't be missed.
+ * As usual the condition must be checked again after the wait returns.
+ */
+typedef struct {
+    wait_queue_t waiters;
+} condvar_t;
+
+void condvar_init(condvar_t *condvar);
+void condvar_wait(condvar_t *condvar, mutex_t *mutex);
+void condvar_signal(condvar_t *condvar);
+void condvar_broadcast(condvar_t *condvar);
+
+#endif
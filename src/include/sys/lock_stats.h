@@ -0,0 +1,77 @@
+#ifndef _LOCK_STATS_H
+#define _LOCK_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// If set to 0 the locks don't update their counters, the lock_stats_t fields are still there
+#ifndef LOCK_STATS_ENABLED
+#define LOCK_STATS_ENABLED 1
+#endif
+
+/**
+ * Contention counters of a lock. They are updated only by the owner of the lock, so they don't need atomics,
+ * but a dump running on another cpu can read them while they change.
+ */
+typedef struct lock_stats_t {
+    const char *name;
+    uint64_t acquisitions;
+    uint64_t contended; /**< Acquisitions that had to wait for another owner */
+    uint64_t spins; /**< Total number of wait loop iterations */
+    uint64_t max_hold_cycles; /**< Longest time the lock has been held, in tsc ticks */
+    uint64_t acquired_tsc; /**< When the current owner took the lock */
+    bool registered;
+    struct lock_stats_t *next;
+} lock_stats_t;
+
+static inline uint64_t lock_stats_tsc() {
+    uint32_t low, high;
+    asm volatile("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t) high << 32) | low;
+}
+
+/**
+ * Called by the lock implementations right after the lock has been taken.
+ *
+ * @param stats the lock counters, can be NULL
+ * @param spins the iterations of the wait loop, 0 if the lock was free
+ */
+static inline void lock_stats_acquired(lock_stats_t *stats, uint64_t spins) {
+#if LOCK_STATS_ENABLED == 1
+    if ( stats == NULL ) {
+        return;
+    }
+    stats->acquisitions++;
+    if ( spins > 0 ) {
+        stats->contended++;
+        stats->spins += spins;
+    }
+    stats->acquired_tsc = lock_stats_tsc();
+#else
+    (void) stats;
+    (void) spins;
+#endif
+}
+
+// Called by the lock implementations right before the lock is released
+static inline void lock_stats_released(lock_stats_t *stats) {
+#if LOCK_STATS_ENABLED == 1
+    if ( stats == NULL ) {
+        return;
+    }
+    uint64_t hold_cycles = lock_stats_tsc() - stats->acquired_tsc;
+    if ( hold_cycles > stats->max_hold_cycles ) {
+        stats->max_hold_cycles = hold_cycles;
+    }
+#else
+    (void) stats;
+#endif
+}
+
+void lock_stats_register(lock_stats_t *stats, const char *name);
+void lock_stats_reset(lock_stats_t *stats);
+lock_stats_t *lock_stats_list();
+void lock_stats_dump();
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _MCS_LOCK_H
+#define _MCS_LOCK_H
+
+#include <lock_stats.h>
+#include <spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// A waiter of an mcs lock, it must stay valid (usually on the stack of the caller) until the lock is released
+typedef struct mcs_node_t {
+    struct mcs_node_t *next;
+    bool locked;
+} mcs_node_t;
+
+/**
+ * A queued spinlock: the waiters form a list and every one of them spins on its own node, the owner hands the lock
+ * to the next one writing only its node. It's fair like the ticket lock, and the contention doesn't bounce a shared
+ * cache line between all the waiters.
+ */
+typedef struct {
+    mcs_node_t *tail; /**< The last waiter, NULL if the lock is free */
+    lock_stats_t *stats; /**< Contention counters, NULL if not collected */
+} mcs_lock_t;
+
+void mcs_lock_init(mcs_lock_t *lock, lock_stats_t *stats, const char *name);
+void mcs_lock_acquire(mcs_lock_t *lock, mcs_node_t *node);
+bool mcs_lock_try_acquire(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_lock_release(mcs_lock_t *lock, mcs_node_t *node);
+
+static inline uint64_t mcs_lock_acquire_irqsave(mcs_lock_t *lock, mcs_node_t *node) {
+    uint64_t flags = lock_irq_save();
+    mcs_lock_acquire(lock, node);
+    return flags;
+}
+
+static inline void mcs_lock_release_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t flags) {
+    mcs_lock_release(lock, node);
+    lock_irq_restore(flags);
+}
+
+#endif
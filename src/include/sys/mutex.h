@@ -0,0 +1,31 @@
+#ifndef _MUTEX_H
+#define _MUTEX_H
+
+#include <lock_stats.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <thread.h>
+#include <wait_queue.h>
+
+// Iterations a thread spins while the owner is running on another cpu, before blocking
+#define MUTEX_SPIN_LIMIT    1000
+
+/**
+ * A sleeping lock, for critical sections that can be long or can block: a waiter spins only while the owner is
+ * running (it will likely release the lock soon), otherwise it blocks on the wait queue and doesn't use the cpu.
+ * The release hands the lock directly to the first waiter, so the waiters get it in arrival order.
+ * It can't be used in interrupt handlers, and the owner must release it from the same thread.
+ */
+typedef struct {
+    thread_t *owner; /**< NULL if the mutex is free */
+    wait_queue_t waiters;
+    lock_stats_t *stats; /**< Contention counters, NULL if not collected */
+} mutex_t;
+
+void mutex_init(mutex_t *mutex, lock_stats_t *stats, const char *name);
+void mutex_acquire(mutex_t *mutex);
+bool mutex_try_acquire(mutex_t *mutex);
+void mutex_release(mutex_t *mutex);
+bool mutex_is_owned(mutex_t *mutex);
+
+#endif
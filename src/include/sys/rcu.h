@@ -0,0 +1,50 @@
+#ifndef _RCU_H
+#define _RCU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RCU_MAX_CPUS    4
+// The scheduler runs only on the bootstrap cpu for now
+#define RCU_BOOT_CPU    0
+
+/**
+ * Publish a pointer to a fully initialized object: the stores done to initialize it are visible before the pointer.
+ */
+#define rcu_assign_pointer(pointer, value) __atomic_store_n(&(pointer), (value), __ATOMIC_RELEASE)
+
+/**
+ * Read a pointer published with rcu_assign_pointer, inside a read side critical section.
+ */
+#define rcu_dereference(pointer) __atomic_load_n(&(pointer), __ATOMIC_ACQUIRE)
+
+/**
+ * Embedded in an object freed after a grace period, the callback gets it back and finds the object (i.e. with an offset).
+ */
+typedef struct rcu_head_t {
+    struct rcu_head_t *next;
+    void (*callback)(struct rcu_head_t *head);
+    uint64_t grace_period; /**< The callback can run when this grace period is completed */
+} rcu_head_t;
+
+typedef struct {
+    uint64_t grace_periods; /**< Grace periods completed */
+    uint64_t queued; /**< Callbacks queued with call_rcu */
+    uint64_t invoked; /**< Callbacks already run */
+} rcu_stats_t;
+
+extern rcu_stats_t rcu_stats;
+
+void init_rcu(size_t cpus);
+void rcu_read_lock();
+void rcu_read_unlock();
+bool rcu_read_locked(size_t cpu);
+size_t rcu_read_abandon(size_t cpu);
+void rcu_quiescent_state(size_t cpu);
+void call_rcu(rcu_head_t *head, void (*callback)(rcu_head_t *head));
+void synchronize_rcu();
+size_t rcu_process_callbacks();
+uint64_t rcu_completed_grace_period();
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _RWLOCK_H
+#define _RWLOCK_H
+
+#include <spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Set in the state while a writer holds the lock, the other bits count the readers
+#define RWLOCK_WRITER   0x80000000
+
+/**
+ * A reader-writer spinlock: many readers can hold it together, a writer holds it alone.
+ * Writers have the precedence: when one is waiting new readers wait too, so a steady flow of readers can't starve it.
+ * For this reason a reader must never take the read lock again while holding it.
+ */
+typedef struct {
+    uint32_t state; /**< Number of readers, or RWLOCK_WRITER */
+    uint32_t writers_waiting;
+} rwlock_t;
+
+void rwlock_init(rwlock_t *lock);
+void rwlock_read_acquire(rwlock_t *lock);
+void rwlock_read_release(rwlock_t *lock);
+void rwlock_write_acquire(rwlock_t *lock);
+bool rwlock_write_try_acquire(rwlock_t *lock);
+void rwlock_write_release(rwlock_t *lock);
+
+static inline uint64_t rwlock_read_acquire_irqsave(rwlock_t *lock) {
+    uint64_t flags = lock_irq_save();
+    rwlock_read_acquire(lock);
+    return flags;
+}
+
+static inline void rwlock_read_release_irqrestore(rwlock_t *lock, uint64_t flags) {
+    rwlock_read_release(lock);
+    lock_irq_restore(flags);
+}
+
+static inline uint64_t rwlock_write_acquire_irqsave(rwlock_t *lock) {
+    uint64_t flags = lock_irq_save();
+    rwlock_write_acquire(lock);
+    return flags;
+}
+
+static inline void rwlock_write_release_irqrestore(rwlock_t *lock, uint64_t flags) {
+    rwlock_write_release(lock);
+    lock_irq_restore(flags);
+}
+
+#endif
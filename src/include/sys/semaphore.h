@@ -0,0 +1,23 @@
+#ifndef _SEMAPHORE_H
+#define _SEMAPHORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <wait_queue.h>
+
+/**
+ * A counting semaphore: semaphore_down takes a unit, blocking while there are none, semaphore_up gives one back.
+ * A unit given back while threads are waiting goes directly to the first of them, so it can't be stolen.
+ * semaphore_up never blocks, so an interrupt handler can use it (i.e. to signal an I/O completion).
+ */
+typedef struct {
+    size_t count; /**< Units available, it's always 0 while there are waiters */
+    wait_queue_t waiters;
+} semaphore_t;
+
+void semaphore_init(semaphore_t *semaphore, size_t count);
+void semaphore_down(semaphore_t *semaphore);
+bool semaphore_try_down(semaphore_t *semaphore);
+void semaphore_up(semaphore_t *semaphore);
+
+#endif
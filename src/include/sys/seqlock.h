@@ -0,0 +1,70 @@
+#ifndef _SEQLOCK_H
+#define _SEQLOCK_H
+
+#include <spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A sequence counter, for data read often and written rarely by a single writer (or by writers already serialized).
+ * The readers never write, they copy the data and retry if a writer was active in the meantime:
+ *
+ *      do {
+ *          sequence = seqcount_read_begin(&count);
+ *          ... copy the data ...
+ *      } while ( seqcount_read_retry(&count, sequence) );
+ *
+ * The functions are all inline and don't use kernel symbols, so user space can read the vdso page with them.
+ */
+typedef struct {
+    volatile uint32_t sequence; /**< Odd while an update is in progress */
+} seqcount_t;
+
+static inline uint32_t seqcount_read_begin(const seqcount_t *count) {
+    uint32_t sequence;
+    while ( (sequence = __atomic_load_n(&count->sequence, __ATOMIC_ACQUIRE)) & 1 ) {
+        cpu_relax();
+    }
+    return sequence;
+}
+
+// Return true if the data read since seqcount_read_begin may be inconsistent, and must be read again
+static inline bool seqcount_read_retry(const seqcount_t *count, uint32_t sequence) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&count->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+static inline void seqcount_write_begin(seqcount_t *count) {
+    __atomic_store_n(&count->sequence, count->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqcount_write_end(seqcount_t *count) {
+    __atomic_store_n(&count->sequence, count->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * A sequence counter with a spinlock serializing the writers, the readers use the seqcount functions on its count.
+ */
+typedef struct {
+    seqcount_t count;
+    spinlock_t lock;
+} seqlock_t;
+
+static inline void seqlock_init(seqlock_t *seqlock) {
+    seqlock->count.sequence = 0;
+    spinlock_init(&seqlock->lock);
+}
+
+static inline uint64_t seqlock_write_acquire_irqsave(seqlock_t *seqlock) {
+    uint64_t flags = spinlock_acquire_irqsave(&seqlock->lock);
+    seqcount_write_begin(&seqlock->count);
+    return flags;
+}
+
+static inline void seqlock_write_release_irqrestore(seqlock_t *seqlock, uint64_t flags) {
+    seqcount_write_end(&seqlock->count);
+    spinlock_release_irqrestore(&seqlock->lock, flags);
+}
+
+#endif
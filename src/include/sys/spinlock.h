@@ -2,14 +2,58 @@
 #define _SPINLOCK_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
     bool    locked;
 } spinlock_t;
 
+// Tell the cpu that we are in a spin loop: it saves power and avoids the memory order flush when the loop ends
+static inline void cpu_relax() {
+    asm volatile("pause" ::: "memory");
+}
+
+/**
+ * Disable the interrupts, returning the previous rflags. A lock that is also taken from an interrupt handler
+ * (or while the interrupts are disabled) must be held with the interrupts disabled, otherwise the handler can spin
+ * forever on a lock owned by the thread it interrupted. In the tests it does nothing.
+ */
+static inline uint64_t lock_irq_save() {
+    uint64_t flags = 0;
+#ifndef _TEST_
+    asm volatile("pushfq; pop %0; cli" : "=r" (flags) :: "memory");
+#endif
+    return flags;
+}
+
+static inline void lock_irq_restore(uint64_t flags) {
+#ifndef _TEST_
+    if ( flags & (1 << 9) ) {
+        asm volatile("sti" ::: "memory");
+    }
+#endif
+    (void) flags;
+}
+
+/**
+ * Initialize a lock as free, the lock is embedded in the data it protects (or static).
+ */
+static inline void spinlock_init(spinlock_t *lock) {
+    lock->locked = false;
+}
 
-spinlock_t* spinlock_init();
 void spinlock_acquire(spinlock_t *lock);
+bool spinlock_try_acquire(spinlock_t *lock);
 void spinlock_release(spinlock_t *lock);
-void spinlock_free(spinlock_t *lock);
+
+static inline uint64_t spinlock_acquire_irqsave(spinlock_t *lock) {
+    uint64_t flags = lock_irq_save();
+    spinlock_acquire(lock);
+    return flags;
+}
+
+static inline void spinlock_release_irqrestore(spinlock_t *lock, uint64_t flags) {
+    spinlock_release(lock);
+    lock_irq_restore(flags);
+}
 #endif
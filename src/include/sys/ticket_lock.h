@@ -0,0 +1,36 @@
+#ifndef _TICKET_LOCK_H
+#define _TICKET_LOCK_H
+
+#include <lock_stats.h>
+#include <spinlock.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * A fair spinlock: every cpu takes a ticket and waits for its turn, so the lock is handed out in arrival order.
+ * The waiters only read now_serving, the cache line is written once per acquire and once per release.
+ */
+typedef struct {
+    uint32_t next_ticket;
+    uint32_t now_serving;
+    lock_stats_t *stats; /**< Contention counters, NULL if not collected */
+} ticket_lock_t;
+
+void ticket_lock_init(ticket_lock_t *lock, lock_stats_t *stats, const char *name);
+void ticket_lock_acquire(ticket_lock_t *lock);
+bool ticket_lock_try_acquire(ticket_lock_t *lock);
+void ticket_lock_release(ticket_lock_t *lock);
+bool ticket_lock_is_locked(ticket_lock_t *lock);
+
+static inline uint64_t ticket_lock_acquire_irqsave(ticket_lock_t *lock) {
+    uint64_t flags = lock_irq_save();
+    ticket_lock_acquire(lock);
+    return flags;
+}
+
+static inline void ticket_lock_release_irqrestore(ticket_lock_t *lock, uint64_t flags) {
+    ticket_lock_release(lock);
+    lock_irq_restore(flags);
+}
+
+#endif
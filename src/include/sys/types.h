@@ -2,5 +2,6 @@
 #define _TYPES_H
 
 typedef long int ssize_t; 
+typedef long int off_t;
 
 #endif
@@ -0,0 +1,253 @@
+#include <fpu.h>
+#include <cpuid.h>
+#include <kheap.h>
+#include <logging.h>
+#include <memops.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <string.h>
+
+fpu_info_t fpu_info;
+// The thread whose extended state is currently loaded in the cpu registers (NULL if nobody)
+thread_t *fpu_owner = NULL;
+
+// State loaded on the first fpu usage of every thread, it's saved right after initialization
+uint8_t fpu_initial_state[FXSAVE_AREA_SIZE * 8] __attribute__((aligned(FPU_STATE_ALIGNMENT)));
+
+size_t kernel_fpu_depth = 0;
+uint64_t kernel_fpu_saved_flags = 0;
+
+static uint64_t read_cr0() {
+    uint64_t value;
+    asm volatile("mov %%cr0, %0" : "=r" (value));
+    return value;
+}
+
+static void write_cr0(uint64_t value) {
+    asm volatile("mov %0, %%cr0" :: "r" (value) : "memory");
+}
+
+static uint64_t read_cr4() {
+    uint64_t value;
+    asm volatile("mov %%cr4, %0" : "=r" (value));
+    return value;
+}
+
+static void write_cr4(uint64_t value) {
+    asm volatile("mov %0, %%cr4" :: "r" (value) : "memory");
+}
+
+static void fpu_set_ts() {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+static void fpu_clear_ts() {
+    asm volatile("clts");
+}
+
+static void fpu_save_state(uint8_t *area) {
+    switch ( fpu_info.save_mode ) {
+        case FPU_SAVE_XSAVEOPT:
+            asm volatile("xsaveopt64 (%0)" :: "r" (area), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF) : "memory");
+            break;
+        case FPU_SAVE_XSAVE:
+            asm volatile("xsave64 (%0)" :: "r" (area), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF) : "memory");
+            break;
+        default:
+            asm volatile("fxsave64 (%0)" :: "r" (area) : "memory");
+            break;
+    }
+}
+
+static void fpu_restore_state(uint8_t *area) {
+    if ( fpu_info.save_mode == FPU_SAVE_FXSAVE ) {
+        asm volatile("fxrstor64 (%0)" :: "r" (area) : "memory");
+    } else {
+        asm volatile("xrstor64 (%0)" :: "r" (area), "a" (0xFFFFFFFF), "d" (0xFFFFFFFF) : "memory");
+    }
+}
+
+/**
+ * Enable the x87/sse (and avx if available) units, and detect the size of the extended state area.
+ * After this call the TS flag is set, so the first fpu instruction of every thread will trap with #NM.
+ */
+void init_fpu() {
+    uint32_t eax, ebx, ecx, edx;
+    fpu_info.initialized = false;
+    fpu_info.save_mode = FPU_SAVE_FXSAVE;
+    fpu_info.xcr0_features = 0;
+    fpu_info.state_size = FXSAVE_AREA_SIZE;
+    fpu_info.has_sse2 = false;
+    fpu_info.has_avx = false;
+
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+    if ( !(edx & CPUID_FEAT_EDX_FXSR) || !(edx & CPUID_FEAT_EDX_SSE) ) {
+        pretty_log(Error, "FXSR/SSE not supported, fpu will not be available");
+        return;
+    }
+    fpu_info.has_sse2 = (edx & CPUID_FEAT_EDX_SSE2) != 0;
+    // The leaf 0xD queries below overwrite ecx, so keep the leaf 1 features aside
+    uint32_t features_ecx = ecx;
+
+    // The fpu must be native (no emulation), and wait/fwait must honour the TS flag
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+
+    if ( features_ecx & CPUID_FEAT_ECX_XSAVE ) {
+        write_cr4(cr4 | CR4_OSXSAVE);
+        uint32_t supported_low, supported_high;
+        __get_cpuid_count(CPUID_XSAVE_LEAF, 0, &supported_low, &ebx, &ecx, &supported_high);
+        uint64_t features = XCR0_X87 | XCR0_SSE;
+        if ( (supported_low & XCR0_AVX) && (features_ecx & CPUID_FEAT_ECX_AVX) ) {
+            features |= XCR0_AVX;
+        }
+        asm volatile("xsetbv" :: "c" (0), "a" ((uint32_t) features), "d" ((uint32_t) (features >> 32)));
+        fpu_info.xcr0_features = features;
+        fpu_info.has_avx = (features & XCR0_AVX) != 0;
+        // Now that XCR0 is set, ebx contains the size needed by the enabled components
+        __get_cpuid_count(CPUID_XSAVE_LEAF, 0, &eax, &ebx, &ecx, &edx);
+        fpu_info.state_size = ebx;
+        __get_cpuid_count(CPUID_XSAVE_LEAF, 1, &eax, &ebx, &ecx, &edx);
+        fpu_info.save_mode = (eax & CPUID_XSAVE_EAX_XSAVEOPT) ? FPU_SAVE_XSAVEOPT : FPU_SAVE_XSAVE;
+    } else {
+        write_cr4(cr4);
+    }
+
+    if ( fpu_info.state_size > sizeof(fpu_initial_state) ) {
+        pretty_logf(Error, "Extended state size 0x%x is too big, fpu will not be available", fpu_info.state_size);
+        return;
+    }
+
+    // Prepare the clean state that every thread will get on its first fpu instruction
+    uint32_t mxcsr = MXCSR_DEFAULT_VALUE;
+    asm volatile("fninit");
+    asm volatile("ldmxcsr %0" :: "m" (mxcsr));
+    memset_qwords(fpu_initial_state, 0, sizeof(fpu_initial_state));
+    fpu_save_state(fpu_initial_state);
+
+    fpu_owner = NULL;
+    kernel_fpu_depth = 0;
+    fpu_info.initialized = true;
+    fpu_set_ts();
+    pretty_logf(Info, "Fpu initialized: save mode: %d - xcr0: 0x%x - state size: 0x%x - lazy: %d", fpu_info.save_mode, fpu_info.xcr0_features, fpu_info.state_size, FPU_LAZY_SWITCH);
+}
+
+static bool fpu_allocate_state(thread_t *thread) {
+    if ( thread->fpu_state != NULL ) {
+        return true;
+    }
+    // kmalloc only guarantees 16 bytes alignment, xsave needs 64
+    void *allocation = kmalloc(fpu_info.state_size + FPU_STATE_ALIGNMENT);
+    if ( allocation == NULL ) {
+        return false;
+    }
+    thread->fpu_state_allocation = allocation;
+    thread->fpu_state = (uint8_t *) (((uintptr_t) allocation + FPU_STATE_ALIGNMENT - 1) & ~((uintptr_t) FPU_STATE_ALIGNMENT - 1));
+    // Not memcpy: its simd variant would set TS again while we are handling #NM
+    memcpy_qwords(thread->fpu_state, fpu_initial_state, fpu_info.state_size);
+    return true;
+}
+
+/**
+ * Called by the scheduler when next is going to be executed.
+ * In lazy mode nothing is saved here, we only set TS if the registers do not belong to next.
+ *
+ * @param next the thread that is going to run
+ */
+void fpu_switch_thread(thread_t *next) {
+    if ( !fpu_info.initialized || next == NULL ) {
+        return;
+    }
+
+    if ( next == fpu_owner ) {
+        fpu_clear_ts();
+        return;
+    }
+
+#if FPU_LAZY_SWITCH == 0
+    if ( fpu_owner != NULL ) {
+        fpu_clear_ts();
+        fpu_save_state(fpu_owner->fpu_state);
+        fpu_owner = NULL;
+    }
+    if ( next->fpu_used ) {
+        fpu_clear_ts();
+        fpu_restore_state(next->fpu_state);
+        fpu_owner = next;
+        return;
+    }
+#endif
+    fpu_set_ts();
+}
+
+/**
+ * #NM handler: the current thread executed an fpu/sse/avx instruction while TS was set.
+ * The registers are saved in the previous owner area, and the current thread state is loaded.
+ */
+void fpu_handle_device_not_available() {
+    thread_t *thread = current_executing_thread;
+    fpu_clear_ts();
+    if ( !fpu_info.initialized || thread == NULL || thread == fpu_owner ) {
+        return;
+    }
+
+    if ( fpu_owner != NULL ) {
+        fpu_save_state(fpu_owner->fpu_state);
+        fpu_owner = NULL;
+    }
+
+    if ( !fpu_allocate_state(thread) ) {
+        pretty_logf(Fatal, "Cannot allocate the fpu state for thread: %d", thread->tid);
+        return;
+    }
+
+    fpu_restore_state(thread->fpu_state);
+    thread->fpu_used = true;
+    fpu_owner = thread;
+}
+
+/**
+ * Release the fpu resources of a thread that is going to be deleted
+ *
+ * @param thread the thread being deleted
+ */
+void fpu_release_thread(thread_t *thread) {
+    if ( thread == fpu_owner ) {
+        fpu_owner = NULL;
+    }
+    if ( thread->fpu_state_allocation != NULL ) {
+        kfree(thread->fpu_state_allocation);
+    }
+    thread->fpu_state_allocation = NULL;
+    thread->fpu_state = NULL;
+    thread->fpu_used = false;
+}
+
+/**
+ * Start a section where the kernel can use simd registers. Interrupts are disabled until kernel_fpu_end is called,
+ * and the registers of the thread owning the fpu are saved first.
+ */
+void kernel_fpu_begin() {
+    uint64_t flags = lock_irq_save();
+    if ( kernel_fpu_depth++ > 0 ) {
+        return;
+    }
+    kernel_fpu_saved_flags = flags;
+    fpu_clear_ts();
+    if ( fpu_owner != NULL ) {
+        fpu_save_state(fpu_owner->fpu_state);
+        fpu_owner = NULL;
+    }
+}
+
+/**
+ * End a kernel simd section. The registers now contains kernel garbage, so TS is set again:
+ * the next thread using the fpu will reload its state.
+ */
+void kernel_fpu_end() {
+    if ( kernel_fpu_depth == 0 || --kernel_fpu_depth > 0 ) {
+        return;
+    }
+    fpu_set_ts();
+    lock_irq_restore(kernel_fpu_saved_flags);
+}
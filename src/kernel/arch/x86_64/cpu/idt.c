@@ -1,9 +1,12 @@
 #include <idt.h>
+#include <fpu.h>
 #include <kernel/qemu.h>
 #include <keyboard.h>
+#include <kstack.h>
 #include <kernel.h>
 #include <lapic.h>
 #include <logging.h>
+#include <profiler.h>
 #include <scheduler.h>
 #include <stacktrace.h>
 #include <stdbool.h>
@@ -11,6 +14,9 @@
 #include <stdio.h>
 #include <syscalls.h>
 #include <timer.h>
+#include <trace.h>
+#include <tss.h>
+#include <vdso.h>
 #include <video.h>
 #include <vm.h>
 
@@ -52,23 +58,46 @@ static const char *exception_names[] = {
 IDT_descriptor idt_table[IDT_SIZE];
 
 cpu_status_t* interrupts_handler(cpu_status_t *status){
+    uint64_t interrupt_number = status->interrupt_number;
+    if ( interrupt_number >= 32 && interrupt_number != SYSCALL_VECTOR_NUMBER && interrupt_number != SCHEDULER_YIELD_INTERRUPT ) {
+        TRACE(TRACE_IRQ_ENTER, interrupt_number, 0);
+    }
     switch(status->interrupt_number){
         case PAGE_FAULT:
             pretty_log(Verbose, "Page fault");
             page_fault_handler(status->error_code);
             break;
+        case DEV_NOT_AVL:
+            fpu_handle_device_not_available();
+            break;
+        case DOUBLE_FAULT: {
+            // A kernel stack overflow faults on the guard page, and the page fault can't be pushed on the same stack
+            uint64_t cr2_content;
+            asm ("mov %%cr2, %0" : "=r" (cr2_content) );
+            if ( kstack_is_guard(cr2_content) ) {
+                pretty_logf(Fatal, "Kernel stack overflow in thread %d (%s) - address: 0x%x", current_executing_thread->tid, current_executing_thread->thread_name, cr2_content);
+            }
+            pretty_logf(Fatal, "Exception: [%s] - cr2: 0x%x", exception_names[status->interrupt_number], cr2_content);
+            asm("hlt");
+            break;
+        }
         case GENERAL_PROTECTION:
             pretty_logf(Verbose, "#GP Error code: 0x%x", status->error_code);
             pretty_logf(Verbose, "Exception: [%s]", exception_names[status->interrupt_number]);
-            printStackTrace(10, false);
+            printStackTrace(10, true);
             asm("hlt");
             break;
         case APIC_TIMER_INTERRUPT:
             timer_handler();
+            profiler_sample(status);
             status = schedule(status);
-            kernel_settings.kernel_uptime++;
+            kernel_clock_tick();
+            vdso_update_clock();
             write_apic_register(APIC_EOI_REGISTER_OFFSET, 0x0l);
             break;
+        case SCHEDULER_YIELD_INTERRUPT:
+            status = schedule(status);
+            break;
         case APIC_SPURIOUS_INTERRUPT:
             pretty_log(Verbose, "Spurious interrupt received");
             //should i send an eoi on a spurious interrupt?
@@ -84,15 +113,22 @@ cpu_status_t* interrupts_handler(cpu_status_t *status){
             break;
         case SYSCALL_VECTOR_NUMBER:
             //pretty_log(Verbose, "Serving syscall.");
-            syscall_dispatch(status);
+            TRACE(TRACE_SYSCALL_ENTER, status->rsi, 0);
+            // The syscall can switch to another thread (i.e. on exit), then the frame returned is the new one
+            cpu_status_t *next_status = syscall_dispatch(status);
+            TRACE(TRACE_SYSCALL_EXIT, status->rsi, status->rax);
+            status = next_status;
             break;
         default:
             pretty_logf(Verbose, "Exception: [%s]", (status->interrupt_number < 32) ? exception_names[status->interrupt_number] : "Unrecognized Error");
-            printStackTrace(10, false);
+            printStackTrace(10, true);
             pretty_logf(Fatal, "Actually i don't know what to do... Better going crazy... asdfasdasdsD - Interrupt number 0x%x", status->interrupt_number);
             asm("hlt");
             break;
     }
+    if ( interrupt_number >= 32 && interrupt_number != SYSCALL_VECTOR_NUMBER && interrupt_number != SCHEDULER_YIELD_INTERRUPT ) {
+        TRACE(TRACE_IRQ_EXIT, interrupt_number, 0);
+    }
     return status;
 }
 
@@ -116,7 +152,7 @@ void init_idt(){
     set_idt_entry(0x05, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_5);
     set_idt_entry(0x06, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_6);
     set_idt_entry(0x07, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_7);
-    set_idt_entry(0x08, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_error_code_8);
+    set_idt_entry(0x08, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, TSS_DOUBLE_FAULT_IST, interrupt_service_routine_error_code_8);
     set_idt_entry(0x09, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_9);
     set_idt_entry(0x0A, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_error_code_10);
     set_idt_entry(0x0B, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_error_code_11);
@@ -130,6 +166,7 @@ void init_idt(){
     set_idt_entry(0x20, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_32);
     set_idt_entry(0x21, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_33);
     set_idt_entry(0x22, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_34);
+    set_idt_entry(SCHEDULER_YIELD_INTERRUPT, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_129);
     set_idt_entry(0xFF, IDT_PRESENT_FLAG | IDT_INTERRUPT_TYPE_FLAG, KERNEL_CS, 0, interrupt_service_routine_255);
 }
 
@@ -4,10 +4,10 @@
 
 uint64_t rdmsr(uint32_t address){
     uint32_t low=0, high=0;
-    asm("movl %2, %%ecx;" 
-        "rdmsr;"
+    // volatile: the same msr can return a different value on every read (i.e. the performance counters)
+    asm volatile("rdmsr"
         : "=a" (low), "=d" (high)
-        : "g" (address)
+        : "c" (address)
     );
 
     return (uint64_t) low | ((uint64_t)high << 32);
@@ -20,3 +20,33 @@ void wrmsr(uint32_t address, uint64_t value)
     : "a" ((uint32_t)value), "d"(value >> 32), "c"(address)
     );
 }
+
+uint64_t rdtsc() {
+    uint32_t low=0, high=0;
+    asm volatile("rdtsc" : "=a" (low), "=d" (high));
+    return (uint64_t) low | ((uint64_t)high << 32);
+}
+
+/**
+ * Read the tsc together with IA32_TSC_AUX (the kernel stores the cpu id there)
+ *
+ * @param aux where the value of IA32_TSC_AUX is stored
+ * @return the tsc value
+ */
+uint64_t rdtscp(uint32_t *aux) {
+    uint32_t low=0, high=0;
+    asm volatile("rdtscp" : "=a" (low), "=d" (high), "=c" (*aux));
+    return (uint64_t) low | ((uint64_t)high << 32);
+}
+
+/**
+ * Read a general purpose performance counter, faster than rdmsr on IA32_PMCx
+ *
+ * @param counter the index of the counter
+ * @return the counter value
+ */
+uint64_t rdpmc(uint32_t counter) {
+    uint32_t low=0, high=0;
+    asm volatile("rdpmc" : "=a" (low), "=d" (high) : "c" (counter));
+    return (uint64_t) low | ((uint64_t)high << 32);
+}
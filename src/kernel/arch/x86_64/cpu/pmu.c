@@ -0,0 +1,114 @@
+#include <pmu.h>
+#include <cpuid.h>
+#include <logging.h>
+#include <msr.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <thread.h>
+
+pmu_info_t pmu_info;
+// Value of every counter when it was last accounted to a thread
+uint64_t pmu_last_values[PMU_MAX_COUNTERS];
+
+static const uint16_t pmu_arch_events[PMU_MAX_COUNTERS] = {
+    PMU_ARCH_EVENT_CYCLES,
+    PMU_ARCH_EVENT_INSTRUCTIONS,
+    PMU_ARCH_EVENT_LLC_MISSES,
+    PMU_ARCH_EVENT_BRANCH_MISSES
+};
+
+static const uint8_t pmu_arch_ebx_bits[PMU_MAX_COUNTERS] = {
+    PMU_ARCH_EBX_CYCLES,
+    PMU_ARCH_EBX_INSTRUCTIONS,
+    PMU_ARCH_EBX_LLC_MISSES,
+    PMU_ARCH_EBX_BRANCH_MISSES
+};
+
+/**
+ * Detect the architectural performance monitoring unit, and program one general purpose counter for every
+ * pmu_counter_t event (if there are enough counters). The counters count both in kernel and user mode.
+ */
+void init_pmu() {
+    uint32_t eax, ebx, ecx, edx;
+    pmu_info.initialized = false;
+    pmu_info.version = 0;
+    pmu_info.general_counters = 0;
+    pmu_info.available = 0;
+    for (size_t i = 0; i < PMU_MAX_COUNTERS; i++) {
+        pmu_last_values[i] = 0;
+    }
+
+    if ( !__get_cpuid(CPUID_PMU_LEAF, &eax, &ebx, &ecx, &edx) || (eax & 0xFF) == 0 ) {
+        pretty_log(Info, "Architectural performance monitoring not supported");
+        return;
+    }
+    pmu_info.version = eax & 0xFF;
+    pmu_info.general_counters = (eax >> 8) & 0xFF;
+    pmu_info.counter_width = (eax >> 16) & 0xFF;
+    // Only the events listed in the ebx bit vector are described by cpuid
+    uint8_t events_described = (eax >> 24) & 0xFF;
+
+    uint8_t next_counter = 0;
+    uint64_t global_enable = 0;
+    for (size_t event = 0; event < PMU_MAX_COUNTERS && next_counter < pmu_info.general_counters; event++) {
+        uint8_t ebx_bit = pmu_arch_ebx_bits[event];
+        if ( ebx_bit >= events_described || (ebx & (1 << ebx_bit)) ) {
+            continue;
+        }
+        wrmsr(IA32_PERFEVTSEL0 + next_counter, 0);
+        wrmsr(IA32_PMC0 + next_counter, 0);
+        wrmsr(IA32_PERFEVTSEL0 + next_counter, pmu_arch_events[event] | PERFEVTSEL_USR | PERFEVTSEL_OS | PERFEVTSEL_EN);
+        pmu_info.counter_index[event] = next_counter;
+        pmu_info.available |= 1 << event;
+        global_enable |= 1 << next_counter;
+        next_counter++;
+    }
+    // Before version 2 there is no global control, the enable bit of every PERFEVTSEL is enough
+    if ( pmu_info.version >= 2 ) {
+        wrmsr(IA32_PERF_GLOBAL_CTRL, global_enable);
+    }
+    pmu_info.initialized = true;
+    pretty_logf(Info, "Pmu initialized: version: %d - counters: %d - width: %d - events available: 0x%x", pmu_info.version, pmu_info.general_counters, pmu_info.counter_width, pmu_info.available);
+}
+
+/**
+ * Add to the thread the events counted since the last call, it's called by the scheduler on the thread
+ * that is leaving the cpu, so every thread only gets the events that happened while it was running.
+ *
+ * @param thread the thread the events are accounted to
+ */
+void pmu_account_thread(thread_t *thread) {
+    if ( !pmu_info.initialized ) {
+        return;
+    }
+    uint64_t mask = pmu_info.counter_width >= 64 ? ~0ull : (1ull << pmu_info.counter_width) - 1;
+    for (size_t event = 0; event < PMU_MAX_COUNTERS; event++) {
+        if ( !(pmu_info.available & (1 << event)) ) {
+            continue;
+        }
+        uint64_t value = rdpmc(pmu_info.counter_index[event]);
+        // The counters are narrower than 64 bits, the mask handles the wrap around
+        thread->pmu_counters.values[event] += (value - pmu_last_values[event]) & mask;
+        pmu_last_values[event] = value;
+    }
+}
+
+/**
+ * Get the events counted while the thread was running. If it is the current thread the counters are
+ * brought up to date first.
+ *
+ * @param thread the thread to read
+ * @param counters where the totals are copied
+ */
+void pmu_read_thread(thread_t *thread, pmu_counters_t *counters) {
+    uint64_t flags = lock_irq_save();
+    if ( thread == current_executing_thread ) {
+        pmu_account_thread(thread);
+    }
+    for (size_t event = 0; event < PMU_MAX_COUNTERS; event++) {
+        counters->values[event] = thread->pmu_counters.values[event];
+    }
+    counters->available = pmu_info.available;
+    counters->reserved = 0;
+    lock_irq_restore(flags);
+}
@@ -1,18 +1,31 @@
+#include <ksyms.h>
 #include <logging.h>
 #include <stacktrace.h>
-#include <stacktrace.h>
 
 
 void printStackTrace(size_t level, bool printFunctionNames) {
-    if (printFunctionNames == true) {
-        pretty_log(Info, "Print function names not implemented yet");
+    if (printFunctionNames == true && kernel_symbols.count == 0) {
+        pretty_log(Info, "Kernel symbols not loaded, function names will not be printed");
+        printFunctionNames = false;
     }
 
     StackFrame *cur_frame = __builtin_frame_address(0);
     size_t cur_level = 0;
     pretty_log(Info, "Stacktrace:");
     while ( cur_level < level && cur_frame != NULL ) {
-        pretty_logf(Info, "(%d):\t at 0x%x", cur_level, cur_frame->rip);
+        const ksym_t *symbol = printFunctionNames ? ksyms_lookup(&kernel_symbols, cur_frame->rip) : NULL;
+        if ( symbol != NULL ) {
+            // The symbol names are not null terminated
+            char name[64];
+            size_t name_length = symbol->name_length < sizeof(name) - 1 ? symbol->name_length : sizeof(name) - 1;
+            for (size_t i = 0; i < name_length; i++) {
+                name[i] = symbol->name[i];
+            }
+            name[name_length] = '\0';
+            pretty_logf(Info, "(%d):\t at 0x%x <%s+0x%x>", cur_level, cur_frame->rip, name, cur_frame->rip - symbol->address);
+        } else {
+            pretty_logf(Info, "(%d):\t at 0x%x", cur_level, cur_frame->rip);
+        }
         cur_frame = cur_frame->next;
         cur_level++;
     }
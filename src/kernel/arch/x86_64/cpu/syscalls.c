@@ -1,8 +1,17 @@
 #include <framebuffer.h>
 #include <idt.h>
+#include <lock_stats.h>
 #include <logging.h>
+#include <pmu.h>
 #include <rtc.h>
+#include <scheduler.h>
+#include <string.h>
 #include <syscalls.h>
+#include <task.h>
+#include <trace.h>
+#include <vm.h>
+#include <vmm.h>
+#include <vmm_mapping.h>
 
 bool _syscalls_init() {
     pretty_log(Verbose, "Initializing sycalls");
@@ -10,6 +19,45 @@ bool _syscalls_init() {
     return true;
 }
 
+/**
+ * Copy a result into a buffer of the calling task. Every page of the buffer must be mapped user accessible and writable:
+ * the pages of the task regions not populated yet (or still shared) are solved first, as a page fault would do,
+ * so the kernel never faults on a user address.
+ *
+ * @param user_address the destination, in the task address space
+ * @param source the data to copy
+ * @param size the number of bytes
+ * @return true if the data has been copied, false if the buffer is not valid
+ */
+static bool syscall_copy_to_user(uintptr_t user_address, const void *source, size_t size) {
+    if ( user_address == 0 || size > SYSCALL_USER_ADDRESS_LIMIT || user_address > SYSCALL_USER_ADDRESS_LIMIT - size ) {
+        return false;
+    }
+    task_t *task = current_executing_thread->parent_task;
+    uint64_t *root_table = (uint64_t *) task->vmm_data.root_table_hhdm;
+    uintptr_t last_page = (user_address + size - 1) & ~(PAGE_SIZE_IN_BYTES - 1);
+    for (uintptr_t page = user_address & ~(PAGE_SIZE_IN_BYTES - 1); page <= last_page; page += PAGE_SIZE_IN_BYTES) {
+        uint64_t entry = get_page_entry_hh((void *) page, root_table);
+        uint64_t required_flags = PRESENT_BIT | WRITE_BIT | VMM_FLAGS_USER_LEVEL;
+        if ( (entry & required_flags) == required_flags ) {
+            continue;
+        }
+        if ( vmm_region_find(&task->vmm_data.regions, page) == NULL ) {
+            return false;
+        }
+        uint64_t error_code = ACCESS_VIOLATION | WRITE_VIOLATION | ((entry & PRESENT_BIT) ? PRESENT_VIOLATION : 0);
+        if ( !vmm_region_handle_fault(page, error_code) ) {
+            return false;
+        }
+        entry = get_page_entry_hh((void *) page, root_table);
+        if ( (entry & required_flags) != required_flags ) {
+            return false;
+        }
+    }
+    memcpy((void *) user_address, (void *) source, size);
+    return true;
+}
+
 cpu_status_t *syscall_dispatch(cpu_status_t* regs) {
     //TODO: add mapping / unmapping memory syscall
     size_t sc_num = regs->rsi;
@@ -25,6 +73,52 @@ cpu_status_t *syscall_dispatch(cpu_status_t* regs) {
             //char *input_string = (char *) regs->rsi;
             //pretty_logf(Verbose, "%s", input_string);
             break;
+        case SYSCALL_PMU_READ: {
+            // rdi: pointer to a pmu_counters_t, filled with the counters of the calling thread
+            pmu_counters_t counters;
+            if ( !pmu_info.initialized ) {
+                regs->rax = E_NOT_SUPPORTED;
+                break;
+            }
+            pmu_read_thread(current_executing_thread, &counters);
+            regs->rax = syscall_copy_to_user(regs->rdi, &counters, sizeof(pmu_counters_t)) ? 0 : E_INVALID_ARGUMENT;
+            break;
+        }
+        case SYSCALL_VMM_FAULTS: {
+            // rdi: pointer to a vmm_fault_stats_t, filled with the page faults of the calling task
+            // The copy can solve faults in the buffer, the counters are taken before
+            vmm_fault_stats_t stats = current_executing_thread->parent_task->vmm_data.regions.stats;
+            regs->rax = syscall_copy_to_user(regs->rdi, &stats, sizeof(vmm_fault_stats_t)) ? 0 : E_INVALID_ARGUMENT;
+            break;
+        }
+        case SYSCALL_EXIT:
+            // The calling thread never runs again, it's deleted by the scheduler (with its task if it is the last thread).
+            // A dead thread with a full time slice is always switched out, so the frame returned is never the caller's
+            current_executing_thread->status = DEAD;
+            TRACE(TRACE_THREAD_STATE, current_executing_thread->tid, DEAD);
+            current_executing_thread->ticks = SCHEDULER_NUMBER_OF_TICKS;
+            return schedule(regs);
+        case SYSCALL_LOCK_STATS:
+            // The counters of the registered locks are written in the kernel log
+            lock_stats_dump();
+            regs->rax = 0;
+            break;
+        case SYSCALL_SCHED_STATS: {
+            // rdi: pointer to a scheduler_stats_t, filled with the scheduler counters
+            scheduler_stats_t stats;
+            scheduler_get_stats(&stats);
+            regs->rax = syscall_copy_to_user(regs->rdi, &stats, sizeof(scheduler_stats_t)) ? 0 : E_INVALID_ARGUMENT;
+            break;
+        }
+        case SYSCALL_TRACE_DUMP:
+            // The trace buffers are written on the serial port, the tracing goes on after the dump
+#if TRACE_ENABLED == 1
+            trace_dump();
+            regs->rax = 0;
+#else
+            regs->rax = E_NOT_SUPPORTED;
+#endif
+            break;
         default:
             regs->rax = E_NO_SYSCALL;
             break;
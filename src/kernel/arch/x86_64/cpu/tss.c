@@ -6,6 +6,8 @@ extern uint64_t stack[];
 
 tss_t kernel_tss;
 
+static uint8_t double_fault_stack[TSS_IST_STACK_SIZE] __attribute__((aligned(16)));
+
 void initialize_tss(){
 
     pretty_log(Verbose, "Initializing tss");
@@ -26,7 +28,7 @@ void initialize_tss(){
     kernel_tss.rsp2 = 0x0;
     // istX are the Interrup stack table,  unless some specific cases they can be left as 0
     // See intel manual chapter 5
-    kernel_tss.ist1 = 0x0;
+    kernel_tss.ist1 = (uint64_t) double_fault_stack + TSS_IST_STACK_SIZE;
     kernel_tss.ist2 = 0x0;
     kernel_tss.ist3 = 0x0;
     kernel_tss.ist4 = 0x0;
@@ -0,0 +1,75 @@
+#include <page_ops.h>
+
+/**
+ * Fill a page with zeroes using non-temporal stores.
+ * A freshly zeroed page is usually not read again soon (it will be handed to a task, or kept in the pmm pool),
+ * so bypassing the cache avoids evicting useful lines. Only general purpose registers are used, so it can be called
+ * without touching the fpu state.
+ *
+ * @param page the virtual address of the page, it must be 8 bytes aligned
+ * @param size the size of the page, it must be a multiple of PAGE_OPS_BLOCK_SIZE
+ */
+void page_zero(void *page, size_t size) {
+    size_t blocks = size / PAGE_OPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return;
+    }
+    asm volatile(
+        "xor %%eax, %%eax\n\t"
+        "1:\n\t"
+        "movnti %%rax, (%0)\n\t"
+        "movnti %%rax, 8(%0)\n\t"
+        "movnti %%rax, 16(%0)\n\t"
+        "movnti %%rax, 24(%0)\n\t"
+        "movnti %%rax, 32(%0)\n\t"
+        "movnti %%rax, 40(%0)\n\t"
+        "movnti %%rax, 48(%0)\n\t"
+        "movnti %%rax, 56(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r" (page), "+r" (blocks)
+        :
+        : "rax", "memory");
+}
+
+/**
+ * Copy a page using non-temporal stores for the destination (i.e. for copy on write or for loading a binary segment).
+ *
+ * @param dest the virtual address of the destination page, it must be 8 bytes aligned
+ * @param src the virtual address of the source page
+ * @param size the size of the page, it must be a multiple of PAGE_OPS_BLOCK_SIZE
+ */
+void page_copy(void *dest, const void *src, size_t size) {
+    size_t blocks = size / PAGE_OPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return;
+    }
+    asm volatile(
+        "1:\n\t"
+        "mov (%1), %%rax\n\t"
+        "mov 8(%1), %%rdx\n\t"
+        "mov 16(%1), %%r8\n\t"
+        "mov 24(%1), %%r9\n\t"
+        "movnti %%rax, (%0)\n\t"
+        "movnti %%rdx, 8(%0)\n\t"
+        "movnti %%r8, 16(%0)\n\t"
+        "movnti %%r9, 24(%0)\n\t"
+        "mov 32(%1), %%rax\n\t"
+        "mov 40(%1), %%rdx\n\t"
+        "mov 48(%1), %%r8\n\t"
+        "mov 56(%1), %%r9\n\t"
+        "movnti %%rax, 32(%0)\n\t"
+        "movnti %%rdx, 40(%0)\n\t"
+        "movnti %%r8, 48(%0)\n\t"
+        "movnti %%r9, 56(%0)\n\t"
+        "add $64, %0\n\t"
+        "add $64, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "sfence"
+        : "+r" (dest), "+r" (src), "+r" (blocks)
+        :
+        : "rax", "rdx", "r8", "r9", "memory");
+}
@@ -262,6 +262,128 @@ int unmap_vaddress_hh(void *address, uint64_t *pml4_root) {
 #endif
 }
 
+/**
+ * Get the entry that maps an address: the page directory entry of a 2mb page, or the page table entry of a 4k page
+ * (with 2mb pages too, for the areas mapped with map_page_table_hh). The caller can check its flags.
+ *
+ * @param address the virtual address
+ * @param pml4_root the root table of the address space (from the direct map)
+ * @return the entry, 0 if the address is not mapped
+ */
+uint64_t get_page_entry_hh(void *address, uint64_t *pml4_root) {
+    uint64_t *pml4_table = pml4_root;
+    uint16_t pml4_e = PML4_ENTRY((uint64_t) address);
+    if ( !(pml4_table[pml4_e] & PRESENT_BIT) ) {
+        return 0;
+    }
+    uint64_t *pdpr_table = (uint64_t *) hhdm_get_variable((uintptr_t) pml4_table[pml4_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+    uint16_t pdpr_e = PDPR_ENTRY((uint64_t) address);
+    if ( !(pdpr_table[pdpr_e] & PRESENT_BIT) ) {
+        return 0;
+    }
+    uint64_t *pd_table = (uint64_t *) hhdm_get_variable((uintptr_t) pdpr_table[pdpr_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+    uint16_t pd_e = PD_ENTRY((uint64_t) address);
+    if ( !(pd_table[pd_e] & PRESENT_BIT) ) {
+        return 0;
+    }
+    if ( pd_table[pd_e] & HUGEPAGE_BIT ) {
+        return pd_table[pd_e];
+    }
+    uint64_t *pt_table = (uint64_t *) hhdm_get_variable((uintptr_t) pd_table[pd_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+    uint64_t entry = pt_table[PT_ENTRY((uint64_t) address)];
+    return (entry & PRESENT_BIT) ? entry : 0;
+}
+
+/**
+ * Find the physical frame mapped at an address of an address space
+ *
+ * @param address the virtual address
+ * @param pml4_root the root table of the address space (from the direct map)
+ * @return the physical address of the page containing address, or NULL if it is not mapped
+ */
+void *translate_virt_address_hh(void *address, uint64_t *pml4_root) {
+    uint64_t entry = get_page_entry_hh(address, pml4_root);
+    if ( entry == 0 ) {
+        return NULL;
+    }
+    if ( entry & HUGEPAGE_BIT ) {
+        return (void *) (ALIGN_PHYSADDRESS(entry) & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+    }
+    return (void *) (entry & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+}
+
+/**
+ * Free the page tables of the lower half of an address space, the higher half tables are shared with the kernel.
+ * The frames mapped by the tables are not freed, the entries of the root table are cleared.
+ *
+ * @param pml4_root the root table of the address space (from the direct map)
+ * @return the number of tables freed
+ */
+size_t free_user_page_tables(uint64_t *pml4_root) {
+    size_t freed_tables = 0;
+    for (size_t pml4_e = 0; pml4_e < VM_PAGES_PER_TABLE / 2; pml4_e++) {
+        if ( !(pml4_root[pml4_e] & PRESENT_BIT) ) {
+            continue;
+        }
+        uintptr_t pdpr_phys = pml4_root[pml4_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK;
+        uint64_t *pdpr_table = (uint64_t *) hhdm_get_variable(pdpr_phys);
+        for (size_t pdpr_e = 0; pdpr_e < VM_PAGES_PER_TABLE; pdpr_e++) {
+            if ( !(pdpr_table[pdpr_e] & PRESENT_BIT) ) {
+                continue;
+            }
+            uintptr_t pd_phys = pdpr_table[pdpr_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK;
+#if SMALL_PAGES == 1
+            uint64_t *pd_table = (uint64_t *) hhdm_get_variable(pd_phys);
+            for (size_t pd_e = 0; pd_e < VM_PAGES_PER_TABLE; pd_e++) {
+                if ( pd_table[pd_e] & PRESENT_BIT ) {
+                    pmm_free_frame((void *) (pd_table[pd_e] & VM_PAGE_TABLE_BASE_ADDRESS_MASK));
+                    freed_tables++;
+                }
+            }
+#endif
+            pmm_free_frame((void *) pd_phys);
+            freed_tables++;
+        }
+        pmm_free_frame((void *) pdpr_phys);
+        freed_tables++;
+        pml4_root[pml4_e] = 0;
+    }
+    return freed_tables;
+}
+
+/**
+ * Make the page directory entry of an address point to a table of 4k pages, the missing upper tables are created.
+ * With 2mb pages it's the way to map an area with a finer grain (i.e. stacks with a guard page below them).
+ * The entries of the table are filled by the caller.
+ *
+ * @param page_table the physical address of the table, 4k aligned
+ * @param address a virtual address in the 2mb area covered by the table
+ * @param pml4_root the root table of the address space (from the direct map), if NULL the kernel one
+ * @return address, or NULL if the area is already mapped
+ */
+void *map_page_table_hh(void *page_table, void *address, uint64_t *pml4_root) {
+    if ( pml4_root == NULL ) {
+        pml4_root = kernel_settings.paging.hhdm_page_root_address;
+    }
+    uint64_t user_mode_status = is_address_higher_half((uint64_t) address) ? 0 : VMM_FLAGS_USER_LEVEL;
+    uint64_t *table = pml4_root;
+    uint16_t entries[] = { PML4_ENTRY((uint64_t) address), PDPR_ENTRY((uint64_t) address) };
+    for (size_t level = 0; level < 2; level++) {
+        if ( !(table[entries[level]] & PRESENT_BIT) ) {
+            uint64_t *new_table = pmm_prepare_new_pagetable();
+            table[entries[level]] = (uint64_t) new_table | user_mode_status | WRITE_BIT | PRESENT_BIT;
+            clean_new_table(hhdm_get_variable((uintptr_t) new_table));
+        }
+        table = (uint64_t *) hhdm_get_variable((uintptr_t) table[entries[level]] & VM_PAGE_TABLE_BASE_ADDRESS_MASK);
+    }
+    uint16_t pd_e = PD_ENTRY((uint64_t) address);
+    if ( table[pd_e] & PRESENT_BIT ) {
+        return NULL;
+    }
+    table[pd_e] = (uint64_t) page_table | user_mode_status | WRITE_BIT | PRESENT_BIT;
+    return address;
+}
+
 //TODO This function is no longer used, it may be removed in the future
 void identity_map_phys_address(void *physical_address, size_t flags) {
     map_phys_to_virt_addr(physical_address, physical_address, flags);
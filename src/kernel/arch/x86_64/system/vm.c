@@ -1,20 +1,35 @@
 #include <framebuffer.h>
+#ifndef _TEST_
+#include <kstack.h>
+#endif
 #include <logging.h>
 #include <main.h>
 #include <video.h>
 #include <vm.h>
 #include <vmm.h>
+#include <vmm_region.h>
+#include <trace.h>
 
 extern uint32_t FRAMEBUFFER_MEMORY_SIZE;
 
 void page_fault_handler(uint64_t error_code) {
-    // TODO: Add ptable info when using 4k pages
-    pretty_log(Verbose, "Welcome to #PF world - Not ready yet... ");
     uint64_t cr2_content = 0;
     uint64_t pd;
     uint64_t pdpr;
     uint64_t pml4;
     asm ("mov %%cr2, %0" : "=r" (cr2_content) );
+    TRACE(TRACE_PAGE_FAULT, cr2_content, error_code);
+#ifndef _TEST_
+    // Most of the user faults are pages populated on demand
+    if ( vmm_region_handle_fault(cr2_content, error_code) ) {
+        return;
+    }
+    if ( kstack_is_guard(cr2_content) ) {
+        pretty_logf(Fatal, "Kernel stack overflow - address: 0x%x", cr2_content);
+    }
+#endif
+    // TODO: Add ptable info when using 4k pages
+    pretty_log(Verbose, "Welcome to #PF world - Not ready yet... ");
     pretty_logf(Verbose, "-- Error code value: %d", error_code);
     pretty_logf(Verbose, "--  Faulting address: 0x%X", cr2_content);
     cr2_content = cr2_content & VM_OFFSET_MASK;
@@ -39,9 +54,12 @@ void page_fault_handler(uint64_t error_code) {
 }
 
 void clean_new_table( uint64_t *table_to_clean ) {
-    for(int i = 0; i < VM_PAGES_PER_TABLE; i++){
-        table_to_clean[i] = 0x00l;
-    }
+    // The new table is going to be filled right after, so here we want normal (cached) stores
+    size_t entries = VM_PAGES_PER_TABLE;
+    asm volatile("rep stosq"
+        : "+D" (table_to_clean), "+c" (entries)
+        : "a" (0x00l)
+        : "memory");
 }
 
 void load_cr3( void* cr3_value ) {
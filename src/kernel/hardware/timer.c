@@ -7,6 +7,7 @@
 #include <scheduler.h>
 #include <kernel.h>
 #include <logging.h>
+#include <msr.h>
 
 uint8_t pit_timer_counter = 0;
 volatile uint32_t pitTicks = 0;
@@ -31,9 +32,12 @@ uint32_t calibrate_apic() {
     //Let's set the APIC Timer initial value to the maximum available
     // Initial value of the apic is the maximum number that can be stored
     write_apic_register(APIC_TIMER_INITIAL_COUNT_REGISTER_OFFSET, (uint32_t)-1);
+    // While we are waiting for the pit, we can calibrate the tsc too, it is basically for free.
+    uint64_t tsc_start = rdtsc();
     //Now it's time to enable interrupts...
     //Now we need to decide how many milliseconds  we want the pit irq to be fired...
     while(pitTicks < CALIBRATION_MS_TO_WAIT);
+    uint64_t tsc_end = rdtsc();
     // We waited enough... let's read the apic counter...
     uint32_t current_apic_count = read_apic_register(APIC_TIMER_CURRENT_COUNT_REGISTER_OFFSET);
     // Disable the irqs first
@@ -49,6 +53,9 @@ uint32_t calibrate_apic() {
     //Let's store the result along with the divider in the kernel_settings.
     kernel_settings.apic_timer.timer_ticks_base = apic_calibrated_ticks;
     kernel_settings.apic_timer.timer_divisor = APIC_TIMER_DIVIDER_2;
+    kernel_settings.tsc.ticks_per_ms = (tsc_end - tsc_start) / CALIBRATION_MS_TO_WAIT;
+    kernel_settings.tsc.boot_tsc = tsc_end;
+    pretty_logf(Verbose, "Calibrated tsc ticks per ms: %u", kernel_settings.tsc.ticks_per_ms);
     // et voila... calibration done, now we can use this value as a base for the initial count register
     return apic_calibrated_ticks;
 }
@@ -0,0 +1,423 @@
+#include <kbench.h>
+#include <elf.h>
+#include <kernel.h>
+#include <kheap.h>
+#include <kstack.h>
+#include <log_ring.h>
+#include <logging.h>
+#include <msr.h>
+#include <numbers.h>
+#include <pmm.h>
+#include <qemu.h>
+#include <reaper.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <syscalls.h>
+#include <task.h>
+#include <thread.h>
+#include <vmm.h>
+#include <vmm_mapping.h>
+
+#define KBENCH_MAX_RESULTS  32
+#define KBENCH_PMM_FRAMES   64
+
+extern uint32_t used_frames;
+
+uint64_t kbench_samples[KBENCH_MAX_SAMPLES];
+void *kbench_pointers[KBENCH_MAX_SAMPLES];
+kbench_result_t kbench_results[KBENCH_MAX_RESULTS];
+size_t kbench_results_count = 0;
+
+// Written by the partner thread of the context switch benchmark right before it yields
+volatile uint64_t kbench_switch_stamp = 0;
+volatile bool kbench_switch_done = false;
+
+static const size_t kbench_kmalloc_sizes[] = { 16, 64, 256, 1024, 4096 };
+static const char *kbench_kmalloc_names[] = { "kmalloc_16", "kmalloc_64", "kmalloc_256", "kmalloc_1024", "kmalloc_4096" };
+static const char *kbench_kfree_names[] = { "kfree_16", "kfree_64", "kfree_256", "kfree_1024", "kfree_4096" };
+
+/**
+ * Check if the benchmarks have been requested on the kernel command line
+ *
+ * @return true if the bench option is present
+ */
+bool kbench_requested() {
+    return kernel_cmdline_option(KBENCH_CMDLINE_OPTION, NULL, NULL);
+}
+
+/**
+ * Create the thread running the benchmarks, it must be called after the scheduler initialization.
+ */
+void kbench_start() {
+    pretty_log(Info, "Kernel benchmarks requested, they will start with the scheduler");
+    create_task("kbench", kbench_run, NULL, true);
+}
+
+static bool kbench_selected(const char *name) {
+    const char *list;
+    size_t list_length;
+    if ( !kernel_cmdline_option(KBENCH_CMDLINE_OPTION, &list, &list_length) || list == NULL ) {
+        return true;
+    }
+    size_t start = 0;
+    while ( start < list_length ) {
+        size_t i = 0;
+        while ( start + i < list_length && list[start + i] != ',' && name[i] == list[start + i] ) {
+            i++;
+        }
+        if ( name[i] == '\0' && (start + i == list_length || list[start + i] == ',') ) {
+            return true;
+        }
+        while ( start < list_length && list[start] != ',' ) {
+            start++;
+        }
+        start++;
+    }
+    return false;
+}
+
+static uint64_t kbench_ticks_to_ns(uint64_t ticks) {
+    if ( kernel_settings.tsc.ticks_per_ms == 0 ) {
+        return ticks;
+    }
+    return ticks * 1000000 / kernel_settings.tsc.ticks_per_ms;
+}
+
+static void kbench_sort(uint64_t *samples, size_t count) {
+    for (size_t gap = count / 2; gap > 0; gap /= 2) {
+        for (size_t i = gap; i < count; i++) {
+            uint64_t current = samples[i];
+            size_t j = i;
+            while ( j >= gap && samples[j - gap] > current ) {
+                samples[j] = samples[j - gap];
+                j -= gap;
+            }
+            samples[j] = current;
+        }
+    }
+}
+
+/**
+ * Compute the statistics of the samples (tsc ticks) collected by a benchmark, and add them to the report
+ *
+ * @param name the benchmark name
+ * @param samples the duration of every operation, they are sorted in place
+ * @param count number of samples
+ * @return the result added, or NULL if there are no samples or the report is full
+ */
+static kbench_result_t *kbench_add_result(const char *name, uint64_t *samples, size_t count) {
+    if ( count == 0 || kbench_results_count == KBENCH_MAX_RESULTS ) {
+        return NULL;
+    }
+    kbench_sort(samples, count);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += samples[i];
+    }
+    kbench_result_t *result = &kbench_results[kbench_results_count++];
+    result->name = name;
+    result->ops = count;
+    result->min_ns = kbench_ticks_to_ns(samples[0]);
+    result->p50_ns = kbench_ticks_to_ns(samples[count / 2]);
+    result->p99_ns = kbench_ticks_to_ns(samples[(count * 99) / 100]);
+    result->mean_ns = kbench_ticks_to_ns(total / count);
+    result->frames_delta = 0;
+    return result;
+}
+
+static void kbench_pmm() {
+    size_t frames = 0;
+    for (; frames < KBENCH_PMM_FRAMES; frames++) {
+        uint64_t start = rdtsc();
+        kbench_pointers[frames] = pmm_alloc_frame();
+        kbench_samples[frames] = rdtsc() - start;
+        if ( kbench_pointers[frames] == NULL ) {
+            break;
+        }
+    }
+    kbench_add_result("pmm_alloc_frame", kbench_samples, frames);
+    for (size_t i = 0; i < frames; i++) {
+        uint64_t start = rdtsc();
+        pmm_free_frame(kbench_pointers[i]);
+        kbench_samples[i] = rdtsc() - start;
+    }
+    kbench_add_result("pmm_free_frame", kbench_samples, frames);
+}
+
+static void kbench_kmalloc() {
+    for (size_t size_class = 0; size_class < sizeof(kbench_kmalloc_sizes) / sizeof(size_t); size_class++) {
+        size_t allocated = 0;
+        for (; allocated < KBENCH_MAX_SAMPLES; allocated++) {
+            uint64_t start = rdtsc();
+            kbench_pointers[allocated] = kmalloc(kbench_kmalloc_sizes[size_class]);
+            kbench_samples[allocated] = rdtsc() - start;
+            if ( kbench_pointers[allocated] == NULL ) {
+                break;
+            }
+        }
+        kbench_add_result(kbench_kmalloc_names[size_class], kbench_samples, allocated);
+        for (size_t i = 0; i < allocated; i++) {
+            uint64_t start = rdtsc();
+            kfree(kbench_pointers[i]);
+            kbench_samples[i] = rdtsc() - start;
+        }
+        kbench_add_result(kbench_kfree_names[size_class], kbench_samples, allocated);
+    }
+}
+
+static void kbench_map() {
+    void *frame = pmm_alloc_frame();
+    void *address = vmm_alloc(PAGE_SIZE_IN_BYTES, VMM_FLAGS_ADDRESS_ONLY | VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, NULL);
+    if ( frame == NULL || address == NULL ) {
+        pretty_log(Error, "kbench: cannot allocate the frame/address for the map benchmark");
+        return;
+    }
+    // The map and unmap samples are collected in the two halves of the buffer
+    uint64_t *unmap_samples = &kbench_samples[KBENCH_MAX_SAMPLES / 2];
+    for (size_t i = 0; i < KBENCH_MAX_SAMPLES / 2; i++) {
+        uint64_t start = rdtsc();
+        map_phys_to_virt_addr(frame, address, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE);
+        uint64_t mapped = rdtsc();
+        unmap_vaddress(address);
+        unmap_samples[i] = rdtsc() - mapped;
+        kbench_samples[i] = mapped - start;
+    }
+    kbench_add_result("map_page", kbench_samples, KBENCH_MAX_SAMPLES / 2);
+    kbench_add_result("unmap_page", unmap_samples, KBENCH_MAX_SAMPLES / 2);
+    pmm_free_frame(frame);
+}
+
+static void kbench_syscall() {
+    for (size_t i = 0; i < KBENCH_MAX_SAMPLES; i++) {
+        uint64_t result;
+        uint64_t start = rdtsc();
+        // An unused syscall number: only the interrupt entry/exit and the dispatch are measured
+        asm volatile("int $0x80" : "=a" (result) : "S" (0) : "memory");
+        kbench_samples[i] = rdtsc() - start;
+    }
+    kbench_add_result("syscall_round_trip", kbench_samples, KBENCH_MAX_SAMPLES);
+}
+
+static void kbench_switch_partner(void *arg) {
+    (void) arg;
+    while ( !kbench_switch_done ) {
+        kbench_switch_stamp = rdtsc();
+        scheduler_yield();
+    }
+}
+
+/**
+ * The partner thread is added at the head of the thread list, so when it yields the next thread is this one:
+ * the time between its stamp and our wakeup is a single switch. The other direction goes through
+ * all the other threads, so only a few rounds are done.
+ */
+static void kbench_context_switch() {
+    size_t samples = 0;
+    kbench_switch_done = false;
+    kbench_switch_stamp = 0;
+    create_thread("kbench_partner", kbench_switch_partner, NULL, current_executing_thread->parent_task, true);
+    for (size_t round = 0; round < KBENCH_SWITCH_ROUNDS; round++) {
+        kbench_switch_stamp = 0;
+        scheduler_yield();
+        uint64_t now = rdtsc();
+        if ( kbench_switch_stamp != 0 ) {
+            kbench_samples[samples++] = now - kbench_switch_stamp;
+        }
+    }
+    kbench_switch_done = true;
+    kbench_add_result("context_switch", kbench_samples, samples);
+}
+
+static void kbench_spawn_entry(void *arg) {
+    (void) arg;
+}
+
+// The frames in the zeroed pool are refilled by the idle thread at any time, and the kernel stacks frames are shared
+// by many stacks and kept for the next threads: they are not counted as used
+static int64_t kbench_used_frames() {
+    return (int64_t) used_frames - (int64_t) pmm_zeroed_pool_count - (int64_t) kstack_stats.frames;
+}
+
+/**
+ * Create a task and destroy it, KBENCH_SPAWN_ROUNDS times. The first and the last samples are reported
+ * separately, so a slowdown over time is visible, and the frames used before and after are compared to find leaks.
+ */
+static void kbench_spawn() {
+    size_t half = KBENCH_MAX_SAMPLES / 2;
+    uint64_t *last_samples = &kbench_samples[half];
+    int64_t used_before = kbench_used_frames();
+    for (size_t round = 0; round < KBENCH_SPAWN_ROUNDS; round++) {
+        uint64_t start = rdtsc();
+        task_t *task = create_task("kbench_spawn", kbench_spawn_entry, NULL, true);
+        task_destroy(task);
+        uint64_t elapsed = rdtsc() - start;
+        if ( round < half ) {
+            kbench_samples[round] = elapsed;
+        } else if ( round >= KBENCH_SPAWN_ROUNDS - half ) {
+            last_samples[round - (KBENCH_SPAWN_ROUNDS - half)] = elapsed;
+        }
+    }
+    int64_t frames_delta = kbench_used_frames() - used_before;
+    kbench_add_result("spawn_exit_first", kbench_samples, half);
+    kbench_result_t *result = kbench_add_result("spawn_exit_last", last_samples, half);
+    if ( result != NULL ) {
+        result->frames_delta = frames_delta;
+    }
+}
+
+/**
+ * Start a user task from the initrd and wait until it's destroyed, KBENCH_SPAWN_USER_ROUNDS times. Unlike kbench_spawn
+ * this goes through the whole life of a user task: the ELF regions, the user stack and page tables, the SYSCALL_EXIT,
+ * the reap list and the teardown of the address space. The reaper is run from here, so its sleep is not measured.
+ */
+static void kbench_spawn_user() {
+    size_t half = KBENCH_MAX_SAMPLES / 2;
+    uint64_t *last_samples = &kbench_samples[half];
+    int64_t used_before = kbench_used_frames();
+    for (size_t round = 0; round < KBENCH_SPAWN_USER_ROUNDS; round++) {
+        uint64_t start = rdtsc();
+        // The task can run and be reaped as soon as the interrupts are enabled, so its id is read before
+        uint64_t flags = lock_irq_save();
+        task_t *task = elf_create_task_from_initrd(KBENCH_SPAWN_USER_PATH);
+        size_t task_id = task != NULL ? task->task_id : 0;
+        lock_irq_restore(flags);
+        if ( task == NULL ) {
+            pretty_log(Error, "User spawn benchmark skipped: " KBENCH_SPAWN_USER_PATH " not found in the initrd");
+            return;
+        }
+        // The id is released by task_destroy, the task memory only after a grace period: the pointer is only compared
+        while ( get_task(task_id) == task ) {
+            scheduler_yield();
+            reaper_collect();
+        }
+        uint64_t elapsed = rdtsc() - start;
+        if ( round < half ) {
+            kbench_samples[round] = elapsed;
+        } else if ( round >= KBENCH_SPAWN_USER_ROUNDS - half ) {
+            last_samples[round - (KBENCH_SPAWN_USER_ROUNDS - half)] = elapsed;
+        }
+    }
+    int64_t frames_delta = kbench_used_frames() - used_before;
+    kbench_add_result("spawn_user_first", kbench_samples, half);
+    kbench_result_t *result = kbench_add_result("spawn_user_last", last_samples, half);
+    if ( result != NULL ) {
+        result->frames_delta = frames_delta;
+    }
+}
+
+static void kbench_log() {
+    // Start with an empty ring, otherwise the messages could be dropped
+    while ( log_drain(LOG_RING_SIZE) > 0 );
+    for (size_t i = 0; i < KBENCH_LOG_BATCH; i++) {
+        uint64_t start = rdtsc();
+        pretty_logf(Info, "kbench log message: %d", i);
+        kbench_samples[i] = rdtsc() - start;
+    }
+    kbench_add_result("log_message", kbench_samples, KBENCH_LOG_BATCH);
+    size_t drained = 0;
+    for (; drained < KBENCH_LOG_BATCH; drained++) {
+        uint64_t start = rdtsc();
+        if ( log_drain(1) == 0 ) {
+            break;
+        }
+        kbench_samples[drained] = rdtsc() - start;
+    }
+    kbench_add_result("log_drain", kbench_samples, drained);
+}
+
+static char *kbench_append(char *position, const char *string) {
+    while ( *string != '\0' ) {
+        *position++ = *string++;
+    }
+    return position;
+}
+
+static char *kbench_append_number(char *position, const char *key, uint64_t value) {
+    position = kbench_append(position, key);
+    return position + _getUnsignedDecString(position, value);
+}
+
+static char *kbench_append_signed(char *position, const char *key, int64_t value) {
+    position = kbench_append(position, key);
+    if ( value < 0 ) {
+        *position++ = '-';
+        value = -value;
+    }
+    return position + _getUnsignedDecString(position, (uint64_t) value);
+}
+
+/**
+ * Write the report on the serial port as a json document, between the KBENCH_BEGIN and KBENCH_END lines:
+ *
+ *      {"version":2,"tsc_ticks_per_ms":N,"results":[
+ *      {"name":"pmm_alloc_frame","ops":64,"min_ns":N,"p50_ns":N,"p99_ns":N,"mean_ns":N,"frames_delta":N},
+ *      ...
+ *      ]}
+ */
+static void kbench_report() {
+    char line[192];
+    char *position;
+    qemu_write_string("KBENCH_BEGIN\r\n");
+    position = kbench_append_number(line, "{\"version\":", KBENCH_REPORT_VERSION);
+    position = kbench_append_number(position, ",\"tsc_ticks_per_ms\":", kernel_settings.tsc.ticks_per_ms);
+    position = kbench_append(position, ",\"results\":[\r\n");
+    *position = '\0';
+    qemu_write_string(line);
+    for (size_t i = 0; i < kbench_results_count; i++) {
+        kbench_result_t *result = &kbench_results[i];
+        position = kbench_append(line, "{\"name\":\"");
+        position = kbench_append(position, result->name);
+        position = kbench_append_number(position, "\",\"ops\":", result->ops);
+        position = kbench_append_number(position, ",\"min_ns\":", result->min_ns);
+        position = kbench_append_number(position, ",\"p50_ns\":", result->p50_ns);
+        position = kbench_append_number(position, ",\"p99_ns\":", result->p99_ns);
+        position = kbench_append_number(position, ",\"mean_ns\":", result->mean_ns);
+        position = kbench_append_signed(position, ",\"frames_delta\":", result->frames_delta);
+        position = kbench_append(position, i + 1 < kbench_results_count ? "},\r\n" : "}\r\n");
+        *position = '\0';
+        qemu_write_string(line);
+    }
+    qemu_write_string("]}\r\nKBENCH_END\r\n");
+}
+
+/**
+ * Entry point of the benchmark thread: run the selected benchmarks and write the report.
+ * If bench_halt is on the command line the cpu is stopped afterwards, otherwise the thread just ends.
+ *
+ * @param arg not used
+ */
+void kbench_run(void *arg) {
+    (void) arg;
+    kbench_results_count = 0;
+    if ( kbench_selected("pmm") ) {
+        kbench_pmm();
+    }
+    if ( kbench_selected("kmalloc") ) {
+        kbench_kmalloc();
+    }
+    if ( kbench_selected("map") ) {
+        kbench_map();
+    }
+    if ( kbench_selected("syscall") ) {
+        kbench_syscall();
+    }
+    if ( kbench_selected("switch") ) {
+        kbench_context_switch();
+    }
+    if ( kbench_selected("log") ) {
+        kbench_log();
+    }
+    if ( kbench_selected("spawn") ) {
+        kbench_spawn();
+        kbench_spawn_user();
+    }
+    kbench_report();
+    if ( kernel_cmdline_option(KBENCH_CMDLINE_HALT, NULL, NULL) ) {
+        pretty_log(Info, "Kernel benchmarks completed, halting");
+        while ( log_drain(LOG_RING_SIZE) > 0 );
+        asm volatile("cli");
+        while ( 1 ) {
+            asm volatile("hlt");
+        }
+    }
+}
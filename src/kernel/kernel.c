@@ -1,11 +1,108 @@
 #include <kernel.h>
+#include <msr.h>
+#include <seqlock.h>
 
 kernel_status_t kernel_settings;
 
+// Wraps the updates of the clock fields (kernel_uptime and kernel_uptime_tsc), only the timer interrupt writes them
+seqcount_t kernel_clock_sequence;
+
 void init_kernel_settings() {
     kernel_settings.kernel_uptime = 0l;
+    kernel_settings.kernel_uptime_tsc = 0l;
 }
 
 uint64_t get_kernel_uptime() {
-    return kernel_settings.kernel_uptime;
+    uint64_t uptime_ms;
+    kernel_clock_read(&uptime_ms, NULL);
+    return uptime_ms;
+}
+
+/**
+ * Advance the kernel uptime by 1ms, it is called on every apic timer tick.
+ */
+void kernel_clock_tick() {
+    seqcount_write_begin(&kernel_clock_sequence);
+    kernel_settings.kernel_uptime++;
+    kernel_settings.kernel_uptime_tsc = rdtsc();
+    seqcount_write_end(&kernel_clock_sequence);
+}
+
+/**
+ * Read the clock fields together, the readers never wait for each other.
+ *
+ * @param uptime_ms if not NULL it will contain the kernel uptime in millisec
+ * @param uptime_tsc if not NULL it will contain the tsc value when the uptime was updated
+ */
+void kernel_clock_read(uint64_t *uptime_ms, uint64_t *uptime_tsc) {
+    uint32_t sequence;
+    uint64_t uptime;
+    uint64_t tsc;
+    do {
+        sequence = seqcount_read_begin(&kernel_clock_sequence);
+        uptime = kernel_settings.kernel_uptime;
+        tsc = kernel_settings.kernel_uptime_tsc;
+    } while ( seqcount_read_retry(&kernel_clock_sequence, sequence) );
+    if ( uptime_ms != NULL ) {
+        *uptime_ms = uptime;
+    }
+    if ( uptime_tsc != NULL ) {
+        *uptime_tsc = tsc;
+    }
+}
+
+/**
+ * Save the command line given by the bootloader, it's truncated to KERNEL_CMDLINE_MAX_LEN - 1 characters.
+ *
+ * @param cmdline the command line from the multiboot tag
+ */
+void kernel_set_cmdline(const char *cmdline) {
+    size_t i = 0;
+    while ( cmdline[i] != '\0' && i < KERNEL_CMDLINE_MAX_LEN - 1 ) {
+        kernel_settings.cmdline[i] = cmdline[i];
+        i++;
+    }
+    kernel_settings.cmdline[i] = '\0';
+}
+
+/**
+ * Look for an option in the kernel command line. Options are separated by spaces, and can have a value: name=value
+ *
+ * @param name the option name
+ * @param value if not NULL it will point to the option value (not null terminated), or NULL if it has no value
+ * @param value_length if not NULL it will contain the length of the value
+ * @return true if the option is present
+ */
+bool kernel_cmdline_option(const char *name, const char **value, size_t *value_length) {
+    const char *option = kernel_settings.cmdline;
+    while ( *option != '\0' ) {
+        while ( *option == ' ' ) {
+            option++;
+        }
+        size_t i = 0;
+        while ( name[i] != '\0' && option[i] == name[i] ) {
+            i++;
+        }
+        if ( name[i] == '\0' && (option[i] == '\0' || option[i] == ' ' || option[i] == '=') ) {
+            const char *option_value = NULL;
+            size_t length = 0;
+            if ( option[i] == '=' ) {
+                option_value = &option[i + 1];
+                while ( option_value[length] != '\0' && option_value[length] != ' ' ) {
+                    length++;
+                }
+            }
+            if ( value != NULL ) {
+                *value = option_value;
+            }
+            if ( value_length != NULL ) {
+                *value_length = length;
+            }
+            return true;
+        }
+        while ( *option != '\0' && *option != ' ' ) {
+            option++;
+        }
+    }
+    return false;
 }
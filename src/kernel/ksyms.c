@@ -0,0 +1,265 @@
+#include <ksyms.h>
+#ifndef _TEST_
+#include <kheap.h>
+#include <logging.h>
+#endif
+
+// The In column of the ld.lld map is this many blanks after the Align one, the symbol names are further indented
+#define KSYMS_LLD_IN_INDENT 9
+
+ksyms_table_t kernel_symbols = {
+    .symbols = NULL,
+    .count = 0
+};
+
+static bool ksyms_is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+static bool ksyms_is_name_char(char c, bool first) {
+    if ( (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '.' || c == '$' ) {
+        return true;
+    }
+    return !first && c >= '0' && c <= '9';
+}
+
+static int ksyms_hex_value(char c) {
+    if ( c >= '0' && c <= '9' ) {
+        return c - '0';
+    }
+    if ( c >= 'a' && c <= 'f' ) {
+        return c - 'a' + 10;
+    }
+    if ( c >= 'A' && c <= 'F' ) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Read a hexadecimal number, and skip the blanks following it.
+ *
+ * @param line pointer to the current position, it's moved after the number and the blanks
+ * @param end the end of the line (exclusive)
+ * @param value where the number is stored
+ * @return the number of blanks after the number, 0 if there is no number or it's not followed by a blank
+ */
+static size_t ksyms_parse_hex(const char **line, const char *end, uintptr_t *value) {
+    const char *current = *line;
+    uintptr_t number = 0;
+    size_t digits = 0;
+    while ( current < end && ksyms_hex_value(*current) >= 0 ) {
+        number = (number << 4) | ksyms_hex_value(*current);
+        current++;
+        digits++;
+    }
+    if ( digits == 0 || current == end || !ksyms_is_space(*current) ) {
+        return 0;
+    }
+    const char *number_end = current;
+    while ( current < end && ksyms_is_space(*current) ) {
+        current++;
+    }
+    *line = current;
+    *value = number;
+    return current - number_end;
+}
+
+/**
+ * Read a symbol name, it must be the last field of the line.
+ *
+ * @param line the start of the name
+ * @param end the end of the line (exclusive)
+ * @param symbol where the name is stored
+ * @return true if the rest of the line is a valid name
+ */
+static bool ksyms_parse_name(const char *line, const char *end, ksym_t *symbol) {
+    const char *name = line;
+    if ( line == end || !ksyms_is_name_char(*line, true) ) {
+        return false;
+    }
+    while ( line < end && ksyms_is_name_char(*line, false) ) {
+        line++;
+    }
+    size_t name_length = line - name;
+    while ( line < end && (ksyms_is_space(*line) || *line == '\r') ) {
+        line++;
+    }
+    if ( line != end ) {
+        return false;
+    }
+    symbol->name = name;
+    symbol->name_length = name_length;
+    return true;
+}
+
+/**
+ * Parse a symbol line of the map written by GNU ld, it contains only two fields:
+ *
+ *                 0xffffffff80100010                kernel_start
+ *
+ * Everything else (sections, input files, linker script assignments) has a different number of fields.
+ */
+static bool ksyms_parse_gnu_line(const char *line, const char *end, ksym_t *symbol) {
+    // Symbol lines are always indented, section names start on the first column
+    if ( line == end || !ksyms_is_space(*line) ) {
+        return false;
+    }
+    while ( line < end && ksyms_is_space(*line) ) {
+        line++;
+    }
+    if ( end - line < 3 || line[0] != '0' || line[1] != 'x' ) {
+        return false;
+    }
+    line += 2;
+    uintptr_t address;
+    if ( ksyms_parse_hex(&line, end, &address) == 0 ) {
+        return false;
+    }
+    symbol->address = address;
+    return ksyms_parse_name(line, end, symbol);
+}
+
+/**
+ * Parse a symbol line of the map written by ld.lld, the columns are VMA, LMA, Size, Align, Out, In and Symbol:
+ *
+ * ffffffff80100010 ffffffff80100010        0     1                 kernel_start
+ *
+ * The numbers have no 0x prefix (the alignment is in decimal), and the names are indented by one column for the
+ * output sections, 9 for the input sections and 17 for the symbols.
+ */
+static bool ksyms_parse_lld_line(const char *line, const char *end, ksym_t *symbol) {
+    while ( line < end && ksyms_is_space(*line) ) {
+        line++;
+    }
+    uintptr_t address, value;
+    if ( ksyms_parse_hex(&line, end, &address) == 0 || ksyms_parse_hex(&line, end, &value) == 0 || ksyms_parse_hex(&line, end, &value) == 0 ) {
+        return false;
+    }
+    // Only the symbols are indented past the In column
+    if ( ksyms_parse_hex(&line, end, &value) <= KSYMS_LLD_IN_INDENT ) {
+        return false;
+    }
+    symbol->address = address;
+    return ksyms_parse_name(line, end, symbol);
+}
+
+/**
+ * Parse a single line of the map, both the GNU ld and the ld.lld layouts are recognized.
+ *
+ * @param line the start of the line
+ * @param end the end of the line (exclusive)
+ * @param symbol where the symbol is stored if found
+ * @return true if the line contains a symbol
+ */
+static bool ksyms_parse_line(const char *line, const char *end, ksym_t *symbol) {
+    return ksyms_parse_gnu_line(line, end, symbol) || ksyms_parse_lld_line(line, end, symbol);
+}
+
+/**
+ * Extract the symbols from the text of a map file generated by ld or ld.lld (-Map option).
+ * It's meant to be called twice: first with symbols = NULL to count them, then to fill the array.
+ *
+ * @param map the content of the map file
+ * @param map_size the size of the map file
+ * @param min_address symbols below this address are ignored
+ * @param symbols the array to fill, if NULL the symbols are only counted
+ * @param max_symbols size of the symbols array
+ * @return the number of symbols found (or stored, if symbols is not NULL)
+ */
+size_t ksyms_parse(const char *map, size_t map_size, uintptr_t min_address, ksym_t *symbols, size_t max_symbols) {
+    const char *map_end = map + map_size;
+    const char *line = map;
+    size_t count = 0;
+    while ( line < map_end ) {
+        const char *line_end = line;
+        while ( line_end < map_end && *line_end != '\n' ) {
+            line_end++;
+        }
+        ksym_t symbol;
+        if ( ksyms_parse_line(line, line_end, &symbol) && symbol.address >= min_address ) {
+            if ( symbols != NULL ) {
+                if ( count == max_symbols ) {
+                    break;
+                }
+                symbols[count] = symbol;
+            }
+            count++;
+        }
+        line = line_end + 1;
+    }
+    return count;
+}
+
+/**
+ * Sort the symbols by address. The map is almost sorted already, so a shell sort is more than enough.
+ *
+ * @param symbols the array to sort
+ * @param count number of symbols in the array
+ */
+void ksyms_sort(ksym_t *symbols, size_t count) {
+    for (size_t gap = count / 2; gap > 0; gap /= 2) {
+        for (size_t i = gap; i < count; i++) {
+            ksym_t current = symbols[i];
+            size_t j = i;
+            while ( j >= gap && symbols[j - gap].address > current.address ) {
+                symbols[j] = symbols[j - gap];
+                j -= gap;
+            }
+            symbols[j] = current;
+        }
+    }
+}
+
+/**
+ * Find the symbol containing an address: the one with the highest address that is not greater than it.
+ *
+ * @param table the symbols table
+ * @param address the address to look for
+ * @return the symbol, or NULL if the address is before the first symbol
+ */
+const ksym_t *ksyms_lookup(const ksyms_table_t *table, uintptr_t address) {
+    if ( table->count == 0 || address < table->symbols[0].address ) {
+        return NULL;
+    }
+    size_t low = 0;
+    size_t high = table->count;
+    while ( high - low > 1 ) {
+        size_t middle = low + (high - low) / 2;
+        if ( table->symbols[middle].address <= address ) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return &table->symbols[low];
+}
+
+#ifndef _TEST_
+/**
+ * Load the kernel symbols from the kernel.map module. The names are not copied, so the module memory must stay mapped.
+ *
+ * @param map_address the virtual address of the map (in the direct map)
+ * @param map_size the size of the map
+ * @return true if at least one symbol has been loaded
+ */
+bool init_ksyms(uintptr_t map_address, size_t map_size) {
+    const char *map = (const char *) map_address;
+    size_t count = ksyms_parse(map, map_size, KSYMS_MIN_ADDRESS, NULL, 0);
+    if ( count == 0 ) {
+        pretty_log(Error, "No symbols found in the kernel map");
+        return false;
+    }
+    ksym_t *symbols = kmalloc(count * sizeof(ksym_t));
+    if ( symbols == NULL ) {
+        pretty_log(Error, "Cannot allocate the kernel symbols table");
+        return false;
+    }
+    count = ksyms_parse(map, map_size, KSYMS_MIN_ADDRESS, symbols, count);
+    ksyms_sort(symbols, count);
+    kernel_symbols.symbols = symbols;
+    kernel_symbols.count = count;
+    pretty_logf(Info, "Kernel symbols loaded: %d", count);
+    return true;
+}
+#endif
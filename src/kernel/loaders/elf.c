@@ -1,12 +1,29 @@
 #include <bitmap.h>
 #include <elf.h>
 #include <logging.h>
+#include <string.h>
 #include <utils.h>
 #include <vmm_util.h>
+#ifndef _TEST_
+#include <hh_direct_map.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <task.h>
+#include <thread.h>
+#include <ustar.h>
+#include <vmm.h>
+#endif
 
 const char _elf_header_mag[ELF_MAGIC_SIZE]={0x7f, 'E', 'L', 'F'};
 
-void load_elf(uintptr_t elf_start, uint64_t size) {
+/**
+ * Check and log an elf module.
+ *
+ * @param elf_start the address of the module
+ * @param size the size of the module
+ * @return true if the module is an executable that can be loaded with elf_create_task
+ */
+bool load_elf(uintptr_t elf_start, uint64_t size) {
     Elf64_Ehdr *elf_header = (Elf64_Ehdr *) elf_start;
     bool is_elf_valid = parse_section_header(elf_header, size, ELF);
     pretty_logf(Verbose, " The elf is valid? %s" , is_elf_valid ? "True" : "False" );
@@ -16,12 +33,237 @@ void load_elf(uintptr_t elf_start, uint64_t size) {
         Elf64_Half phdr_entsize = elf_header->e_phentsize;
         pretty_logf(Verbose, " Number of PHDR entries: 0x%x", phdr_entries);
         pretty_logf(Verbose, " PHDR Entry Size: 0x%x", phdr_entsize );
+        if ( !elf_validate_executable(elf_header, size) ) {
+            pretty_log(Verbose, " The elf is not a loadable executable");
+            return false;
+        }
         Elf64_Half result = loop_phdrs(elf_header, phdr_entries);
         if (result > 0) {
             pretty_logf(Verbose, " Number of PT_LOAD entries: %d", result);
         }
     }
+    return is_elf_valid;
+}
+
+/**
+ * Check that an executable can be loaded: all the program headers and the segments must be inside the file,
+ * the segments must be in the user half of the address space, and the entry point in an executable segment.
+ *
+ * @param elf_header the start of the file
+ * @param size the size of the file
+ * @return true if the file can be loaded
+ */
+bool elf_validate_executable(Elf64_Ehdr *elf_header, uint64_t size) {
+    if ( size < sizeof(Elf64_Ehdr) || !parse_section_header(elf_header, size, ELF) ) {
+        return false;
+    }
+    if ( elf_header->e_type != ET_EXEC || elf_header->e_phentsize != sizeof(Elf64_Phdr) || elf_header->e_phnum == 0 ) {
+        pretty_logf(Verbose, " Unsupported elf: type: 0x%x - phentsize: 0x%x - phnum: %d", elf_header->e_type, elf_header->e_phentsize, elf_header->e_phnum);
+        return false;
+    }
+    if ( elf_header->e_phoff > size || (size - elf_header->e_phoff) / sizeof(Elf64_Phdr) < elf_header->e_phnum ) {
+        pretty_log(Verbose, " The program headers are outside of the file");
+        return false;
+    }
+    bool entry_found = false;
+    for (Elf64_Half i = 0; i < elf_header->e_phnum; i++) {
+        Elf64_Phdr *phdr = read_phdr(elf_header, i);
+        if ( phdr->p_type != PT_LOAD || phdr->p_memsz == 0 ) {
+            continue;
+        }
+        if ( phdr->p_filesz > phdr->p_memsz || phdr->p_offset > size || size - phdr->p_offset < phdr->p_filesz ) {
+            pretty_logf(Verbose, " Segment %d is outside of the file", i);
+            return false;
+        }
+        if ( phdr->p_vaddr >= ELF_USER_ADDRESS_LIMIT || ELF_USER_ADDRESS_LIMIT - phdr->p_vaddr < phdr->p_memsz ) {
+            pretty_logf(Verbose, " Segment %d is outside of the user address space", i);
+            return false;
+        }
+        if ( (phdr->p_flags & PF_X) && elf_header->e_entry >= phdr->p_vaddr && elf_header->e_entry < phdr->p_vaddr + phdr->p_memsz ) {
+            entry_found = true;
+        }
+    }
+    if ( !entry_found ) {
+        pretty_logf(Verbose, " The entry point 0x%x is not in an executable segment", elf_header->e_entry);
+    }
+    return entry_found;
+}
+
+/**
+ * A page can be mapped straight from the module if only one segment uses it, the module data has the same
+ * alignment of the segment, and there is no bss in the page (it must read as zero).
+ * If the segment is writable the page is copied on the first write.
+ */
+static bool elf_page_can_be_shared(Elf64_Phdr *phdr, uintptr_t page_vaddr, uint64_t module_phys, uint64_t module_size) {
+    if ( ((module_phys + phdr->p_offset) & (PAGE_SIZE_IN_BYTES - 1)) != (phdr->p_vaddr & (PAGE_SIZE_IN_BYTES - 1)) ) {
+        return false;
+    }
+    // The whole frame is mapped in the task: the memory around the module (i.e. the kernel image) must not be reachable
+    uint64_t page_offset = phdr->p_vaddr - page_vaddr;
+    if ( phdr->p_offset < page_offset || phdr->p_offset - page_offset + PAGE_SIZE_IN_BYTES > module_size ) {
+        return false;
+    }
+    uint64_t page_end = page_vaddr + PAGE_SIZE_IN_BYTES;
+    uint64_t memory_end = phdr->p_vaddr + phdr->p_memsz;
+    uint64_t used_end = memory_end < page_end ? memory_end : page_end;
+    return phdr->p_vaddr + phdr->p_filesz >= used_end;
+}
+
+/**
+ * Compute the pages needed by the PT_LOAD segments of an executable, and which of them can be shared.
+ *
+ * @param elf_header the start of the file (it must be already validated)
+ * @param module_phys the physical address of the file
+ * @param module_size the size of the file, only the frames entirely inside it are shared
+ * @param pages the array filled with the pages, sorted by address
+ * @param max_pages the size of pages
+ * @return the number of pages, 0 if they are more than max_pages
+ */
+size_t elf_plan_pages(Elf64_Ehdr *elf_header, uint64_t module_phys, uint64_t module_size, elf_page_t *pages, size_t max_pages) {
+    size_t pages_count = 0;
+    for (Elf64_Half i = 0; i < elf_header->e_phnum; i++) {
+        Elf64_Phdr *phdr = read_phdr(elf_header, i);
+        if ( phdr->p_type != PT_LOAD || phdr->p_memsz == 0 ) {
+            continue;
+        }
+        uintptr_t page_vaddr = phdr->p_vaddr & ~(PAGE_SIZE_IN_BYTES - 1);
+        for (; page_vaddr < phdr->p_vaddr + phdr->p_memsz; page_vaddr += PAGE_SIZE_IN_BYTES) {
+            size_t position = 0;
+            while ( position < pages_count && pages[position].vaddr < page_vaddr ) {
+                position++;
+            }
+            if ( position < pages_count && pages[position].vaddr == page_vaddr ) {
+                // Two segments in the same page: the page content must be built in a private frame
+                pages[position].shared = false;
+                pages[position].phys = 0;
+                pages[position].writable |= (phdr->p_flags & PF_W) != 0;
+                continue;
+            }
+            if ( pages_count == max_pages ) {
+                pretty_logf(Error, " The executable needs more than %d pages", max_pages);
+                return 0;
+            }
+            for (size_t j = pages_count; j > position; j--) {
+                pages[j] = pages[j - 1];
+            }
+            pages_count++;
+            elf_page_t *page = &pages[position];
+            page->vaddr = page_vaddr;
+            page->writable = (phdr->p_flags & PF_W) != 0;
+            page->shared = elf_page_can_be_shared(phdr, page_vaddr, module_phys, module_size);
+            page->phys = page->shared ? module_phys + phdr->p_offset - (phdr->p_vaddr - page_vaddr) : 0;
+        }
+    }
+    return pages_count;
+}
+
+/**
+ * Copy in a private page the file content of all the segments using it, the page must be already zeroed (for the bss).
+ *
+ * @param elf_header the start of the file
+ * @param page_vaddr the address of the page in the task
+ * @param destination the page memory
+ */
+void elf_copy_page(Elf64_Ehdr *elf_header, uintptr_t page_vaddr, uint8_t *destination) {
+    uintptr_t page_end = page_vaddr + PAGE_SIZE_IN_BYTES;
+    for (Elf64_Half i = 0; i < elf_header->e_phnum; i++) {
+        Elf64_Phdr *phdr = read_phdr(elf_header, i);
+        if ( phdr->p_type != PT_LOAD || phdr->p_filesz == 0 ) {
+            continue;
+        }
+        uintptr_t start = phdr->p_vaddr > page_vaddr ? phdr->p_vaddr : page_vaddr;
+        uintptr_t end = phdr->p_vaddr + phdr->p_filesz < page_end ? phdr->p_vaddr + phdr->p_filesz : page_end;
+        if ( start >= end ) {
+            continue;
+        }
+        memcpy(destination + (start - page_vaddr), (uint8_t *) elf_header + phdr->p_offset + (start - phdr->p_vaddr), end - start);
+    }
+}
+
+#ifndef _TEST_
+static void elf_fill_page(void *source, uintptr_t page_address, uint8_t *destination) {
+    elf_copy_page((Elf64_Ehdr *) source, page_address, destination);
+}
+
+/**
+ * Create a user task running an executable. Nothing is copied here: the image pages are registered as regions
+ * of the task, and the page fault handler populates them on the first access. The pages that can be shared
+ * are mapped from the module frames, so every task running the same module uses the same memory (the writable
+ * ones are copied on the first write); the other pages get a new frame with a copy of the data.
+ *
+ * @param name the task name
+ * @param module_phys the physical address of the executable (it must stay in memory while the task is alive)
+ * @param size the size of the executable
+ * @return the new task, or NULL if the executable can't be loaded
+ */
+task_t *elf_create_task(char *name, uint64_t module_phys, uint64_t size) {
+    Elf64_Ehdr *elf_header = (Elf64_Ehdr *) hhdm_get_variable(module_phys);
+    if ( !elf_validate_executable(elf_header, size) ) {
+        pretty_logf(Error, "Cannot load executable: %s", name);
+        return NULL;
+    }
+    elf_page_t pages[ELF_MAX_PAGES];
+    size_t pages_count = elf_plan_pages(elf_header, module_phys, size, pages, ELF_MAX_PAGES);
+    if ( pages_count == 0 ) {
+        return NULL;
+    }
+
+    uint64_t irq_flags = lock_irq_save();
+    task_t *task = prepare_task(name, false);
+    if ( task == NULL ) {
+        lock_irq_restore(irq_flags);
+        return NULL;
+    }
+    uintptr_t image_start = pages[0].vaddr;
+    size_t image_size = pages[pages_count - 1].vaddr + PAGE_SIZE_IN_BYTES - image_start;
+    // The whole image is reserved, so the stack and the other allocations will be placed after it
+    if ( vmm_alloc_at(image_start, image_size, VMM_FLAGS_ADDRESS_ONLY | VMM_FLAGS_USER_LEVEL, &task->vmm_data) != (void *) image_start ) {
+        pretty_logf(Error, "Cannot reserve 0x%x for executable: %s", image_start, name);
+        task_destroy(task);
+        lock_irq_restore(irq_flags);
+        return NULL;
+    }
+
+    // Consecutive pages with the same properties (and contiguous module frames if shared) are a single region
+    size_t first = 0;
+    for (size_t i = 1; i <= pages_count; i++) {
+        if ( i < pages_count && pages[i].vaddr == pages[i - 1].vaddr + PAGE_SIZE_IN_BYTES && pages[i].shared == pages[first].shared && pages[i].writable == pages[first].writable
+            && (!pages[i].shared || pages[i].phys == pages[i - 1].phys + PAGE_SIZE_IN_BYTES) ) {
+            continue;
+        }
+        size_t flags = (pages[first].writable ? VMM_REGION_WRITE : 0) | (pages[first].shared ? VMM_REGION_FILE_SHARED : 0);
+        if ( !vmm_region_add(&task->vmm_data.regions, pages[first].vaddr, pages[i - 1].vaddr + PAGE_SIZE_IN_BYTES, flags, pages[first].phys, elf_header, elf_fill_page) ) {
+            pretty_logf(Error, "Cannot add the image regions of executable: %s", name);
+            task_destroy(task);
+            lock_irq_restore(irq_flags);
+            return NULL;
+        }
+        first = i;
+    }
+
+    task->threads = create_thread(name, (void (*)(void *)) elf_header->e_entry, name, task, false);
+    scheduler_add_task(task);
+    pretty_logf(Verbose, "Executable %s loaded: entry: 0x%x - pages: %d - regions: %d", name, elf_header->e_entry, pages_count, task->vmm_data.regions.count);
+    lock_irq_restore(irq_flags);
+    return task;
+}
+
+/**
+ * Create a user task running an executable of the initrd. The file is used in place, the archive memory
+ * is never released.
+ *
+ * @param path the path of the executable inside the archive
+ * @return the new task, or NULL if the file is not found or is not a valid executable
+ */
+task_t *elf_create_task_from_initrd(char *path) {
+    const ustar_index_entry_t *entry = ustar_lookup(path);
+    if ( entry == NULL ) {
+        pretty_logf(Error, "Executable not found: %s", path);
+        return NULL;
+    }
+    return elf_create_task(path, hhdm_get_phys_address((void *) entry->data), entry->size);
 }
+#endif
 
 Elf64_Half loop_phdrs(Elf64_Ehdr* e_hdr, Elf64_Half phdr_entries) {
     Elf64_Phdr *phdr_list = (Elf64_Phdr*) ((uintptr_t) e_hdr + e_hdr->e_phoff);
@@ -57,8 +299,8 @@ bool parse_section_header(Elf64_Ehdr *elf_start, uint64_t size, executable_loade
     bool value_to_return = false;
     if ( type == ELF ) {
         for (int i = 0; i < ELF_MAGIC_SIZE; i++) {
-            if (elf_start->e_ident[i] == _elf_header_mag[i]) {
-                pretty_logf(Verbose, " i: %d: elf_start = %c : _elf_header_mag = %c", i, elf_start->e_ident[i], _elf_header_mag[i]);
+            if (elf_start->e_ident[i] != _elf_header_mag[i]) {
+                return false;
             }
         }
         pretty_log(Verbose, "Nident flags:" );
@@ -0,0 +1,130 @@
+#include <log_ring.h>
+
+void log_ring_init(log_ring_t *ring) {
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        __atomic_store_n(&ring->records[i].sequence, i, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&ring->enqueue_position, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->dequeue_position, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->dropped, 0, __ATOMIC_RELEASE);
+}
+
+// Reserve the next free record, or return NULL (counting the drop) if the ring is full
+static log_record_t *log_ring_reserve(log_ring_t *ring, size_t *reserved_position) {
+    size_t position = __atomic_load_n(&ring->enqueue_position, __ATOMIC_RELAXED);
+    while (true) {
+        log_record_t *record = &ring->records[position & (LOG_RING_SIZE - 1)];
+        size_t sequence = __atomic_load_n(&record->sequence, __ATOMIC_ACQUIRE);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+        if ( difference == 0 ) {
+            // The slot is free, let's try to reserve it
+            if ( __atomic_compare_exchange_n(&ring->enqueue_position, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ) {
+                *reserved_position = position;
+                return record;
+            }
+        } else if ( difference < 0 ) {
+            // The consumer has not released this slot yet: the ring is full
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            position = __atomic_load_n(&ring->enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * Copy a message in the ring. It never blocks: if the ring is full the message is dropped.
+ *
+ * @param ring the ring buffer
+ * @param level the log level of the message
+ * @param message the message to copy, truncated to LOG_RECORD_MESSAGE_LEN - 1 characters
+ * @return true if the message has been stored
+ */
+bool log_ring_push(log_ring_t *ring, log_level_t level, const char *message) {
+    size_t position;
+    log_record_t *record = log_ring_reserve(ring, &position);
+    if ( record == NULL ) {
+        return false;
+    }
+
+    record->level = level;
+    record->format = NULL;
+    record->values_count = 0;
+    size_t i = 0;
+    while ( i < LOG_RECORD_MESSAGE_LEN - 1 && message[i] != '\0' ) {
+        record->message[i] = message[i];
+        i++;
+    }
+    record->message[i] = '\0';
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Store a message that is not formatted yet: only the format pointer and the raw arguments are copied.
+ * The format string (and any string argument) must stay valid until the record is drained.
+ *
+ * @param ring the ring buffer
+ * @param level the log level of the message
+ * @param format the format string
+ * @param values the raw arguments
+ * @param values_count the number of arguments, at most LOG_RECORD_MAX_VALUES
+ * @return true if the message has been stored
+ */
+bool log_ring_push_binary(log_ring_t *ring, log_level_t level, const char *format, const uint64_t *values, size_t values_count) {
+    if ( values_count > LOG_RECORD_MAX_VALUES ) {
+        return false;
+    }
+    size_t position;
+    log_record_t *record = log_ring_reserve(ring, &position);
+    if ( record == NULL ) {
+        return false;
+    }
+
+    record->level = level;
+    record->format = format;
+    record->values_count = values_count;
+    for (size_t i = 0; i < values_count; i++) {
+        record->values[i] = values[i];
+    }
+    __atomic_store_n(&record->sequence, position + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Take the oldest record from the ring, it must be called by one consumer at time.
+ *
+ * @param ring the ring buffer
+ * @param record where the record is copied
+ * @return false if there is no record ready
+ */
+bool log_ring_pop(log_ring_t *ring, log_record_t *record) {
+    size_t position = __atomic_load_n(&ring->dequeue_position, __ATOMIC_RELAXED);
+    log_record_t *ring_record = &ring->records[position & (LOG_RING_SIZE - 1)];
+    size_t sequence = __atomic_load_n(&ring_record->sequence, __ATOMIC_ACQUIRE);
+    if ( sequence != position + 1 ) {
+        // Empty, or the producer of the oldest record has not finished writing it
+        return false;
+    }
+
+    record->level = ring_record->level;
+    record->format = ring_record->format;
+    record->values_count = ring_record->values_count;
+    if ( ring_record->format != NULL ) {
+        for (size_t i = 0; i < ring_record->values_count; i++) {
+            record->values[i] = ring_record->values[i];
+        }
+    } else {
+        size_t i = 0;
+        do {
+            record->message[i] = ring_record->message[i];
+        } while ( ring_record->message[i++] != '\0' );
+    }
+    __atomic_store_n(&ring->dequeue_position, position + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring_record->sequence, position + LOG_RING_SIZE, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint64_t log_ring_dropped(log_ring_t *ring) {
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
@@ -1,10 +1,13 @@
 #include <logging.h>
+#include <log_ring.h>
+#include <trace.h>
 #include <qemu.h>
 #include <framebuffer.h>
 #include <video.h>
 #include <io.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 char* logLevelStrings[] = {
     "  [DEBUG] ",
@@ -16,18 +19,31 @@ char* logLevelStrings[] = {
 const size_t logLevelStrLen = 10; //all the above strings are 10 chars long (excluding null terminator)
 const size_t formatBufferLen = 256; //formatted log output limit, in characters.
 
+extern char _kernel_rodata_start;
+extern char _kernel_rodata_end;
+
 size_t logDestBitmap;
 size_t logTrimLevel;
 
 size_t fbCurrentLine;
 size_t fbMaxLine;
 bool useVgaOutput;
+
+// When async mode is enabled the messages are queued here, and written by the idle thread
+log_ring_t log_ring;
+bool logAsync = false;
+bool logBinary = LOG_BINARY_MODE;
+bool logDrainBusy = false;
+uint64_t logDroppedReported = 0;
+
 void init_log(size_t defaultOutputs, log_level_t trimBelowLevel, bool useVgaVideo){
     if (defaultOutputs == LOG_OUTPUT_DONT_CARE)
         defaultOutputs = LOG_OUTPUT_SERIAL; //default to serial
 
     logDestBitmap = defaultOutputs;
     logTrimLevel = trimBelowLevel;
+    logAsync = false;
+    log_ring_init(&log_ring);
 
     useVgaOutput = useVgaVideo;
 
@@ -45,10 +61,36 @@ void set_log_trim_level(size_t newTrim){
     logTrimLevel = newTrim;
 }
 
-void logline(log_level_t level, const char* msg){
-    if (level < logTrimLevel)
-        return; //dont log things that we dont want to see for now. (would be nice to store these somewhere in the future perhaps, just not display them?)
+/**
+ * Enable or disable the asynchronous logging. It should be enabled only when there is a thread draining the ring
+ * (the idle thread), before that every message is written synchronously.
+ *
+ * @param enabled true to queue the messages
+ */
+void set_log_async(bool enabled){
+    if (!enabled)
+        log_drain(LOG_RING_SIZE);
+    logAsync = enabled;
+}
+
+/**
+ * Enable or disable the binary records: when logging is asynchronous loglinef stores only the format pointer
+ * and the raw arguments, and the message is formatted by log_drain.
+ *
+ * @param enabled true to store binary records
+ */
+void set_log_binary(bool enabled){
+    logBinary = enabled;
+}
 
+static void log_format(char* buffer, const char* msg, ...){
+    va_list format_args;
+    va_start(format_args, msg);
+    vsprintf(buffer, msg, format_args);
+    va_end(format_args);
+}
+
+static void log_emit(log_level_t level, const char* msg){
     for (size_t i = 0; i < LOG_OUTPUT_COUNT; i++){
         if ((logDestBitmap & (1 << i)) == 0)
             continue; //bit is cleared, we should not log there
@@ -89,20 +131,107 @@ void logline(log_level_t level, const char* msg){
                 continue;
         }
     }
+}
+
+/**
+ * Write up to max_records queued messages to the log outputs. Only one caller at time can drain,
+ * if another one is already draining it returns immediately.
+ *
+ * @param max_records maximum number of records to write
+ * @return the number of records written
+ */
+size_t log_drain(size_t max_records){
+    if (__atomic_test_and_set(&logDrainBusy, __ATOMIC_ACQUIRE))
+        return 0;
+
+    char message[LOG_RECORD_MESSAGE_LEN];
+    log_record_t record;
+    size_t drained = 0;
+    while (drained < max_records && log_ring_pop(&log_ring, &record)){
+        if (record.format != NULL) {
+            vsprintf_values(message, record.format, record.values, record.values_count);
+            log_emit(record.level, message);
+        } else {
+            log_emit(record.level, record.message);
+        }
+        drained++;
+    }
+
+    uint64_t dropped = log_ring_dropped(&log_ring);
+    if (dropped != logDroppedReported){
+        log_format(message, "(log_drain): %d log records dropped, the ring is full", dropped - logDroppedReported);
+        logDroppedReported = dropped;
+        log_emit(Error, message);
+    }
+
+    __atomic_clear(&logDrainBusy, __ATOMIC_RELEASE);
+    return drained;
+}
+
+void logline(log_level_t level, const char* msg){
+    if (level < logTrimLevel)
+        return; //dont log things that we dont want to see for now. (would be nice to store these somewhere in the future perhaps, just not display them?)
+
+    if (logAsync && level != Fatal){
+        // Never wait for the serial port here: if the ring is full the message is dropped (and counted)
+        log_ring_push(&log_ring, level, msg);
+        return;
+    }
+
+    if (level == Fatal)
+        log_drain(LOG_RING_SIZE); //the queued messages probably explain what went wrong, they must come first
+
+    log_emit(level, msg);
 
     if (level == Fatal)
     {
+#if TRACE_ENABLED == 1
+        // What happened right before the panic is often more useful than the message
+        if (trace_active)
+            trace_dump();
+#endif
         cli();
         while (1);
     }
 }
 
+// Only strings stored in the kernel read only data can be formatted later, anything else could change or disappear
+static bool log_is_static_string(uint64_t address){
+    return address >= (uint64_t) &_kernel_rodata_start && address < (uint64_t) &_kernel_rodata_end;
+}
+
+// Store the message unformatted, it returns false if the message must be formatted now
+static bool log_push_binary(log_level_t level, const char* msg, va_list format_args){
+    uint64_t values[LOG_RECORD_MAX_VALUES];
+    uint32_t string_mask;
+    if (!log_is_static_string((uint64_t) msg))
+        return false;
+
+    int values_count = vsprintf_capture(msg, format_args, values, LOG_RECORD_MAX_VALUES, &string_mask);
+    if (values_count < 0)
+        return false;
+
+    for (int i = 0; i < values_count; i++){
+        if ((string_mask & (1 << i)) && !log_is_static_string(values[i]))
+            return false;
+    }
+    log_ring_push_binary(&log_ring, level, msg, values, values_count);
+    return true;
+}
+
 void loglinef(log_level_t level, const char* msg, ...)
 {
+    if (level < logTrimLevel)
+        return;
+
     char format_buffer[formatBufferLen];
 
     va_list format_args;
     va_start(format_args, msg);
+    if (logAsync && logBinary && level != Fatal && log_push_binary(level, msg, format_args)){
+        va_end(format_args);
+        return;
+    }
     vsprintf(format_buffer, msg, format_args);
     va_end(format_args);
 
@@ -12,6 +12,8 @@
 #include <kernel/qemu.h>
 #include <psf.h>
 #include <framebuffer.h>
+#include <fpu.h>
+#include <pmu.h>
 #include <cpu.h>
 #include <lapic.h>
 #include <acpi.h>
@@ -31,6 +33,8 @@
 #include <timer.h>
 #include <kernel.h>
 #include <string.h>
+#include <kstack.h>
+#include <reaper.h>
 #include <scheduler.h>
 #include <thread.h>
 #include <rtc.h>
@@ -39,10 +43,19 @@
 #include <task.h>
 #include <tss.h>
 #include <vfs.h>
+#include <dcache.h>
+#include <page_cache.h>
+#include <ustar.h>
 #include <vm.h>
 #include <vmm.h>
 #include <vmm_mapping.h>
 #include <userspace.h>
+#include <vdso.h>
+#include <memops.h>
+#include <trace.h>
+#include <ksyms.h>
+#include <profiler.h>
+#include <kbench.h>
 #include <utils.h>
 //#include <runtime_tests.h>
 
@@ -62,6 +75,8 @@ struct multiboot_tag_new_acpi *tagnew_acpi = NULL;
 struct multiboot_tag_mmap *tagmmap = NULL;
 struct multiboot_tag *tagacpi = NULL;
 struct multiboot_tag_module *loaded_module = NULL;
+struct multiboot_tag_module *kernel_map_module = NULL;
+struct multiboot_tag_module *initrd_module = NULL;
 struct multiboot_tag *tag_start = NULL;
 
 uint64_t elf_module_start_hh = 0;
@@ -153,7 +168,25 @@ void _init_basic_system(unsigned long addr){
         tag->type != MULTIBOOT_TAG_TYPE_END;
         tag = (struct multiboot_tag *) ((multiboot_uint8_t *) tag + ((tag->size + 7) & ~7))){
         switch(tag->type){
+            case MULTIBOOT_TAG_TYPE_CMDLINE:
+                kernel_set_cmdline(((struct multiboot_tag_string *) tag)->string);
+                pretty_logf(Verbose, " \t[Tag 0x%x] (%s): cmdline: %s", tag->type, multiboot_names[tag->type], kernel_settings.cmdline);
+                break;
             case MULTIBOOT_TAG_TYPE_MODULE:
+                // The modules are used in place for the whole kernel life (symbols, initrd, elf pages), their frames are never handed out
+                pmm_reserve_area(((struct multiboot_tag_module *) tag)->mod_start, ((struct multiboot_tag_module *) tag)->mod_end - ((struct multiboot_tag_module *) tag)->mod_start);
+                // The kernel map is not an executable, it's used only to resolve the kernel symbols
+                if ( strcmp(((struct multiboot_tag_module *) tag)->cmdline, KSYMS_MODULE_NAME) == 0 ) {
+                    kernel_map_module = (struct multiboot_tag_module *) tag;
+                    pretty_logf(Verbose, " \t[Tag 0x%x] (%s): kernel map: mod_start: 0x%x : mod_end: 0x%x" , kernel_map_module->type, multiboot_names[kernel_map_module->type], kernel_map_module->mod_start, kernel_map_module->mod_end);
+                    break;
+                }
+                // The initrd is an ustar archive, it will be mounted in place by the vfs
+                if ( strcmp(((struct multiboot_tag_module *) tag)->cmdline, USTAR_MODULE_NAME) == 0 ) {
+                    initrd_module = (struct multiboot_tag_module *) tag;
+                    pretty_logf(Verbose, " \t[Tag 0x%x] (%s): initrd: mod_start: 0x%x : mod_end: 0x%x" , initrd_module->type, multiboot_names[initrd_module->type], initrd_module->mod_start, initrd_module->mod_end);
+                    break;
+                }
                 loaded_module = (struct multiboot_tag_module *) tag;
                 pretty_logf(Verbose, " \t[Tag 0x%x] (%s): Size: 0x%x - mod_start: 0x%x : mod_end: 0x%x" , loaded_module->type, multiboot_names[loaded_module->type], loaded_module->size, loaded_module->mod_start, loaded_module->mod_end);
                 break;
@@ -214,6 +247,9 @@ void kernel_start(unsigned long addr, unsigned long magic){
 
     draw_logo(0, 400);
 #endif
+    init_fpu();
+    memops_init();
+    init_pmu();
     _syscalls_init();
     //_sc_putc('c', 0);
     //asm("int $0x80");
@@ -221,11 +257,15 @@ void kernel_start(unsigned long addr, unsigned long magic){
 
 
     initialize_kheap();
+    init_kstack_pool();
     kernel_settings.paging.page_generation = 0;
     init_apic();
+    if (kernel_map_module != NULL) {
+        init_ksyms((uintptr_t) hhdm_get_variable(kernel_map_module->mod_start), kernel_map_module->mod_end - kernel_map_module->mod_start);
+    }
     if (loaded_module != NULL) {
         if ( load_module_hh(loaded_module) ) {
-            pretty_log(Verbose, " The ELF module can be loaded succesfully" );
+            pretty_log(Verbose, " The ELF module is an executable, it will be started with the other tasks" );
             elf_module_start_phys = loaded_module->mod_start;
         }
     }
@@ -247,7 +287,16 @@ void kernel_start(unsigned long addr, unsigned long magic){
     pretty_logf(Verbose, "Calibrated apic value: %u", apic_ticks);
     pretty_logf(Verbose, "(END of Mapped memory: 0x%x)", end_of_mapped_memory);
     vfs_init();
+    init_page_cache();
+    if (initrd_module != NULL) {
+        ustar_mount((void *) hhdm_get_variable(initrd_module->mod_start), initrd_module->mod_end - initrd_module->mod_start);
+        vfs_dcache_invalidate();
+        page_cache_invalidate();
+    }
     uint64_t unix_timestamp = read_rtc_time();
+    init_vdso(unix_timestamp);
+    init_trace();
+    init_profiler();
 
     #if USE_FRAMEBUFFER == 1
     _fb_printStrAndNumberAt("Epoch time: ", unix_timestamp, 0, 11, 0xf5c4f1, 0x000000);
@@ -256,10 +305,35 @@ void kernel_start(unsigned long addr, unsigned long magic){
     char a = 'a';
     task_t* idle_task = create_task("idle", idle, &a, true);
     idle_thread = idle_task->threads;
+    reaper_start();
     task_t* userspace_task = create_task("userspace_idle", NULL, &a, false);
+    if (elf_module_start_phys != 0) {
+        elf_create_task(loaded_module->cmdline[0] != '\0' ? loaded_module->cmdline : "elf_module", elf_module_start_phys, loaded_module->mod_end - loaded_module->mod_start);
+    }
+    const char *init_option;
+    size_t init_option_length;
+    if ( initrd_module != NULL && kernel_cmdline_option("init", &init_option, &init_option_length) && init_option_length > 0 ) {
+        // init=<path> starts an executable of the initrd, the path is also the task name
+        char init_path[TASK_NAME_MAX_LEN];
+        if ( init_option_length < TASK_NAME_MAX_LEN ) {
+            strncpy(init_path, init_option, init_option_length);
+            init_path[init_option_length] = '\0';
+            elf_create_task_from_initrd(init_path);
+        } else {
+            pretty_logf(Error, "init path too long, the maximum length is: %d", TASK_NAME_MAX_LEN - 1);
+        }
+    }
+    if ( kbench_requested() ) {
+        kbench_start();
+    }
+    if ( kernel_cmdline_option("profile", NULL, NULL) ) {
+        profiler_start();
+    }
     //create_thread("ledi", noop2, &c, eldi_task);
     //create_task("sleeper", noop3, &d);
     //execute_runtime_tests();
+    // From now on the idle thread writes the log messages
+    set_log_async(true);
     start_apic_timer(kernel_settings.apic_timer.timer_ticks_base, APIC_TIMER_SET_PERIODIC, kernel_settings.apic_timer.timer_divisor);
     pretty_logf(Verbose, "(END of Mapped memory: 0x%x)", end_of_mapped_memory);
     pretty_logf(Info, "init_basic_system: Memory lower (in kb): %d - upper (in kb): %d", tagmem->mem_lower, tagmem->mem_upper);
@@ -41,7 +41,7 @@ void _initialize_bitmap ( uint64_t end_of_reserved_area ) {
     number_of_entries = bitmap_size / 64 + 1;
     uint64_t memory_map_phys_addr;
 #ifdef _TEST_
-    memory_map = malloc(bitmap_size / 8 + 1);
+    memory_map = malloc(number_of_entries * sizeof(uint64_t));
 #else
     memory_map_phys_addr = _mmap_determine_bitmap_region(end_of_reserved_area, bitmap_size / 8 + 1);
     memory_map = (uint64_t *) hhdm_get_variable(memory_map_phys_addr);
@@ -96,8 +96,12 @@ int64_t _bitmap_request_frame(){
     for (row = 0; row < number_of_entries; row++){
         if(memory_map[row] != BITMAP_ENTRY_FULL){
             for (column = 0; column < BITMAP_ROW_BITS; column++){
-                uint64_t bit = 1 << column;
+                uint64_t bit = 1ULL << column;
                 if((memory_map[row] & bit) == 0){
+                    // The last row can have bits past the end of the memory
+                    if ( (uint64_t) row * BITMAP_ROW_BITS + column >= bitmap_size ) {
+                        return -1;
+                    }
                     return row * BITMAP_ROW_BITS + column;
                 }
             }
@@ -116,7 +120,7 @@ int64_t _bitmap_request_frames(size_t number_of_frames) {
     for (row = 0; row < number_of_entries; row++){
         if(memory_map[row] != BITMAP_ENTRY_FULL){
             for (column = 0; column < BITMAP_ROW_BITS; column++){
-                uint64_t bit = 1 << column;
+                uint64_t bit = 1ULL << column;
                 if((memory_map[row] & bit) == 0){
                     if(adjacents_found == 0) {
                         start_row = row;
@@ -145,15 +149,15 @@ void _bitmap_set_bit_from_address(uint64_t address) {
  * In the next 3 function location is the bit-location inside the bitmap
  * */
 void _bitmap_set_bit(uint64_t location){
-    memory_map[location / BITMAP_ROW_BITS] |= 1 << (location % BITMAP_ROW_BITS);
+    memory_map[location / BITMAP_ROW_BITS] |= 1ULL << (location % BITMAP_ROW_BITS);
 }
 
 void _bitmap_free_bit(uint64_t location){
-    memory_map[location / BITMAP_ROW_BITS] &= ~(1 << (location % BITMAP_ROW_BITS));
+    memory_map[location / BITMAP_ROW_BITS] &= ~(1ULL << (location % BITMAP_ROW_BITS));
 }
 
 bool _bitmap_test_bit(uint64_t location){
-    return memory_map[location / BITMAP_ROW_BITS] & (1 << (location % BITMAP_ROW_BITS));
+    return memory_map[location / BITMAP_ROW_BITS] & (1ULL << (location % BITMAP_ROW_BITS));
 }
 
 
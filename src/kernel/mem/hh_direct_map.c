@@ -27,6 +27,16 @@ void *hhdm_get_variable ( uintptr_t phys_address ) {
     return NULL;
 }
 
+/**
+ * The inverse of hhdm_get_variable: get the physical address of a variable in the direct map
+ *
+ * @param variable an address inside the direct map
+ * @return the physical address
+ */
+uintptr_t hhdm_get_phys_address ( void *variable ) {
+    return (uintptr_t) variable - higherHalfDirectMapBase;
+}
+
 
 void hhdm_map_physical_memory() {
     // This function should be called only once, and the hhdm shouldn't change during the kernel uptime
@@ -6,6 +6,7 @@
 #include <logging.h>
 #include <vmm_mapping.h>
 #include <vmm_util.h>
+#include <trace.h>
 
 KHeapMemoryNode *kernel_heap_start;
 KHeapMemoryNode *kernel_heap_current_pos;
@@ -74,6 +75,7 @@ void *kmalloc(size_t size) {
                     current_node->is_free = false;
                     //current_node->size -= real_size;
                 }
+                TRACE(TRACE_KMALLOC, (void *) current_node + sizeof(KHeapMemoryNode), size);
                 return (void *) current_node + sizeof(KHeapMemoryNode);
             }
         }
@@ -133,6 +135,7 @@ void kfree(void *ptr) {
     if ( (uint64_t) ptr < (uint64_t) kernel_heap_start || (uint64_t) ptr > (uint64_t) kernel_heap_end) {
         return;
     }
+    TRACE(TRACE_KFREE, ptr, 0);
 
     // Now we can search for the node containing our address
     KHeapMemoryNode *current_node = kernel_heap_start;
@@ -206,6 +209,10 @@ void merge_memory_nodes(KHeapMemoryNode *left_node, KHeapMemoryNode *right_node)
             KHeapMemoryNode *next_node = right_node->next;
             next_node->prev = left_node;
         }
+        //4. If the right node was the tail, now the tail is the left node
+        if(right_node == kernel_heap_end){
+            kernel_heap_end = left_node;
+        }
     }
 }
 
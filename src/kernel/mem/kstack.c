@@ -0,0 +1,267 @@
+#include <kstack.h>
+#include <hh_direct_map.h>
+#include <kernel.h>
+#include <logging.h>
+#include <pmm.h>
+#include <spinlock.h>
+#include <string.h>
+#include <vm.h>
+#include <vmm.h>
+#include <vmm_mapping.h>
+
+kstack_stats_t kstack_stats;
+
+/**
+ * The kernel stacks live in a range of the higher half reserved at boot, divided in KSTACK_POOL_MAX_STACKS slots:
+ * a slot is a guard page never mapped followed by the stack pages. The free slots are kept in two lists
+ * linked by slot index: the cached ones, still mapped, and the unmapped ones.
+ */
+static uintptr_t kstack_pool_base;
+static uint16_t kstack_next_slot[KSTACK_POOL_MAX_STACKS];
+static uint16_t kstack_cached_head;
+static uint16_t kstack_unmapped_head;
+
+static uintptr_t kstack_slot_stack(uint16_t slot) {
+    return kstack_pool_base + (uintptr_t) slot * KSTACK_SLOT_SIZE + KSTACK_GUARD_SIZE;
+}
+
+#if SMALL_PAGES == 0
+/**
+ * With 2mb pages a frame is split in blocks of KSTACK_MAPPED_SIZE, every mapped stack uses one of them.
+ * The range has its own tables of 4k pages, they are contiguous: kstack_page_entries has an entry for every 4k page of the range.
+ */
+static uintptr_t kstack_frames[KSTACK_POOL_MAX_FRAMES];
+static uint64_t kstack_frame_blocks[KSTACK_POOL_MAX_FRAMES]; /**< A bit set for every block in use */
+static uint64_t *kstack_page_entries;
+
+/**
+ * Take a block from the frames of the pool, a frame is taken from the pmm when all the others are full.
+ *
+ * @return the physical address of the block, or 0 if there is no memory
+ */
+static uintptr_t kstack_block_alloc() {
+    size_t empty_frame = KSTACK_POOL_MAX_FRAMES;
+    for (size_t frame = 0; frame < KSTACK_POOL_MAX_FRAMES; frame++) {
+        if ( kstack_frames[frame] == 0 ) {
+            if ( empty_frame == KSTACK_POOL_MAX_FRAMES ) {
+                empty_frame = frame;
+            }
+            continue;
+        }
+        for (size_t block = 0; block < KSTACK_STACKS_PER_FRAME; block++) {
+            if ( !(kstack_frame_blocks[frame] & (1ULL << block)) ) {
+                kstack_frame_blocks[frame] |= 1ULL << block;
+                return kstack_frames[frame] + block * KSTACK_MAPPED_SIZE;
+            }
+        }
+    }
+    if ( empty_frame == KSTACK_POOL_MAX_FRAMES ) {
+        return 0;
+    }
+    void *frame_address = pmm_alloc_frame();
+    if ( frame_address == NULL ) {
+        return 0;
+    }
+    kstack_frames[empty_frame] = (uintptr_t) frame_address;
+    kstack_frame_blocks[empty_frame] = 1;
+    kstack_stats.frames++;
+    return (uintptr_t) frame_address;
+}
+
+/**
+ * Give back a block, its frame goes back to the pmm when none of its blocks is used.
+ */
+static void kstack_block_free(uintptr_t block_address) {
+    for (size_t frame = 0; frame < KSTACK_POOL_MAX_FRAMES; frame++) {
+        if ( kstack_frames[frame] == 0 || block_address < kstack_frames[frame] || block_address >= kstack_frames[frame] + PAGE_SIZE_IN_BYTES ) {
+            continue;
+        }
+        kstack_frame_blocks[frame] &= ~(1ULL << ((block_address - kstack_frames[frame]) / KSTACK_MAPPED_SIZE));
+        if ( kstack_frame_blocks[frame] == 0 ) {
+            pmm_free_frame((void *) kstack_frames[frame]);
+            kstack_frames[frame] = 0;
+            kstack_stats.frames--;
+        }
+        return;
+    }
+}
+
+static bool kstack_map_slot(uint16_t slot) {
+    uintptr_t block = kstack_block_alloc();
+    if ( block == 0 ) {
+        return false;
+    }
+    size_t first_entry = (kstack_slot_stack(slot) - kstack_pool_base) / KSTACK_PAGE_SIZE;
+    for (size_t i = 0; i < KSTACK_PAGES; i++) {
+        kstack_page_entries[first_entry + i] = (block + i * KSTACK_PAGE_SIZE) | WRITE_BIT | PRESENT_BIT;
+    }
+    kstack_stats.mapped++;
+    return true;
+}
+
+static void kstack_unmap_slot(uint16_t slot) {
+    uintptr_t stack = kstack_slot_stack(slot);
+    size_t first_entry = (stack - kstack_pool_base) / KSTACK_PAGE_SIZE;
+    uintptr_t block = kstack_page_entries[first_entry] & VM_PAGE_TABLE_BASE_ADDRESS_MASK;
+    for (size_t i = 0; i < KSTACK_PAGES; i++) {
+        kstack_page_entries[first_entry + i] = 0;
+        invalidate_page_table((uint64_t *) (stack + i * KSTACK_PAGE_SIZE));
+    }
+    kstack_block_free(block);
+    kstack_stats.mapped--;
+}
+
+/**
+ * Put the page tables in the first block, and make the page directory entries of the range point to them.
+ */
+static bool kstack_map_range() {
+    uintptr_t tables = kstack_block_alloc();
+    if ( tables == 0 ) {
+        return false;
+    }
+    kstack_page_entries = hhdm_get_variable(tables);
+    memset(kstack_page_entries, 0, KSTACK_PAGE_TABLES * KSTACK_PAGE_SIZE);
+    for (size_t i = 0; i < KSTACK_PAGE_TABLES; i++) {
+        map_page_table_hh((void *) (tables + i * KSTACK_PAGE_SIZE), (void *) (kstack_pool_base + i * PAGE_SIZE_IN_BYTES), NULL);
+    }
+    return true;
+}
+#elif SMALL_PAGES == 1
+static bool kstack_map_slot(uint16_t slot) {
+    uintptr_t stack = kstack_slot_stack(slot);
+    for (size_t i = 0; i < KSTACK_PAGES; i++) {
+        void *frame = pmm_alloc_frame();
+        if ( frame == NULL ) {
+            while ( i-- > 0 ) {
+                void *page = (void *) (stack + i * PAGE_SIZE_IN_BYTES);
+                pmm_free_frame(translate_virt_address_hh(page, kernel_settings.paging.hhdm_page_root_address));
+                unmap_vaddress_hh(page, kernel_settings.paging.hhdm_page_root_address);
+            }
+            return false;
+        }
+        map_phys_to_virt_addr_hh(frame, (void *) (stack + i * PAGE_SIZE_IN_BYTES), VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, NULL);
+    }
+    kstack_stats.mapped++;
+    kstack_stats.frames += KSTACK_PAGES;
+    return true;
+}
+
+static void kstack_unmap_slot(uint16_t slot) {
+    uintptr_t stack = kstack_slot_stack(slot);
+    for (size_t i = 0; i < KSTACK_PAGES; i++) {
+        void *page = (void *) (stack + i * PAGE_SIZE_IN_BYTES);
+        pmm_free_frame(translate_virt_address_hh(page, kernel_settings.paging.hhdm_page_root_address));
+        unmap_vaddress_hh(page, kernel_settings.paging.hhdm_page_root_address);
+    }
+    kstack_stats.mapped--;
+    kstack_stats.frames -= KSTACK_PAGES;
+}
+
+/**
+ * Mapping the last slot creates the tables of the end of the range, it's given back right away
+ */
+static bool kstack_map_range() {
+    uint16_t last_slot = KSTACK_POOL_MAX_STACKS - 1;
+    if ( kstack_map_slot(last_slot) ) {
+        kstack_unmap_slot(last_slot);
+    }
+    return true;
+}
+#endif
+
+/**
+ * Reserve the stacks range and map the first stacks. It must be called before the first task is created:
+ * the tasks copy the higher half entries of the kernel root table, so the tables covering the range must already be there.
+ */
+void init_kstack_pool() {
+    memset(&kstack_stats, 0, sizeof(kstack_stats_t));
+    size_t range_size = (KSTACK_POOL_MAX_STACKS * KSTACK_SLOT_SIZE + PAGE_SIZE_IN_BYTES - 1) & ~(PAGE_SIZE_IN_BYTES - 1);
+    kstack_pool_base = (uintptr_t) vmm_alloc(range_size, VMM_FLAGS_ADDRESS_ONLY, NULL);
+    for (uint16_t slot = 0; slot < KSTACK_POOL_MAX_STACKS; slot++) {
+        kstack_next_slot[slot] = slot + 1 < KSTACK_POOL_MAX_STACKS ? slot + 1 : KSTACK_NO_SLOT;
+    }
+    kstack_unmapped_head = 0;
+    kstack_cached_head = KSTACK_NO_SLOT;
+
+    if ( !kstack_map_range() ) {
+        pretty_log(Fatal, "Can't map the kernel stacks range");
+    }
+    for (size_t i = 0; i < KSTACK_POOL_PREFILL; i++) {
+        uint16_t slot = kstack_unmapped_head;
+        if ( !kstack_map_slot(slot) ) {
+            break;
+        }
+        kstack_unmapped_head = kstack_next_slot[slot];
+        kstack_next_slot[slot] = kstack_cached_head;
+        kstack_cached_head = slot;
+        kstack_stats.cached++;
+    }
+    pretty_logf(Verbose, "Kernel stacks pool at: 0x%x - stacks: %d - stack size: 0x%x - prefilled: %d - frames: %d", kstack_pool_base, KSTACK_POOL_MAX_STACKS, KSTACK_MAPPED_SIZE, kstack_stats.cached, kstack_stats.frames);
+}
+
+/**
+ * Get a kernel stack, a cached one is returned in O(1), otherwise its pages are mapped.
+ *
+ * @return the top of the stack (the stack grows backward), or NULL if there are no slots or no memory
+ */
+void *kstack_alloc() {
+    uint64_t flags = lock_irq_save();
+    uint16_t slot = kstack_cached_head;
+    if ( slot != KSTACK_NO_SLOT ) {
+        kstack_cached_head = kstack_next_slot[slot];
+        kstack_stats.cached--;
+        kstack_stats.cache_hits++;
+    } else {
+        slot = kstack_unmapped_head;
+        if ( slot == KSTACK_NO_SLOT || !kstack_map_slot(slot) ) {
+            lock_irq_restore(flags);
+            pretty_log(Error, "No kernel stack available");
+            return NULL;
+        }
+        kstack_unmapped_head = kstack_next_slot[slot];
+    }
+    kstack_stats.allocations++;
+    kstack_stats.in_use++;
+    lock_irq_restore(flags);
+    return (void *) (kstack_slot_stack(slot) + KSTACK_MAPPED_SIZE);
+}
+
+/**
+ * Give back a kernel stack, it's kept mapped for the next thread unless there are already enough cached stacks.
+ *
+ * @param stack_top the value returned by kstack_alloc
+ */
+void kstack_free(void *stack_top) {
+    uintptr_t address = (uintptr_t) stack_top - KSTACK_MAPPED_SIZE;
+    if ( !kstack_is_pool_address(address) || kstack_is_guard(address) ) {
+        pretty_logf(Error, "Address 0x%x is not a kernel stack", stack_top);
+        return;
+    }
+    uint16_t slot = (address - kstack_pool_base) / KSTACK_SLOT_SIZE;
+    uint64_t flags = lock_irq_save();
+    if ( kstack_stats.cached < KSTACK_POOL_MAX_CACHED ) {
+        kstack_next_slot[slot] = kstack_cached_head;
+        kstack_cached_head = slot;
+        kstack_stats.cached++;
+    } else {
+        kstack_unmap_slot(slot);
+        kstack_next_slot[slot] = kstack_unmapped_head;
+        kstack_unmapped_head = slot;
+    }
+    kstack_stats.in_use--;
+    lock_irq_restore(flags);
+}
+
+bool kstack_is_pool_address(uintptr_t address) {
+    return kstack_pool_base != 0 && address >= kstack_pool_base && address < kstack_pool_base + KSTACK_POOL_MAX_STACKS * KSTACK_SLOT_SIZE;
+}
+
+/**
+ * Check if an address is in the guard page below a kernel stack, an access there means that the stack overflowed.
+ *
+ * @param address the address to check (i.e. the page fault address)
+ * @return true if the address is in a guard page
+ */
+bool kstack_is_guard(uintptr_t address) {
+    return kstack_is_pool_address(address) && (address - kstack_pool_base) % KSTACK_SLOT_SIZE < KSTACK_GUARD_SIZE;
+}
@@ -7,7 +7,10 @@
 #include <vmm.h>
 #include <logging.h>
 #include <spinlock.h>
+#include <ticket_lock.h>
 #include <vmm_util.h>
+#include <page_ops.h>
+#include <trace.h>
 
 #ifndef _TEST_
 #include <video.h>
@@ -20,9 +23,17 @@ extern multiboot_memory_map_t *mmap_entries;
 extern uint8_t count_physical_reserved;
 extern size_t memory_size_in_bytes;
 
-spinlock_t memory_spinlock;
+// Taken also from the page fault handler and with the interrupts disabled, it's always held with the interrupts off
+ticket_lock_t memory_lock;
+lock_stats_t memory_lock_stats;
+spinlock_t zeroed_pool_spinlock;
+
+// Frames already zeroed by the idle thread, handed out in O(1) by pmm_alloc_zeroed_frame
+void *pmm_zeroed_pool[PMM_ZEROED_POOL_SIZE];
+size_t pmm_zeroed_pool_count = 0;
 
 bool pmm_initialized = false;
+static pmm_reclaim_t pmm_reclaim = NULL;
 uint64_t anon_memory_loc;
 uint64_t anon_physical_memory_loc;
 
@@ -42,7 +53,9 @@ void pmm_setup(uint64_t addr, uint32_t size){
     uint64_t bitmap_start_addr;
     size_t bitmap_size;
     _bitmap_get_region(&bitmap_start_addr, &bitmap_size, ADDRESS_TYPE_PHYSICAL);
-    spinlock_release(&memory_spinlock);
+    ticket_lock_init(&memory_lock, &memory_lock_stats, "pmm");
+    spinlock_init(&zeroed_pool_spinlock);
+    pmm_zeroed_pool_count = 0;
 #ifndef _TEST_
     //we cant reserve the bitmap in testing scenarios, as malloc() can return any address, usually leading to a super high index when we try to reserve it.
     //this usually results in a seg fault as we try to access entries in the bitmap waaaay too large.
@@ -54,28 +67,122 @@ void pmm_setup(uint64_t addr, uint32_t size){
     pmm_initialized = true;
 }
 
-/**
- * This function allocate a physical frame of memory.
- *
- * @return The physical address of the allocated frame of memory of PAGE_SIZE_IN_BYTES
- */
-void *pmm_alloc_frame(){
+static void *pmm_take_frame(){
     if( ! pmm_check_frame_availability() ) {
         return 0; // No more frames to allocate
     }
 
-    spinlock_acquire(&memory_spinlock);
-    uint64_t frame = _bitmap_request_frame();
+    uint64_t flags = ticket_lock_acquire_irqsave(&memory_lock);
+    int64_t frame = _bitmap_request_frame();
     if (frame > 0) {
         _bitmap_set_bit(frame);
         used_frames++;
-        spinlock_release(&memory_spinlock);
+        ticket_lock_release_irqrestore(&memory_lock, flags);
+        TRACE(TRACE_PMM_ALLOC, frame * PAGE_SIZE_IN_BYTES, 0);
         return (void*)(frame * PAGE_SIZE_IN_BYTES);
     }
-    spinlock_release(&memory_spinlock);
+    ticket_lock_release_irqrestore(&memory_lock, flags);
     return NULL;
 }
 
+static void *pmm_zeroed_pool_take();
+
+/**
+ * This function allocate a physical frame of memory.
+ * If there are no free frames the zeroed pool is drained first, then the reclaim function is asked to give one back,
+ * and the allocation is tried again.
+ *
+ * @return The physical address of the allocated frame of memory of PAGE_SIZE_IN_BYTES
+ */
+void *pmm_alloc_frame(){
+    void *frame = pmm_take_frame();
+    if ( frame == NULL ) {
+        // The pool is only a speedup, its frames are handed out before shrinking the caches
+        frame = pmm_zeroed_pool_take();
+    }
+    if ( frame == NULL && pmm_reclaim != NULL && pmm_reclaim(1) > 0 ) {
+        frame = pmm_take_frame();
+    }
+    return frame;
+}
+
+/**
+ * Set the function called when the memory runs out, i.e. to shrink the page cache.
+ *
+ * @param reclaim the reclaim function, NULL to disable it
+ */
+void pmm_set_reclaim(pmm_reclaim_t reclaim) {
+    pmm_reclaim = reclaim;
+}
+
+// The idle thread can be preempted while refilling, interrupts are disabled to not leave the lock taken
+static uint64_t zeroed_pool_lock() {
+    return spinlock_acquire_irqsave(&zeroed_pool_spinlock);
+}
+
+static void zeroed_pool_unlock(uint64_t flags) {
+    spinlock_release_irqrestore(&zeroed_pool_spinlock, flags);
+}
+
+static void *pmm_zeroed_pool_take() {
+    void *frame = NULL;
+    uint64_t flags = zeroed_pool_lock();
+    if ( pmm_zeroed_pool_count > 0 ) {
+        frame = pmm_zeroed_pool[--pmm_zeroed_pool_count];
+    }
+    zeroed_pool_unlock(flags);
+    return frame;
+}
+
+/**
+ * This function allocate a physical frame filled with zeroes.
+ * If the pool prepared by the idle thread is not empty it takes constant time, otherwise the frame is zeroed now.
+ *
+ * @return The physical address of the allocated frame, or NULL if there is no memory left
+ */
+void *pmm_alloc_zeroed_frame() {
+    void *frame = pmm_zeroed_pool_take();
+    if ( frame != NULL ) {
+        return frame;
+    }
+
+    frame = pmm_alloc_frame();
+    if ( frame != NULL ) {
+        page_zero(hhdm_get_variable((uintptr_t) frame), PAGE_SIZE_IN_BYTES);
+    }
+    return frame;
+}
+
+/**
+ * Add up to max_frames zeroed frames to the pool, it is called by the idle thread.
+ * The zeroing is done without holding any lock.
+ *
+ * @param max_frames the maximum number of frames to prepare in this call
+ * @return the number of frames added to the pool
+ */
+size_t pmm_refill_zeroed_pool(size_t max_frames) {
+    size_t added = 0;
+    while ( added < max_frames && pmm_zeroed_pool_count < PMM_ZEROED_POOL_SIZE ) {
+        // The pool is only a speedup, the caches are not shrunk to fill it
+        void *frame = pmm_take_frame();
+        if ( frame == NULL ) {
+            break;
+        }
+        page_zero(hhdm_get_variable((uintptr_t) frame), PAGE_SIZE_IN_BYTES);
+        uint64_t flags = zeroed_pool_lock();
+        bool stored = pmm_zeroed_pool_count < PMM_ZEROED_POOL_SIZE;
+        if ( stored ) {
+            pmm_zeroed_pool[pmm_zeroed_pool_count++] = frame;
+        }
+        zeroed_pool_unlock(flags);
+        if ( !stored ) {
+            pmm_free_frame(frame);
+            break;
+        }
+        added++;
+    }
+    return added;
+}
 
 void *pmm_prepare_new_pagetable() {
     if ( !pmm_initialized) {
@@ -113,7 +220,7 @@ void *pmm_alloc_area(size_t size) {
     size_t requested_frames = get_number_of_pages_from_size(size);
 
     pretty_logf(Verbose, "requested_frames: %x\n", requested_frames);
-    spinlock_acquire(&memory_spinlock);
+    uint64_t flags = ticket_lock_acquire_irqsave(&memory_lock);
     uint64_t frames = _bitmap_request_frames(requested_frames);
 
     for (size_t i =0; i < requested_frames; i++) {
@@ -121,16 +228,17 @@ void *pmm_alloc_area(size_t size) {
     }
 
     used_frames += requested_frames;
-    spinlock_release(&memory_spinlock);
+    ticket_lock_release_irqrestore(&memory_lock, flags);
     return (void *) frames;
 }
 
 void pmm_free_frame(void *address){
-    spinlock_acquire(&memory_spinlock);
+    TRACE(TRACE_PMM_FREE, address, 0);
+    uint64_t flags = ticket_lock_acquire_irqsave(&memory_lock);
     uint64_t frame = ((uint64_t)address) / PAGE_SIZE_IN_BYTES;
     _bitmap_free_bit(frame);
-    spinlock_release(&memory_spinlock);
     used_frames--;
+    ticket_lock_release_irqrestore(&memory_lock, flags);
 }
 
 bool pmm_check_frame_availability() {
@@ -140,20 +248,23 @@ bool pmm_check_frame_availability() {
     return false;
 }
 
+/**
+ * Mark as used all the frames touched by an area, the area doesn't need to be aligned.
+ *
+ * @param starting_address the physical address of the area
+ * @param size the area size in bytes
+ */
 void pmm_reserve_area(uint64_t starting_address, size_t size){
     uint64_t location = starting_address / PAGE_SIZE_IN_BYTES;
-    uint32_t number_of_frames = size / PAGE_SIZE_IN_BYTES;
-    if((size % PAGE_SIZE_IN_BYTES) != 0){
-        number_of_frames++;
-    }
-    spinlock_acquire(&memory_spinlock);
-    for(; number_of_frames > 0; number_of_frames--){
+    uint64_t end_location = (starting_address + size + PAGE_SIZE_IN_BYTES - 1) / PAGE_SIZE_IN_BYTES;
+    uint64_t flags = ticket_lock_acquire_irqsave(&memory_lock);
+    for(; location < end_location; location++){
        if(!_bitmap_test_bit(location)){
-           _bitmap_set_bit(location++);
+           _bitmap_set_bit(location);
            used_frames++;
        }
     }
-    spinlock_release(&memory_spinlock);
+    ticket_lock_release_irqrestore(&memory_lock, flags);
 }
 
 void pmm_free_area(uint64_t starting_address, size_t size){
@@ -170,10 +281,10 @@ void pmm_free_area(uint64_t starting_address, size_t size){
     if((size % PAGE_SIZE_IN_BYTES) != 0){
         number_of_frames++;
     }
-    spinlock_acquire(&memory_spinlock);
+    uint64_t flags = ticket_lock_acquire_irqsave(&memory_lock);
     for(; number_of_frames > 0; number_of_frames--){
         _bitmap_free_bit(location);
         used_frames--;
     }
-    spinlock_release(&memory_spinlock);
+    ticket_lock_release_irqrestore(&memory_lock, flags);
 }
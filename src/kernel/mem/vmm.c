@@ -1,4 +1,5 @@
 #include <bitmap.h>
+#include <hh_direct_map.h>
 #include <kernel.h>
 #include <logging.h>
 #include <main.h>
@@ -33,29 +34,23 @@ VmmInfo vmm_kernel;
  */
 void vmm_init(vmm_level_t vmm_level, VmmInfo *vmm_info) {
 
-    uint64_t *root_table_hh;
-
     if ( vmm_info == NULL ) {
         pretty_log(Verbose, "Kernel vmm initialization");
         vmm_info = &vmm_kernel;
-        root_table_hh = kernel_settings.paging.hhdm_page_root_address;
     } else {
         pretty_logf(Verbose, "Task vmm initialization: root_table_hhdm: 0x%x", vmm_info->root_table_hhdm);
-        root_table_hh = (uint64_t *) vmm_info->root_table_hhdm;
     }
 
     vmm_info->vmmDataStart = align_value_to_page(higherHalfDirectMapBase + memory_size_in_bytes + VM_KERNEL_MEMORY_PADDING);
 
-    vmm_info->status.vmm_container_root = (VmmContainer *) vmm_info->vmmDataStart;
-
-    vmm_info->status.end_of_vmm_data = (uint64_t) vmm_container_root + VMM_RESERVED_SPACE_SIZE;
+    vmm_info->status.end_of_vmm_data = vmm_info->vmmDataStart + VMM_RESERVED_SPACE_SIZE;
 
     //maybe start of vmm space can be removed.
 
     if (vmm_level == VMM_LEVEL_SUPERVISOR) {
         pretty_log(Verbose, "Supervisor level initialization");
         vmm_info->vmmSpaceStart = vmm_info->vmmDataStart + VMM_RESERVED_SPACE_SIZE + VM_KERNEL_MEMORY_PADDING;
-        vmm_info->start_of_vmm_space = (size_t) vmm_info->status.vmm_container_root + VMM_RESERVED_SPACE_SIZE + VM_KERNEL_MEMORY_PADDING;
+        vmm_info->start_of_vmm_space = vmm_info->vmmDataStart + VMM_RESERVED_SPACE_SIZE + VM_KERNEL_MEMORY_PADDING;
     } else if (vmm_level == VMM_LEVEL_USER) {
         pretty_log(Verbose, "User level initialization");
         vmm_info->vmmSpaceStart = 0x0l + VM_KERNEL_MEMORY_PADDING;
@@ -67,6 +62,7 @@ void vmm_init(vmm_level_t vmm_level, VmmInfo *vmm_info) {
     vmm_info->status.next_available_address = vmm_info->start_of_vmm_space;
     vmm_info->status.vmm_items_per_page = (PAGE_SIZE_IN_BYTES / sizeof(VmmItem)) - 1;
     vmm_info->status.vmm_cur_index = 0;
+    vmm_regions_init(&vmm_info->regions);
 
     pretty_logf(Verbose, "\tvmm_container_root starts at: 0x%x - %x", vmm_info->status.vmm_container_root, is_address_aligned(vmm_info->vmmDataStart, PAGE_SIZE_IN_BYTES));
     pretty_logf(Verbose, "\tvmmDataStart  starts at: 0x%x - %x (end_of_vmm_data)", vmm_info->vmmDataStart, vmm_info->status.end_of_vmm_data);
@@ -81,8 +77,9 @@ void vmm_init(vmm_level_t vmm_level, VmmInfo *vmm_info) {
         return;
     }
 
-    // Mapping the phyiscal address for the vmm structures
-    map_phys_to_virt_addr_hh(vmm_root_phys, vmm_info->status.vmm_container_root, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, root_table_hh);
+    // The containers are used through the direct map: the higher half is shared by all the tasks,
+    // mapping them there would give the same containers to everybody.
+    vmm_info->status.vmm_container_root = (VmmContainer *) hhdm_get_variable((uintptr_t) vmm_root_phys);
     vmm_info->status.vmm_container_root->next = NULL;
     vmm_info->status.vmm_cur_container = vmm_info->status.vmm_container_root;
 }
@@ -104,10 +101,8 @@ void *vmm_alloc_at(uint64_t base_address, size_t size, size_t flags, VmmInfo *vm
         void *new_container_phys_address = pmm_alloc_frame();
         VmmContainer *new_container = NULL;
         if ( new_container_phys_address != NULL) {
-            // 1.a We need to get the virtual address for the new structure
-            new_container = (VmmContainer*)align_value_to_page((uint64_t)vmm_info->status.vmm_cur_container + sizeof(VmmContainer) + PAGE_SIZE_IN_BYTES);
-            pretty_logf(Verbose, "new address 0x%x is aligned: %d", new_container, is_address_aligned((uintptr_t)new_container, PAGE_SIZE_IN_BYTES));
-            map_phys_to_virt_addr_hh(new_container_phys_address, new_container, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, (uint64_t *) vmm_info->root_table_hhdm);
+            // 1.a Like the root, the new container is used through the direct map
+            new_container = (VmmContainer*) hhdm_get_variable((uintptr_t) new_container_phys_address);
             // Step 2: Reset vmm_cur_index
             vmm_info->status.vmm_cur_index = 0;
             // Step 2.a: Set next as null for new_container;
@@ -158,7 +153,8 @@ void *vmm_alloc_at(uint64_t base_address, size_t size, size_t flags, VmmInfo *vm
         pretty_logf(Verbose, "No physical memory needed: mapping address: 0x%x", vmm_info->root_table_hhdm);
 
         for  ( size_t i = 0; i < required_pages; i++ )  {
-            void *frame = pmm_alloc_frame();
+            // Never hand out frames with stale content, the pool of the idle thread makes it O(1)
+            void *frame = pmm_alloc_zeroed_frame();
             pretty_logf(Verbose, "address to map: 0x%x - phys frame: 0x%x", frame, address_to_return);
             map_phys_to_virt_addr_hh((void*) frame, (void *)address_to_return + (i * PAGE_SIZE_IN_BYTES), arch_flags | VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, (uint64_t *) vmm_info->root_table_hhdm);
         }
@@ -184,6 +180,66 @@ void *vmm_alloc(size_t size, size_t flags, VmmInfo *vmm_info) {
 
 }
 
+/**
+ * Release the memory of an address space: the frames allocated by vmm_alloc, the pages populated in the regions,
+ * the lower half page tables and the vmm containers. The root table is not freed, and the address space
+ * must not be used anymore.
+ *
+ * @param vmm_info the vmm data of the address space
+ * @return the number of frames freed
+ */
+size_t vmm_destroy(VmmInfo *vmm_info) {
+    uint64_t *root_table = (uint64_t *) vmm_info->root_table_hhdm;
+    size_t freed_frames = 0;
+
+    VmmContainer *container = vmm_info->status.vmm_container_root;
+    while ( container != NULL ) {
+        size_t items = container == vmm_info->status.vmm_cur_container ? vmm_info->status.vmm_cur_index : vmm_info->status.vmm_items_per_page;
+        for (size_t i = 0; i < items; i++) {
+            VmmItem item = container->vmm_root[i];
+            // The address only items are mapped by somebody else, and the higher half is shared with the kernel
+            if ( is_address_only(item.flags) || is_address_higher_half(item.base) ) {
+                continue;
+            }
+            for (size_t offset = 0; offset < item.size; offset += PAGE_SIZE_IN_BYTES) {
+                void *frame = translate_virt_address_hh((void *) (item.base + offset), root_table);
+                if ( frame != NULL ) {
+                    pmm_free_frame(frame);
+                    freed_frames++;
+                }
+            }
+        }
+        VmmContainer *next = container->next;
+        pmm_free_frame((void *) hhdm_get_phys_address(container));
+        freed_frames++;
+        container = next;
+    }
+    vmm_info->status.vmm_container_root = NULL;
+    vmm_info->status.vmm_cur_container = NULL;
+
+    // The shared pages are only unreferenced, the private ones (filled or copied on write) are freed
+    vmm_region_table_t *table = &vmm_info->regions;
+    for (size_t i = 0; i < table->count; i++) {
+        vmm_region_t *region = &table->regions[i];
+        for (uintptr_t page = region->start; page < region->end; page += PAGE_SIZE_IN_BYTES) {
+            void *frame = translate_virt_address_hh((void *) page, root_table);
+            if ( frame == NULL ) {
+                continue;
+            }
+            if ( (region->flags & VMM_REGION_FILE_SHARED) && (uint64_t) frame == region->file_phys + (page - region->start) ) {
+                vmm_frame_unref((uint64_t) frame);
+            } else {
+                pmm_free_frame(frame);
+                freed_frames++;
+            }
+        }
+    }
+    table->count = 0;
+
+    freed_frames += free_user_page_tables(root_table);
+    return freed_frames;
+}
+
 bool is_address_only(size_t  flags) {
     if ( flags & VMM_FLAGS_ADDRESS_ONLY ) {
         return true;
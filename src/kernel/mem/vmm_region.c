@@ -0,0 +1,248 @@
+#include <vmm_region.h>
+#include <bitmap.h>
+#include <logging.h>
+#include <vm.h>
+#ifndef _TEST_
+#include <hh_direct_map.h>
+#include <pmm.h>
+#include <scheduler.h>
+#include <string.h>
+#include <task.h>
+#include <vmm.h>
+#include <vmm_mapping.h>
+#endif
+
+/**
+ * Reference counts of the file frames mapped in the tasks address space.
+ * The key is the physical address, a slot with phys 0 is empty. The file frames are never freed,
+ * so the slots are never removed, a count of 0 means that no task maps the frame anymore.
+ */
+typedef struct {
+    uint64_t phys;
+    size_t count;
+} vmm_shared_frame_t;
+
+vmm_shared_frame_t vmm_shared_frames[VMM_SHARED_FRAMES_MAX];
+
+void vmm_regions_init(vmm_region_table_t *table) {
+    table->count = 0;
+    table->stats.faults = 0;
+    table->stats.shared_maps = 0;
+    table->stats.private_fills = 0;
+    table->stats.cow_copies = 0;
+    table->stats.invalid = 0;
+}
+
+/**
+ * Add a region populated on demand. The bounds must be page aligned, and the region can't overlap the existing ones.
+ *
+ * @param table the region table of the task
+ * @param start the first address of the region
+ * @param end the address after the end of the region
+ * @param flags VMM_REGION_* flags
+ * @param file_phys the physical address of the file data that will be mapped at start (shared regions only)
+ * @param source the argument for fill
+ * @param fill the function filling the private pages (not shared regions only)
+ * @return true if the region has been added
+ */
+bool vmm_region_add(vmm_region_table_t *table, uintptr_t start, uintptr_t end, size_t flags, uint64_t file_phys, void *source, vmm_region_fill_t fill) {
+    if ( start >= end || (start & (PAGE_SIZE_IN_BYTES - 1)) || (end & (PAGE_SIZE_IN_BYTES - 1)) ) {
+        return false;
+    }
+    if ( table->count == VMM_MAX_REGIONS ) {
+        pretty_logf(Error, "Too many regions, the maximum is: %d", VMM_MAX_REGIONS);
+        return false;
+    }
+    if ( !(flags & VMM_REGION_FILE_SHARED) && fill == NULL ) {
+        return false;
+    }
+    size_t position = 0;
+    while ( position < table->count && table->regions[position].start < start ) {
+        position++;
+    }
+    if ( position > 0 && table->regions[position - 1].end > start ) {
+        return false;
+    }
+    if ( position < table->count && table->regions[position].start < end ) {
+        return false;
+    }
+    for (size_t i = table->count; i > position; i--) {
+        table->regions[i] = table->regions[i - 1];
+    }
+    vmm_region_t *region = &table->regions[position];
+    region->start = start;
+    region->end = end;
+    region->flags = flags;
+    region->file_phys = file_phys;
+    region->source = source;
+    region->fill = fill;
+    table->count++;
+    return true;
+}
+
+/**
+ * Find the region containing an address
+ *
+ * @param table the region table of the task
+ * @param address the address to search
+ * @return the region, or NULL if the address is not in any region
+ */
+vmm_region_t *vmm_region_find(vmm_region_table_t *table, uintptr_t address) {
+    size_t low = 0;
+    size_t high = table->count;
+    while ( low < high ) {
+        size_t middle = (low + high) / 2;
+        vmm_region_t *region = &table->regions[middle];
+        if ( address < region->start ) {
+            high = middle;
+        } else if ( address >= region->end ) {
+            low = middle + 1;
+        } else {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Decide how a page fault in a region must be solved
+ *
+ * @param region the region containing the faulting address (can be NULL)
+ * @param error_code the page fault error code
+ * @return the action to take
+ */
+vmm_fault_action_t vmm_region_fault_action(vmm_region_t *region, uint64_t error_code) {
+    if ( region == NULL || (error_code & RESERVED_VIOLATION) ) {
+        return VMM_FAULT_INVALID;
+    }
+    bool write = (error_code & WRITE_VIOLATION) != 0;
+    if ( write && !(region->flags & VMM_REGION_WRITE) ) {
+        return VMM_FAULT_INVALID;
+    }
+    if ( error_code & PRESENT_VIOLATION ) {
+        // The page is there: the only allowed case is the first write on a shared writable page
+        if ( write && (region->flags & VMM_REGION_FILE_SHARED) ) {
+            return VMM_FAULT_COPY_ON_WRITE;
+        }
+        return VMM_FAULT_INVALID;
+    }
+    return (region->flags & VMM_REGION_FILE_SHARED) ? VMM_FAULT_MAP_SHARED : VMM_FAULT_FILL_PRIVATE;
+}
+
+static vmm_shared_frame_t *vmm_shared_frame_slot(uint64_t phys, bool create) {
+    size_t slot = (size_t) ((phys / PAGE_SIZE_IN_BYTES) * 0x9E3779B97F4A7C15ULL >> 32) % VMM_SHARED_FRAMES_MAX;
+    for (size_t i = 0; i < VMM_SHARED_FRAMES_MAX; i++) {
+        vmm_shared_frame_t *frame = &vmm_shared_frames[(slot + i) % VMM_SHARED_FRAMES_MAX];
+        if ( frame->phys == phys ) {
+            return frame;
+        }
+        if ( frame->phys == 0 ) {
+            if ( !create ) {
+                return NULL;
+            }
+            frame->phys = phys;
+            frame->count = 0;
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Add a reference to a shared file frame
+ *
+ * @param phys the physical address of the frame
+ * @return the number of references, 0 if the table is full and the frame is not tracked
+ */
+size_t vmm_frame_ref(uint64_t phys) {
+    vmm_shared_frame_t *frame = vmm_shared_frame_slot(phys, true);
+    if ( frame == NULL ) {
+        pretty_logf(Error, "Shared frames table full, frame 0x%x not tracked", phys);
+        return 0;
+    }
+    return ++frame->count;
+}
+
+/**
+ * Remove a reference from a shared file frame
+ *
+ * @param phys the physical address of the frame
+ * @return the number of references left
+ */
+size_t vmm_frame_unref(uint64_t phys) {
+    vmm_shared_frame_t *frame = vmm_shared_frame_slot(phys, false);
+    if ( frame == NULL || frame->count == 0 ) {
+        return 0;
+    }
+    return --frame->count;
+}
+
+size_t vmm_frame_refcount(uint64_t phys) {
+    vmm_shared_frame_t *frame = vmm_shared_frame_slot(phys, false);
+    return frame != NULL ? frame->count : 0;
+}
+
+#ifndef _TEST_
+/**
+ * Populate the page of the current task containing a faulting address, if it belongs to one of its regions.
+ * Shared pages are mapped read-only from the file frames, private pages get a new frame filled by the region,
+ * and the first write on a shared writable page replaces it with a private copy.
+ *
+ * @param address the faulting address (cr2)
+ * @param error_code the page fault error code
+ * @return true if the fault has been solved and the instruction can be executed again
+ */
+bool vmm_region_handle_fault(uintptr_t address, uint64_t error_code) {
+    thread_t *thread = current_executing_thread;
+    if ( thread == NULL || thread->parent_task == NULL || is_address_higher_half(address) ) {
+        return false;
+    }
+    task_t *task = thread->parent_task;
+    vmm_region_table_t *table = &task->vmm_data.regions;
+    uint64_t *root_table = (uint64_t *) task->vmm_data.root_table_hhdm;
+    uintptr_t page = address & ~(PAGE_SIZE_IN_BYTES - 1);
+    vmm_region_t *region = vmm_region_find(table, address);
+    table->stats.faults++;
+
+    switch ( vmm_region_fault_action(region, error_code) ) {
+        case VMM_FAULT_MAP_SHARED: {
+            // Mapped read-only even in a writable region, the first write will make a private copy
+            uint64_t phys = region->file_phys + (page - region->start);
+            map_phys_to_virt_addr_hh((void *) phys, (void *) page, VMM_FLAGS_PRESENT | VMM_FLAGS_USER_LEVEL, root_table);
+            vmm_frame_ref(phys);
+            table->stats.shared_maps++;
+            return true;
+        }
+        case VMM_FAULT_FILL_PRIVATE: {
+            void *frame = pmm_alloc_zeroed_frame();
+            if ( frame == NULL ) {
+                break;
+            }
+            region->fill(region->source, page, hhdm_get_variable((uintptr_t) frame));
+            size_t flags = VMM_FLAGS_PRESENT | VMM_FLAGS_USER_LEVEL | ((region->flags & VMM_REGION_WRITE) ? VMM_FLAGS_WRITE_ENABLE : 0);
+            map_phys_to_virt_addr_hh(frame, (void *) page, flags, root_table);
+            table->stats.private_fills++;
+            return true;
+        }
+        case VMM_FAULT_COPY_ON_WRITE: {
+            uint64_t phys = region->file_phys + (page - region->start);
+            void *frame = pmm_alloc_frame();
+            if ( frame == NULL ) {
+                break;
+            }
+            // Not page_copy: the task resumes right away on this page, non-temporal stores would evict it from the cache
+            memcpy(hhdm_get_variable((uintptr_t) frame), hhdm_get_variable(phys), PAGE_SIZE_IN_BYTES);
+            unmap_vaddress_hh((void *) page, root_table);
+            map_phys_to_virt_addr_hh(frame, (void *) page, VMM_FLAGS_PRESENT | VMM_FLAGS_USER_LEVEL | VMM_FLAGS_WRITE_ENABLE, root_table);
+            vmm_frame_unref(phys);
+            table->stats.cow_copies++;
+            return true;
+        }
+        default:
+            break;
+    }
+    table->stats.invalid++;
+    pretty_logf(Error, "Unhandled page fault in task %s: address: 0x%x - error code: 0x%x", task->task_name, address, error_code);
+    return false;
+}
+#endif
@@ -0,0 +1,199 @@
+#include <profiler.h>
+#include <kernel.h>
+#include <kstack.h>
+#include <ksyms.h>
+#include <lapic.h>
+#include <logging.h>
+#include <numbers.h>
+#include <qemu.h>
+#include <scheduler.h>
+#include <stacktrace.h>
+
+extern char _kernel_rodata_start;
+
+profiler_buffer_t profiler_buffers[PROFILER_MAX_CPUS];
+bool profiler_active = false;
+
+/**
+ * Initialize the sample buffers, and start sampling if PROFILER_AUTOSTART is set.
+ * It must be called after the lapic initialization.
+ */
+void init_profiler() {
+    for (size_t i = 0; i < PROFILER_MAX_CPUS; i++) {
+        profiler_buffers[i].count = 0;
+        profiler_buffers[i].dropped = 0;
+    }
+    profiler_active = PROFILER_AUTOSTART == 1;
+    pretty_logf(Info, "Profiler initialized: buffer size: %d samples - stack depth: %d - symbols: %d - active: %d", PROFILER_BUFFER_SIZE, PROFILER_STACK_DEPTH, kernel_symbols.count, profiler_active);
+}
+
+void profiler_start() {
+    profiler_active = true;
+}
+
+/**
+ * Stop sampling, and write out the samples still in the buffers.
+ */
+void profiler_stop() {
+    profiler_active = false;
+    profiler_flush(true);
+}
+
+static bool profiler_is_kernel_address(uint64_t address) {
+    return address >= 0xFFFF800000000000 && (address & (sizeof(uint64_t) - 1)) == 0;
+}
+
+/**
+ * Find the kernel stack of a thread containing an address: its rsp0 stack, or its own stack for a supervisor thread.
+ *
+ * @param thread the interrupted thread
+ * @param address the address to look for (i.e. the interrupted rsp)
+ * @return the top of the stack, 0 if the address is not in the thread kernel stacks (i.e. during the boot)
+ */
+static uint64_t profiler_kernel_stack_top(thread_t *thread, uint64_t address) {
+    if ( thread == NULL ) {
+        return 0;
+    }
+    uint64_t tops[] = { (uint64_t) thread->rsp0, (uint64_t) thread->stack };
+    for (size_t i = 0; i < sizeof(tops) / sizeof(uint64_t); i++) {
+        if ( tops[i] >= 0xFFFF800000000000 && address >= tops[i] - KSTACK_MAPPED_SIZE && address < tops[i] ) {
+            return tops[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Take a sample of the interrupted code, it's called by the apic timer handler.
+ * Kernel samples contain the frame pointer chain of the interrupted code, user samples only the rip.
+ *
+ * @param status the cpu status saved when the interrupt was raised
+ */
+void profiler_sample(cpu_status_t *status) {
+    if ( !profiler_active ) {
+        return;
+    }
+    profiler_buffer_t *buffer = &profiler_buffers[lapic_id() % PROFILER_MAX_CPUS];
+    size_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+    if ( count == PROFILER_BUFFER_SIZE ) {
+        buffer->dropped++;
+        return;
+    }
+    profiler_sample_t *sample = &buffer->samples[count];
+    sample->tid = current_executing_thread != NULL ? current_executing_thread->tid : 0;
+    sample->flags = 0;
+    sample->stack[0] = status->rip;
+    sample->depth = 1;
+    if ( (status->cs & 0x3) != 0 ) {
+        sample->flags |= PROFILER_SAMPLE_USER;
+    } else {
+        // The frames must go up the stack, and stay in the thread kernel stack: a corrupted rbp would make us fault here
+        uint64_t stack_top = profiler_kernel_stack_top(current_executing_thread, status->rsp);
+        StackFrame *frame = (StackFrame *) status->rbp;
+        while ( sample->depth < PROFILER_STACK_DEPTH && profiler_is_kernel_address((uint64_t) frame) && (uint64_t) frame >= status->rsp && (uint64_t) frame + sizeof(StackFrame) <= stack_top ) {
+            if ( frame->rip == 0 ) {
+                break;
+            }
+            sample->stack[sample->depth++] = frame->rip;
+            if ( (uint64_t) frame->next <= (uint64_t) frame ) {
+                break;
+            }
+            frame = frame->next;
+        }
+    }
+    __atomic_store_n(&buffer->count, count + 1, __ATOMIC_RELEASE);
+}
+
+static char *profiler_append_string(char *position, char *end, const char *string, size_t length) {
+    while ( length > 0 && *string != '\0' && position < end ) {
+        *position++ = *string++;
+        length--;
+    }
+    return position;
+}
+
+static char *profiler_append_frame(char *position, char *end, uint64_t address, bool user) {
+    char number[24];
+    const ksym_t *symbol = NULL;
+    if ( !user && address < (uint64_t) &_kernel_rodata_start ) {
+        symbol = ksyms_lookup(&kernel_symbols, address);
+    }
+    if ( symbol != NULL ) {
+        return profiler_append_string(position, end, symbol->name, symbol->name_length);
+    }
+    if ( user ) {
+        position = profiler_append_string(position, end, "[user];", 7);
+    }
+    position = profiler_append_string(position, end, "0x", 2);
+    int length = _getHexString(number, address, false);
+    return profiler_append_string(position, end, number, length);
+}
+
+static void profiler_write_sample(profiler_sample_t *sample) {
+    char line[PROFILER_LINE_LEN];
+    char number[24];
+    // Leave room for the count and the line terminator
+    char *end = line + PROFILER_LINE_LEN - 8;
+    char *position = profiler_append_string(line, end, "tid_", 4);
+    int length = _getUnsignedDecString(number, sample->tid);
+    position = profiler_append_string(position, end, number, length);
+    // Folded stacks start from the outermost frame
+    for (size_t i = sample->depth; i > 0; i--) {
+        position = profiler_append_string(position, end, ";", 1);
+        position = profiler_append_frame(position, end, sample->stack[i - 1], (sample->flags & PROFILER_SAMPLE_USER) != 0);
+    }
+    position = profiler_append_string(position, line + PROFILER_LINE_LEN - 1, " 1\r\n", 4);
+    *position = '\0';
+    qemu_write_string(line);
+}
+
+static void profiler_write_marker(const char *marker, size_t cpu, size_t samples, uint64_t dropped) {
+    char line[96];
+    char *end = line + sizeof(line) - 3;
+    char *position = profiler_append_string(line, end, marker, sizeof(line));
+    uint64_t values[3] = { cpu, samples, dropped };
+    for (size_t i = 0; i < 3; i++) {
+        char number[24];
+        *position++ = ' ';
+        int length = _getUnsignedDecString(number, values[i]);
+        position = profiler_append_string(position, end, number, length);
+    }
+    *position++ = '\r';
+    *position++ = '\n';
+    *position = '\0';
+    qemu_write_string(line);
+}
+
+/**
+ * Write the full sample buffers on the serial port as folded stacks (the input format of flamegraph.pl), one line per sample:
+ *
+ *      PROFILE_BEGIN <cpu> <samples> <dropped>
+ *      tid_<tid>;<outer function>;...;<sampled function> 1
+ *      PROFILE_END <cpu> <samples> <dropped>
+ *
+ * The addresses are resolved with the symbols of kernel.map, if it was not loaded they are written in hex.
+ * It's called by the idle thread, so the output doesn't disturb the sampled code too much.
+ *
+ * @param partial if true the buffers are written even if they are not full (only when the profiler is stopped)
+ * @return the number of samples written
+ */
+size_t profiler_flush(bool partial) {
+    size_t written = 0;
+    for (size_t cpu = 0; cpu < PROFILER_MAX_CPUS; cpu++) {
+        profiler_buffer_t *buffer = &profiler_buffers[cpu];
+        size_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+        if ( count == 0 || (count < PROFILER_BUFFER_SIZE && !(partial && !profiler_active)) ) {
+            continue;
+        }
+        profiler_write_marker("PROFILE_BEGIN", cpu, count, buffer->dropped);
+        for (size_t i = 0; i < count; i++) {
+            profiler_write_sample(&buffer->samples[i]);
+        }
+        profiler_write_marker("PROFILE_END", cpu, count, buffer->dropped);
+        written += count;
+        buffer->dropped = 0;
+        // From now on the timer interrupt can fill the buffer again
+        __atomic_store_n(&buffer->count, 0, __ATOMIC_RELEASE);
+    }
+    return written;
+}
@@ -0,0 +1,103 @@
+#include <id_table.h>
+#include <kheap.h>
+#include <logging.h>
+
+void id_table_init(id_table_t *table) {
+    for (size_t i = 0; i < ID_TABLE_LEAVES; i++) {
+        table->leaves[i] = NULL;
+    }
+    table->free_head = ID_TABLE_NO_INDEX;
+    table->next_index = 0;
+    table->count = 0;
+}
+
+static id_table_entry_t *id_table_entry(id_table_t *table, uint32_t index) {
+    id_table_entry_t *leaf = table->leaves[index >> ID_TABLE_LEAF_BITS];
+    if ( leaf == NULL ) {
+        return NULL;
+    }
+    return &leaf[index & (ID_TABLE_LEAF_SIZE - 1)];
+}
+
+/**
+ * Allocate a new id for an object
+ *
+ * @param table the id table
+ * @param object the object, it can't be NULL
+ * @return the new id, or ID_TABLE_INVALID_ID if the table is full or there is no memory for a new leaf
+ */
+uint32_t id_table_alloc(id_table_t *table, void *object) {
+    if ( object == NULL ) {
+        return ID_TABLE_INVALID_ID;
+    }
+    uint32_t index;
+    id_table_entry_t *entry;
+    if ( table->free_head != ID_TABLE_NO_INDEX ) {
+        index = table->free_head;
+        entry = id_table_entry(table, index);
+        table->free_head = entry->next_free;
+    } else {
+        if ( table->next_index == ID_TABLE_MAX_OBJECTS ) {
+            pretty_logf(Error, "Id table full, the maximum number of objects is: %d", ID_TABLE_MAX_OBJECTS);
+            return ID_TABLE_INVALID_ID;
+        }
+        index = table->next_index;
+        size_t leaf_index = index >> ID_TABLE_LEAF_BITS;
+        if ( table->leaves[leaf_index] == NULL ) {
+            id_table_entry_t *leaf = kmalloc(ID_TABLE_LEAF_SIZE * sizeof(id_table_entry_t));
+            if ( leaf == NULL ) {
+                return ID_TABLE_INVALID_ID;
+            }
+            for (size_t i = 0; i < ID_TABLE_LEAF_SIZE; i++) {
+                leaf[i].object = NULL;
+                leaf[i].next_free = ID_TABLE_NO_INDEX;
+                leaf[i].generation = 0;
+            }
+            table->leaves[leaf_index] = leaf;
+        }
+        table->next_index++;
+        entry = id_table_entry(table, index);
+    }
+    entry->object = object;
+    table->count++;
+    return ((uint32_t) entry->generation << ID_TABLE_INDEX_BITS) | index;
+}
+
+/**
+ * Find the object of an id
+ *
+ * @param table the id table
+ * @param id the id to search
+ * @return the object, or NULL if the id is not allocated (or it has been released)
+ */
+void *id_table_lookup(id_table_t *table, uint32_t id) {
+    if ( id == ID_TABLE_INVALID_ID ) {
+        return NULL;
+    }
+    id_table_entry_t *entry = id_table_entry(table, id & ID_TABLE_INDEX_MASK);
+    if ( entry == NULL || entry->generation != (id >> ID_TABLE_INDEX_BITS) ) {
+        return NULL;
+    }
+    return entry->object;
+}
+
+/**
+ * Release an id, its slot goes at the head of the free list
+ *
+ * @param table the id table
+ * @param id the id to release
+ * @return true if the id was allocated
+ */
+bool id_table_release(id_table_t *table, uint32_t id) {
+    if ( id_table_lookup(table, id) == NULL ) {
+        return false;
+    }
+    uint32_t index = id & ID_TABLE_INDEX_MASK;
+    id_table_entry_t *entry = id_table_entry(table, index);
+    entry->object = NULL;
+    entry->generation = (entry->generation + 1) & ID_TABLE_GENERATION_MASK;
+    entry->next_free = table->free_head;
+    table->free_head = index;
+    table->count--;
+    return true;
+}
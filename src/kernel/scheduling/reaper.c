@@ -0,0 +1,86 @@
+#include <reaper.h>
+#include <logging.h>
+#include <rcu.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <string.h>
+#include <task.h>
+
+reaper_stats_t reaper_stats;
+
+/**
+ * The dead threads waiting to be freed, linked with their reaper_next field: next is left alone, since an rcu reader
+ * walking the scheduler list can still follow it.
+ * It's a lock-free stack: the scheduler pushes from the timer interrupt, and the reaper takes the whole list at once,
+ * so a node is never popped while another one is pushed over it.
+ */
+static thread_t *reaper_list;
+
+void init_reaper() {
+    __atomic_store_n(&reaper_list, NULL, __ATOMIC_RELEASE);
+    memset(&reaper_stats, 0, sizeof(reaper_stats_t));
+}
+
+static void reaper_run(void *arg) {
+    (void) arg;
+    while ( true ) {
+        reaper_collect();
+        // The threads and tasks freed above, and anything else queued with call_rcu, are released after a grace period
+        rcu_process_callbacks();
+        thread_sleep(REAPER_SLEEP_MS);
+    }
+}
+
+/**
+ * Start the reaper thread, in a supervisor task of its own.
+ */
+void reaper_start() {
+    create_task("reaper", reaper_run, NULL, true);
+}
+
+/**
+ * Queue a dead thread to be freed by the reaper. It's O(1) and doesn't allocate or free anything, so it can be called
+ * from the timer interrupt. The thread must be already removed from the scheduler list.
+ *
+ * @param thread the dead thread
+ */
+void reaper_push(thread_t *thread) {
+    thread_t *head = __atomic_load_n(&reaper_list, __ATOMIC_RELAXED);
+    do {
+        thread->reaper_next = head;
+    } while ( !__atomic_compare_exchange_n(&reaper_list, &head, thread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED) );
+    __atomic_add_fetch(&reaper_stats.queued, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Free all the queued dead threads, and the tasks that lost their last thread.
+ * It runs with the interrupts enabled, only the update of the task threads list is done with them disabled.
+ *
+ * @return the number of threads freed
+ */
+size_t reaper_collect() {
+    thread_t *thread = __atomic_exchange_n(&reaper_list, NULL, __ATOMIC_ACQUIRE);
+    size_t reaped = 0;
+    while ( thread != NULL ) {
+        thread_t *next = thread->reaper_next;
+        task_t *task = thread->parent_task;
+        uint64_t flags = lock_irq_save();
+        remove_thread_from_task(thread->tid, task);
+        bool last_thread = task->threads == NULL;
+        lock_irq_restore(flags);
+        thread_free(thread);
+        if ( last_thread ) {
+            // Nothing of the task is running anymore, so its address space is not in use
+            task_destroy(task);
+            reaper_stats.tasks_destroyed++;
+        }
+        reaped++;
+        thread = next;
+    }
+    if ( reaped > 0 ) {
+        reaper_stats.reaped += reaped;
+        reaper_stats.batches++;
+        pretty_logf(Verbose, "Reaper: %d threads freed - total: %d", reaped, reaper_stats.reaped);
+    }
+    return reaped;
+}
@@ -1,18 +1,23 @@
 
+#include <fpu.h>
 #include <framebuffer.h>
+#include <idt.h>
 #include <scheduler.h>
 #include <string.h>
 #include <kernel.h>
 #include <kheap.h>
 #include <logging.h>
+#include <pmu.h>
+#include <rcu.h>
+#include <reaper.h>
+#include <seqlock.h>
 #include <stdio.h>
 #include <task.h>
+#include <trace.h>
 #include <tss.h>
 #include <vm.h>
 
 uint16_t scheduler_ticks;
-size_t next_thread_id;
-size_t next_task_id;
 
 thread_t* thread_list;
 thread_t* current_executing_thread;
@@ -21,15 +26,44 @@ task_t* root_task;
 
 size_t thread_list_size;
 
+scheduler_stats_t scheduler_stats;
+seqlock_t scheduler_stats_lock;
+
 void init_scheduler() {
     scheduler_ticks = 0;
-    next_task_id = 0;
-    next_thread_id = 0;
+    id_table_init(&task_ids);
+    id_table_init(&thread_ids);
     current_executing_thread = NULL;
     thread_list = NULL;
     idle_thread = NULL;
     root_task = NULL;
     thread_list_size = 0;
+    init_rcu(1);
+    memset(&scheduler_stats, 0, sizeof(scheduler_stats_t));
+    seqlock_init(&scheduler_stats_lock);
+    init_reaper();
+}
+
+// Only the head of the list has no previous item
+static bool scheduler_thread_linked(thread_t *thread) {
+    return thread->prev != NULL || thread_list == thread;
+}
+
+/**
+ * Remove a thread from the scheduler list in O(1), the list is doubly linked.
+ * The readers only go forward: the thread keeps its next, so a reader standing on it can continue the walk.
+ */
+static void scheduler_unlink_thread(thread_t *thread) {
+    if (thread->prev != NULL) {
+        rcu_assign_pointer(thread->prev->next, thread->next);
+    } else {
+        rcu_assign_pointer(thread_list, thread->next);
+    }
+    if (thread->next != NULL) {
+        thread->next->prev = thread->prev;
+    }
+    thread->prev = NULL;
+    thread_list_size--;
 }
 
 cpu_status_t* schedule(cpu_status_t* cur_status) {
@@ -40,12 +74,14 @@ cpu_status_t* schedule(cpu_status_t* cur_status) {
     thread_t* current_thread = current_executing_thread;
     thread_t* prev_executing_thread;
     thread_t* thread_to_execute = idle_thread;
-    uint16_t prev_thread_tid = -1;
+    uint32_t prev_thread_tid = ID_TABLE_INVALID_ID;
+    uint64_t wakeups = 0;
+    uint64_t dead_threads = 0;
     //pretty_logf(Verbose, "Cur thread: %u %s", current_thread->tid, current_thread->thread_name);
     //pretty_logf(Verbose, "---Cur stack: 0x%x", cur_status->rsp);
     // First let's check if the current task need to be scheduled or not;
-    if (current_executing_thread->status == SLEEP) {
-        // If the task has been placed to sleep it needs to be scheduled
+    if (current_executing_thread->status == SLEEP || current_executing_thread->status == WAIT || current_executing_thread->status == DEAD) {
+        // If the task has been placed to sleep (or is blocked on a wait queue, or is dead) it needs to be scheduled
         //loglinef(Verbose, "Current thread %d status is sleeping!" ,current_executing_thread->tid);
         current_executing_thread->ticks = SCHEDULER_NUMBER_OF_TICKS;
     }
@@ -54,17 +90,30 @@ cpu_status_t* schedule(cpu_status_t* cur_status) {
         return cur_status;
     }
 
+    // A read side section can't cross a context switch, the time slice is already over so the switch is done at the next tick.
+    // A dead thread must never run again instead: the sections it left open can't be closed by anybody else
+    if (current_executing_thread->status == DEAD) {
+        size_t open_sections = rcu_read_abandon(RCU_BOOT_CPU);
+        if (open_sections > 0) {
+            pretty_logf(Error, "Thread %d (%s) died in %d rcu read sections", current_executing_thread->tid, current_executing_thread->thread_name, open_sections);
+        }
+    } else if (rcu_read_locked(RCU_BOOT_CPU)) {
+        return cur_status;
+    }
+
     // We don't want to change the execution frame of a newly creted task
     if (current_executing_thread->status != NEW) {
         current_executing_thread->execution_frame = cur_status;
     }
 
-    if (current_executing_thread->status != SLEEP && current_executing_thread->status != DEAD) {
+    if (current_executing_thread->status != SLEEP && current_executing_thread->status != WAIT && current_executing_thread->status != DEAD) {
         current_executing_thread->status = READY;
     }
 
     prev_executing_thread = current_executing_thread;
     prev_thread_tid = prev_executing_thread->tid;
+    // Done before looking for the next thread, since a dead thread is deleted in the loop below
+    pmu_account_thread(prev_executing_thread);
     current_thread = scheduler_get_next_thread();
 
     while (current_thread->tid != prev_thread_tid) {
@@ -74,25 +123,50 @@ cpu_status_t* schedule(cpu_status_t* cur_status) {
             if ( get_kernel_uptime() > current_thread->wakeup_time) {
                 //pretty_logf(Verbose, "--->WAKING UP: %d - thread_name: %s", current_thread->tid, current_thread->thread_name);
                 current_thread->status = READY;
+                TRACE(TRACE_THREAD_STATE, current_thread->tid, READY);
+                wakeups++;
                 thread_to_execute = current_thread;
                 break;
             }
         }
 
         if (current_thread->status == DEAD) {
-            remove_thread_from_task(current_thread->tid, current_thread->parent_task);
-            scheduler_delete_thread(current_thread->tid);
+            // Nothing is freed in the interrupt: the thread is queued, and the reaper thread will release it with its task.
+            // A removed thread can be found again through the next of another removed thread, it's skipped
+            thread_t *next_thread = current_thread->next;
+            if (scheduler_thread_linked(current_thread)) {
+                scheduler_unlink_thread(current_thread);
+                reaper_push(current_thread);
+                dead_threads++;
+            }
+            current_thread = next_thread != NULL ? next_thread : thread_list;
+            continue;
         } else if (current_thread->status == READY || current_thread->status == NEW) {
             thread_to_execute = current_thread;
             break;
         }
-        prev_thread_tid = current_thread->tid;
-        current_thread = scheduler_get_next_thread();
+        // A blocked or still sleeping thread is skipped without giving it a time slice, the walk stops back at the previous thread
+        current_thread = current_thread->next != NULL ? current_thread->next : thread_list;
     }
 
     pretty_logf(Verbose, "Current thread %d status: %d name: %s!", current_thread->status, current_thread->tid, current_thread->thread_name);
 
+    uint64_t flags = seqlock_write_acquire_irqsave(&scheduler_stats_lock);
+    if (thread_to_execute != prev_executing_thread) {
+        scheduler_stats.context_switches++;
+        if (thread_to_execute == idle_thread) {
+            scheduler_stats.idle_switches++;
+        }
+    }
+    scheduler_stats.wakeups += wakeups;
+    scheduler_stats.dead_threads += dead_threads;
+    scheduler_stats.threads = thread_list_size;
+    seqlock_write_release_irqrestore(&scheduler_stats_lock, flags);
+    // No read side section is running on this cpu, see the check above
+    rcu_quiescent_state(RCU_BOOT_CPU);
+
     // We have found a thread to run, let's update it's status
+    TRACE(TRACE_CONTEXT_SWITCH, prev_executing_thread->tid, thread_to_execute->tid);
     thread_to_execute->status = RUN;
     thread_to_execute->ticks = 0;
     // ... and update the current executing thread
@@ -104,6 +178,8 @@ cpu_status_t* schedule(cpu_status_t* cur_status) {
     pretty_logf(Verbose, "current_thread->execution_frame->rip: 0x%x, vmm_data is: 0x%x", current_executing_thread->execution_frame->rip, &(current_task->vmm_data));
     // ... and finally we need to update the tss structure with the current thread rsp0
     kernel_tss.rsp0 = (uint64_t) current_executing_thread->rsp0;
+    // ... the extended registers are not switched here, TS is set so they will be loaded on first use
+    fpu_switch_thread(current_executing_thread);
     //pretty_log(Verbose, "leaving schedule...");
     pretty_logf(Verbose, "next task to run: %d->(%s)", current_executing_thread->tid, current_executing_thread->thread_name);
     return current_executing_thread->execution_frame;
@@ -114,13 +190,34 @@ void scheduler_add_task(task_t* task) {
         pretty_logf(Verbose, "(scheduler_add_task) First task being added: %s", task->task_name);
     }
     task->next = root_task;
-    root_task = task;
+    rcu_assign_pointer(root_task, task);
+}
+
+/**
+ * Remove a task from the tasks list, its threads must be already deleted.
+ * The task keeps its next, and it must be freed after a grace period (see call_rcu).
+ *
+ * @param task the task to remove
+ */
+void scheduler_remove_task(task_t* task) {
+    task_t **link = &root_task;
+    while (*link != NULL) {
+        if (*link == task) {
+            rcu_assign_pointer(*link, task->next);
+            return;
+        }
+        link = &(*link)->next;
+    }
 }
 
 void scheduler_add_thread(thread_t* thread) {
+    thread->prev = NULL;
     thread->next = thread_list;
+    if (thread_list != NULL) {
+        thread_list->prev = thread;
+    }
     thread_list_size++;
-    thread_list = thread;
+    rcu_assign_pointer(thread_list, thread);
     pretty_logf(Verbose, "(scheduler_add_thread) Adding thread: %s - %d", thread_list->thread_name, thread_list->tid);
     if (current_executing_thread == NULL) {
         //This means that there are no tasks on the queue yet.
@@ -128,37 +225,22 @@ void scheduler_add_thread(thread_t* thread) {
     }
 }
 
-void scheduler_delete_thread(size_t thread_id) {
-    pretty_logf(Verbose, "(scheduler_delete_thread) Called with thread id: %d", thread_id);
-    thread_t *thread_item = thread_list;
-    thread_t *prev_item = NULL;
-
-    // First thing: we should search for the thread to be deleted.
-    while (thread_item != NULL && thread_item->tid != thread_id ) {
-        prev_item = thread_item;
-        thread_item = thread_item->next;
+/**
+ * Remove a thread from the scheduler list, without freeing it. It must be called with the interrupts disabled.
+ * The dead threads already queued for the reaper are not in the list, and are left to it.
+ *
+ * @param thread the thread to remove, it can't be the current one
+ * @return true if the thread was removed, false if it was not in the list
+ */
+bool scheduler_remove_thread(thread_t *thread) {
+    if (!scheduler_thread_linked(thread)) {
+        return false;
     }
-
-    if (thread_item == NULL) {
-        return;
-    }
-
-    kfree(thread_item->execution_frame);
-    kfree((void*)(thread_item->stack - THREAD_DEFAULT_STACK_SIZE));
-    if (thread_item == thread_list) {
-        // If thread_item == thread_list it means that it is the first item so we just need
-        // to make the root of the stack to point to the next item
-        thread_list = thread_list->next;
-        thread_list_size--;
-    } else {
-        // Otherwise we only need to make the previous thread
-        // to point to thread pointe by the one we are deleting
-        prev_item->next = thread_item->next;
-        thread_list_size--;
-    }
-    kfree(thread_item);
+    scheduler_unlink_thread(thread);
+    return true;
 }
 
+
 thread_t* scheduler_get_next_thread() {
     if (thread_list_size == 0 || thread_list == NULL) {
         return NULL;
@@ -174,17 +256,33 @@ thread_t* scheduler_get_next_thread() {
 }
 
 size_t scheduler_get_queue_size() {
-    thread_t *thread = thread_list;
     uint32_t counter = 0;
+    rcu_read_lock();
+    thread_t *thread = rcu_dereference(thread_list);
     while (thread != NULL) {
         counter++;
-        thread = thread->next;
+        thread = rcu_dereference(thread->next);
     }
+    rcu_read_unlock();
     return counter;
 }
 
 void scheduler_yield() {
-    pretty_log(Verbose, "Interrupting current_thread");
-    asm("int $0x20");
+    // The time slice is over, so schedule will pick the next thread even if the current one is still ready
+    current_executing_thread->ticks = SCHEDULER_NUMBER_OF_TICKS;
+    // Not the timer vector: a yield must not advance the clock, take a profiler sample or send an EOI
+    asm("int %0" :: "i" (SCHEDULER_YIELD_INTERRUPT));
 }
 
+/**
+ * Copy the scheduler counters, the copy is consistent even if a schedule runs meanwhile (on this or another cpu).
+ *
+ * @param stats where to copy the counters
+ */
+void scheduler_get_stats(scheduler_stats_t *stats) {
+    uint32_t sequence;
+    do {
+        sequence = seqcount_read_begin(&scheduler_stats_lock.count);
+        *stats = scheduler_stats;
+    } while ( seqcount_read_retry(&scheduler_stats_lock.count, sequence) );
+}
@@ -9,6 +9,10 @@
 #include <vmm.h>
 #include <vmm_mapping.h>
 #include <pmm.h>
+#include <spinlock.h>
+#include <vdso.h>
+
+id_table_t task_ids;
 
 extern uint64_t p4_table[];
 extern uint64_t p3_table[];
@@ -17,16 +21,10 @@ extern uint64_t p3_table_hh[];
 task_t* create_task(char *name, void (*_entry_point)(void *), void *args, bool is_supervisor) {
     //disable interrupts while creating a task
     asm("cli");
-    task_t* new_task = (task_t*) kmalloc(sizeof(task_t));
-    strcpy(new_task->task_name, name);
-    new_task->parent = NULL;
-    new_task->task_id = next_task_id++;
-    pretty_logf(Verbose, "Task created with name: %s - Task id: %d", new_task->task_name, new_task->task_id);
-    prepare_virtual_memory_environment(new_task);
-    if ( is_supervisor ){
-        vmm_init(VMM_LEVEL_SUPERVISOR, &(new_task->vmm_data));
-    } else {
-        vmm_init(VMM_LEVEL_USER, &(new_task->vmm_data));
+    task_t* new_task = prepare_task(name, is_supervisor);
+    if ( new_task == NULL ) {
+        asm("sti");
+        return NULL;
     }
     if( is_supervisor) {
         pretty_logf(Verbose, "creating new supervisor thread: %s", name);
@@ -43,6 +41,37 @@ task_t* create_task(char *name, void (*_entry_point)(void *), void *args, bool i
     return new_task;
 }
 
+/**
+ * Allocate a task with its address space, but without threads and without adding it to the scheduler.
+ * It is used when the address space must be filled before the first thread is created (i.e. by the elf loader).
+ *
+ * @param name the task name
+ * @param is_supervisor true for kernel tasks
+ * @return the new task
+ */
+task_t* prepare_task(char *name, bool is_supervisor) {
+    task_t* new_task = (task_t*) kmalloc(sizeof(task_t));
+    strcpy(new_task->task_name, name);
+    new_task->parent = NULL;
+    new_task->threads = NULL;
+    // The callers run with the interrupts disabled, so the id table updates are serialized
+    new_task->task_id = id_table_alloc(&task_ids, new_task);
+    if ( new_task->task_id == ID_TABLE_INVALID_ID ) {
+        pretty_logf(Error, "No task id available for task: %s", name);
+        kfree(new_task);
+        return NULL;
+    }
+    fd_table_init(&new_task->fd_table);
+    pretty_logf(Verbose, "Task created with name: %s - Task id: %d", new_task->task_name, new_task->task_id);
+    prepare_virtual_memory_environment(new_task);
+    if ( is_supervisor ){
+        vmm_init(VMM_LEVEL_SUPERVISOR, &(new_task->vmm_data));
+    } else {
+        vmm_init(VMM_LEVEL_USER, &(new_task->vmm_data));
+    }
+    return new_task;
+}
+
 void prepare_virtual_memory_environment(task_t* task) {
     // Steps:
     // 1. Prepare resources: allocatin an array of VM_PAGES_PER_TABLE
@@ -74,6 +103,9 @@ void prepare_virtual_memory_environment(task_t* task) {
             pretty_logf(Verbose, "\t%d: o:0x%x - c:0x%x - t:0x%x", i, p4_table[i], kernel_settings.paging.page_root_address[i], ((uint64_t*)vm_root_vaddress)[i]);
         }
     }
+
+    // 3. Every task can read the clock and cpu information from the vdso page without a syscall.
+    vdso_map(task);
 }
 
 bool add_thread_to_task_by_id( size_t task_id, thread_t* thread ) {
@@ -82,66 +114,112 @@ bool add_thread_to_task_by_id( size_t task_id, thread_t* thread ) {
         return false;
     }
     thread->parent_task = task;
-    thread->next = task->threads;
-    thread->next_sibling = thread;
-    return true;
+    return add_thread_to_task(task, thread);
 }
 
 bool remove_thread_from_task(size_t thread_id, task_t *task) {
-    // We don't freethe thread here, because is the scheduler in charge of deleting DEAD threads
-    thread_t *cur_thread = task->threads;
-    thread_t *prev_thread = cur_thread;
+    // We don't free the thread here, the DEAD threads are freed by the reaper
     pretty_logf( Verbose, "Removing thread with thread id: %d, from task: %d with name: %s", thread_id, task->task_id, task->task_name);
-    while ( cur_thread != NULL ) {
-        if ( cur_thread->tid == thread_id ) {
-            pretty_logf( Verbose, "Found thread to remove thread name: %s", cur_thread->thread_name);
-            if ( cur_thread == task->threads) {
-                pretty_logf( Verbose, "Is the first thread in the queue addr_value: 0x%x", cur_thread->next_sibling);
-                task->threads = cur_thread->next_sibling;
-                return true;;
-            } else {
-                pretty_log( Verbose, "Is in the middle, merging prev and cur->next_sibling");
-                prev_thread->next_sibling = cur_thread->next_sibling;
-            }
-        }
-        prev_thread = cur_thread;
-        cur_thread = cur_thread->next_sibling;
-        return true;
+    thread_t *thread = get_thread(thread_id);
+    if ( thread == NULL || thread->parent_task != task ) {
+        return false;
+    }
+    // The sibling list is doubly linked, only the first thread has no previous sibling
+    if ( thread->prev_sibling != NULL ) {
+        thread->prev_sibling->next_sibling = thread->next_sibling;
+    } else if ( task->threads == thread ) {
+        task->threads = thread->next_sibling;
+    } else {
+        return false;
+    }
+    if ( thread->next_sibling != NULL ) {
+        thread->next_sibling->prev_sibling = thread->prev_sibling;
     }
-    return false;
+    // next_sibling is kept, a reader can still be on the thread
+    thread->prev_sibling = NULL;
+    return true;
 }
 
 bool add_thread_to_task(task_t* task, thread_t* thread) {
     if (task == NULL || thread == NULL) {
         return false;
     }
-    thread->next = task->threads;
-    thread->next_sibling = thread;
+    // The threads of a task are linked with next_sibling and prev_sibling, next and prev are used by the scheduler list
+    thread->prev_sibling = NULL;
+    thread->next_sibling = task->threads;
+    if ( task->threads != NULL ) {
+        task->threads->prev_sibling = thread;
+    }
+    rcu_assign_pointer(task->threads, thread);
     return true;
 }
 
+static void task_free_rcu(rcu_head_t *head) {
+    kfree((task_t *) ((uintptr_t) head - offsetof(task_t, rcu)));
+}
+
+/**
+ * Release a task and all its resources: the threads still alive, the open files (closed through their drivers), all the frames
+ * of the address space (with the page tables and the vmm containers) and the root table.
+ * It can't be called on the task of the running thread, since its address space is in use.
+ * Only the threads and tasks lists are updated with the interrupts disabled, the rest of the teardown is proportional
+ * to the size of the address space and runs with them enabled.
+ *
+ * @param task the task to destroy
+ */
+void task_destroy(task_t *task) {
+    // The removed threads are collected on their reaper_next, it's unused since they are not on the reap list
+    thread_t *removed = NULL;
+    uint64_t flags = lock_irq_save();
+    while ( task->threads != NULL ) {
+        thread_t *thread = task->threads;
+        task->threads = thread->next_sibling;
+        if ( scheduler_remove_thread(thread) ) {
+            thread->reaper_next = removed;
+            removed = thread;
+        }
+    }
+    scheduler_remove_task(task);
+    // The id table updates are serialized by disabling the interrupts, like in create_task
+    id_table_release(&task_ids, task->task_id);
+    lock_irq_restore(flags);
+
+    while ( removed != NULL ) {
+        thread_t *next = removed->reaper_next;
+        thread_free(removed);
+        removed = next;
+    }
+    // The driver slots of the files left opened are limited and global, they must be given back
+    fd_table_close_all(&task->fd_table);
+    fd_table_destroy(&task->fd_table);
+    size_t freed_frames = vmm_destroy(&task->vmm_data);
+    pmm_free_frame(task->vm_root_page_table);
+    pretty_logf(Verbose, "Task %d (%s) destroyed, frames freed: %d - page faults: %d", task->task_id, task->task_name, freed_frames + 1, task->vmm_data.regions.stats.faults);
+    call_rcu(&task->rcu, task_free_rcu);
+}
+
+/**
+ * Find a task by id in O(1)
+ *
+ * @param task_id the task id
+ * @return the task, or NULL if there is no task with that id
+ */
 task_t* get_task(size_t task_id) {
-    if (task_id > next_task_id) {
+    if ( task_id > UINT32_MAX ) {
         return NULL;
     }
-    task_t* cur_task = root_task;
-    while ( cur_task != NULL ) {
-        pretty_logf(Verbose, "Searching task: %d", cur_task->task_id);
-        if ( cur_task->task_id == task_id ) {
-            return cur_task;
-        }
-        cur_task = cur_task->next;
-    }
-    return NULL;
+    return id_table_lookup(&task_ids, (uint32_t) task_id);
 }
 
 void print_thread_list(size_t task_id) {
+    rcu_read_lock();
     task_t* task = get_task(task_id);
     if (task != NULL) {
-        thread_t* thread = task->threads;
+        thread_t* thread = rcu_dereference(task->threads);
         while(thread != NULL) {
             pretty_logf(Verbose, "\tThread; %d - %s", thread->tid, thread->thread_name);
-            thread = thread->next;
+            thread = rcu_dereference(thread->next_sibling);
         }
     }
+    rcu_read_unlock();
 }
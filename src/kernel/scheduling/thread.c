@@ -2,17 +2,22 @@
 #include <scheduler.h>
 #include <stdio.h>
 #include <framebuffer.h>
+#include <fpu.h>
 #include <string.h>
 #include <kheap.h>
+#include <kstack.h>
 #include <logging.h>
 #include <kernel.h>
 #include <userspace.h>
+#include <vm.h>
 #include <vmm.h>
 #include <vmm_mapping.h>
+#include <pmm.h>
+#include <spinlock.h>
+#include <profiler.h>
+#include <trace.h>
 
-unsigned char code_to_run[] = {
-    0xeb, 0xfe
-};
+id_table_t thread_ids;
 
 thread_t* create_thread(char* thread_name, void (*_entry_point)(void *), void* arg, task_t* parent_task, bool is_supervisor) {
     // The first part is pretty trivial mostly bureaucray. Setting basic thread information like name, tid, parent...
@@ -22,14 +27,30 @@ thread_t* create_thread(char* thread_name, void (*_entry_point)(void *), void* a
     }
 
     thread_t *new_thread = kmalloc(sizeof(thread_t));
-    new_thread->tid = next_thread_id++;
+    uint64_t flags = lock_irq_save();
+    new_thread->tid = id_table_alloc(&thread_ids, new_thread);
+    lock_irq_restore(flags);
+    if ( new_thread->tid == ID_TABLE_INVALID_ID ) {
+        pretty_logf(Error, "No thread id available for thread: %s", thread_name);
+        kfree(new_thread);
+        return NULL;
+    }
     new_thread->parent_task = parent_task;
     new_thread->status = NEW;
     new_thread->wakeup_time = 0;
     strcpy(new_thread->thread_name, thread_name);
     new_thread->next = NULL;
     new_thread->next_sibling = NULL;
+    new_thread->prev_sibling = NULL;
+    new_thread->prev = NULL;
+    new_thread->wait_next = NULL;
     new_thread->ticks = 0;
+    new_thread->fpu_state = NULL;
+    new_thread->fpu_state_allocation = NULL;
+    new_thread->fpu_used = false;
+    for (size_t i = 0; i < PMU_MAX_COUNTERS; i++) {
+        new_thread->pmu_counters.values[i] = 0;
+    }
     pretty_logf(Verbose, "Creating thread with arg: %c - arg: %x - name: %s - rip: %x", (char) *((char*) arg), arg, thread_name, _entry_point);
 
     //Here we create a new execution frame to be used when switching to a newly created task
@@ -37,18 +58,22 @@ thread_t* create_thread(char* thread_name, void (*_entry_point)(void *), void* a
     new_thread->execution_frame->interrupt_number = 0x101;
     new_thread->execution_frame->error_code = 0x0;
     if (!is_supervisor) {
-        // This piece of code is temporary, just to test a userspace task, it run just an infinite loop.
         pretty_logf(Verbose, "vmm_data address: 0x%x", &(parent_task->vmm_data));
-        new_thread->execution_frame->rip = prepare_userspace_function(&(parent_task->vmm_data));
+        if ( _entry_point != NULL ) {
+            // The code is already loaded in the task address space (i.e. by the elf loader)
+            new_thread->execution_frame->rip = (uint64_t) _entry_point;
+        } else {
+            // This piece of code is temporary, just to test a userspace task, it run just an infinite loop.
+            new_thread->execution_frame->rip = prepare_userspace_function(&(parent_task->vmm_data));
+        }
         pretty_logf(Verbose, "using userspace function address: 0x%x", new_thread->execution_frame->rip);
         new_thread->execution_frame->rdi = 0;
         new_thread->execution_frame->rsi = 0;
     } else {
-        pretty_logf(Verbose, "using idle function: 0x%x", _entry_point);
-        new_thread->execution_frame->rip = (uint64_t) code_to_run;
-        //new_thread->execution_frame->rip = (uint64_t) thread_execution_wrapper;
-        //new_thread->execution_frame->rdi = (uint64_t) _entry_point;
-        //new_thread->execution_frame->rsi = (uint64_t) arg;
+        pretty_logf(Verbose, "using supervisor function: 0x%x", _entry_point);
+        new_thread->execution_frame->rip = (uint64_t) thread_execution_wrapper;
+        new_thread->execution_frame->rdi = (uint64_t) _entry_point;
+        new_thread->execution_frame->rsi = (uint64_t) arg;
     }
     // rdi and rsi are the two arguments passed to the thread_execution_wrapper function
     new_thread->execution_frame->rflags = 0x202;
@@ -62,14 +87,21 @@ thread_t* create_thread(char* thread_name, void (*_entry_point)(void *), void* a
     }
 
     // Every thread need it's kernel stack allocated (aka rsp0 field of the TSS)
-    new_thread->rsp0 = kmalloc(THREAD_DEFAULT_STACK_SIZE) + THREAD_DEFAULT_STACK_SIZE;
+    new_thread->rsp0 = kstack_alloc();
     if (new_thread->rsp0 == NULL) {
           pretty_log(Fatal, "rsp0 is null - PANIC!");
           while(1);
     }
     // We need to allocate a new stack for each thread
-    //void* stack_pointer = kmalloc(THREAD_DEFAULT_STACK_SIZE);
-    void* stack_pointer = vmm_alloc(THREAD_DEFAULT_STACK_SIZE, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE | VMM_FLAGS_STACK, &(parent_task->vmm_data));
+    void* stack_pointer = NULL;
+    if ( is_supervisor ) {
+        // The kernel half of the address space is shared by all the tasks, so the supervisor stacks come from the kernel stacks pool
+        stack_pointer = kstack_alloc();
+    } else {
+        // The page reserved below the stack is never mapped, it's the guard page
+        vmm_alloc(PAGE_SIZE_IN_BYTES, VMM_FLAGS_ADDRESS_ONLY, &(parent_task->vmm_data));
+        stack_pointer = vmm_alloc(THREAD_DEFAULT_STACK_SIZE, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE | VMM_FLAGS_STACK, &(parent_task->vmm_data));
+    }
     if (stack_pointer == NULL) {
         pretty_log(Fatal, "rsp is null - PANIC!");
         while(1);
@@ -90,21 +122,70 @@ thread_t* create_thread(char* thread_name, void (*_entry_point)(void *), void* a
     return new_thread;
 }
 
+static void thread_free_rcu(rcu_head_t *head) {
+    kfree((thread_t *) ((uintptr_t) head - offsetof(thread_t, rcu)));
+}
+
+/**
+ * Free a thread, its kernel stacks go back to the pool. The stack in the task address space is released with the task.
+ *
+ * @param thread the thread to free, it must not be in the scheduler list
+ */
+void thread_free(thread_t *thread) {
+    uint64_t flags = lock_irq_save();
+    id_table_release(&thread_ids, thread->tid);
+    lock_irq_restore(flags);
+    fpu_release_thread(thread);
+    kfree(thread->execution_frame);
+    kstack_free(thread->rsp0);
+    if (is_address_higher_half(thread->stack)) {
+        // Supervisor threads stacks come from the kernel stacks pool
+        kstack_free((void*) thread->stack);
+    }
+    // A reader walking the scheduler list or the task threads can still be on the thread
+    call_rcu(&thread->rcu, thread_free_rcu);
+}
+
+/**
+ * Find a thread by id in O(1)
+ *
+ * @param tid the thread id
+ * @return the thread, or NULL if there is no thread with that id
+ */
+thread_t* get_thread(uint32_t tid) {
+    return id_table_lookup(&thread_ids, tid);
+}
+
 void thread_sleep(size_t millis) {
     current_executing_thread->status = SLEEP;
+    TRACE(TRACE_THREAD_STATE, current_executing_thread->tid, SLEEP);
     uint64_t kernel_uptime = get_kernel_uptime();
     current_executing_thread->wakeup_time = kernel_uptime + millis; // To change with millis since boot + millis
     pretty_logf(Verbose, "(thread_sleep) Kernel uptime is: %u - wakeup time is: %u", kernel_uptime, current_executing_thread->wakeup_time);
     scheduler_yield();
 }
 
+/**
+ * Make a sleeping or blocked thread ready, it runs again the next time the scheduler finds it.
+ * A blocked thread must be woken through its wait queue (see wait_queue.h), that removes it from the queue first.
+ *
+ * @param thread the thread to wake, nothing is done if it's not in the SLEEP or WAIT state
+ */
 void thread_wakeup(thread_t* thread) {
-(void)thread;
+    if (thread->status != SLEEP && thread->status != WAIT) {
+        return;
+    }
+    thread->wakeup_time = 0;
+    thread->status = READY;
+    TRACE(TRACE_THREAD_STATE, thread->tid, READY);
 }
 
 void thread_suicide_trap() {
     current_executing_thread->status = DEAD;
+    TRACE(TRACE_THREAD_STATE, current_executing_thread->tid, DEAD);
     pretty_logf(Verbose, "(thread_suicide_trap) Suicide function called on thread: %d name: %s - Status: %s", current_executing_thread->tid, current_executing_thread->thread_name, get_thread_status(current_executing_thread));
+    // No need to wait for the end of the time slice, a dead thread is never scheduled again
+    scheduler_yield();
     while(1);
 }
 
@@ -116,7 +197,15 @@ void thread_execution_wrapper( void (*_thread_function)(void *), void* arg) {
 }
 
 void idle(void *c) {
-    while(1);
+    while(1) {
+        // Write the queued log messages and the full profiler buffers, and prepare one zeroed frame at time, so the other threads are not delayed too much
+        size_t work_done = log_drain(LOG_DRAIN_BATCH);
+        work_done += pmm_refill_zeroed_pool(1);
+        work_done += profiler_flush(false);
+        if ( work_done == 0 ) {
+            asm volatile("hlt");
+        }
+    }
 }
 
 void noop(void *v) {
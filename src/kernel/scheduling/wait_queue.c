@@ -0,0 +1,93 @@
+#include <wait_queue.h>
+#include <scheduler.h>
+#include <trace.h>
+
+void wait_queue_init(wait_queue_t *queue) {
+    spinlock_init(&queue->lock);
+    queue->head = NULL;
+    queue->tail = NULL;
+}
+
+/**
+ * Block the current thread on the queue until it is woken. The caller holds the queue lock, taken with
+ * spinlock_acquire_irqsave after checking its condition, so a wakeup can't be lost between the check and the sleep.
+ * The lock is released before switching thread, the interrupts stay disabled until the thread runs again.
+ *
+ * @param queue the wait queue, locked
+ * @param flags the flags returned by spinlock_acquire_irqsave, restored when the thread is woken
+ */
+void wait_queue_sleep_locked(wait_queue_t *queue, uint64_t flags) {
+    thread_t *thread = current_executing_thread;
+    thread->wait_next = NULL;
+    if ( queue->tail != NULL ) {
+        queue->tail->wait_next = thread;
+    } else {
+        queue->head = thread;
+    }
+    queue->tail = thread;
+    thread->status = WAIT;
+    TRACE(TRACE_THREAD_STATE, thread->tid, WAIT);
+    spinlock_release(&queue->lock);
+    // With the interrupts disabled only this yield can switch thread, and the scheduler won't pick it again until it's woken
+    scheduler_yield();
+    lock_irq_restore(flags);
+}
+
+/**
+ * Wake the first thread of the queue in O(1), the caller holds the queue lock.
+ *
+ * @param queue the wait queue, locked
+ * @return the thread woken, or NULL if the queue is empty
+ */
+thread_t *wait_queue_wake_one_locked(wait_queue_t *queue) {
+    thread_t *thread = queue->head;
+    if ( thread == NULL ) {
+        return NULL;
+    }
+    queue->head = thread->wait_next;
+    if ( queue->head == NULL ) {
+        queue->tail = NULL;
+    }
+    thread->wait_next = NULL;
+    thread_wakeup(thread);
+    return thread;
+}
+
+/**
+ * Wake all the threads of the queue, the caller holds the queue lock.
+ *
+ * @param queue the wait queue, locked
+ * @return the number of threads woken
+ */
+size_t wait_queue_wake_all_locked(wait_queue_t *queue) {
+    size_t woken = 0;
+    while ( wait_queue_wake_one_locked(queue) != NULL ) {
+        woken++;
+    }
+    return woken;
+}
+
+/**
+ * Block the current thread until the next wakeup of the queue. Without a condition checked under the lock a wakeup
+ * done before the call is lost, so it's only for events that are always signaled after the wait (see wait_queue_sleep_locked).
+ *
+ * @param queue the wait queue
+ */
+void wait_queue_sleep(wait_queue_t *queue) {
+    uint64_t flags = spinlock_acquire_irqsave(&queue->lock);
+    wait_queue_sleep_locked(queue, flags);
+}
+
+thread_t *wait_queue_wake_one(wait_queue_t *queue) {
+    uint64_t flags = spinlock_acquire_irqsave(&queue->lock);
+    thread_t *thread = wait_queue_wake_one_locked(queue);
+    spinlock_release_irqrestore(&queue->lock, flags);
+    return thread;
+}
+
+size_t wait_queue_wake_all(wait_queue_t *queue) {
+    uint64_t flags = spinlock_acquire_irqsave(&queue->lock);
+    size_t woken = wait_queue_wake_all_locked(queue);
+    spinlock_release_irqrestore(&queue->lock, flags);
+    return woken;
+}
@@ -0,0 +1,133 @@
+#include <trace.h>
+#include <cpuid.h>
+#include <kernel.h>
+#include <lapic.h>
+#include <logging.h>
+#include <msr.h>
+#include <numbers.h>
+#include <qemu.h>
+#include <scheduler.h>
+
+trace_buffer_t trace_buffers[TRACE_MAX_CPUS];
+bool trace_active = false;
+// If rdtscp is available IA32_TSC_AUX contains the cpu id, so the timestamp and the cpu are read with one instruction
+bool trace_use_rdtscp = false;
+
+/**
+ * Initialize the trace buffers and start recording. It must be called after the lapic initialization.
+ */
+void init_trace() {
+    uint32_t eax, ebx, ecx, edx;
+    for (size_t i = 0; i < TRACE_MAX_CPUS; i++) {
+        trace_buffers[i].head = 0;
+    }
+    trace_use_rdtscp = false;
+    if ( __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (edx & CPUID_EXT_FEAT_EDX_RDTSCP) ) {
+        wrmsr(IA32_TSC_AUX, lapic_id());
+        trace_use_rdtscp = true;
+    }
+    trace_active = true;
+    pretty_logf(Info, "Tracing started: buffer size: %d events - rdtscp: %d", TRACE_BUFFER_SIZE, trace_use_rdtscp);
+}
+
+void trace_set_active(bool active) {
+    trace_active = active;
+}
+
+/**
+ * Add an event to the trace buffer of the current cpu, it's safe to call it from interrupt handlers.
+ * Better to use the TRACE macro, that is removed when tracing is disabled.
+ *
+ * @param event_id one of trace_event_id_t
+ * @param arg0 first event argument
+ * @param arg1 second event argument
+ */
+void trace_record(uint16_t event_id, uint64_t arg0, uint64_t arg1) {
+    uint32_t cpu_id = 0;
+    uint64_t tsc;
+    if ( trace_use_rdtscp ) {
+        tsc = rdtscp(&cpu_id);
+    } else {
+        tsc = rdtsc();
+    }
+    trace_buffer_t *buffer = &trace_buffers[cpu_id % TRACE_MAX_CPUS];
+    // An interrupt can arrive at any point, reserving the slot first means a nested event never overwrites ours
+    uint64_t index = __atomic_fetch_add(&buffer->head, 1, __ATOMIC_RELAXED);
+    trace_event_t *event = &buffer->events[index & (TRACE_BUFFER_SIZE - 1)];
+    event->tsc = tsc;
+    event->event_id = event_id;
+    event->cpu_id = cpu_id;
+    event->tid = current_executing_thread != NULL ? current_executing_thread->tid : 0xFFFFFFFF;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+}
+
+static char *trace_append_hex(char *buffer, uint64_t value) {
+    *buffer++ = ' ';
+    return buffer + _getHexString(buffer, value, false);
+}
+
+/**
+ * Write the content of the trace buffers on the serial port, the format is one line per event:
+ *
+ *      TRACE_BEGIN <version> <tsc ticks per ms> <boot tsc> <number of cpus>
+ *      T <cpu> <tsc> <event id> <tid> <arg0> <arg1>
+ *      TRACE_END <events lost>
+ *
+ * All the numbers are hexadecimal. The output can be converted for perfetto/chrome with scripts/trace_to_perfetto.py
+ */
+void trace_dump() {
+    char line[160];
+    char *position;
+    uint64_t lost_events = 0;
+    bool was_active = trace_active;
+    trace_active = false;
+
+    position = line;
+    const char *begin = "TRACE_BEGIN";
+    while ( *begin != '\0' ) {
+        *position++ = *begin++;
+    }
+    position = trace_append_hex(position, TRACE_FORMAT_VERSION);
+    position = trace_append_hex(position, kernel_settings.tsc.ticks_per_ms);
+    position = trace_append_hex(position, kernel_settings.tsc.boot_tsc);
+    position = trace_append_hex(position, TRACE_MAX_CPUS);
+    *position++ = '\r';
+    *position++ = '\n';
+    *position = '\0';
+    qemu_write_string(line);
+
+    for (size_t cpu = 0; cpu < TRACE_MAX_CPUS; cpu++) {
+        trace_buffer_t *buffer = &trace_buffers[cpu];
+        uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+        uint64_t first = head > TRACE_BUFFER_SIZE ? head - TRACE_BUFFER_SIZE : 0;
+        lost_events += first;
+        for (uint64_t i = first; i < head; i++) {
+            trace_event_t *event = &buffer->events[i & (TRACE_BUFFER_SIZE - 1)];
+            position = line;
+            *position++ = 'T';
+            position = trace_append_hex(position, cpu);
+            position = trace_append_hex(position, event->tsc);
+            position = trace_append_hex(position, event->event_id);
+            position = trace_append_hex(position, event->tid);
+            position = trace_append_hex(position, event->arg0);
+            position = trace_append_hex(position, event->arg1);
+            *position++ = '\r';
+            *position++ = '\n';
+            *position = '\0';
+            qemu_write_string(line);
+        }
+    }
+
+    position = line;
+    const char *end = "TRACE_END";
+    while ( *end != '\0' ) {
+        *position++ = *end++;
+    }
+    position = trace_append_hex(position, lost_events);
+    *position++ = '\r';
+    *position++ = '\n';
+    *position = '\0';
+    qemu_write_string(line);
+    trace_active = was_active;
+}
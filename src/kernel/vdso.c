@@ -0,0 +1,65 @@
+#include <vdso.h>
+#include <hh_direct_map.h>
+#include <kernel.h>
+#include <lapic.h>
+#include <logging.h>
+#include <pmm.h>
+#include <vmm.h>
+#include <vmm_mapping.h>
+
+vdso_data_t *vdso_data = NULL;
+void *vdso_phys_address = NULL;
+
+/**
+ * Allocate and initialize the vdso page. It must be called after the tsc calibration
+ * and before the first task is created, since every task will map it in its address space.
+ *
+ * @param epoch_base the unix timestamp read from the rtc
+ */
+void init_vdso(uint64_t epoch_base) {
+    vdso_phys_address = pmm_alloc_frame();
+    if ( vdso_phys_address == NULL ) {
+        pretty_log(Error, "Cannot allocate the vdso page");
+        return;
+    }
+    // The kernel writes to the page through the direct map, the tasks will see it only as read-only.
+    vdso_data = (vdso_data_t *) hhdm_get_variable((uintptr_t) vdso_phys_address);
+    kernel_settings.boot_epoch = epoch_base;
+    vdso_data->sequence.sequence = 0;
+    vdso_data->version = VDSO_VERSION;
+    vdso_data->reserved = 0;
+    vdso_data->epoch_base = epoch_base;
+    vdso_data->tsc_ticks_per_ms = kernel_settings.tsc.ticks_per_ms;
+    vdso_data->boot_tsc = kernel_settings.tsc.boot_tsc;
+    vdso_update_clock();
+    pretty_logf(Verbose, "vdso page phys: 0x%x - user address: 0x%x - epoch_base: %u", vdso_phys_address, VDSO_USER_ADDRESS, epoch_base);
+}
+
+/**
+ * Map the vdso page in the task address space, the page is user accessible but not writable.
+ *
+ * @param task the task that is being created
+ */
+void vdso_map(task_t *task) {
+    if ( vdso_phys_address == NULL ) {
+        return;
+    }
+    map_phys_to_virt_addr_hh(vdso_phys_address, (void *) VDSO_USER_ADDRESS, VMM_FLAGS_PRESENT | VMM_FLAGS_USER_LEVEL, (uint64_t *) task->vmm_data.root_table_hhdm);
+}
+
+/**
+ * Update the clock fields of the vdso page, it is called on every apic timer tick.
+ */
+void vdso_update_clock() {
+    if ( vdso_data == NULL ) {
+        return;
+    }
+    uint64_t uptime_ms;
+    uint64_t uptime_tsc;
+    kernel_clock_read(&uptime_ms, &uptime_tsc);
+    seqcount_write_begin(&vdso_data->sequence);
+    vdso_data->uptime_ms = uptime_ms;
+    vdso_data->tsc_at_update = uptime_tsc;
+    vdso_data->cpu_id = lapic_id();
+    seqcount_write_end(&vdso_data->sequence);
+}
@@ -0,0 +1,291 @@
+#include <memops.h>
+#include <cpuid.h>
+#ifndef _TEST_
+#include <fpu.h>
+#include <logging.h>
+#endif
+
+// The kernel is compiled without sse, so the compiler refuses xmm clobbers (and it never uses them anyway)
+#ifdef __SSE__
+#define MEMOPS_SIMD_CLOBBERS "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+#else
+#define MEMOPS_SIMD_CLOBBERS "memory"
+#endif
+
+#ifndef _TEST_
+#define MEMOPS_SIMD_BEGIN() kernel_fpu_begin()
+#define MEMOPS_SIMD_END() kernel_fpu_end()
+#else
+#define MEMOPS_SIMD_BEGIN()
+#define MEMOPS_SIMD_END()
+#endif
+
+#define MEMOPS_BLOCK_SIZE   64
+
+typedef uint64_t __attribute__((__may_alias__, aligned(1))) unaligned_qword_t;
+
+// Until memops_init is called only the plain 64bit loops are used, they don't need any cpu feature
+memops_dispatch_t memops = {
+    .memcpy_small = memcpy_qwords,
+    .memcpy_large = memcpy_qwords,
+    .memset_small = memset_qwords,
+    .memset_large = memset_qwords,
+    .has_erms = false,
+    .has_fsrm = false,
+    .has_fsrs = false,
+    .has_sse2 = false,
+    .has_avx2 = false
+};
+
+#ifndef _TEST_
+/**
+ * Select the best memcpy/memset variants for the current cpu.
+ * It must be called after init_fpu, since the simd variants need the sse/avx state enabled.
+ */
+void memops_init() {
+    uint32_t eax, ebx, ecx, edx;
+    memops.has_erms = false;
+    memops.has_fsrm = false;
+    memops.has_fsrs = false;
+    memops.has_avx2 = false;
+    if ( __get_cpuid_count(CPUID_EXT_FEATURES_LEAF, 0, &eax, &ebx, &ecx, &edx) ) {
+        uint32_t max_subleaf = eax;
+        memops.has_erms = (ebx & CPUID_EXT_FEAT_EBX_ERMS) != 0;
+        memops.has_fsrm = (edx & CPUID_EXT_FEAT_EDX_FSRM) != 0;
+        memops.has_avx2 = (ebx & CPUID_EXT_FEAT_EBX_AVX2) != 0 && fpu_info.initialized && fpu_info.has_avx;
+        if ( max_subleaf >= 1 && __get_cpuid_count(CPUID_EXT_FEATURES_LEAF, 1, &eax, &ebx, &ecx, &edx) ) {
+            memops.has_fsrs = (eax & CPUID_EXT_FEAT_1_EAX_FSRS) != 0;
+        }
+    }
+    memops.has_sse2 = fpu_info.initialized && fpu_info.has_sse2;
+
+    // Small copies: erms only makes long rep movsb/stosb fast, their startup cost on short sizes is low only with fsrm/fsrs
+    memops.memcpy_small = memops.has_fsrm ? memcpy_erms : memcpy_qwords;
+    memops.memset_small = memops.has_fsrs ? memset_erms : memset_qwords;
+
+    if ( memops.has_avx2 ) {
+        memops.memcpy_large = memcpy_avx2;
+        memops.memset_large = memset_avx2;
+    } else if ( memops.has_sse2 ) {
+        memops.memcpy_large = memcpy_sse2;
+        memops.memset_large = memset_sse2;
+    } else {
+        memops.memcpy_large = memops.has_erms ? memcpy_erms : memcpy_qwords;
+        memops.memset_large = memops.has_erms ? memset_erms : memset_qwords;
+    }
+    pretty_logf(Verbose, "Memory operations: erms: %d - fsrm: %d - fsrs: %d - sse2: %d - avx2: %d", memops.has_erms, memops.has_fsrm, memops.has_fsrs, memops.has_sse2, memops.has_avx2);
+}
+#endif
+
+void* memcpy_bytes(void *dest, const void *src, size_t count) {
+    const uint8_t *source = src;
+    uint8_t *destination = dest;
+    for (size_t i = 0; i < count; i++) {
+        destination[i] = source[i];
+    }
+    return dest;
+}
+
+void* memcpy_qwords(void *dest, const void *src, size_t count) {
+    const unaligned_qword_t *source = src;
+    unaligned_qword_t *destination = dest;
+    size_t qwords = count / sizeof(uint64_t);
+    for (size_t i = 0; i < qwords; i++) {
+        destination[i] = source[i];
+    }
+    size_t copied = qwords * sizeof(uint64_t);
+    memcpy_bytes((uint8_t *) dest + copied, (const uint8_t *) src + copied, count - copied);
+    return dest;
+}
+
+void* memcpy_erms(void *dest, const void *src, size_t count) {
+    void *destination = dest;
+    asm volatile("rep movsb"
+        : "+D" (destination), "+S" (src), "+c" (count)
+        :
+        : "memory");
+    return dest;
+}
+
+void* memcpy_sse2(void *dest, const void *src, size_t count) {
+    size_t blocks = count / MEMOPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return memcpy_qwords(dest, src, count);
+    }
+    uint8_t *destination = dest;
+    const uint8_t *source = src;
+    MEMOPS_SIMD_BEGIN();
+    asm volatile(
+        "1:\n\t"
+        "movdqu (%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movdqu %%xmm0, (%0)\n\t"
+        "movdqu %%xmm1, 16(%0)\n\t"
+        "movdqu %%xmm2, 32(%0)\n\t"
+        "movdqu %%xmm3, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "add $64, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b"
+        : "+r" (destination), "+r" (source), "+r" (blocks)
+        :
+        : MEMOPS_SIMD_CLOBBERS);
+    MEMOPS_SIMD_END();
+    memcpy_qwords(destination, source, count % MEMOPS_BLOCK_SIZE);
+    return dest;
+}
+
+void* memcpy_avx2(void *dest, const void *src, size_t count) {
+    size_t blocks = count / MEMOPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return memcpy_qwords(dest, src, count);
+    }
+    uint8_t *destination = dest;
+    const uint8_t *source = src;
+    MEMOPS_SIMD_BEGIN();
+    asm volatile(
+        "1:\n\t"
+        "vmovdqu (%1), %%ymm0\n\t"
+        "vmovdqu 32(%1), %%ymm1\n\t"
+        "vmovdqu %%ymm0, (%0)\n\t"
+        "vmovdqu %%ymm1, 32(%0)\n\t"
+        "add $64, %0\n\t"
+        "add $64, %1\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper"
+        : "+r" (destination), "+r" (source), "+r" (blocks)
+        :
+        : MEMOPS_SIMD_CLOBBERS);
+    MEMOPS_SIMD_END();
+    memcpy_qwords(destination, source, count % MEMOPS_BLOCK_SIZE);
+    return dest;
+}
+
+/**
+ * Copy starting from the end of the buffers, used by memmove when dest overlaps the end of src.
+ */
+void* memcpy_backward(void *dest, const void *src, size_t count) {
+    const uint8_t *source = src;
+    uint8_t *destination = dest;
+    while ( count >= sizeof(uint64_t) ) {
+        count -= sizeof(uint64_t);
+        *(unaligned_qword_t *) (destination + count) = *(const unaligned_qword_t *) (source + count);
+    }
+    while ( count > 0 ) {
+        count--;
+        destination[count] = source[count];
+    }
+    return dest;
+}
+
+void* memset_bytes(void *dest, int ch, size_t count) {
+    uint8_t *destination = dest;
+    for (size_t i = 0; i < count; i++) {
+        destination[i] = (uint8_t) ch;
+    }
+    return dest;
+}
+
+void* memset_qwords(void *dest, int ch, size_t count) {
+    uint64_t pattern = 0x0101010101010101ull * (uint8_t) ch;
+    unaligned_qword_t *destination = dest;
+    size_t qwords = count / sizeof(uint64_t);
+    for (size_t i = 0; i < qwords; i++) {
+        destination[i] = pattern;
+    }
+    size_t filled = qwords * sizeof(uint64_t);
+    memset_bytes((uint8_t *) dest + filled, ch, count - filled);
+    return dest;
+}
+
+void* memset_erms(void *dest, int ch, size_t count) {
+    void *destination = dest;
+    asm volatile("rep stosb"
+        : "+D" (destination), "+c" (count)
+        : "a" (ch)
+        : "memory");
+    return dest;
+}
+
+void* memset_sse2(void *dest, int ch, size_t count) {
+    size_t blocks = count / MEMOPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return memset_qwords(dest, ch, count);
+    }
+    uint64_t pattern = 0x0101010101010101ull * (uint8_t) ch;
+    uint8_t *destination = dest;
+    MEMOPS_SIMD_BEGIN();
+    asm volatile(
+        "movq %2, %%xmm0\n\t"
+        "punpcklqdq %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movdqu %%xmm0, (%0)\n\t"
+        "movdqu %%xmm0, 16(%0)\n\t"
+        "movdqu %%xmm0, 32(%0)\n\t"
+        "movdqu %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b"
+        : "+r" (destination), "+r" (blocks)
+        : "r" (pattern)
+        : MEMOPS_SIMD_CLOBBERS);
+    MEMOPS_SIMD_END();
+    memset_qwords(destination, ch, count % MEMOPS_BLOCK_SIZE);
+    return dest;
+}
+
+void* memset_avx2(void *dest, int ch, size_t count) {
+    size_t blocks = count / MEMOPS_BLOCK_SIZE;
+    if ( blocks == 0 ) {
+        return memset_qwords(dest, ch, count);
+    }
+    uint64_t pattern = 0x0101010101010101ull * (uint8_t) ch;
+    uint8_t *destination = dest;
+    MEMOPS_SIMD_BEGIN();
+    asm volatile(
+        "vmovq %2, %%xmm0\n\t"
+        "vpbroadcastq %%xmm0, %%ymm0\n\t"
+        "1:\n\t"
+        "vmovdqu %%ymm0, (%0)\n\t"
+        "vmovdqu %%ymm0, 32(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "vzeroupper"
+        : "+r" (destination), "+r" (blocks)
+        : "r" (pattern)
+        : MEMOPS_SIMD_CLOBBERS);
+    MEMOPS_SIMD_END();
+    memset_qwords(destination, ch, count % MEMOPS_BLOCK_SIZE);
+    return dest;
+}
+
+int memcmp_bytes(const void *a, const void *b, size_t limit) {
+    const unsigned char* ap = a;
+    const unsigned char* bp = b;
+
+    for (size_t i = 0; i < limit; i++) {
+        if (ap[i] < bp[i])
+            return -1;
+        if (ap[i] > bp[i])
+            return 1;
+    }
+    return 0;
+}
+
+int memcmp_qwords(const void *a, const void *b, size_t limit) {
+    const uint8_t *ap = a;
+    const uint8_t *bp = b;
+    size_t i = 0;
+    // Skip the equal words quickly, the first different word is compared byte by byte to get the sign
+    while ( i + sizeof(uint64_t) <= limit ) {
+        if ( *(const unaligned_qword_t *) (ap + i) != *(const unaligned_qword_t *) (bp + i) ) {
+            return memcmp_bytes(ap + i, bp + i, sizeof(uint64_t));
+        }
+        i += sizeof(uint64_t);
+    }
+    return memcmp_bytes(ap + i, bp + i, limit - i);
+}
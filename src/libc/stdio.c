@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdbool.h>
 #include <video.h>
 #include <vsprintf.h>
 #include <numbers.h>
@@ -29,72 +30,193 @@ static int skip_atoi(const char **s){
   return i;
 }
 
+static bool is_conversion(char conversion){
+    switch(conversion){
+        case 'd':
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        case 'c':
+        case 's':
+            return true;
+        default:
+            return false;
+    }
+}
+
+// fmt points to the character after '%', it returns the pointer to the conversion character
+static const char *parse_conversion(const char *fmt, int *precision){
+    *precision = -1;
+    if(*fmt == '.'){
+        ++fmt;
+        *precision = skip_atoi(&fmt);
+        if(*precision < 0) {
+            *precision = 0;
+        }
+    }
+    return fmt;
+}
+
+// Read the next argument with the same type used by format_value
+static uint64_t fetch_value(char conversion, va_list *args){
+    switch(conversion){
+        case 'd':
+        case 'c':
+            return (uint64_t) (int64_t) va_arg(*args, int);
+        case 'u':
+            return va_arg(*args, unsigned int);
+        case 'x':
+        case 'X':
+            return (uint64_t) va_arg(*args, long int);
+        case 'o':
+            return va_arg(*args, unsigned long);
+        case 's':
+            return (uint64_t) va_arg(*args, char*);
+        default:
+            return 0;
+    }
+}
+
+static char *format_value(char *str, char conversion, int precision, uint64_t value){
+    switch(conversion){
+        case 'd': {
+            int string_size = _getDecString(str, (int) value);
+            str+= string_size;
+            break;
+        }
+        case 'u': {
+            int string_size = _getUnsignedDecString(str, (unsigned int) value);
+            str+= string_size;
+            break;
+        }
+        case 'x': {
+            int string_size = _getHexString(str, (long int) value, false);
+            str+= string_size;
+            break;
+        }
+        case 'X': {
+            int string_size = _getHexString(str, (long int) value, true);
+            str+= string_size;
+            break;
+        }
+        case 'o': {
+            int string_size = _getNumericString(str, (unsigned long) value, 8, false);
+            str+= string_size;
+            break;
+        }
+        case 'c':
+        {
+            unsigned char character = (unsigned char) value;
+            *str++ = character;
+            break;
+        }
+        case 's': {
+            char *arg_string = (char *) value;
+            int str_len = strnlen(arg_string, precision);
+            for(int i=0; i < str_len; ++i) {
+                *str++ = *arg_string++;
+            }
+            break;
+        }
+    }
+    return str;
+}
+
 int vsprintf(char *buffer, const char *fmt, va_list args){
     char *str;
+    va_list values;
+    va_copy(values, args);
     for(str = buffer; *fmt; fmt++){
         int precision;
         if(*fmt != '%'){
             *str++ = *fmt; //fmt is increased by the for loop
             continue;
         }
-        fmt++;
-        precision = -1;
-        if(*fmt == '.'){
-            ++fmt;
-            precision = skip_atoi(&fmt);
-            if(precision < 0) {
-                precision = 0;
-            }
+        fmt = parse_conversion(fmt + 1, &precision);
+        if(*fmt == '\0') {
+            break;
         }
-        switch(*fmt){
-            case 'd': {
-                int number = va_arg(args, int);
-                int string_size = _getDecString(str, number);
-                str+= string_size;
-                break;
-            }
-            case 'u': {
-                unsigned int number = va_arg(args, unsigned int);
-                int string_size = _getUnsignedDecString(str, number);
-                str+= string_size;
-                break;
-            }
-            case 'x': {
-                long int number = va_arg(args, long int);
-                int string_size = _getHexString(str, number, false);
-                str+= string_size;
-                break;
-            }
-            case 'X': {
-                long int number = va_arg(args, long int);
-                int string_size = _getHexString(str, number, true);
-                str+= string_size;
-                break;
-            }
-            case 'o': {
-                unsigned long number = va_arg(args, unsigned long);
-                int string_size = _getNumericString(str, number, 8, false);
-                str+= string_size;
-                break;
-            }
-            case 'c':
-            {
-                unsigned char character = va_arg(args, int);
-                *str++ = character;
-                //*str++ = 'v';
-                break;
-            }
-            case 's': {
-                char *arg_string = va_arg(args, char*);
-                int str_len = strnlen(arg_string, precision);
-                for(int i=0; i < str_len; ++i) {
-                    *str++ = *arg_string++;
-                }
-                /*while(*arg_string != 0){
-                    *str++ = *arg_string++;
-                }*/
-                break;
+        if(is_conversion(*fmt)) {
+            str = format_value(str, *fmt, precision, fetch_value(*fmt, &values));
+        }
+    }
+    va_end(values);
+
+    *str = '\0';
+    return str-buffer;
+}
+
+/**
+ * Save the arguments of a format string as raw 64 bit values, so that the string can be formatted later
+ * with vsprintf_values. Strings are saved as pointers, string_mask has the bit i set if values[i] is a string.
+ *
+ * @param fmt the format string
+ * @param args the arguments
+ * @param values where the values are stored
+ * @param max_values the size of values
+ * @param string_mask the string arguments bitmask
+ * @return the number of values saved, or -1 if there are more than max_values arguments
+ */
+int vsprintf_capture(const char *fmt, va_list args, uint64_t *values, size_t max_values, uint32_t *string_mask){
+    size_t count = 0;
+    va_list arguments;
+    va_copy(arguments, args);
+    *string_mask = 0;
+    for(; *fmt; fmt++){
+        int precision;
+        if(*fmt != '%'){
+            continue;
+        }
+        fmt = parse_conversion(fmt + 1, &precision);
+        if(*fmt == '\0') {
+            break;
+        }
+        if(!is_conversion(*fmt)) {
+            continue;
+        }
+        if(count >= max_values || count >= 32) {
+            va_end(arguments);
+            return -1;
+        }
+        if(*fmt == 's') {
+            *string_mask |= (1 << count);
+        }
+        values[count++] = fetch_value(*fmt, &arguments);
+    }
+    va_end(arguments);
+    return (int) count;
+}
+
+/**
+ * Format a string using the values saved by vsprintf_capture
+ *
+ * @param buffer the output buffer
+ * @param fmt the format string
+ * @param values the saved values
+ * @param values_count the number of saved values
+ * @return the length of the formatted string
+ */
+int vsprintf_values(char *buffer, const char *fmt, const uint64_t *values, size_t values_count){
+    char *str;
+    size_t index = 0;
+    for(str = buffer; *fmt; fmt++){
+        int precision;
+        if(*fmt != '%'){
+            *str++ = *fmt;
+            continue;
+        }
+        fmt = parse_conversion(fmt + 1, &precision);
+        if(*fmt == '\0') {
+            break;
+        }
+        if(is_conversion(*fmt)) {
+            uint64_t value = index < values_count ? values[index] : 0;
+            index++;
+            if(*fmt == 's' && value == 0) {
+                continue;
             }
+            str = format_value(str, *fmt, precision, value);
         }
     }
 
@@ -1,12 +1,10 @@
 #include <string.h>
 #include <stdint.h>
-#include <kheap.h>
+#include <memops.h>
 #ifndef TEST
 #include <video.h>
 #endif
 
-#define MEMMOVE_SMALL_COPY_SIZE 0x200
-
 char *strcpy(char *dst, const char *src) {
     char* output = dst;
     while (*src != '\0') {
@@ -147,71 +145,32 @@ void* memchr(void* src, int ch, size_t count)
 
 int memcmp(const void* a, const void* b, size_t limit)
 {
-    const unsigned char* ap = a;
-    const unsigned char* bp = b;
-
-    for (size_t i = 0; i < limit; i++)
-    {
-        if (ap[i] < bp[i])
-            return -1;
-        if (ap[i] > bp[i])
-            return 1;
-    }
-
-    return 0;
+    return memcmp_qwords(a, b, limit);
 }
 
 void* memset(void* dest, int ch, size_t count)
 {
-    uint8_t* dst = dest;
-    for (size_t i = 0; i < count; i++)
-        dst[i] = ch;
-
-    return dest;
+    if (count < MEMOPS_SIMD_THRESHOLD)
+        return memops.memset_small(dest, ch, count);
+    return memops.memset_large(dest, ch, count);
 }
 
 void* memcpy(void* dest, void* src, size_t count)
 {
-    //these casts are not necessary if using gcc extensions to allow pointer arithmatic
-    //on void pointers, but this is more portable and will be optimized away.
-    const uint8_t* source = src;
-    uint8_t* destination = dest;
-
-    for (size_t i = 0; i < count; i++)
-        destination[i] = source[i];
-
-    return dest;
+    if (count < MEMOPS_SIMD_THRESHOLD)
+        return memops.memcpy_small(dest, src, count);
+    return memops.memcpy_large(dest, src, count);
 }
 
 void* memmove(void* dest, void* src, size_t count)
 {
-    //memmove must act like it supports an internmediate buffer (i.e. if we src and dest overlap, it must work as expected).
-    //first lets check if the buffers even overlap, if they dont it's just memcpy.
-    //if they do, we'll decide whether we want to allocate the intermediate buffer
-    //on the stack (for small copies, its much faster), or the heap.
-    const uintptr_t dest_top = (uintptr_t)dest + count;
-    const uintptr_t src_top = (uintptr_t)src + count;
-    if (dest_top < (uintptr_t)src || src_top < (uintptr_t)dest)
+    //memmove must act like it supports an intermediate buffer (i.e. if src and dest overlap, it must work as expected).
+    //a forward copy is safe when dest is below src or the buffers don't overlap at all,
+    //otherwise copying from the end never overwrites source bytes before they are read.
+    if ((uintptr_t)dest <= (uintptr_t)src || (uintptr_t)dest >= (uintptr_t)src + count)
         return memcpy(dest, src, count);
 
-    uint8_t* buff;
-    if (count <= MEMMOVE_SMALL_COPY_SIZE)
-        buff = __builtin_alloca(count);
-    else
-        buff = kmalloc(count);
-    
-    //see memcopy for why these variables are used.
-    const uint8_t* source = src;
-    uint8_t* destination = dest;
-    for (size_t i = 0; i < count; i++)
-        buff[i] = source[i];
-    for (size_t i = 0; i < count; i++)
-        destination[i] = source[i];
-
-    if (count <= MEMMOVE_SMALL_COPY_SIZE)
-        kfree(buff);
-
-    return dest;
+    return memcpy_backward(dest, src, count);
 }
 
 void test_strcmp(){
@@ -1,40 +1,56 @@
 #include <unistd.h>
+#include <fd_table.h>
+#include <page_cache.h>
 #include <vfs.h>
 #include <logging.h>
 
 int close (int fildes) {
-    if (fildes >= 0 && fildes < OPENEDFILES_MAX) {
-        //TODO: it should check for opened files by all threads.
-        loglinef(Verbose, "(close) called with fildes: %d", fildes);       
-        if (vfs_opened_files[fildes].fs_specific_id > 0) {
-            int fs_specific_id = vfs_opened_files[fildes].fs_specific_id;
-            int mountpoint_id = vfs_opened_files[fildes].mountpoint_id;
-            mountpoint_t mountpoint = mountpoints[mountpoint_id];
-            if (mountpoint.file_operations.close != NULL) {
-                mountpoint.file_operations.close(fs_specific_id);
-            }
-        }
-        vfs_opened_files[fildes].fs_specific_id = -1;
-        vfs_opened_files[fildes].mountpoint_id = -1;
-        vfs_opened_files[fildes].buffer_read_pos = -1;
-        return 0;
+    loglinef(Verbose, "(close) called with fildes: %d", fildes);
+    if (!fd_table_close(get_current_fd_table(), fildes)) {
+        return -1;
     }
-    return -1;
+    return 0;
 }
 
+// The table lock is held while the descriptor is used, since an open in another thread can move the table
 ssize_t read(int fildes, void *buf, size_t nbytes){
-    //Will be implemented in the future
-    if (fildes >= 0 && fildes < OPENEDFILES_MAX) {
-        if (vfs_opened_files[fildes].fs_specific_id >= 0) {
-            int fs_specific_id = vfs_opened_files[fildes].fs_specific_id;
-            int mountpoint_id = vfs_opened_files[fildes].mountpoint_id;
-            mountpoint_t mountpoint = mountpoints[mountpoint_id];
-            if (mountpoint.file_operations.read != NULL) {
-                return mountpoint.file_operations.read(fs_specific_id, buf, nbytes);
-            }
-            return 0;
-        }
+    fd_table_t *fd_table = get_current_fd_table();
+    rwlock_read_acquire(&fd_table->lock);
+    vfs_file_descriptor_t *file = fd_table_get(fd_table, fildes);
+    if (file == NULL || file->fs_specific_id < 0) {
+        rwlock_read_release(&fd_table->lock);
+        return -1;
+    }
+    mountpoint_t *mountpoint = &mountpoints[file->mountpoint_id];
+    ssize_t read_bytes = 0;
+    if (file->node != NULL && mountpoint->file_operations.pread != NULL) {
+        read_bytes = page_cache_read(file, buf, nbytes, file->offset);
+    } else if (mountpoint->file_operations.pread != NULL) {
+        // The position is the one of the descriptor, so two descriptors of the same file don't interfere
+        read_bytes = mountpoint->file_operations.pread(file->fs_specific_id, buf, nbytes, file->offset);
+    } else if (mountpoint->file_operations.read != NULL) {
+        read_bytes = mountpoint->file_operations.read(file->fs_specific_id, buf, nbytes);
+    }
+    if (read_bytes > 0) {
+        file->offset += read_bytes;
     }
-    return -1;
+    rwlock_read_release(&fd_table->lock);
+    return read_bytes;
 }
 
+ssize_t pread(int fildes, void *buf, size_t nbytes, off_t offset) {
+    fd_table_t *fd_table = get_current_fd_table();
+    rwlock_read_acquire(&fd_table->lock);
+    vfs_file_descriptor_t *file = fd_table_get(fd_table, fildes);
+    ssize_t read_bytes = -1;
+    if (file != NULL && file->fs_specific_id >= 0 && offset >= 0) {
+        mountpoint_t *mountpoint = &mountpoints[file->mountpoint_id];
+        if (mountpoint->file_operations.pread != NULL && file->node != NULL) {
+            read_bytes = page_cache_read(file, buf, nbytes, offset);
+        } else if (mountpoint->file_operations.pread != NULL) {
+            read_bytes = mountpoint->file_operations.pread(file->fs_specific_id, buf, nbytes, offset);
+        }
+    }
+    rwlock_read_release(&fd_table->lock);
+    return read_bytes;
+}
@@ -0,0 +1,28 @@
+#include <condvar.h>
+
+void condvar_init(condvar_t *condvar) {
+    wait_queue_init(&condvar->waiters);
+}
+
+/**
+ * Release the mutex and block until the condition variable is signaled, the mutex is taken again before returning.
+ *
+ * @param condvar the condition variable
+ * @param mutex the mutex protecting the condition, owned by the current thread
+ */
+void condvar_wait(condvar_t *condvar, mutex_t *mutex) {
+    // The queue lock is taken before releasing the mutex: a thread that signals after changing the condition finds us queued
+    uint64_t flags = spinlock_acquire_irqsave(&condvar->waiters.lock);
+    mutex_release(mutex);
+    wait_queue_sleep_locked(&condvar->waiters, flags);
+    mutex_acquire(mutex);
+}
+
+// Wake the first waiting thread in O(1)
+void condvar_signal(condvar_t *condvar) {
+    wait_queue_wake_one(&condvar->waiters);
+}
+
+void condvar_broadcast(condvar_t *condvar) {
+    wait_queue_wake_all(&condvar->waiters);
+}
@@ -0,0 +1,52 @@
+#include <lock_stats.h>
+#include <logging.h>
+
+// The registered counters, new ones are pushed at the head and never removed
+static lock_stats_t *lock_stats_head = NULL;
+
+void lock_stats_reset(lock_stats_t *stats) {
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->spins = 0;
+    stats->max_hold_cycles = 0;
+    stats->acquired_tsc = 0;
+}
+
+/**
+ * Add the counters of a lock to the list printed by lock_stats_dump, the counters are reset.
+ * Registering again the same counters only resets them.
+ *
+ * @param stats the counters, they must never be freed
+ * @param name the lock name shown in the dump
+ */
+void lock_stats_register(lock_stats_t *stats, const char *name) {
+    stats->name = name;
+    lock_stats_reset(stats);
+    if ( stats->registered ) {
+        return;
+    }
+    stats->registered = true;
+    lock_stats_t *head = __atomic_load_n(&lock_stats_head, __ATOMIC_RELAXED);
+    do {
+        stats->next = head;
+    } while ( !__atomic_compare_exchange_n(&lock_stats_head, &head, stats, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED) );
+}
+
+lock_stats_t *lock_stats_list() {
+    return __atomic_load_n(&lock_stats_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Log the counters of all the registered locks, one line per lock.
+ * The hold time is in tsc ticks, kernel_settings.tsc.ticks_per_ms converts it.
+ */
+void lock_stats_dump() {
+#if LOCK_STATS_ENABLED == 1
+    pretty_log(Info, "Lock statistics (name: acquisitions contended spins max_hold_cycles)");
+    for (lock_stats_t *stats = lock_stats_list(); stats != NULL; stats = stats->next) {
+        pretty_logf(Info, "%s: %d %d %d %d", stats->name, stats->acquisitions, stats->contended, stats->spins, stats->max_hold_cycles);
+    }
+#else
+    pretty_log(Info, "Lock statistics are disabled (LOCK_STATS_ENABLED is 0)");
+#endif
+}
@@ -0,0 +1,66 @@
+#include <mcs_lock.h>
+
+/**
+ * Initialize an mcs lock, unlocked.
+ *
+ * @param lock the lock
+ * @param stats where to collect the contention counters, can be NULL
+ * @param name the lock name used by lock_stats_dump, ignored if stats is NULL
+ */
+void mcs_lock_init(mcs_lock_t *lock, lock_stats_t *stats, const char *name) {
+    lock->tail = NULL;
+    lock->stats = stats;
+    if ( stats != NULL ) {
+        lock_stats_register(stats, name);
+    }
+}
+
+void mcs_lock_acquire(mcs_lock_t *lock, mcs_node_t *node) {
+    uint64_t spins = 0;
+    node->next = NULL;
+    node->locked = true;
+    mcs_node_t *previous = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if ( previous != NULL ) {
+        __atomic_store_n(&previous->next, node, __ATOMIC_RELEASE);
+        while ( __atomic_load_n(&node->locked, __ATOMIC_ACQUIRE) ) {
+            cpu_relax();
+            spins++;
+        }
+    }
+    lock_stats_acquired(lock->stats, spins);
+}
+
+/**
+ * Take the lock only if nobody holds it or waits for it.
+ *
+ * @param lock the lock
+ * @param node the node of the caller, to pass to mcs_lock_release
+ * @return true if the lock has been taken
+ */
+bool mcs_lock_try_acquire(mcs_lock_t *lock, mcs_node_t *node) {
+    mcs_node_t *expected = NULL;
+    node->next = NULL;
+    node->locked = false;
+    if ( !__atomic_compare_exchange_n(&lock->tail, &expected, node, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) ) {
+        return false;
+    }
+    lock_stats_acquired(lock->stats, 0);
+    return true;
+}
+
+void mcs_lock_release(mcs_lock_t *lock, mcs_node_t *node) {
+    lock_stats_released(lock->stats);
+    mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if ( next == NULL ) {
+        // No known waiter: if we are still the tail the lock becomes free
+        mcs_node_t *expected = node;
+        if ( __atomic_compare_exchange_n(&lock->tail, &expected, NULL, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED) ) {
+            return;
+        }
+        // Someone swapped the tail but didn't link its node yet, it takes a few instructions
+        while ( (next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL ) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, false, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,81 @@
+#include <mutex.h>
+#include <scheduler.h>
+
+/**
+ * Initialize a mutex, unlocked.
+ *
+ * @param mutex the mutex
+ * @param stats where to collect the contention counters, can be NULL
+ * @param name the mutex name used by lock_stats_dump, ignored if stats is NULL
+ */
+void mutex_init(mutex_t *mutex, lock_stats_t *stats, const char *name) {
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->waiters);
+    mutex->stats = stats;
+    if ( stats != NULL ) {
+        lock_stats_register(stats, name);
+    }
+}
+
+static inline bool mutex_try_take(mutex_t *mutex, thread_t *thread) {
+    thread_t *expected = NULL;
+    return __atomic_compare_exchange_n(&mutex->owner, &expected, thread, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void mutex_acquire(mutex_t *mutex) {
+    thread_t *thread = current_executing_thread;
+    uint64_t spins = 0;
+    if ( mutex_try_take(mutex, thread) ) {
+        lock_stats_acquired(mutex->stats, 0);
+        return;
+    }
+    // Spinning makes sense only while the owner is running, a preempted or blocked owner won't release it soon
+    while ( spins < MUTEX_SPIN_LIMIT ) {
+        thread_t *owner = __atomic_load_n(&mutex->owner, __ATOMIC_RELAXED);
+        if ( owner == NULL ) {
+            if ( mutex_try_take(mutex, thread) ) {
+                lock_stats_acquired(mutex->stats, spins + 1);
+                return;
+            }
+        } else if ( owner == thread || owner->status != RUN ) {
+            break;
+        }
+        cpu_relax();
+        spins++;
+    }
+    uint64_t flags = spinlock_acquire_irqsave(&mutex->waiters.lock);
+    // Checked again under the queue lock: a release done after this point finds us in the queue
+    if ( mutex_try_take(mutex, thread) ) {
+        spinlock_release_irqrestore(&mutex->waiters.lock, flags);
+    } else {
+        // When we are woken the owner has already handed the mutex to us
+        wait_queue_sleep_locked(&mutex->waiters, flags);
+    }
+    lock_stats_acquired(mutex->stats, spins + 1);
+}
+
+bool mutex_try_acquire(mutex_t *mutex) {
+    if ( !mutex_try_take(mutex, current_executing_thread) ) {
+        return false;
+    }
+    lock_stats_acquired(mutex->stats, 0);
+    return true;
+}
+
+/**
+ * Release the mutex, if there are waiters the first one becomes the owner and is woken in O(1).
+ *
+ * @param mutex the mutex, owned by the current thread
+ */
+void mutex_release(mutex_t *mutex) {
+    lock_stats_released(mutex->stats);
+    uint64_t flags = spinlock_acquire_irqsave(&mutex->waiters.lock);
+    thread_t *next_owner = mutex->waiters.head;
+    __atomic_store_n(&mutex->owner, next_owner, __ATOMIC_RELEASE);
+    wait_queue_wake_one_locked(&mutex->waiters);
+    spinlock_release_irqrestore(&mutex->waiters.lock, flags);
+}
+
+bool mutex_is_owned(mutex_t *mutex) {
+    return __atomic_load_n(&mutex->owner, __ATOMIC_RELAXED) != NULL;
+}
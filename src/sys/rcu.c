@@ -0,0 +1,197 @@
+#include <rcu.h>
+#include <scheduler.h>
+#include <spinlock.h>
+#include <string.h>
+
+/**
+ * Quiescent state based RCU. A cpu is in a quiescent state when schedule() switches thread, and the read side sections
+ * never cross a context switch: schedule() doesn't switch thread while the cpu is inside one.
+ * A grace period starts when someone waits for it, and it is completed when every online cpu has passed a quiescent
+ * state after its start: then no reader can still hold a pointer removed before it started.
+ */
+typedef struct {
+    uint32_t read_depth; /**< Nesting of the read side sections running on the cpu */
+} rcu_cpu_t;
+
+rcu_stats_t rcu_stats;
+
+static rcu_cpu_t rcu_cpus[RCU_MAX_CPUS];
+static size_t rcu_online_cpus;
+static spinlock_t rcu_lock;
+static uint64_t rcu_started; /**< The last grace period started */
+static uint64_t rcu_completed; /**< The last grace period completed, equal to rcu_started if none is running */
+static uint64_t rcu_requested; /**< The last grace period someone is waiting for */
+static uint32_t rcu_pending_cpus; /**< Bitmask of the cpus that didn't pass a quiescent state in the current grace period */
+// The callbacks are queued in order, so their grace periods never decrease from the head to the tail
+static rcu_head_t *rcu_callbacks_head;
+static rcu_head_t *rcu_callbacks_tail;
+
+static inline size_t rcu_this_cpu() {
+    return RCU_BOOT_CPU;
+}
+
+/**
+ * Initialize the rcu state, it must be called before the scheduler starts.
+ *
+ * @param cpus the number of cpus that will report quiescent states, up to RCU_MAX_CPUS
+ */
+void init_rcu(size_t cpus) {
+    memset(rcu_cpus, 0, sizeof(rcu_cpus));
+    memset(&rcu_stats, 0, sizeof(rcu_stats_t));
+    rcu_online_cpus = cpus < RCU_MAX_CPUS ? cpus : RCU_MAX_CPUS;
+    spinlock_init(&rcu_lock);
+    rcu_started = 0;
+    rcu_completed = 0;
+    rcu_requested = 0;
+    rcu_pending_cpus = 0;
+    rcu_callbacks_head = NULL;
+    rcu_callbacks_tail = NULL;
+}
+
+/**
+ * Enter a read side section: until rcu_read_unlock the objects reached through rcu_dereference are not freed.
+ * The sections can be nested, and can be used in interrupt handlers. The caller must not sleep or yield inside.
+ */
+void rcu_read_lock() {
+    rcu_cpus[rcu_this_cpu()].read_depth++;
+    asm volatile("" ::: "memory");
+}
+
+void rcu_read_unlock() {
+    asm volatile("" ::: "memory");
+    rcu_cpus[rcu_this_cpu()].read_depth--;
+}
+
+bool rcu_read_locked(size_t cpu) {
+    return rcu_cpus[cpu].read_depth > 0;
+}
+
+/**
+ * Close the read sections left open on a cpu by a thread that will never run again (i.e. a dead thread):
+ * nobody else can close them, and the cpu would never pass a quiescent state.
+ *
+ * @param cpu the cpu
+ * @return the number of sections that were open, 0 if the thread behaved
+ */
+size_t rcu_read_abandon(size_t cpu) {
+    size_t depth = rcu_cpus[cpu].read_depth;
+    rcu_cpus[cpu].read_depth = 0;
+    return depth;
+}
+
+// Called with rcu_lock held
+static void rcu_start_grace_period() {
+    rcu_started++;
+    rcu_pending_cpus = (1 << rcu_online_cpus) - 1;
+}
+
+// Return the grace period that a removal done now has to wait for, starting it if none is running. Called with rcu_lock held
+static uint64_t rcu_request_grace_period() {
+    uint64_t grace_period;
+    if ( rcu_started == rcu_completed ) {
+        rcu_start_grace_period();
+        grace_period = rcu_started;
+    } else {
+        // The running grace period started before the removal, it's the next one that counts
+        grace_period = rcu_started + 1;
+    }
+    if ( grace_period > rcu_requested ) {
+        rcu_requested = grace_period;
+    }
+    return grace_period;
+}
+
+/**
+ * Report that a cpu is not inside a read side section, it is called by schedule() on every context switch.
+ * If it was the last cpu the grace period is completed, and the next one is started if someone waits for it.
+ *
+ * @param cpu the cpu id
+ */
+void rcu_quiescent_state(size_t cpu) {
+    if ( (__atomic_load_n(&rcu_pending_cpus, __ATOMIC_RELAXED) & (1 << cpu)) == 0 ) {
+        return;
+    }
+    uint64_t flags = spinlock_acquire_irqsave(&rcu_lock);
+    rcu_pending_cpus &= ~(1 << cpu);
+    if ( rcu_pending_cpus == 0 && rcu_started != rcu_completed ) {
+        rcu_completed = rcu_started;
+        rcu_stats.grace_periods++;
+        if ( rcu_requested > rcu_completed ) {
+            rcu_start_grace_period();
+        }
+    }
+    spinlock_release_irqrestore(&rcu_lock, flags);
+}
+
+/**
+ * Run a callback after a grace period, i.e. to free an object already removed from the lists the readers walk.
+ * It doesn't wait and doesn't allocate, so it can be called with the interrupts disabled. The callbacks are run
+ * by rcu_process_callbacks, in thread context.
+ *
+ * @param head the rcu_head_t embedded in the object
+ * @param callback the function to call
+ */
+void call_rcu(rcu_head_t *head, void (*callback)(rcu_head_t *head)) {
+    head->callback = callback;
+    head->next = NULL;
+    uint64_t flags = spinlock_acquire_irqsave(&rcu_lock);
+    head->grace_period = rcu_request_grace_period();
+    if ( rcu_callbacks_tail != NULL ) {
+        rcu_callbacks_tail->next = head;
+    } else {
+        rcu_callbacks_head = head;
+    }
+    rcu_callbacks_tail = head;
+    rcu_stats.queued++;
+    spinlock_release_irqrestore(&rcu_lock, flags);
+}
+
+/**
+ * Wait until all the read side sections running now are finished. It yields the cpu, so it must be called
+ * from a thread, outside of any read side section.
+ */
+void synchronize_rcu() {
+    uint64_t flags = spinlock_acquire_irqsave(&rcu_lock);
+    uint64_t grace_period = rcu_request_grace_period();
+    spinlock_release_irqrestore(&rcu_lock, flags);
+    while ( rcu_completed_grace_period() < grace_period ) {
+        scheduler_yield();
+    }
+}
+
+/**
+ * Run the callbacks whose grace period is completed, in the order they were queued.
+ *
+ * @return the number of callbacks run
+ */
+size_t rcu_process_callbacks() {
+    uint64_t flags = spinlock_acquire_irqsave(&rcu_lock);
+    rcu_head_t *head = NULL;
+    rcu_head_t *last = NULL;
+    size_t ready = 0;
+    // Detach the ready callbacks, they are run without the lock, since they can call call_rcu
+    for (rcu_head_t *callback = rcu_callbacks_head; callback != NULL && callback->grace_period <= rcu_completed; callback = callback->next) {
+        last = callback;
+        ready++;
+    }
+    if ( last != NULL ) {
+        head = rcu_callbacks_head;
+        rcu_callbacks_head = last->next;
+        if ( rcu_callbacks_head == NULL ) {
+            rcu_callbacks_tail = NULL;
+        }
+        last->next = NULL;
+    }
+    spinlock_release_irqrestore(&rcu_lock, flags);
+    while ( head != NULL ) {
+        rcu_head_t *next = head->next;
+        head->callback(head);
+        head = next;
+    }
+    __atomic_add_fetch(&rcu_stats.invoked, ready, __ATOMIC_RELAXED);
+    return ready;
+}
+
+uint64_t rcu_completed_grace_period() {
+    return __atomic_load_n(&rcu_completed, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,54 @@
+#include <rwlock.h>
+
+void rwlock_init(rwlock_t *lock) {
+    lock->state = 0;
+    lock->writers_waiting = 0;
+}
+
+void rwlock_read_acquire(rwlock_t *lock) {
+    while ( true ) {
+        // Wait only reading, so the waiting readers don't steal the cache line from the owner
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+        if ( (state & RWLOCK_WRITER) || __atomic_load_n(&lock->writers_waiting, __ATOMIC_RELAXED) > 0 ) {
+            cpu_relax();
+            continue;
+        }
+        if ( __atomic_compare_exchange_n(&lock->state, &state, state + 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ) {
+            return;
+        }
+    }
+}
+
+void rwlock_read_release(rwlock_t *lock) {
+    __atomic_fetch_sub(&lock->state, 1, __ATOMIC_RELEASE);
+}
+
+void rwlock_write_acquire(rwlock_t *lock) {
+    __atomic_fetch_add(&lock->writers_waiting, 1, __ATOMIC_RELAXED);
+    while ( true ) {
+        uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+        if ( state != 0 ) {
+            cpu_relax();
+            continue;
+        }
+        if ( __atomic_compare_exchange_n(&lock->state, &state, RWLOCK_WRITER, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ) {
+            break;
+        }
+    }
+    __atomic_fetch_sub(&lock->writers_waiting, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Take the write lock only if nobody holds the lock.
+ *
+ * @param lock the lock
+ * @return true if the write lock has been taken
+ */
+bool rwlock_write_try_acquire(rwlock_t *lock) {
+    uint32_t state = 0;
+    return __atomic_compare_exchange_n(&lock->state, &state, RWLOCK_WRITER, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void rwlock_write_release(rwlock_t *lock) {
+    __atomic_store_n(&lock->state, 0, __ATOMIC_RELEASE);
+}
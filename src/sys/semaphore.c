@@ -0,0 +1,36 @@
+#include <semaphore.h>
+
+void semaphore_init(semaphore_t *semaphore, size_t count) {
+    semaphore->count = count;
+    wait_queue_init(&semaphore->waiters);
+}
+
+void semaphore_down(semaphore_t *semaphore) {
+    uint64_t flags = spinlock_acquire_irqsave(&semaphore->waiters.lock);
+    if ( semaphore->count > 0 ) {
+        semaphore->count--;
+        spinlock_release_irqrestore(&semaphore->waiters.lock, flags);
+        return;
+    }
+    // When we are woken the unit has been handed to us by semaphore_up
+    wait_queue_sleep_locked(&semaphore->waiters, flags);
+}
+
+bool semaphore_try_down(semaphore_t *semaphore) {
+    bool taken = false;
+    uint64_t flags = spinlock_acquire_irqsave(&semaphore->waiters.lock);
+    if ( semaphore->count > 0 ) {
+        semaphore->count--;
+        taken = true;
+    }
+    spinlock_release_irqrestore(&semaphore->waiters.lock, flags);
+    return taken;
+}
+
+void semaphore_up(semaphore_t *semaphore) {
+    uint64_t flags = spinlock_acquire_irqsave(&semaphore->waiters.lock);
+    if ( wait_queue_wake_one_locked(&semaphore->waiters) == NULL ) {
+        semaphore->count++;
+    }
+    spinlock_release_irqrestore(&semaphore->waiters.lock, flags);
+}
@@ -1,20 +1,24 @@
 #include <spinlock.h>
-#include <kheap.h>
 
-spinlock_t* spinlock_init() {
-    spinlock_t* new_spinlock = kmalloc(sizeof(spinlock_t));
-    spinlock_release(new_spinlock);
-    return new_spinlock;
+void spinlock_acquire(spinlock_t *lock) {
+    while (__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE)) {
+        // Wait reading the lock, so the cache line stays shared until the owner releases it
+        while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED)) {
+            cpu_relax();
+        }
+    }
 }
 
-void spinlock_acquire(spinlock_t *lock) {
-    while (__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE));
+/**
+ * Take the lock only if it's free, i.e. in a path that can run while the same cpu already holds it.
+ *
+ * @param lock the lock
+ * @return true if the lock has been taken
+ */
+bool spinlock_try_acquire(spinlock_t *lock) {
+    return !__atomic_test_and_set(&lock->locked, __ATOMIC_ACQUIRE);
 }
 
 void spinlock_release(spinlock_t *lock) {
     __atomic_clear(&lock->locked, __ATOMIC_RELEASE);
 }
-
-void spinlock_free(spinlock_t* spinlock) {
-    kfree(spinlock);
-}
@@ -0,0 +1,58 @@
+#include <ticket_lock.h>
+
+/**
+ * Initialize a ticket lock, unlocked.
+ *
+ * @param lock the lock
+ * @param stats where to collect the contention counters, can be NULL
+ * @param name the lock name used by lock_stats_dump, ignored if stats is NULL
+ */
+void ticket_lock_init(ticket_lock_t *lock, lock_stats_t *stats, const char *name) {
+    lock->next_ticket = 0;
+    lock->now_serving = 0;
+    lock->stats = stats;
+    if ( stats != NULL ) {
+        lock_stats_register(stats, name);
+    }
+}
+
+void ticket_lock_acquire(ticket_lock_t *lock) {
+    uint32_t ticket = __atomic_fetch_add(&lock->next_ticket, 1, __ATOMIC_RELAXED);
+    uint64_t spins = 0;
+    uint32_t serving;
+    while ( (serving = __atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE)) != ticket ) {
+        // Proportional backoff: every owner ahead of us will hold the lock for a while, don't hammer the line meanwhile
+        uint32_t waiting = ticket - serving;
+        for (uint32_t i = 0; i < waiting; i++) {
+            cpu_relax();
+        }
+        spins++;
+    }
+    lock_stats_acquired(lock->stats, spins);
+}
+
+/**
+ * Take the lock only if it is free.
+ *
+ * @param lock the lock
+ * @return true if the lock has been taken
+ */
+bool ticket_lock_try_acquire(ticket_lock_t *lock) {
+    uint32_t serving = __atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE);
+    uint32_t ticket = serving;
+    if ( !__atomic_compare_exchange_n(&lock->next_ticket, &ticket, serving + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ) {
+        return false;
+    }
+    lock_stats_acquired(lock->stats, 0);
+    return true;
+}
+
+void ticket_lock_release(ticket_lock_t *lock) {
+    lock_stats_released(lock->stats);
+    // Only the owner writes now_serving, a plain increment published with release order is enough
+    __atomic_store_n(&lock->now_serving, lock->now_serving + 1, __ATOMIC_RELEASE);
+}
+
+bool ticket_lock_is_locked(ticket_lock_t *lock) {
+    return __atomic_load_n(&lock->now_serving, __ATOMIC_RELAXED) != __atomic_load_n(&lock->next_ticket, __ATOMIC_RELAXED);
+}
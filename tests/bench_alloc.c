@@ -0,0 +1,321 @@
+#include <test_common.h>
+#include <bitmap.h>
+#include <kheap.h>
+#include <multiboot.h>
+#include <pmm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_HEAP_SIZE     (256 * 1024 * 1024)
+#define BENCH_OPERATIONS    200000
+#define BENCH_MAX_LIVE      1024
+#define BENCH_QUEUE_LENGTH  256
+#define BENCH_MEMORY_SIZE   (2ull * 1024 * 1024 * 1024)
+#define BENCH_SEED  0x2545F4914F6CDD1Dull
+
+extern KHeapMemoryNode *kernel_heap_start;
+extern KHeapMemoryNode *kernel_heap_current_pos;
+extern KHeapMemoryNode *kernel_heap_end;
+extern size_t memory_size_in_bytes;
+extern uint32_t bitmap_size;
+
+unsigned int end_of_mapped_memory;
+struct multiboot_tag_basic_meminfo *tagmem;
+struct multiboot_tag_mmap *mmap_root;
+uint64_t _kernel_end = 0x1190AC;
+uint64_t _kernel_physical_end = 0x1190AC;
+
+/**
+ * Latencies and memory usage of a single workload
+ */
+typedef struct {
+    uint64_t *latencies;
+    size_t operations;
+    size_t failures;
+    uint64_t elapsed_ns;
+    size_t live_bytes;
+    size_t peak_live_bytes;
+    size_t peak_footprint; /**< Highest heap offset used by a live allocation (kheap), or frames used (pmm) */
+} bench_stats_t;
+
+typedef struct {
+    void *pointer;
+    size_t size;
+} bench_allocation_t;
+
+uint64_t bench_random_state;
+bench_allocation_t bench_live[BENCH_MAX_LIVE];
+size_t bench_live_count;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// xorshift64*, fixed seed so every run executes the same sequence of operations
+static uint64_t bench_random() {
+    bench_random_state ^= bench_random_state >> 12;
+    bench_random_state ^= bench_random_state << 25;
+    bench_random_state ^= bench_random_state >> 27;
+    return bench_random_state * 0x2545F4914F6CDD1Dull;
+}
+
+// Sizes between 16 bytes and 4KB, smaller sizes are more frequent
+static size_t bench_random_small_size() {
+    size_t order = 4 + bench_random() % 9;
+    return (1ul << order) + bench_random() % (1ul << order);
+}
+
+static int compare_latencies(const void *a, const void *b) {
+    uint64_t left = *(const uint64_t *) a;
+    uint64_t right = *(const uint64_t *) b;
+    return (left > right) - (left < right);
+}
+
+static void bench_reset_kheap() {
+    kernel_heap_start->size = BENCH_HEAP_SIZE - sizeof(KHeapMemoryNode);
+    kernel_heap_start->is_free = true;
+    kernel_heap_start->next = NULL;
+    kernel_heap_start->prev = NULL;
+    kernel_heap_current_pos = kernel_heap_start;
+    kernel_heap_end = kernel_heap_start;
+}
+
+static void bench_reset_pmm() {
+    tagmem->mem_lower = 0x27F;
+    tagmem->mem_upper = BENCH_MEMORY_SIZE / 1024 - 1024;
+    memory_size_in_bytes = BENCH_MEMORY_SIZE;
+    pmm_setup(0, 0);
+}
+
+static void bench_stats_begin(bench_stats_t *stats) {
+    memset(stats, 0, sizeof(bench_stats_t));
+    stats->latencies = malloc(sizeof(uint64_t) * BENCH_OPERATIONS * 2);
+    bench_live_count = 0;
+    bench_random_state = BENCH_SEED;
+}
+
+static void bench_record(bench_stats_t *stats, uint64_t start, uint64_t end) {
+    stats->latencies[stats->operations++] = end - start;
+}
+
+static void *bench_kmalloc(bench_stats_t *stats, size_t size) {
+    uint64_t start = now_ns();
+    void *pointer = kmalloc(size);
+    bench_record(stats, start, now_ns());
+    if ( pointer == NULL ) {
+        stats->failures++;
+        return NULL;
+    }
+    stats->live_bytes += size;
+    if ( stats->live_bytes > stats->peak_live_bytes ) {
+        stats->peak_live_bytes = stats->live_bytes;
+    }
+    size_t footprint = (uint8_t *) pointer + size - (uint8_t *) kernel_heap_start;
+    if ( footprint > stats->peak_footprint ) {
+        stats->peak_footprint = footprint;
+    }
+    return pointer;
+}
+
+static void bench_kfree(bench_stats_t *stats, void *pointer, size_t size) {
+    uint64_t start = now_ns();
+    kfree(pointer);
+    bench_record(stats, start, now_ns());
+    stats->live_bytes -= size;
+}
+
+static void bench_live_add(void *pointer, size_t size) {
+    bench_live[bench_live_count].pointer = pointer;
+    bench_live[bench_live_count].size = size;
+    bench_live_count++;
+}
+
+static bench_allocation_t bench_live_remove(size_t index) {
+    bench_allocation_t allocation = bench_live[index];
+    bench_live[index] = bench_live[--bench_live_count];
+    return allocation;
+}
+
+static void bench_free_all(bench_stats_t *stats) {
+    while ( bench_live_count > 0 ) {
+        bench_allocation_t allocation = bench_live_remove(bench_live_count - 1);
+        bench_kfree(stats, allocation.pointer, allocation.size);
+    }
+}
+
+/**
+ * Random sizes: allocations and frees in random order, the live set is bounded by BENCH_MAX_LIVE
+ */
+static void workload_random_sizes(bench_stats_t *stats) {
+    for (size_t i = 0; i < BENCH_OPERATIONS; i++) {
+        if ( bench_live_count < BENCH_MAX_LIVE && (bench_live_count == 0 || bench_random() % 2 == 0) ) {
+            size_t size = bench_random_small_size();
+            void *pointer = bench_kmalloc(stats, size);
+            if ( pointer != NULL ) {
+                bench_live_add(pointer, size);
+            }
+        } else {
+            bench_allocation_t allocation = bench_live_remove(bench_random() % bench_live_count);
+            bench_kfree(stats, allocation.pointer, allocation.size);
+        }
+    }
+    bench_free_all(stats);
+}
+
+/**
+ * Producer/consumer: the buffers are freed in the same order they were allocated, like a message queue
+ */
+static void workload_producer_consumer(bench_stats_t *stats) {
+    bench_allocation_t queue[BENCH_QUEUE_LENGTH];
+    size_t head = 0;
+    size_t length = 0;
+    for (size_t i = 0; i < BENCH_OPERATIONS / 2; i++) {
+        if ( length == BENCH_QUEUE_LENGTH ) {
+            bench_kfree(stats, queue[head].pointer, queue[head].size);
+            head = (head + 1) % BENCH_QUEUE_LENGTH;
+            length--;
+        }
+        size_t size = 64 + bench_random() % 1024;
+        void *pointer = bench_kmalloc(stats, size);
+        if ( pointer != NULL ) {
+            queue[(head + length) % BENCH_QUEUE_LENGTH].pointer = pointer;
+            queue[(head + length) % BENCH_QUEUE_LENGTH].size = size;
+            length++;
+        }
+    }
+    for (; length > 0; length--) {
+        bench_kfree(stats, queue[head].pointer, queue[head].size);
+        head = (head + 1) % BENCH_QUEUE_LENGTH;
+    }
+}
+
+/**
+ * Fragmentation churn: fill the heap with small blocks, free every other one, then ask for blocks
+ * that do not fit in the holes. Repeated until the operations are done.
+ */
+static void workload_fragmentation(bench_stats_t *stats) {
+    while ( stats->operations + BENCH_MAX_LIVE * 3 < BENCH_OPERATIONS ) {
+        while ( bench_live_count < BENCH_MAX_LIVE ) {
+            void *pointer = bench_kmalloc(stats, 32);
+            if ( pointer == NULL ) {
+                break;
+            }
+            bench_live_add(pointer, 32);
+        }
+        for (size_t i = 0; i < bench_live_count; i++) {
+            bench_kfree(stats, bench_live[i].pointer, bench_live[i].size);
+            bench_live[i] = bench_live[--bench_live_count];
+        }
+        for (size_t i = 0; i < BENCH_MAX_LIVE / 4 && bench_live_count < BENCH_MAX_LIVE; i++) {
+            void *pointer = bench_kmalloc(stats, 96);
+            if ( pointer != NULL ) {
+                bench_live_add(pointer, 96);
+            }
+        }
+        bench_free_all(stats);
+    }
+}
+
+/**
+ * Long tail: mostly small allocations, with 1% of them between 64KB and 1MB
+ */
+static void workload_long_tail(bench_stats_t *stats) {
+    for (size_t i = 0; i < BENCH_OPERATIONS; i++) {
+        if ( bench_live_count < BENCH_MAX_LIVE && (bench_live_count == 0 || bench_random() % 2 == 0) ) {
+            size_t size = bench_random() % 100 == 0 ? (64 * 1024) + bench_random() % (960 * 1024) : bench_random_small_size();
+            void *pointer = bench_kmalloc(stats, size);
+            if ( pointer != NULL ) {
+                bench_live_add(pointer, size);
+            }
+        } else {
+            bench_allocation_t allocation = bench_live_remove(bench_random() % bench_live_count);
+            bench_kfree(stats, allocation.pointer, allocation.size);
+        }
+    }
+    bench_free_all(stats);
+}
+
+/**
+ * Physical frames: random allocation and free of single frames
+ */
+static void workload_pmm_frames(bench_stats_t *stats) {
+    size_t frames_limit = bitmap_size / 2 < BENCH_MAX_LIVE ? bitmap_size / 2 : BENCH_MAX_LIVE;
+    for (size_t i = 0; i < BENCH_OPERATIONS; i++) {
+        if ( bench_live_count < frames_limit && (bench_live_count == 0 || bench_random() % 2 == 0) ) {
+            uint64_t start = now_ns();
+            void *frame = pmm_alloc_frame();
+            bench_record(stats, start, now_ns());
+            if ( frame == NULL ) {
+                stats->failures++;
+                continue;
+            }
+            bench_live_add(frame, PAGE_SIZE_IN_BYTES);
+            stats->live_bytes += PAGE_SIZE_IN_BYTES;
+            if ( stats->live_bytes > stats->peak_live_bytes ) {
+                stats->peak_live_bytes = stats->live_bytes;
+            }
+        } else {
+            bench_allocation_t allocation = bench_live_remove(bench_random() % bench_live_count);
+            uint64_t start = now_ns();
+            pmm_free_frame(allocation.pointer);
+            bench_record(stats, start, now_ns());
+            stats->live_bytes -= PAGE_SIZE_IN_BYTES;
+        }
+    }
+    while ( bench_live_count > 0 ) {
+        pmm_free_frame(bench_live_remove(bench_live_count - 1).pointer);
+    }
+    // The only metadata of the pmm is the bitmap
+    stats->peak_footprint = stats->peak_live_bytes + bitmap_size / 8 + 1;
+}
+
+static void bench_report(const char *name, bench_stats_t *stats) {
+    qsort(stats->latencies, stats->operations, sizeof(uint64_t), compare_latencies);
+    double seconds = (double) stats->elapsed_ns / 1e9;
+    double overhead = stats->peak_live_bytes > 0 ? ((double) stats->peak_footprint / (double) stats->peak_live_bytes - 1.0) * 100.0 : 0;
+    printf("%-20s %10zu %12.0f %8lu %8lu %10.1f%% %8zu\n", name, stats->operations, (double) stats->operations / seconds,
+        stats->latencies[stats->operations / 2], stats->latencies[(stats->operations * 99) / 100], overhead, stats->failures);
+    free(stats->latencies);
+}
+
+static void bench_run_kheap(const char *name, void (*workload)(bench_stats_t *)) {
+    bench_stats_t stats;
+    bench_reset_kheap();
+    bench_stats_begin(&stats);
+    uint64_t start = now_ns();
+    workload(&stats);
+    stats.elapsed_ns = now_ns() - start;
+    bench_report(name, &stats);
+}
+
+/**
+ * Host benchmark of the kernel allocators (kheap and pmm), built from the same sources of the unit tests.
+ * The latencies include the cost of clock_gettime (a few tens of ns), the overhead is the peak memory used
+ * (heap end of the highest live allocation, or frames plus bitmap) compared to the peak of live bytes requested.
+ */
+int main() {
+    kernel_heap_start = malloc(BENCH_HEAP_SIZE);
+    tagmem = malloc(sizeof(struct multiboot_tag_basic_meminfo));
+    printf("Allocators benchmark (latencies in ns)\n");
+    printf("======================================\n");
+    printf("%-20s %10s %12s %8s %8s %11s %8s\n", "workload", "ops", "ops/s", "p50", "p99", "overhead", "failed");
+    bench_run_kheap("kheap_random_sizes", workload_random_sizes);
+    bench_run_kheap("kheap_producer_cons", workload_producer_consumer);
+    bench_run_kheap("kheap_fragmentation", workload_fragmentation);
+    bench_run_kheap("kheap_long_tail", workload_long_tail);
+
+    bench_stats_t stats;
+    bench_reset_pmm();
+    bench_stats_begin(&stats);
+    uint64_t start = now_ns();
+    workload_pmm_frames(&stats);
+    stats.elapsed_ns = now_ns() - start;
+    bench_report("pmm_frames", &stats);
+    free(kernel_heap_start);
+    free(tagmem);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <memops.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_MIN_BYTES     (64 * 1024 * 1024)
+#define BENCH_MAX_SIZE      (4 * 1024 * 1024)
+
+typedef struct {
+    const char *name;
+    memcpy_function_t memcpy_function;
+    memset_function_t memset_function;
+} memops_variant_t;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static double bench_memcpy(memcpy_function_t function, uint8_t *dst, uint8_t *src, size_t size) {
+    size_t iterations = BENCH_MIN_BYTES / size;
+    function(dst, src, size);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        function(dst, src, size);
+        asm volatile("" ::: "memory");
+    }
+    uint64_t elapsed = now_ns() - start;
+    return (double) (iterations * size) / (double) elapsed;
+}
+
+static double bench_memset(memset_function_t function, uint8_t *dst, size_t size) {
+    size_t iterations = BENCH_MIN_BYTES / size;
+    function(dst, 0, size);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < iterations; i++) {
+        function(dst, (int) i, size);
+        asm volatile("" ::: "memory");
+    }
+    uint64_t elapsed = now_ns() - start;
+    return (double) (iterations * size) / (double) elapsed;
+}
+
+/**
+ * Host benchmark of the memops variants, results are in GB/s.
+ * The kernel calls them with the same code, but with -O0 and the simd variants wrapped in kernel_fpu_begin/end.
+ */
+int main() {
+    memops_variant_t variants[] = {
+        {"bytes", memcpy_bytes, memset_bytes},
+        {"qwords", memcpy_qwords, memset_qwords},
+        {"erms", memcpy_erms, memset_erms},
+        {"sse2", memcpy_sse2, memset_sse2},
+        {"avx2", memcpy_avx2, memset_avx2},
+    };
+    size_t variants_count = sizeof(variants) / sizeof(memops_variant_t);
+    if ( !__builtin_cpu_supports("avx2") ) {
+        variants_count--;
+    }
+    uint8_t *src, *dst;
+    if ( posix_memalign((void **) &src, 64, BENCH_MAX_SIZE + 64) != 0 || posix_memalign((void **) &dst, 64, BENCH_MAX_SIZE + 64) != 0 ) {
+        printf("Cannot allocate the benchmark buffers\n");
+        return 1;
+    }
+    memset(src, 0x42, BENCH_MAX_SIZE + 64);
+
+    printf("Memory operations benchmark (GB/s)\n");
+    printf("==================================\n");
+    for (int operation = 0; operation < 2; operation++) {
+        printf("%-8s %10s", operation == 0 ? "memcpy" : "memset", "size");
+        for (size_t i = 0; i < variants_count; i++) {
+            printf(" %9s", variants[i].name);
+        }
+        printf("\n");
+        for (size_t size = 8; size <= BENCH_MAX_SIZE; size *= 2) {
+            printf("%-8s %10zu", "", size);
+            for (size_t i = 0; i < variants_count; i++) {
+                double result = operation == 0 ? bench_memcpy(variants[i].memcpy_function, dst, src, size) : bench_memset(variants[i].memset_function, dst, size);
+                printf(" %9.2f", result);
+            }
+            printf("\n");
+        }
+    }
+    free(src);
+    free(dst);
+    return 0;
+}
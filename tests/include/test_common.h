@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <spinlock.h>
 
 typedef enum {
     Debug = 0,
@@ -13,15 +14,6 @@ typedef enum {
     Fatal = 4,
 } log_level_t;
 
-typedef struct {
-    bool    locked;
-} spinlock_t;
-
-
-void spinlock_acquire(spinlock_t *lock);
-void spinlock_release(spinlock_t *lock);
-void spinlock_free(spinlock_t *lock);
-
 void _printStringAndNumber(char *, unsigned long);
 void _printStr(const char *);
 void _printNewLine();
@@ -32,4 +24,7 @@ void loglinef(log_level_t level, const char* msg, ...);
 void *map_phys_to_virt_addr(void* physical_address, void* address, unsigned int flags);
 
 uint32_t _compute_kernel_entries(uint64_t);
+
+// Added by hhdm_get_variable to the physical addresses, a test can point it to a host buffer to access the frames
+extern uintptr_t test_hhdm_offset;
 #endif
@@ -4,6 +4,7 @@
 void test_pmm_initialize();
 void test_pmm();
 void test_mmap();
+void test_pmm_zeroed_pool();
 
 #endif
 
@@ -2,5 +2,7 @@
 #define _TEST_VFS_
 
 void test_get_mountpoint_id();
+void test_mountpoint_trie();
+void test_dcache();
 
 #endif
@@ -1,5 +1,6 @@
 #include <test_common.h>
 #include <stdio.h>
+#include <string.h>
 #include <bitmap.h>
 
 void _printStringAndNumber(char *string, unsigned long number){
@@ -38,6 +39,8 @@ void map_vaddress_range(void *virtual_address, unsigned int flags, size_t requir
 void *map_phys_to_virt_addr(void* physical_address, void* address, unsigned int flags) {
     return NULL;
 }
+size_t logTrimLevel = 0;
+
 void init_log(size_t defaultOutputs, log_level_t trimBelowLevel, bool useVgaVideo) {
     return;
 }
@@ -56,6 +59,10 @@ void spinlock_acquire(spinlock_t *lock) {
     return;
 }
 
+bool spinlock_try_acquire(spinlock_t *lock) {
+    return true;
+}
+
 void spinlock_release(spinlock_t *lock) {
     return;
 }
@@ -63,10 +70,24 @@ void spinlock_release(spinlock_t *lock) {
 void hhdm_map_physical_memory() {
 }
 
+uintptr_t test_hhdm_offset = 0;
+
+void *hhdm_get_variable(uintptr_t phys_address) {
+    return (void *) (phys_address + test_hhdm_offset);
+}
+
+void page_zero(void *page, size_t size) {
+    memset(page, 0, size);
+}
+
 bool _is_address_in_multiboot(uint64_t address) {
     return false;
 }
 
-void spinlock_free(spinlock_t* spinlock) {
+void rcu_read_lock() {
+    return;
+}
+
+void rcu_read_unlock() {
     return;
 }
@@ -0,0 +1,153 @@
+#include <elf.h>
+#include <assert.h>
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
+#include <test_common.h>
+
+#define TEST_FILE_SIZE  0x500000
+#define TEST_MODULE_PHYS    0x10000000
+
+uint8_t test_file[TEST_FILE_SIZE] __attribute__((aligned(16)));
+uint8_t test_page[PAGE_SIZE_IN_BYTES];
+
+void test_validate();
+void test_plan_pages();
+void test_copy_page();
+
+Elf64_Phdr *test_phdrs() {
+    return (Elf64_Phdr *) (test_file + sizeof(Elf64_Ehdr));
+}
+
+void set_phdr(int index, Elf64_Word flags, Elf64_Off offset, Elf64_Addr vaddr, Elf64_Xword filesz, Elf64_Xword memsz) {
+    Elf64_Phdr *phdr = &test_phdrs()[index];
+    phdr->p_type = PT_LOAD;
+    phdr->p_flags = flags;
+    phdr->p_offset = offset;
+    phdr->p_vaddr = vaddr;
+    phdr->p_paddr = vaddr;
+    phdr->p_filesz = filesz;
+    phdr->p_memsz = memsz;
+    phdr->p_align = PAGE_SIZE_IN_BYTES;
+}
+
+// An executable with: text and rodata in their own pages, data + bss sharing a page with another segment,
+// and a read-only segment with a different alignment than its file offset
+void build_executable() {
+    memset(test_file, 0, sizeof(test_file));
+    for (size_t i = sizeof(Elf64_Ehdr) + 5 * sizeof(Elf64_Phdr); i < TEST_FILE_SIZE; i++) {
+        test_file[i] = (uint8_t) (i * 31 + 7);
+    }
+    Elf64_Ehdr *header = (Elf64_Ehdr *) test_file;
+    memcpy(header->e_ident, _elf_header_mag, ELF_MAGIC_SIZE);
+    header->e_ident[EI_CLASS] = ELFCLASS64;
+    header->e_ident[EI_DATA] = ELFDATA2LSB;
+    header->e_ident[EI_VERSION] = EV_CURRENT;
+    header->e_type = ET_EXEC;
+    header->e_machine = ELF_MACHINE;
+    header->e_version = EV_CURRENT;
+    header->e_entry = 0x400100;
+    header->e_phoff = sizeof(Elf64_Ehdr);
+    header->e_ehsize = sizeof(Elf64_Ehdr);
+    header->e_phentsize = sizeof(Elf64_Phdr);
+    header->e_phnum = 5;
+    set_phdr(0, PF_R | PF_X, 0, 0x400000, 0x1800, 0x1800);
+    set_phdr(1, PF_R, 0x200000, 0x600000, 0x100, 0x100);
+    set_phdr(2, PF_R | PF_W, 0x201000, 0x801000, 0x20, 0x3000);
+    set_phdr(3, PF_R, 0x300010, 0x805010, 0x10, 0x10);
+    set_phdr(4, PF_R, 0x400001, 0xA00000, 0x40, 0x40);
+}
+
+int main() {
+    printf("Testing elf loader\n");
+    test_validate();
+    test_plan_pages();
+    test_copy_page();
+    return 0;
+}
+
+void test_validate() {
+    Elf64_Ehdr *header = (Elf64_Ehdr *) test_file;
+    build_executable();
+    printf("\t [test_elf] (validate): A well formed executable is accepted\n");
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == true);
+    assert(load_elf((uintptr_t) test_file, TEST_FILE_SIZE) == true);
+    printf("\t [test_elf] (validate): Relocatable files are rejected\n");
+    header->e_type = 1;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+    assert(load_elf((uintptr_t) test_file, TEST_FILE_SIZE) == false);
+    build_executable();
+    printf("\t [test_elf] (validate): The entry point must be in an executable segment\n");
+    header->e_entry = 0x600010;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+    build_executable();
+    printf("\t [test_elf] (validate): Headers and segments must be inside the file\n");
+    assert(elf_validate_executable(header, sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr)) == false);
+    test_phdrs()[4].p_offset = TEST_FILE_SIZE - 0x10;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+    build_executable();
+    test_phdrs()[2].p_filesz = 0x4000;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+    build_executable();
+    printf("\t [test_elf] (validate): Segments can't be in the kernel half\n");
+    test_phdrs()[1].p_vaddr = 0xFFFFFFFF80000000;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+    build_executable();
+    header->e_ident[0] = 0;
+    assert(elf_validate_executable(header, TEST_FILE_SIZE) == false);
+}
+
+void test_plan_pages() {
+    Elf64_Ehdr *header = (Elf64_Ehdr *) test_file;
+    elf_page_t pages[ELF_MAX_PAGES];
+    build_executable();
+    printf("\t [test_elf] (plan_pages): Read-only pages with the same alignment are mapped from the module\n");
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS, TEST_FILE_SIZE, pages, ELF_MAX_PAGES) == 4);
+    assert(pages[0].vaddr == 0x400000 && pages[0].shared && !pages[0].writable);
+    assert(pages[0].phys == TEST_MODULE_PHYS);
+    assert(pages[1].vaddr == 0x600000 && pages[1].shared && !pages[1].writable);
+    assert(pages[1].phys == TEST_MODULE_PHYS + 0x200000);
+    printf("\t [test_elf] (plan_pages): Pages used by two segments are private\n");
+    assert(pages[2].vaddr == 0x800000 && !pages[2].shared && pages[2].writable && pages[2].phys == 0);
+    printf("\t [test_elf] (plan_pages): A misaligned read-only segment is copied\n");
+    assert(pages[3].vaddr == 0xA00000 && !pages[3].shared && !pages[3].writable);
+    printf("\t [test_elf] (plan_pages): Nothing is shared if the module is not aligned like the segments\n");
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS + 0x1000, TEST_FILE_SIZE, pages, ELF_MAX_PAGES) == 4);
+    for (int i = 0; i < 4; i++) {
+        assert(!pages[i].shared);
+    }
+    printf("\t [test_elf] (plan_pages): Writable pages can be shared until the first write\n");
+    test_phdrs()[1].p_flags = PF_R | PF_W;
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS, TEST_FILE_SIZE, pages, ELF_MAX_PAGES) == 4);
+    assert(pages[1].shared && pages[1].writable && pages[1].phys == TEST_MODULE_PHYS + 0x200000);
+    build_executable();
+    printf("\t [test_elf] (plan_pages): A page with bss is private\n");
+    test_phdrs()[1].p_memsz = 0x200;
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS, TEST_FILE_SIZE, pages, ELF_MAX_PAGES) == 4);
+    assert(pages[0].shared && !pages[1].shared);
+    build_executable();
+    printf("\t [test_elf] (plan_pages): A frame that is not entirely inside the module is copied\n");
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS, 0x300000, pages, ELF_MAX_PAGES) == 4);
+    assert(pages[0].shared && !pages[1].shared && pages[1].phys == 0);
+    printf("\t [test_elf] (plan_pages): Too many pages\n");
+    assert(elf_plan_pages(header, TEST_MODULE_PHYS, TEST_FILE_SIZE, pages, 3) == 0);
+}
+
+void test_copy_page() {
+    Elf64_Ehdr *header = (Elf64_Ehdr *) test_file;
+    build_executable();
+    printf("\t [test_elf] (copy_page): The data of every segment is copied, the bss is left zeroed\n");
+    memset(test_page, 0, sizeof(test_page));
+    elf_copy_page(header, 0x800000, test_page);
+    assert(memcmp(test_page + 0x1000, test_file + 0x201000, 0x20) == 0);
+    for (size_t i = 0x1020; i < 0x5010; i++) {
+        assert(test_page[i] == 0);
+    }
+    assert(memcmp(test_page + 0x5010, test_file + 0x300010, 0x10) == 0);
+    assert(test_page[0xFFF] == 0 && test_page[0x5020] == 0);
+    printf("\t [test_elf] (copy_page): A misaligned segment is copied at its address\n");
+    memset(test_page, 0, sizeof(test_page));
+    elf_copy_page(header, 0xA00000, test_page);
+    assert(memcmp(test_page, test_file + 0x400001, 0x40) == 0);
+    assert(test_page[0x40] == 0);
+}
@@ -0,0 +1,131 @@
+#include <fd_table.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_lowest_free();
+void test_grow();
+void test_release();
+void test_close_all();
+
+size_t closed_files = 0;
+
+// The table is the only user of the heap here, the host allocator is enough
+void *kmalloc(size_t size) {
+    return malloc(size);
+}
+
+void kfree(void *ptr) {
+    free(ptr);
+}
+
+// The drivers are not linked, only the closes are counted
+void vfs_close_file(vfs_file_descriptor_t *file) {
+    closed_files++;
+    file->fs_specific_id = -1;
+}
+
+int main() {
+    printf("Testing file descriptor tables\n");
+    test_lowest_free();
+    test_grow();
+    test_release();
+    test_close_all();
+    return 0;
+}
+
+void test_lowest_free() {
+    fd_table_t table;
+    fd_table_init(&table);
+    printf("\t [test_fd_table] (lowest_free): An empty table has no memory and no descriptors\n");
+    assert(table.size == 0);
+    assert(fd_table_get(&table, 0) == NULL);
+    printf("\t [test_fd_table] (lowest_free): Descriptors are allocated in order\n");
+    for (int i = 0; i < 10; i++) {
+        assert(fd_table_alloc(&table) == i);
+    }
+    assert(table.size == FD_TABLE_INITIAL_SIZE);
+    assert(table.opened_files == 10);
+    printf("\t [test_fd_table] (lowest_free): A released descriptor is the first to be reused\n");
+    assert(fd_table_release(&table, 3) == true);
+    assert(fd_table_release(&table, 7) == true);
+    assert(fd_table_get(&table, 3) == NULL);
+    assert(fd_table_alloc(&table) == 3);
+    assert(fd_table_alloc(&table) == 7);
+    assert(fd_table_alloc(&table) == 10);
+    printf("\t [test_fd_table] (lowest_free): The table lock is free after the updates\n");
+    assert(table.lock.state == 0 && table.lock.writers_waiting == 0);
+    fd_table_destroy(&table);
+    assert(table.size == 0 && table.files == NULL);
+}
+
+void test_grow() {
+    fd_table_t table;
+    fd_table_init(&table);
+    printf("\t [test_fd_table] (grow): The table doubles when it's full, keeping the descriptors\n");
+    for (int i = 0; i < FD_TABLE_INITIAL_SIZE; i++) {
+        assert(fd_table_alloc(&table) == i);
+        fd_table_get(&table, i)->offset = i;
+    }
+    assert(table.full_rows == 1);
+    assert(fd_table_alloc(&table) == FD_TABLE_INITIAL_SIZE);
+    assert(table.size == FD_TABLE_INITIAL_SIZE * 2);
+    for (int i = 0; i < FD_TABLE_INITIAL_SIZE; i++) {
+        assert(fd_table_get(&table, i)->offset == (size_t) i);
+    }
+    printf("\t [test_fd_table] (grow): The table can't grow over FD_TABLE_MAX_SIZE\n");
+    for (int i = FD_TABLE_INITIAL_SIZE + 1; i < FD_TABLE_MAX_SIZE; i++) {
+        assert(fd_table_alloc(&table) == i);
+    }
+    assert(table.full_rows == ~0ULL);
+    assert(fd_table_alloc(&table) == -1);
+    printf("\t [test_fd_table] (grow): A full table can reuse released descriptors\n");
+    assert(fd_table_release(&table, 2000) == true);
+    assert(table.full_rows != ~0ULL);
+    assert(fd_table_alloc(&table) == 2000);
+    fd_table_destroy(&table);
+}
+
+void test_release() {
+    fd_table_t table;
+    fd_table_init(&table);
+    printf("\t [test_fd_table] (release): Invalid descriptors can't be released\n");
+    assert(fd_table_release(&table, 0) == false);
+    assert(fd_table_alloc(&table) == 0);
+    assert(fd_table_release(&table, -1) == false);
+    assert(fd_table_release(&table, 1) == false);
+    assert(fd_table_release(&table, FD_TABLE_MAX_SIZE) == false);
+    assert(fd_table_release(&table, 0) == true);
+    assert(fd_table_release(&table, 0) == false);
+    assert(table.opened_files == 0);
+    printf("\t [test_fd_table] (release): A new descriptor starts with a clean state\n");
+    assert(fd_table_alloc(&table) == 0);
+    vfs_file_descriptor_t *file = fd_table_get(&table, 0);
+    assert(file->offset == 0 && file->fs_specific_id == -1 && file->mountpoint_id == -1);
+    printf("\t [test_fd_table] (release): A closed descriptor is closed by the driver once, and released\n");
+    closed_files = 0;
+    assert(fd_table_close(&table, 0) == true);
+    assert(fd_table_close(&table, 0) == false);
+    assert(closed_files == 1 && table.opened_files == 0);
+    assert(table.lock.state == 0);
+    fd_table_destroy(&table);
+}
+
+void test_close_all() {
+    fd_table_t table;
+    fd_table_init(&table);
+    closed_files = 0;
+    printf("\t [test_fd_table] (close_all): Every opened file is closed, in every row\n");
+    for (int i = 0; i < FD_TABLE_INITIAL_SIZE + 3; i++) {
+        assert(fd_table_alloc(&table) == i);
+    }
+    assert(fd_table_release(&table, 5) == true);
+    fd_table_close_all(&table);
+    assert(closed_files == FD_TABLE_INITIAL_SIZE + 2);
+    assert(table.opened_files == 0 && table.full_rows == 0);
+    assert(fd_table_get(&table, 0) == NULL && fd_table_get(&table, FD_TABLE_INITIAL_SIZE) == NULL);
+    printf("\t [test_fd_table] (close_all): An empty table has nothing to close\n");
+    fd_table_destroy(&table);
+    fd_table_close_all(&table);
+    assert(closed_files == FD_TABLE_INITIAL_SIZE + 2);
+}
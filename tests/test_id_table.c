@@ -0,0 +1,106 @@
+#include <id_table.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void test_alloc_lookup();
+void test_recycle();
+void test_full_table();
+
+size_t allocated_leaves = 0;
+
+// The table is the only user of the heap here, the host allocator is enough
+void *kmalloc(size_t size) {
+    allocated_leaves++;
+    return malloc(size);
+}
+
+void kfree(void *ptr) {
+    free(ptr);
+}
+
+int main() {
+    printf("Testing id tables\n");
+    test_alloc_lookup();
+    test_recycle();
+    test_full_table();
+    return 0;
+}
+
+void test_alloc_lookup() {
+    id_table_t table;
+    int objects[3];
+    id_table_init(&table);
+    allocated_leaves = 0;
+    printf("\t [test_id_table] (alloc_lookup): An empty table has no leaves and finds nothing\n");
+    assert(id_table_lookup(&table, 0) == NULL);
+    assert(id_table_lookup(&table, ID_TABLE_INVALID_ID) == NULL);
+    assert(allocated_leaves == 0);
+    printf("\t [test_id_table] (alloc_lookup): The ids are allocated in order, and find their objects\n");
+    for (uint32_t i = 0; i < 3; i++) {
+        assert(id_table_alloc(&table, &objects[i]) == i);
+    }
+    for (uint32_t i = 0; i < 3; i++) {
+        assert(id_table_lookup(&table, i) == &objects[i]);
+    }
+    assert(table.count == 3);
+    assert(allocated_leaves == 1);
+    printf("\t [test_id_table] (alloc_lookup): A NULL object is not accepted\n");
+    assert(id_table_alloc(&table, NULL) == ID_TABLE_INVALID_ID);
+    printf("\t [test_id_table] (alloc_lookup): An id never allocated is not found\n");
+    assert(id_table_lookup(&table, 3) == NULL);
+    assert(id_table_lookup(&table, ID_TABLE_LEAF_SIZE * 4) == NULL);
+}
+
+void test_recycle() {
+    id_table_t table;
+    int objects[4];
+    id_table_init(&table);
+    for (int i = 0; i < 3; i++) {
+        id_table_alloc(&table, &objects[i]);
+    }
+    printf("\t [test_id_table] (recycle): A released id is not found anymore\n");
+    assert(id_table_release(&table, 1) == true);
+    assert(id_table_lookup(&table, 1) == NULL);
+    assert(id_table_release(&table, 1) == false);
+    assert(table.count == 2);
+    printf("\t [test_id_table] (recycle): The released slot is reused with a new generation\n");
+    uint32_t id = id_table_alloc(&table, &objects[3]);
+    assert((id & ID_TABLE_INDEX_MASK) == 1);
+    assert((id >> ID_TABLE_INDEX_BITS) == 1);
+    assert(id_table_lookup(&table, id) == &objects[3]);
+    printf("\t [test_id_table] (recycle): The old id doesn't find the new object\n");
+    assert(id_table_lookup(&table, 1) == NULL);
+    assert(id_table_release(&table, 1) == false);
+    printf("\t [test_id_table] (recycle): The last released slot is the first reused\n");
+    assert(id_table_release(&table, 0) == true);
+    assert(id_table_release(&table, 2) == true);
+    assert((id_table_alloc(&table, &objects[2]) & ID_TABLE_INDEX_MASK) == 2);
+    assert((id_table_alloc(&table, &objects[0]) & ID_TABLE_INDEX_MASK) == 0);
+    assert((id_table_alloc(&table, &objects[1]) & ID_TABLE_INDEX_MASK) == 3);
+    printf("\t [test_id_table] (recycle): The generation wraps without producing the invalid id\n");
+    for (uint32_t i = 0; i <= ID_TABLE_GENERATION_MASK; i++) {
+        assert(id_table_release(&table, id) == true);
+        id = id_table_alloc(&table, &objects[3]);
+        assert(id != ID_TABLE_INVALID_ID);
+        assert((id & ID_TABLE_INDEX_MASK) == 1);
+    }
+    assert((id >> ID_TABLE_INDEX_BITS) == 1);
+}
+
+void test_full_table() {
+    id_table_t table;
+    int object;
+    id_table_init(&table);
+    allocated_leaves = 0;
+    printf("\t [test_id_table] (full_table): The table holds ID_TABLE_MAX_OBJECTS objects\n");
+    for (uint32_t i = 0; i < ID_TABLE_MAX_OBJECTS; i++) {
+        assert(id_table_alloc(&table, &object) == i);
+    }
+    assert(allocated_leaves == ID_TABLE_LEAVES);
+    assert(id_table_alloc(&table, &object) == ID_TABLE_INVALID_ID);
+    printf("\t [test_id_table] (full_table): A released id can be allocated again\n");
+    assert(id_table_release(&table, 0x1234) == true);
+    assert(id_table_alloc(&table, &object) == ((1 << ID_TABLE_INDEX_BITS) | 0x1234));
+    assert(table.count == ID_TABLE_MAX_OBJECTS);
+}
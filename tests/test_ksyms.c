@@ -0,0 +1,109 @@
+#include <ksyms.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// A small excerpt in the same format of the map generated by ld
+const char *test_map =
+    "Memory Configuration\n"
+    "\n"
+    "Name             Origin             Length             Attributes\n"
+    "*default*        0x0000000000000000 0xffffffffffffffff\n"
+    "\n"
+    "                0x0000000000100000                . = 0x100000\n"
+    "                0x0000000000100000                _kernel_start = .\n"
+    " .text          0xffffffff80101000      0x120 dist/kernel/main.o\n"
+    "                0xffffffff80101080                kernel_start\n"
+    "                0xffffffff80101000                _init_basic_system\n"
+    " .text          0xffffffff80101120       0x60 dist/kernel/scheduling/thread.o\n"
+    "                0xffffffff80101150                idle\r\n"
+    "                0xffffffff80101120                create_thread\n"
+    " .text.unlikely\n"
+    "                0xffffffff80101180       0x10 dist/kernel/logging.o\n"
+    "                0x0000000000001000                low_symbol\n"
+    "                0xffffffff80101190                last_function";
+
+// The same excerpt in the format of the map generated by ld.lld
+const char *test_lld_map =
+    "             VMA              LMA     Size Align Out     In      Symbol\n"
+    "               0                0   100000     1 . = 0x100000\n"
+    "          100000           100000        0     1 _kernel_start = .\n"
+    "ffffffff80101000 ffffffff80101000      1a0  4096 .text\n"
+    "ffffffff80101000 ffffffff80101000      120    16         dist/kernel/main.o:(.text)\n"
+    "ffffffff80101080 ffffffff80101080        0     1                 kernel_start\n"
+    "ffffffff80101000 ffffffff80101000       80     1                 _init_basic_system\n"
+    "ffffffff80101120 ffffffff80101120       60    16         dist/kernel/scheduling/thread.o:(.text)\n"
+    "ffffffff80101150 ffffffff80101150       30     1                 idle\r\n"
+    "ffffffff80101120 ffffffff80101120       30     1                 create_thread\n"
+    "            1000             1000        0     1                 low_symbol\n"
+    "ffffffff80101190 ffffffff80101190       10     1                 last_function";
+
+void test_parse();
+void test_parse_lld();
+void test_lookup();
+
+int main() {
+    printf("Testing kernel symbols\n");
+    test_parse();
+    test_parse_lld();
+    test_lookup();
+    return 0;
+}
+
+void test_parse() {
+    ksym_t symbols[16];
+    size_t map_size = strlen(test_map);
+    printf("\t [test_ksyms] (parse): Only the symbol lines above the minimum address should be counted\n");
+    assert(ksyms_parse(test_map, map_size, KSYMS_MIN_ADDRESS, NULL, 0) == 5);
+    printf("\t [test_ksyms] (parse): With a lower minimum address the low symbol is found too\n");
+    assert(ksyms_parse(test_map, map_size, 0x1000, NULL, 0) == 6);
+    printf("\t [test_ksyms] (parse): The array is filled with names and addresses\n");
+    assert(ksyms_parse(test_map, map_size, KSYMS_MIN_ADDRESS, symbols, 16) == 5);
+    assert(symbols[0].address == 0xffffffff80101080);
+    assert(symbols[0].name_length == strlen("kernel_start"));
+    assert(strncmp(symbols[0].name, "kernel_start", symbols[0].name_length) == 0);
+    printf("\t [test_ksyms] (parse): Windows line endings are ignored, and the last line doesn't need a new line\n");
+    assert(symbols[2].name_length == strlen("idle"));
+    assert(strncmp(symbols[4].name, "last_function", symbols[4].name_length) == 0);
+    printf("\t [test_ksyms] (parse): No more than max_symbols are stored\n");
+    assert(ksyms_parse(test_map, map_size, KSYMS_MIN_ADDRESS, symbols, 2) == 2);
+}
+
+void test_parse_lld() {
+    ksym_t symbols[16];
+    size_t map_size = strlen(test_lld_map);
+    printf("\t [test_ksyms] (parse_lld): Only the symbol lines are counted, not the output and input sections\n");
+    assert(ksyms_parse(test_lld_map, map_size, KSYMS_MIN_ADDRESS, NULL, 0) == 5);
+    assert(ksyms_parse(test_lld_map, map_size, 0x1000, NULL, 0) == 6);
+    printf("\t [test_ksyms] (parse_lld): The array is filled with names and addresses\n");
+    assert(ksyms_parse(test_lld_map, map_size, KSYMS_MIN_ADDRESS, symbols, 16) == 5);
+    assert(symbols[0].address == 0xffffffff80101080);
+    assert(strncmp(symbols[0].name, "kernel_start", symbols[0].name_length) == 0);
+    assert(symbols[2].address == 0xffffffff80101150);
+    assert(symbols[2].name_length == strlen("idle"));
+    assert(symbols[4].address == 0xffffffff80101190);
+    assert(strncmp(symbols[4].name, "last_function", symbols[4].name_length) == 0);
+}
+
+void test_lookup() {
+    ksym_t symbols[16];
+    ksyms_table_t table;
+    table.symbols = symbols;
+    table.count = ksyms_parse(test_map, strlen(test_map), KSYMS_MIN_ADDRESS, symbols, 16);
+    ksyms_sort(symbols, table.count);
+    printf("\t [test_ksyms] (lookup): The symbols should be sorted by address\n");
+    for (size_t i = 1; i < table.count; i++) {
+        assert(symbols[i - 1].address < symbols[i].address);
+    }
+    printf("\t [test_ksyms] (lookup): An address is resolved to the function containing it\n");
+    const ksym_t *symbol = ksyms_lookup(&table, 0xffffffff80101010);
+    assert(symbol != NULL && strncmp(symbol->name, "_init_basic_system", symbol->name_length) == 0);
+    symbol = ksyms_lookup(&table, 0xffffffff80101150);
+    assert(symbol != NULL && strncmp(symbol->name, "idle", symbol->name_length) == 0);
+    symbol = ksyms_lookup(&table, 0xffffffff801011a0);
+    assert(symbol != NULL && strncmp(symbol->name, "last_function", symbol->name_length) == 0);
+    printf("\t [test_ksyms] (lookup): Addresses before the first symbol are not resolved\n");
+    assert(ksyms_lookup(&table, 0xffffffff80100000) == NULL);
+    table.count = 0;
+    assert(ksyms_lookup(&table, 0xffffffff80101010) == NULL);
+}
@@ -0,0 +1,254 @@
+#include <lock_stats.h>
+#include <mcs_lock.h>
+#include <rwlock.h>
+#include <seqlock.h>
+#include <spinlock.h>
+#include <ticket_lock.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <logging.h>
+
+#define LOCK_THREADS    4
+#define INCREMENTS_PER_THREAD   50000
+// A fair lock hands the lock to a waiter that may not be running when there are more threads than cpus
+#define FAIR_INCREMENTS_PER_THREAD  2000
+
+size_t logTrimLevel = 0;
+size_t dumped_lines = 0;
+
+void loglinef(log_level_t level, const char* msg, ...) {
+    dumped_lines++;
+}
+
+// The counter is not atomic on purpose: a lost update means that two threads were in the critical section
+volatile uint64_t shared_counter;
+size_t workers;
+spinlock_t shared_spinlock;
+ticket_lock_t shared_ticket_lock;
+mcs_lock_t shared_mcs_lock;
+lock_stats_t ticket_stats;
+lock_stats_t mcs_stats;
+rwlock_t shared_rwlock;
+volatile uint64_t readers_inside;
+seqlock_t shared_seqlock;
+// Written as a pair under the seqlock, a reader must never see two different values
+uint64_t seq_first;
+uint64_t seq_second;
+volatile bool seq_writer_done;
+
+void test_spinlock_exclusion();
+void test_ticket_lock();
+void test_mcs_lock();
+void test_stats_list();
+void test_rwlock();
+void test_seqlock();
+
+int main() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = cpus < 2 ? 2 : (cpus > LOCK_THREADS ? LOCK_THREADS : cpus);
+    printf("Testing locks\n");
+    test_spinlock_exclusion();
+    test_ticket_lock();
+    test_mcs_lock();
+    test_stats_list();
+    test_rwlock();
+    test_seqlock();
+    return 0;
+}
+
+void *spinlock_worker(void *arg) {
+    for (size_t i = 0; i < INCREMENTS_PER_THREAD; i++) {
+        uint64_t flags = spinlock_acquire_irqsave(&shared_spinlock);
+        shared_counter++;
+        spinlock_release_irqrestore(&shared_spinlock, flags);
+    }
+    return NULL;
+}
+
+void *ticket_worker(void *arg) {
+    for (size_t i = 0; i < FAIR_INCREMENTS_PER_THREAD; i++) {
+        uint64_t flags = ticket_lock_acquire_irqsave(&shared_ticket_lock);
+        shared_counter++;
+        ticket_lock_release_irqrestore(&shared_ticket_lock, flags);
+    }
+    return NULL;
+}
+
+void *mcs_worker(void *arg) {
+    mcs_node_t node;
+    for (size_t i = 0; i < FAIR_INCREMENTS_PER_THREAD; i++) {
+        uint64_t flags = mcs_lock_acquire_irqsave(&shared_mcs_lock, &node);
+        shared_counter++;
+        mcs_lock_release_irqrestore(&shared_mcs_lock, &node, flags);
+    }
+    return NULL;
+}
+
+void run_workers(void *(*worker)(void *)) {
+    pthread_t threads[LOCK_THREADS];
+    shared_counter = 0;
+    for (size_t i = 0; i < workers; i++) {
+        assert(pthread_create(&threads[i], NULL, worker, NULL) == 0);
+    }
+    for (size_t i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+void test_spinlock_exclusion() {
+    spinlock_release(&shared_spinlock);
+    printf("\t [test_locks] (spinlock): Concurrent increments under the spinlock are not lost\n");
+    run_workers(spinlock_worker);
+    assert(shared_counter == workers * INCREMENTS_PER_THREAD);
+    assert(shared_spinlock.locked == false);
+}
+
+void test_ticket_lock() {
+    ticket_lock_init(&shared_ticket_lock, &ticket_stats, "test_ticket");
+    printf("\t [test_locks] (ticket_lock): try_acquire fails while the lock is held\n");
+    assert(ticket_lock_is_locked(&shared_ticket_lock) == false);
+    assert(ticket_lock_try_acquire(&shared_ticket_lock) == true);
+    assert(ticket_lock_is_locked(&shared_ticket_lock) == true);
+    assert(ticket_lock_try_acquire(&shared_ticket_lock) == false);
+    ticket_lock_release(&shared_ticket_lock);
+    assert(ticket_lock_is_locked(&shared_ticket_lock) == false);
+    assert(ticket_stats.acquisitions == 1 && ticket_stats.contended == 0);
+    printf("\t [test_locks] (ticket_lock): Concurrent increments are not lost, and every acquisition is counted\n");
+    run_workers(ticket_worker);
+    assert(shared_counter == workers * FAIR_INCREMENTS_PER_THREAD);
+    assert(ticket_lock_is_locked(&shared_ticket_lock) == false);
+    assert(ticket_stats.acquisitions == workers * FAIR_INCREMENTS_PER_THREAD + 1);
+    assert(ticket_stats.contended <= ticket_stats.acquisitions);
+    assert(ticket_stats.spins >= ticket_stats.contended);
+}
+
+void test_mcs_lock() {
+    mcs_node_t node;
+    mcs_node_t other_node;
+    mcs_lock_init(&shared_mcs_lock, &mcs_stats, "test_mcs");
+    printf("\t [test_locks] (mcs_lock): try_acquire fails while the lock is held\n");
+    assert(mcs_lock_try_acquire(&shared_mcs_lock, &node) == true);
+    assert(mcs_lock_try_acquire(&shared_mcs_lock, &other_node) == false);
+    mcs_lock_release(&shared_mcs_lock, &node);
+    assert(shared_mcs_lock.tail == NULL);
+    assert(mcs_stats.acquisitions == 1);
+    printf("\t [test_locks] (mcs_lock): Concurrent increments are not lost, and the lock ends free\n");
+    run_workers(mcs_worker);
+    assert(shared_counter == workers * FAIR_INCREMENTS_PER_THREAD);
+    assert(shared_mcs_lock.tail == NULL);
+    assert(mcs_stats.acquisitions == workers * FAIR_INCREMENTS_PER_THREAD + 1);
+    assert(mcs_stats.spins >= mcs_stats.contended);
+}
+
+void test_stats_list() {
+    size_t registered = 0;
+    printf("\t [test_locks] (stats_list): The registered counters are listed once, even if registered again\n");
+    ticket_lock_init(&shared_ticket_lock, &ticket_stats, "test_ticket");
+    for (lock_stats_t *stats = lock_stats_list(); stats != NULL; stats = stats->next) {
+        registered++;
+    }
+    assert(registered == 2);
+    assert(ticket_stats.acquisitions == 0 && ticket_stats.max_hold_cycles == 0);
+    printf("\t [test_locks] (stats_list): A lock without counters is not registered\n");
+    ticket_lock_t no_stats_lock;
+    ticket_lock_init(&no_stats_lock, NULL, "no_stats");
+    ticket_lock_acquire(&no_stats_lock);
+    ticket_lock_release(&no_stats_lock);
+    assert(lock_stats_list() == &mcs_stats);
+    printf("\t [test_locks] (stats_list): The dump has a header and one line per lock\n");
+    dumped_lines = 0;
+    lock_stats_dump();
+    assert(dumped_lines == 3);
+}
+
+void *rwlock_writer(void *arg) {
+    for (size_t i = 0; i < FAIR_INCREMENTS_PER_THREAD; i++) {
+        rwlock_write_acquire(&shared_rwlock);
+        assert(readers_inside == 0);
+        shared_counter++;
+        rwlock_write_release(&shared_rwlock);
+    }
+    return NULL;
+}
+
+void *rwlock_reader(void *arg) {
+    for (size_t i = 0; i < FAIR_INCREMENTS_PER_THREAD; i++) {
+        rwlock_read_acquire(&shared_rwlock);
+        __atomic_fetch_add(&readers_inside, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&readers_inside, 1, __ATOMIC_RELAXED);
+        rwlock_read_release(&shared_rwlock);
+    }
+    return NULL;
+}
+
+void test_rwlock() {
+    rwlock_init(&shared_rwlock);
+    printf("\t [test_locks] (rwlock): Many readers can hold the lock, a writer can't take it meanwhile\n");
+    rwlock_read_acquire(&shared_rwlock);
+    rwlock_read_acquire(&shared_rwlock);
+    assert(shared_rwlock.state == 2);
+    assert(rwlock_write_try_acquire(&shared_rwlock) == false);
+    rwlock_read_release(&shared_rwlock);
+    rwlock_read_release(&shared_rwlock);
+    assert(rwlock_write_try_acquire(&shared_rwlock) == true);
+    assert(shared_rwlock.state == RWLOCK_WRITER);
+    assert(rwlock_write_try_acquire(&shared_rwlock) == false);
+    rwlock_write_release(&shared_rwlock);
+    printf("\t [test_locks] (rwlock): Concurrent writers are serialized, and never run with readers\n");
+    pthread_t threads[LOCK_THREADS];
+    shared_counter = 0;
+    readers_inside = 0;
+    for (size_t i = 0; i < workers; i++) {
+        assert(pthread_create(&threads[i], NULL, i % 2 == 0 ? rwlock_writer : rwlock_reader, NULL) == 0);
+    }
+    for (size_t i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    assert(shared_counter == ((workers + 1) / 2) * FAIR_INCREMENTS_PER_THREAD);
+    assert(shared_rwlock.state == 0 && shared_rwlock.writers_waiting == 0);
+}
+
+void *seqlock_writer(void *arg) {
+    for (uint64_t i = 1; i <= INCREMENTS_PER_THREAD; i++) {
+        uint64_t flags = seqlock_write_acquire_irqsave(&shared_seqlock);
+        seq_first = i;
+        seq_second = i;
+        seqlock_write_release_irqrestore(&shared_seqlock, flags);
+    }
+    seq_writer_done = true;
+    return NULL;
+}
+
+void test_seqlock() {
+    pthread_t writer;
+    uint32_t sequence;
+    uint64_t first;
+    uint64_t second;
+    seqlock_init(&shared_seqlock);
+    printf("\t [test_locks] (seqlock): A write makes the readers that started before retry\n");
+    sequence = seqcount_read_begin(&shared_seqlock.count);
+    assert(seqcount_read_retry(&shared_seqlock.count, sequence) == false);
+    uint64_t flags = seqlock_write_acquire_irqsave(&shared_seqlock);
+    assert(shared_seqlock.count.sequence & 1);
+    seqlock_write_release_irqrestore(&shared_seqlock, flags);
+    assert(seqcount_read_retry(&shared_seqlock.count, sequence) == true);
+    printf("\t [test_locks] (seqlock): The readers always see a consistent pair while a writer updates it\n");
+    seq_first = 0;
+    seq_second = 0;
+    seq_writer_done = false;
+    assert(pthread_create(&writer, NULL, seqlock_writer, NULL) == 0);
+    while ( !seq_writer_done ) {
+        do {
+            sequence = seqcount_read_begin(&shared_seqlock.count);
+            first = seq_first;
+            second = seq_second;
+        } while ( seqcount_read_retry(&shared_seqlock.count, sequence) );
+        assert(first == second);
+    }
+    pthread_join(writer, NULL);
+    assert(seq_first == INCREMENTS_PER_THREAD && (shared_seqlock.count.sequence & 1) == 0);
+}
@@ -0,0 +1,143 @@
+#include <log_ring.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRODUCERS_NUMBER    4
+#define MESSAGES_PER_PRODUCER   20000
+
+log_ring_t ring;
+size_t pushed_messages[PRODUCERS_NUMBER];
+size_t producers_finished = 0;
+
+void test_push_pop();
+void test_full_ring();
+void test_binary_records();
+void test_concurrent_producers();
+
+int main() {
+    printf("Testing log ring buffer\n");
+    test_push_pop();
+    test_full_ring();
+    test_binary_records();
+    test_concurrent_producers();
+    return 0;
+}
+
+void test_push_pop() {
+    char long_message[LOG_RECORD_MESSAGE_LEN * 2];
+    log_record_t record;
+    log_ring_init(&ring);
+    printf("\t [test_log_ring] (push_pop): Pop on an empty ring should fail\n");
+    assert(log_ring_pop(&ring, &record) == false);
+    printf("\t [test_log_ring] (push_pop): Records should come out in order, with their level\n");
+    assert(log_ring_push(&ring, Info, "first"));
+    assert(log_ring_push(&ring, Error, "second"));
+    assert(log_ring_pop(&ring, &record));
+    assert(record.level == Info && strcmp(record.message, "first") == 0);
+    assert(log_ring_pop(&ring, &record));
+    assert(record.level == Error && strcmp(record.message, "second") == 0);
+    assert(log_ring_pop(&ring, &record) == false);
+    printf("\t [test_log_ring] (push_pop): Long messages should be truncated\n");
+    memset(long_message, 'x', sizeof(long_message) - 1);
+    long_message[sizeof(long_message) - 1] = '\0';
+    assert(log_ring_push(&ring, Verbose, long_message));
+    assert(log_ring_pop(&ring, &record));
+    assert(record.format == NULL && strlen(record.message) == LOG_RECORD_MESSAGE_LEN - 1);
+}
+
+void test_full_ring() {
+    char message[LOG_RECORD_MESSAGE_LEN];
+    log_record_t record;
+    log_ring_init(&ring);
+    printf("\t [test_log_ring] (full_ring): Pushing on a full ring should drop and count the message\n");
+    for (size_t i = 0; i < LOG_RING_SIZE; i++) {
+        sprintf(message, "message %zu", i);
+        assert(log_ring_push(&ring, Info, message));
+    }
+    assert(log_ring_push(&ring, Info, "dropped") == false);
+    assert(log_ring_push(&ring, Info, "dropped") == false);
+    assert(log_ring_dropped(&ring) == 2);
+    printf("\t [test_log_ring] (full_ring): After a pop there is space again, and the ring wraps around\n");
+    assert(log_ring_pop(&ring, &record));
+    assert(strcmp(record.message, "message 0") == 0);
+    assert(log_ring_push(&ring, Info, "wrapped"));
+    for (size_t i = 1; i < LOG_RING_SIZE; i++) {
+        assert(log_ring_pop(&ring, &record));
+    }
+    assert(log_ring_pop(&ring, &record));
+    assert(strcmp(record.message, "wrapped") == 0);
+    assert(log_ring_pop(&ring, &record) == false);
+}
+
+void test_binary_records() {
+    const char *format = "(%s): value: %d";
+    uint64_t values[2] = {(uint64_t) "test_binary_records", 42};
+    uint64_t too_many_values[LOG_RECORD_MAX_VALUES + 1];
+    log_record_t record;
+    log_ring_init(&ring);
+    printf("\t [test_log_ring] (binary): Binary records keep the format pointer and the raw values\n");
+    assert(log_ring_push_binary(&ring, Verbose, format, values, 2));
+    assert(log_ring_push(&ring, Info, "text"));
+    assert(log_ring_pop(&ring, &record));
+    assert(record.level == Verbose && record.format == format && record.values_count == 2);
+    assert(record.values[0] == values[0] && record.values[1] == 42);
+    assert(log_ring_pop(&ring, &record));
+    assert(record.format == NULL && strcmp(record.message, "text") == 0);
+    printf("\t [test_log_ring] (binary): Records with too many values are refused\n");
+    assert(log_ring_push_binary(&ring, Verbose, format, too_many_values, LOG_RECORD_MAX_VALUES + 1) == false);
+}
+
+void *producer_thread(void *arg) {
+    size_t producer_id = (size_t) arg;
+    char message[LOG_RECORD_MESSAGE_LEN];
+    for (size_t i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+        sprintf(message, "%zu %zu", producer_id, i);
+        if ( log_ring_push(&ring, Info, message) ) {
+            pushed_messages[producer_id]++;
+        }
+    }
+    __atomic_fetch_add(&producers_finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void test_concurrent_producers() {
+    pthread_t producers[PRODUCERS_NUMBER];
+    size_t last_message[PRODUCERS_NUMBER];
+    size_t popped_messages = 0;
+    log_record_t record;
+    log_ring_init(&ring);
+    producers_finished = 0;
+    printf("\t [test_log_ring] (concurrent): %d producers, every record is either consumed or counted as dropped\n", PRODUCERS_NUMBER);
+    for (size_t i = 0; i < PRODUCERS_NUMBER; i++) {
+        pushed_messages[i] = 0;
+        last_message[i] = (size_t) -1;
+        pthread_create(&producers[i], NULL, producer_thread, (void *) i);
+    }
+    bool running = true;
+    while ( running ) {
+        // Check the status before draining, so nothing pushed before the last producer finished is missed
+        running = __atomic_load_n(&producers_finished, __ATOMIC_ACQUIRE) < PRODUCERS_NUMBER;
+        while ( log_ring_pop(&ring, &record) ) {
+            size_t producer_id, message_id;
+            sscanf(record.message, "%zu %zu", &producer_id, &message_id);
+            assert(producer_id < PRODUCERS_NUMBER);
+            // Records of the same producer must keep their order
+            assert(last_message[producer_id] == (size_t) -1 || message_id > last_message[producer_id]);
+            last_message[producer_id] = message_id;
+            popped_messages++;
+        }
+    }
+    for (size_t i = 0; i < PRODUCERS_NUMBER; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    size_t total_pushed = 0;
+    for (size_t i = 0; i < PRODUCERS_NUMBER; i++) {
+        total_pushed += pushed_messages[i];
+    }
+    printf("\t [test_log_ring] (concurrent): pushed: %zu - popped: %zu - dropped: %lu\n", total_pushed, popped_messages, log_ring_dropped(&ring));
+    assert(total_pushed == popped_messages);
+    assert(total_pushed + log_ring_dropped(&ring) == PRODUCERS_NUMBER * MESSAGES_PER_PRODUCER);
+}
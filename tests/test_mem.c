@@ -4,6 +4,7 @@
 #include <test_mem.h>
 #include <test_common.h>
 #include <pmm.h>
+#include <hh_direct_map.h>
 #include <multiboot.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -12,11 +13,14 @@
 #include <video.h>
 #include <inttypes.h>
 #include <main.h>
+#include <string.h>
+#include <sys/mman.h>
 
 extern uint64_t *memory_map;
 extern uint32_t number_of_entries;
 extern uint32_t bitmap_size;
 extern uint32_t used_frames;
+extern void *pmm_zeroed_pool[];
 extern uint32_t mmap_number_of_entries;
 extern multiboot_memory_map_t *mmap_entries;
 
@@ -30,6 +34,7 @@ int main() {
     test_pmm_initialize();
     test_pmm();
     test_mmap();
+    test_pmm_zeroed_pool();
     return 0;
 }
 
@@ -186,3 +191,63 @@ void test_mmap(){
     printf("Finished\n");
 }
 
+
+static bool frame_is_zeroed(void *frame) {
+    uint8_t *data = hhdm_get_variable((uintptr_t) frame);
+    for (size_t i = 0; i < PAGE_SIZE_IN_BYTES; i++) {
+        if ( data[i] != 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_pmm_zeroed_pool(){
+    printf("Testing zeroed frames pool\n");
+    // The frames are zeroed through the direct map, so it must point to real memory: only the touched pages are allocated
+    size_t memory_size = (size_t) bitmap_size * PAGE_SIZE_IN_BYTES;
+    void *physical_memory = mmap(NULL, memory_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(physical_memory != MAP_FAILED);
+    test_hhdm_offset = (uintptr_t) physical_memory;
+    printf("\t [test_mem] (zeroed_pool): Pool should be empty after pmm_setup\n");
+    assert(pmm_zeroed_pool_count == 0);
+    // A dirty frame is freed, the refill takes the lowest free frame so it will be in the pool
+    void *dirty_frame = pmm_alloc_frame();
+    memset(hhdm_get_variable((uintptr_t) dirty_frame), 0xAA, PAGE_SIZE_IN_BYTES);
+    pmm_free_frame(dirty_frame);
+    uint32_t used_frames_before = used_frames;
+    size_t added = pmm_refill_zeroed_pool(2);
+    printf("\t [test_mem] (zeroed_pool): Refilled frames: %d - pool count: %d\n", added, pmm_zeroed_pool_count);
+    assert(added == 2);
+    assert(pmm_zeroed_pool_count == 2);
+    assert(used_frames == used_frames_before + 2);
+    printf("\t [test_mem] (zeroed_pool): The pooled frames are zeroed\n");
+    assert(pmm_zeroed_pool[0] == dirty_frame);
+    assert(frame_is_zeroed(pmm_zeroed_pool[0]));
+    printf("\t [test_mem] (zeroed_pool): Allocation should be served from the pool\n");
+    void *zeroed_frame = pmm_alloc_zeroed_frame();
+    assert(zeroed_frame != NULL);
+    assert(frame_is_zeroed(zeroed_frame));
+    assert(pmm_zeroed_pool_count == 1);
+    assert(used_frames == used_frames_before + 2);
+    printf("\t [test_mem] (zeroed_pool): The pool should never grow above its size\n");
+    pmm_refill_zeroed_pool(PMM_ZEROED_POOL_SIZE * 2);
+    assert(pmm_zeroed_pool_count <= PMM_ZEROED_POOL_SIZE);
+    printf("\t [test_mem] (zeroed_pool): When the memory runs out the pooled frames are handed out\n");
+    size_t pooled = pmm_zeroed_pool_count;
+    assert(pooled > 0);
+    void **frames = malloc(bitmap_size * sizeof(void *));
+    size_t allocated = 0;
+    while ( (frames[allocated] = pmm_alloc_frame()) != NULL ) {
+        allocated++;
+    }
+    assert(pmm_zeroed_pool_count == 0);
+    assert(allocated >= pooled);
+    for (size_t i = 0; i < allocated; i++) {
+        pmm_free_frame(frames[i]);
+    }
+    free(frames);
+    test_hhdm_offset = 0;
+    munmap(physical_memory, memory_size);
+    printf("Finished\n");
+}
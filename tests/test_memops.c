@@ -0,0 +1,98 @@
+#include <memops.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BUFFER_SIZE    0x3000
+
+typedef struct {
+    const char *name;
+    memcpy_function_t memcpy_function;
+    memset_function_t memset_function;
+} memops_variant_t;
+
+uint8_t source_buffer[TEST_BUFFER_SIZE];
+uint8_t destination_buffer[TEST_BUFFER_SIZE];
+uint8_t expected_buffer[TEST_BUFFER_SIZE];
+
+void test_variant(memops_variant_t *variant);
+void test_memmove_backward();
+void test_memcmp();
+
+int main() {
+    memops_variant_t variants[] = {
+        {"bytes", memcpy_bytes, memset_bytes},
+        {"qwords", memcpy_qwords, memset_qwords},
+        {"erms", memcpy_erms, memset_erms},
+        {"sse2", memcpy_sse2, memset_sse2},
+        {"avx2", memcpy_avx2, memset_avx2},
+    };
+    size_t variants_count = sizeof(variants) / sizeof(memops_variant_t);
+    if ( !__builtin_cpu_supports("avx2") ) {
+        printf("\t [test_memops] avx2 not supported by the host, skipping it\n");
+        variants_count--;
+    }
+    printf("Testing memory operations\n");
+    for (size_t i = 0; i < TEST_BUFFER_SIZE; i++) {
+        source_buffer[i] = (uint8_t) (i * 7 + 3);
+    }
+    for (size_t i = 0; i < variants_count; i++) {
+        test_variant(&variants[i]);
+    }
+    test_memmove_backward();
+    test_memcmp();
+    return 0;
+}
+
+void test_variant(memops_variant_t *variant) {
+    size_t sizes[] = {0, 1, 7, 8, 9, 63, 64, 65, 127, 128, 200, 0x3FF, 0x400, 0x401, 0x1000, 0x2000 - 3};
+    size_t offsets[] = {0, 1, 3, 8, 13};
+    printf("\t [test_memops] (%s) Testing copy and fill with different sizes and alignments\n", variant->name);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
+        for (size_t j = 0; j < sizeof(offsets) / sizeof(size_t); j++) {
+            for (size_t k = 0; k < sizeof(offsets) / sizeof(size_t); k++) {
+                size_t size = sizes[i];
+                uint8_t *dst = destination_buffer + offsets[j];
+                uint8_t *src = source_buffer + offsets[k];
+                // Bytes around the destination must not be touched
+                memset(destination_buffer, 0xAA, TEST_BUFFER_SIZE);
+                memcpy(expected_buffer, destination_buffer, TEST_BUFFER_SIZE);
+                memcpy(expected_buffer + offsets[j], src, size);
+                assert(variant->memcpy_function(dst, src, size) == dst);
+                assert(memcmp(destination_buffer, expected_buffer, TEST_BUFFER_SIZE) == 0);
+
+                memset(expected_buffer + offsets[j], 0x5C, size);
+                assert(variant->memset_function(dst, 0x15C, size) == dst);
+                assert(memcmp(destination_buffer, expected_buffer, TEST_BUFFER_SIZE) == 0);
+            }
+        }
+    }
+}
+
+void test_memmove_backward() {
+    printf("\t [test_memops] (memcpy_backward) Testing overlapping copy with dest after src\n");
+    for (size_t shift = 1; shift < 20; shift++) {
+        memcpy(destination_buffer, source_buffer, TEST_BUFFER_SIZE);
+        memcpy(expected_buffer, source_buffer, TEST_BUFFER_SIZE);
+        memmove(expected_buffer + shift, expected_buffer, 0x1000 + 5);
+        memcpy_backward(destination_buffer + shift, destination_buffer, 0x1000 + 5);
+        assert(memcmp(destination_buffer, expected_buffer, TEST_BUFFER_SIZE) == 0);
+    }
+}
+
+void test_memcmp() {
+    printf("\t [test_memops] (memcmp_qwords) Testing comparison sign and length\n");
+    memcpy(destination_buffer, source_buffer, TEST_BUFFER_SIZE);
+    memcpy(expected_buffer, source_buffer, TEST_BUFFER_SIZE);
+    assert(memcmp_qwords(destination_buffer, expected_buffer, TEST_BUFFER_SIZE) == 0);
+    for (size_t position = 0; position < 40; position++) {
+        destination_buffer[position] = 0xFF;
+        expected_buffer[position] = 0x00;
+        assert(memcmp_qwords(destination_buffer, expected_buffer, 41) == 1);
+        assert(memcmp_qwords(expected_buffer, destination_buffer, 41) == -1);
+        assert(memcmp_qwords(expected_buffer, destination_buffer, position) == 0);
+        destination_buffer[position] = source_buffer[position];
+        expected_buffer[position] = source_buffer[position];
+    }
+}
@@ -0,0 +1,181 @@
+#include <page_cache.h>
+#include <pmm.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FILE_SIZE  (PAGE_CACHE_PAGE_SIZE * 40 + 100)
+
+uint8_t test_file[TEST_FILE_SIZE];
+size_t test_driver_reads = 0;
+size_t test_frames = 0;
+size_t test_max_frames = 1;
+size_t test_freed_frames = 0;
+pmm_reclaim_t test_reclaim = NULL;
+
+void test_cached_reads();
+void test_readahead();
+void test_eviction();
+
+// The frames are allocated from the host, test_max_frames simulates the memory pressure
+void *pmm_alloc_frame() {
+    if ( test_frames == test_max_frames ) {
+        return NULL;
+    }
+    void *frame = NULL;
+    if ( posix_memalign(&frame, PAGE_SIZE_IN_BYTES, PAGE_SIZE_IN_BYTES) != 0 ) {
+        return NULL;
+    }
+    test_frames++;
+    return frame;
+}
+
+void pmm_free_frame(void *address) {
+    test_frames--;
+    test_freed_frames++;
+    free(address);
+}
+
+void pmm_set_reclaim(pmm_reclaim_t reclaim) {
+    test_reclaim = reclaim;
+}
+
+ssize_t test_driver_pread(int fildes, char *buf, size_t nbytes, size_t offset) {
+    test_driver_reads++;
+    if ( offset >= TEST_FILE_SIZE ) {
+        return 0;
+    }
+    if ( nbytes > TEST_FILE_SIZE - offset ) {
+        nbytes = TEST_FILE_SIZE - offset;
+    }
+    memcpy(buf, test_file + offset, nbytes);
+    return nbytes;
+}
+
+void test_open_file(vfs_file_descriptor_t *file, int mountpoint_id, const void *node) {
+    memset(file, 0, sizeof(vfs_file_descriptor_t));
+    file->fs_specific_id = 1;
+    file->mountpoint_id = mountpoint_id;
+    file->node = node;
+    file->readahead_last_page = PAGE_CACHE_NO_PAGE;
+}
+
+int main() {
+    printf("Testing page cache\n");
+    for (size_t i = 0; i < TEST_FILE_SIZE; i++) {
+        test_file[i] = (uint8_t) (i * 7 + i / PAGE_CACHE_PAGE_SIZE);
+    }
+    vfs_init();
+    fs_file_operations_t operations;
+    memset(&operations, 0, sizeof(fs_file_operations_t));
+    operations.pread = test_driver_pread;
+    assert(mount_fs("/test", "TestFS", operations) == 4);
+    init_page_cache();
+    test_cached_reads();
+    test_readahead();
+    test_eviction();
+    return 0;
+}
+
+void test_cached_reads() {
+    vfs_file_descriptor_t file;
+    uint8_t buffer[PAGE_CACHE_PAGE_SIZE * 2];
+    test_open_file(&file, 4, "file_a");
+    printf("\t [test_page_cache] (cached_reads): A read across two pages returns the file content\n");
+    size_t offset = PAGE_CACHE_PAGE_SIZE * 10 + 500;
+    assert(page_cache_read(&file, buffer, sizeof(buffer), offset) == sizeof(buffer));
+    assert(memcmp(buffer, test_file + offset, sizeof(buffer)) == 0);
+    size_t driver_reads = test_driver_reads;
+    assert(driver_reads == 3);
+
+    printf("\t [test_page_cache] (cached_reads): The same read from another descriptor doesn't call the driver\n");
+    vfs_file_descriptor_t second_file;
+    test_open_file(&second_file, 4, "file_a");
+    memset(buffer, 0, sizeof(buffer));
+    assert(page_cache_read(&second_file, buffer, sizeof(buffer), offset) == sizeof(buffer));
+    assert(memcmp(buffer, test_file + offset, sizeof(buffer)) == 0);
+    assert(test_driver_reads == driver_reads);
+
+    printf("\t [test_page_cache] (cached_reads): Different files don't share the pages\n");
+    vfs_file_descriptor_t other_file;
+    test_open_file(&other_file, 4, "file_b");
+    assert(page_cache_read(&other_file, buffer, 10, offset) == 10);
+    assert(test_driver_reads == driver_reads + 1);
+
+    printf("\t [test_page_cache] (cached_reads): Reads stop at the end of the file\n");
+    assert(page_cache_read(&file, buffer, sizeof(buffer), TEST_FILE_SIZE - 50) == 50);
+    assert(memcmp(buffer, test_file + TEST_FILE_SIZE - 50, 50) == 0);
+    assert(page_cache_read(&file, buffer, sizeof(buffer), TEST_FILE_SIZE) == 0);
+    page_cache_invalidate();
+}
+
+void test_readahead() {
+    vfs_file_descriptor_t file;
+    uint8_t buffer[PAGE_CACHE_PAGE_SIZE];
+    test_open_file(&file, 4, "file_c");
+    printf("\t [test_page_cache] (readahead): Sequential reads load the next pages in advance\n");
+    size_t readahead_pages = page_cache.stats.readahead_pages;
+    size_t offset = 0;
+    for (int i = 0; i < 8; i++) {
+        assert(page_cache_read(&file, buffer, sizeof(buffer), offset) == sizeof(buffer));
+        assert(memcmp(buffer, test_file + offset, sizeof(buffer)) == 0);
+        offset += sizeof(buffer);
+    }
+    assert(page_cache.stats.readahead_pages > readahead_pages);
+    assert(file.readahead_window == PAGE_CACHE_READAHEAD_MAX);
+    size_t misses = page_cache.stats.misses;
+    assert(page_cache_read(&file, buffer, sizeof(buffer), offset) == sizeof(buffer));
+    assert(page_cache.stats.misses == misses);
+
+    printf("\t [test_page_cache] (readahead): A random read resets the window\n");
+    assert(page_cache_read(&file, buffer, 10, 3) == 10);
+    assert(file.readahead_window == 0);
+    page_cache_invalidate();
+}
+
+void test_eviction() {
+    vfs_file_descriptor_t file;
+    uint8_t buffer[16];
+    test_open_file(&file, 4, "file_d");
+    printf("\t [test_page_cache] (eviction): When the pmm has no frames the least recently used pages are replaced\n");
+    size_t pages_per_frame = PAGE_CACHE_PAGES_PER_FRAME;
+    assert(page_cache.frames_count == 1);
+    for (size_t i = 0; i < pages_per_frame + 10; i++) {
+        // Random access, so there is no readahead
+        size_t page = (i * 13) % 40;
+        assert(page_cache_read(&file, buffer, sizeof(buffer), page * PAGE_CACHE_PAGE_SIZE + i % 4) == sizeof(buffer));
+        assert(memcmp(buffer, test_file + page * PAGE_CACHE_PAGE_SIZE + i % 4, sizeof(buffer)) == 0);
+    }
+    for (size_t i = 0; i < pages_per_frame; i++) {
+        vfs_file_descriptor_t other_file;
+        test_open_file(&other_file, 4, test_file + i);
+        assert(page_cache_read(&other_file, buffer, sizeof(buffer), (i % 40) * PAGE_CACHE_PAGE_SIZE) == sizeof(buffer));
+    }
+    assert(page_cache.frames_count == 1);
+    assert(page_cache.stats.evictions > 0);
+    printf("\t [test_page_cache] (eviction): The cache is the pmm reclaim function\n");
+    assert(test_reclaim == page_cache_shrink);
+    printf("\t [test_page_cache] (eviction): Shrinking the cache gives the frame back to the pmm\n");
+    size_t evictions = page_cache.stats.evictions;
+    assert(page_cache_shrink(1) == 1);
+    assert(test_freed_frames == 1);
+    assert(test_frames == 0);
+    assert(page_cache.frames_count == 0);
+    assert(page_cache.lru_head == PAGE_CACHE_NONE);
+    assert(page_cache.free_pages == PAGE_CACHE_NONE);
+    assert(page_cache.stats.evictions == evictions + pages_per_frame);
+    assert(page_cache_shrink(1) == 0);
+    printf("\t [test_page_cache] (eviction): After a shrink the pages are read again in a new frame\n");
+    size_t driver_reads = test_driver_reads;
+    assert(page_cache_read(&file, buffer, sizeof(buffer), 0) == sizeof(buffer));
+    assert(memcmp(buffer, test_file, sizeof(buffer)) == 0);
+    assert(test_driver_reads == driver_reads + 1);
+    assert(page_cache.frames_count == 1);
+    printf("\t [test_page_cache] (eviction): A frame without cached pages is freed before evicting\n");
+    page_cache_invalidate();
+    evictions = page_cache.stats.evictions;
+    assert(page_cache_shrink(1) == 1);
+    assert(page_cache.stats.evictions == evictions);
+    assert(test_frames == 0);
+}
@@ -0,0 +1,132 @@
+#include <rcu.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_CPUS   2
+
+void test_grace_period();
+void test_callbacks_order();
+void test_read_nesting();
+void test_synchronize();
+
+size_t yields = 0;
+size_t invoked_order[4];
+size_t invoked_count = 0;
+
+// The test has no scheduler: a yield is a context switch on every cpu
+void scheduler_yield() {
+    yields++;
+    for (size_t cpu = 0; cpu < TEST_CPUS; cpu++) {
+        rcu_quiescent_state(cpu);
+    }
+}
+
+typedef struct {
+    size_t id;
+    rcu_head_t rcu;
+} test_object_t;
+
+void test_object_free(rcu_head_t *head) {
+    test_object_t *object = (test_object_t *) ((uintptr_t) head - __builtin_offsetof(test_object_t, rcu));
+    invoked_order[invoked_count++] = object->id;
+}
+
+int main() {
+    printf("Testing rcu\n");
+    test_grace_period();
+    test_callbacks_order();
+    test_read_nesting();
+    test_synchronize();
+    return 0;
+}
+
+void test_grace_period() {
+    test_object_t object = { .id = 1 };
+    init_rcu(TEST_CPUS);
+    invoked_count = 0;
+    printf("\t [test_rcu] (grace_period): A callback doesn't run before every cpu passed a quiescent state\n");
+    call_rcu(&object.rcu, test_object_free);
+    assert(rcu_process_callbacks() == 0);
+    rcu_quiescent_state(0);
+    // A second quiescent state of the same cpu doesn't count
+    rcu_quiescent_state(0);
+    assert(rcu_completed_grace_period() == 0);
+    assert(rcu_process_callbacks() == 0);
+    rcu_quiescent_state(1);
+    assert(rcu_completed_grace_period() == 1);
+    printf("\t [test_rcu] (grace_period): After the grace period the callback runs once\n");
+    assert(rcu_process_callbacks() == 1);
+    assert(invoked_count == 1 && invoked_order[0] == 1);
+    assert(rcu_process_callbacks() == 0);
+    assert(rcu_stats.queued == 1 && rcu_stats.invoked == 1 && rcu_stats.grace_periods == 1);
+    printf("\t [test_rcu] (grace_period): Without callbacks no grace period is started\n");
+    rcu_quiescent_state(0);
+    rcu_quiescent_state(1);
+    assert(rcu_completed_grace_period() == 1);
+}
+
+void test_callbacks_order() {
+    test_object_t objects[3] = { { .id = 0 }, { .id = 1 }, { .id = 2 } };
+    init_rcu(TEST_CPUS);
+    invoked_count = 0;
+    call_rcu(&objects[0].rcu, test_object_free);
+    rcu_quiescent_state(0);
+    printf("\t [test_rcu] (callbacks_order): A callback queued during a grace period waits for the next one\n");
+    call_rcu(&objects[1].rcu, test_object_free);
+    call_rcu(&objects[2].rcu, test_object_free);
+    rcu_quiescent_state(1);
+    assert(rcu_completed_grace_period() == 1);
+    assert(rcu_process_callbacks() == 1);
+    assert(invoked_count == 1 && invoked_order[0] == 0);
+    printf("\t [test_rcu] (callbacks_order): The next grace period is started for the waiting callbacks\n");
+    rcu_quiescent_state(1);
+    rcu_quiescent_state(0);
+    assert(rcu_completed_grace_period() == 2);
+    assert(rcu_process_callbacks() == 2);
+    assert(invoked_count == 3 && invoked_order[1] == 1 && invoked_order[2] == 2);
+    assert(rcu_stats.grace_periods == 2);
+}
+
+void test_read_nesting() {
+    init_rcu(TEST_CPUS);
+    printf("\t [test_rcu] (read_nesting): The cpu stays in the read section until the outer unlock\n");
+    assert(rcu_read_locked(RCU_BOOT_CPU) == false);
+    rcu_read_lock();
+    rcu_read_lock();
+    assert(rcu_read_locked(RCU_BOOT_CPU) == true);
+    rcu_read_unlock();
+    assert(rcu_read_locked(RCU_BOOT_CPU) == true);
+    rcu_read_unlock();
+    assert(rcu_read_locked(RCU_BOOT_CPU) == false);
+    printf("\t [test_rcu] (read_nesting): The sections left open by a dead thread are closed\n");
+    rcu_read_lock();
+    rcu_read_lock();
+    assert(rcu_read_abandon(RCU_BOOT_CPU) == 2);
+    assert(rcu_read_locked(RCU_BOOT_CPU) == false);
+    assert(rcu_read_abandon(RCU_BOOT_CPU) == 0);
+    printf("\t [test_rcu] (read_nesting): A pointer published with rcu_assign_pointer is read back\n");
+    test_object_t object = { .id = 7 };
+    test_object_t *published = NULL;
+    rcu_assign_pointer(published, &object);
+    rcu_read_lock();
+    assert(rcu_dereference(published)->id == 7);
+    rcu_read_unlock();
+}
+
+void test_synchronize() {
+    test_object_t object = { .id = 3 };
+    init_rcu(TEST_CPUS);
+    invoked_count = 0;
+    yields = 0;
+    printf("\t [test_rcu] (synchronize): synchronize_rcu returns after a full grace period\n");
+    synchronize_rcu();
+    assert(yields == 1 && rcu_completed_grace_period() == 1);
+    printf("\t [test_rcu] (synchronize): A grace period already running is not enough\n");
+    call_rcu(&object.rcu, test_object_free);
+    rcu_quiescent_state(0);
+    yields = 0;
+    synchronize_rcu();
+    assert(yields == 2 && rcu_completed_grace_period() == 3);
+    assert(rcu_process_callbacks() == 1 && invoked_order[0] == 3);
+}
@@ -0,0 +1,212 @@
+#include <condvar.h>
+#include <mutex.h>
+#include <semaphore.h>
+#include <wait_queue.h>
+#include <scheduler.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <logging.h>
+
+#define TEST_THREADS    3
+
+void test_wait_queue();
+void test_mutex();
+void test_mutex_spin();
+void test_semaphore();
+void test_condvar();
+
+size_t logTrimLevel = 0;
+bool trace_active = false;
+thread_t *current_executing_thread;
+thread_t threads[TEST_THREADS];
+size_t yields = 0;
+// Run when a thread blocks: it plays the part of the other threads, that must wake the blocked one
+void (*on_block)() = NULL;
+
+mutex_t test_mutex_lock;
+lock_stats_t test_mutex_stats;
+semaphore_t test_semaphore_units;
+condvar_t test_condvar_cond;
+bool test_condition;
+
+void loglinef(log_level_t level, const char* msg, ...) {
+}
+
+void trace_record(uint16_t event_id, uint64_t arg0, uint64_t arg1) {
+}
+
+// There is no scheduler: a yield runs the other threads through on_block, then comes back to the thread that yielded
+void scheduler_yield() {
+    thread_t *thread = current_executing_thread;
+    yields++;
+    if ( on_block != NULL ) {
+        on_block();
+    }
+    current_executing_thread = thread;
+    if ( thread->status == READY ) {
+        thread->status = RUN;
+    }
+}
+
+void thread_wakeup(thread_t *thread) {
+    if ( thread->status == SLEEP || thread->status == WAIT ) {
+        thread->status = READY;
+    }
+}
+
+void run_as(size_t id) {
+    current_executing_thread = &threads[id];
+    threads[id].status = RUN;
+}
+
+int main() {
+    for (size_t i = 0; i < TEST_THREADS; i++) {
+        threads[i].tid = i;
+        threads[i].status = READY;
+    }
+    printf("Testing blocking synchronization\n");
+    test_wait_queue();
+    test_mutex();
+    test_mutex_spin();
+    test_semaphore();
+    test_condvar();
+    return 0;
+}
+
+void test_wait_queue() {
+    wait_queue_t queue;
+    wait_queue_init(&queue);
+    on_block = NULL;
+    printf("\t [test_sync] (wait_queue): A blocked thread is in the WAIT state and queued in order\n");
+    assert(wait_queue_is_empty(&queue));
+    assert(wait_queue_wake_one(&queue) == NULL);
+    for (size_t i = 0; i < TEST_THREADS; i++) {
+        run_as(i);
+        wait_queue_sleep(&queue);
+        assert(threads[i].status == WAIT);
+    }
+    assert(queue.head == &threads[0] && queue.tail == &threads[2]);
+    printf("\t [test_sync] (wait_queue): The threads are woken first in, first out\n");
+    assert(wait_queue_wake_one(&queue) == &threads[0]);
+    assert(threads[0].status == READY && threads[1].status == WAIT);
+    assert(queue.head == &threads[1]);
+    printf("\t [test_sync] (wait_queue): wake_all empties the queue\n");
+    assert(wait_queue_wake_all(&queue) == 2);
+    assert(threads[1].status == READY && threads[2].status == READY);
+    assert(wait_queue_is_empty(&queue) && queue.tail == NULL);
+    assert(queue.lock.locked == false);
+}
+
+void mutex_release_by_owner() {
+    assert(test_mutex_lock.waiters.head == &threads[1] && threads[1].status == WAIT);
+    run_as(0);
+    mutex_release(&test_mutex_lock);
+    assert(test_mutex_lock.owner == &threads[1] && threads[1].status == READY);
+    threads[0].status = READY;
+}
+
+void test_mutex() {
+    mutex_init(&test_mutex_lock, &test_mutex_stats, "test_mutex");
+    on_block = mutex_release_by_owner;
+    printf("\t [test_sync] (mutex): A free mutex is taken without blocking\n");
+    run_as(0);
+    yields = 0;
+    mutex_acquire(&test_mutex_lock);
+    assert(test_mutex_lock.owner == &threads[0] && mutex_is_owned(&test_mutex_lock));
+    assert(yields == 0);
+    printf("\t [test_sync] (mutex): A thread blocks while a preempted owner holds it, and gets it on release\n");
+    threads[0].status = READY;
+    run_as(1);
+    assert(mutex_try_acquire(&test_mutex_lock) == false);
+    mutex_acquire(&test_mutex_lock);
+    assert(yields == 1);
+    assert(test_mutex_lock.owner == &threads[1] && wait_queue_is_empty(&test_mutex_lock.waiters));
+    assert(test_mutex_stats.acquisitions == 2 && test_mutex_stats.contended == 1 && test_mutex_stats.spins == 1);
+    printf("\t [test_sync] (mutex): The release without waiters leaves it free\n");
+    mutex_release(&test_mutex_lock);
+    assert(test_mutex_lock.owner == NULL && test_mutex_lock.waiters.lock.locked == false);
+    assert(mutex_try_acquire(&test_mutex_lock) == true);
+    mutex_release(&test_mutex_lock);
+}
+
+void test_mutex_spin() {
+    mutex_init(&test_mutex_lock, &test_mutex_stats, "test_mutex");
+    on_block = mutex_release_by_owner;
+    run_as(0);
+    mutex_acquire(&test_mutex_lock);
+    printf("\t [test_sync] (mutex_spin): While the owner is running a waiter spins a bounded time before blocking\n");
+    // The owner stays RUN, as if it was running on another cpu
+    current_executing_thread = &threads[1];
+    threads[1].status = RUN;
+    yields = 0;
+    mutex_acquire(&test_mutex_lock);
+    assert(yields == 1 && test_mutex_lock.owner == &threads[1]);
+    assert(test_mutex_stats.spins == MUTEX_SPIN_LIMIT + 1);
+    mutex_release(&test_mutex_lock);
+}
+
+void semaphore_up_by_interrupt() {
+    assert(test_semaphore_units.waiters.head == &threads[0]);
+    semaphore_up(&test_semaphore_units);
+    assert(threads[0].status == READY);
+}
+
+void test_semaphore() {
+    semaphore_init(&test_semaphore_units, 2);
+    on_block = semaphore_up_by_interrupt;
+    run_as(0);
+    printf("\t [test_sync] (semaphore): The units are taken without blocking until they run out\n");
+    yields = 0;
+    semaphore_down(&test_semaphore_units);
+    assert(semaphore_try_down(&test_semaphore_units) == true);
+    assert(semaphore_try_down(&test_semaphore_units) == false);
+    assert(yields == 0 && test_semaphore_units.count == 0);
+    printf("\t [test_sync] (semaphore): Without units the thread blocks, and the unit given back goes to it\n");
+    semaphore_down(&test_semaphore_units);
+    assert(yields == 1 && test_semaphore_units.count == 0);
+    assert(wait_queue_is_empty(&test_semaphore_units.waiters));
+    printf("\t [test_sync] (semaphore): Without waiters a unit given back is counted\n");
+    semaphore_up(&test_semaphore_units);
+    semaphore_up(&test_semaphore_units);
+    assert(test_semaphore_units.count == 2);
+}
+
+void condvar_signal_by_other() {
+    assert(test_mutex_lock.owner == NULL);
+    assert(test_condvar_cond.waiters.head == &threads[0] && threads[0].status == WAIT);
+    run_as(1);
+    mutex_acquire(&test_mutex_lock);
+    test_condition = true;
+    condvar_signal(&test_condvar_cond);
+    assert(threads[0].status == READY);
+    mutex_release(&test_mutex_lock);
+}
+
+void test_condvar() {
+    mutex_init(&test_mutex_lock, NULL, NULL);
+    condvar_init(&test_condvar_cond);
+    on_block = condvar_signal_by_other;
+    test_condition = false;
+    run_as(0);
+    printf("\t [test_sync] (condvar): The wait releases the mutex, and takes it back after the signal\n");
+    mutex_acquire(&test_mutex_lock);
+    yields = 0;
+    while ( !test_condition ) {
+        condvar_wait(&test_condvar_cond, &test_mutex_lock);
+    }
+    assert(yields == 1 && test_mutex_lock.owner == &threads[0]);
+    mutex_release(&test_mutex_lock);
+    printf("\t [test_sync] (condvar): A signal without waiters is lost, a broadcast wakes everyone\n");
+    condvar_signal(&test_condvar_cond);
+    assert(wait_queue_is_empty(&test_condvar_cond.waiters));
+    on_block = NULL;
+    for (size_t i = 0; i < TEST_THREADS; i++) {
+        run_as(i);
+        wait_queue_sleep(&test_condvar_cond.waiters);
+    }
+    condvar_broadcast(&test_condvar_cond);
+    for (size_t i = 0; i < TEST_THREADS; i++) {
+        assert(threads[i].status == READY);
+    }
+}
@@ -0,0 +1,142 @@
+#include <ustar.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <test_common.h>
+
+#define TEST_ARCHIVE_BLOCKS 16
+
+uint8_t test_archive[TEST_ARCHIVE_BLOCKS * HEADER_SIZE] __attribute__((aligned(HEADER_SIZE)));
+size_t test_archive_offset = 0;
+
+const char *long_content = "This file is longer than the buffers used by the read test";
+
+void test_mount();
+void test_lookup();
+void test_read();
+void test_invalid_archive();
+
+// Append an entry in the same format produced by tar --format=ustar
+void add_entry(const char *prefix, const char *name, char type, const char *content) {
+    ustar_item *header = (ustar_item *) (test_archive + test_archive_offset);
+    size_t size = content != NULL ? strlen(content) : 0;
+    memset(header, 0, HEADER_SIZE);
+    strncpy(header->filename, name, USTAR_FILENAME_SIZE);
+    if ( prefix != NULL ) {
+        strncpy(header->prefix, prefix, USTAR_PREFIX_SIZE);
+    }
+    snprintf(header->file_mode, sizeof(header->file_mode), "%07o", 0644);
+    snprintf(header->size, sizeof(header->size), "%011zo", size);
+    header->type = type;
+    memcpy(header->magic, USTAR_MAGIC, 6);
+    memcpy(header->version, USTAR_VERSION, 2);
+    memset(header->checksum, ' ', sizeof(header->checksum));
+    unsigned int checksum = 0;
+    for (size_t i = 0; i < HEADER_SIZE; i++) {
+        checksum += ((uint8_t *) header)[i];
+    }
+    snprintf(header->checksum, sizeof(header->checksum), "%06o", checksum);
+    test_archive_offset += HEADER_SIZE;
+    if ( size > 0 ) {
+        memcpy(test_archive + test_archive_offset, content, size);
+        test_archive_offset += (size + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1);
+    }
+}
+
+int main() {
+    printf("Testing ustar driver\n");
+    add_entry(NULL, "./", USTAR_TYPE_DIRECTORY, NULL);
+    add_entry(NULL, "./hello.txt", USTAR_TYPE_FILE, "Hello from the initrd");
+    add_entry(NULL, "./etc/", USTAR_TYPE_DIRECTORY, NULL);
+    add_entry(NULL, "./etc/motd", USTAR_TYPE_FILE, long_content);
+    add_entry("./very/long/path", "empty", USTAR_TYPE_FILE, NULL);
+    test_mount();
+    test_lookup();
+    test_read();
+    test_invalid_archive();
+    return 0;
+}
+
+void test_mount() {
+    printf("\t [test_ustar] (mount): The archive should be indexed until the end marker\n");
+    assert(ustar_mount(test_archive, sizeof(test_archive)) == true);
+    assert(ustar_fs.entries_count == 5);
+    assert(ustar_fs.entries[1].size == strlen("Hello from the initrd"));
+    assert(ustar_fs.entries[1].data == (const char *) test_archive + 2 * HEADER_SIZE);
+}
+
+void test_lookup() {
+    printf("\t [test_ustar] (lookup): Paths are found regardless of the leading and trailing /\n");
+    const ustar_index_entry_t *entry = ustar_lookup("/hello.txt");
+    assert(entry != NULL);
+    assert(entry == &ustar_fs.entries[1]);
+    assert(ustar_lookup("hello.txt") == entry);
+    assert(ustar_lookup("/etc/motd") == &ustar_fs.entries[3]);
+    assert(ustar_lookup("/etc/") == &ustar_fs.entries[2]);
+    assert(ustar_lookup("/etc") == &ustar_fs.entries[2]);
+    printf("\t [test_ustar] (lookup): The prefix field is part of the path\n");
+    assert(ustar_lookup("/very/long/path/empty") == &ustar_fs.entries[4]);
+    assert(ustar_lookup("/empty") == NULL);
+    printf("\t [test_ustar] (lookup): Missing paths are not found\n");
+    assert(ustar_lookup("/hello") == NULL);
+    assert(ustar_lookup("/hello.txt2") == NULL);
+    assert(ustar_lookup("/etc/motd/x") == NULL);
+}
+
+void test_read() {
+    char buffer[32];
+    printf("\t [test_ustar] (read): A missing file can't be opened\n");
+    assert(ustar_open("/missing", 0) == -1);
+
+    printf("\t [test_ustar] (read): Read the whole file\n");
+    int fd = ustar_open("/hello.txt", 0);
+    assert(fd > 0);
+    memset(buffer, 0, sizeof(buffer));
+    assert(ustar_read(fd, buffer, sizeof(buffer)) == (ssize_t) strlen("Hello from the initrd"));
+    assert(strcmp(buffer, "Hello from the initrd") == 0);
+    assert(ustar_read(fd, buffer, sizeof(buffer)) == 0);
+
+    printf("\t [test_ustar] (read): Consecutive reads continue from the current offset\n");
+    int second_fd = ustar_open("/etc/motd", 0);
+    assert(second_fd > 0 && second_fd != fd);
+    size_t total = 0;
+    char content[128];
+    ssize_t read_bytes;
+    while ( (read_bytes = ustar_read(second_fd, buffer, 10)) > 0 ) {
+        assert(read_bytes <= 10);
+        memcpy(content + total, buffer, read_bytes);
+        total += read_bytes;
+    }
+    assert(total == strlen(long_content));
+    assert(strncmp(content, long_content, total) == 0);
+
+    printf("\t [test_ustar] (read): Directories can't be read\n");
+    int dir_fd = ustar_open("/etc", 0);
+    assert(dir_fd > 0);
+    assert(ustar_read(dir_fd, buffer, sizeof(buffer)) == -1);
+
+    printf("\t [test_ustar] (read): Closed descriptors are not valid anymore\n");
+    assert(ustar_close(fd) == 0);
+    assert(ustar_close(fd) == -1);
+    assert(ustar_read(fd, buffer, sizeof(buffer)) == -1);
+    assert(ustar_close(second_fd) == 0);
+    assert(ustar_close(dir_fd) == 0);
+    assert(ustar_close(0) == -1);
+}
+
+void test_invalid_archive() {
+    printf("\t [test_ustar] (invalid): A corrupted header stops the parsing\n");
+    ustar_item *header = (ustar_item *) (test_archive + 2 * HEADER_SIZE + HEADER_SIZE);
+    header->filename[2] = 'X';
+    assert(ustar_mount(test_archive, sizeof(test_archive)) == true);
+    assert(ustar_fs.entries_count == 2);
+    header->filename[2] = 'e';
+    printf("\t [test_ustar] (invalid): An archive with a broken first header is not mounted\n");
+    test_archive[0] ^= 1;
+    assert(ustar_mount(test_archive, sizeof(test_archive)) == false);
+    assert(ustar_lookup("/hello.txt") == NULL);
+    test_archive[0] ^= 1;
+    printf("\t [test_ustar] (invalid): Truncated archives are detected\n");
+    assert(ustar_mount(test_archive, 5 * HEADER_SIZE + 10) == true);
+    assert(ustar_fs.entries_count == 3);
+}
@@ -1,6 +1,8 @@
 #include <vfs.h>
+#include <dcache.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <test_common.h>
 #include <test_vfs.h>
 
@@ -9,6 +11,8 @@ int positions[5] = { 3, 1, 2, 0, 2 };
 int main() {
     vfs_init();    
     test_get_mountpoint_id();
+    test_mountpoint_trie();
+    test_dcache();
 }
 
 void test_get_mountpoint_id() {
@@ -29,3 +33,79 @@ void test_get_mountpoint_id() {
     printf("\t [test_vfs](test_get_mountpoint_id): Testing /usr/asd: found at position: %d found at: %d\n", last, positions[4]);
     assert(last == positions[4]);
 }
+
+int test_driver_lookups = 0;
+
+const void *test_driver_lookup(const char *path) {
+    test_driver_lookups++;
+    if ( strcmp(path, "/bin/sh") == 0 || strcmp(path, "/bin") == 0 ) {
+        return path;
+    }
+    return NULL;
+}
+
+void test_mountpoint_trie() {
+    const char *relative_path;
+    printf("\t [test_vfs](test_mountpoint_trie): Mountpoints match whole components only\n");
+    assert(get_mountpoint_id("/usrlocal") == 0);
+    assert(get_mountpoint_id("/home/mountain") == 3);
+    assert(get_mountpoint_id("//home//mount/") == 1);
+    printf("\t [test_vfs](test_mountpoint_trie): The relative path starts after the mountpoint\n");
+    assert(vfs_find_mountpoint("/home/mount/file", &relative_path) == 1);
+    assert(strcmp(relative_path, "/file") == 0);
+    assert(vfs_find_mountpoint("/home", &relative_path) == 3);
+    assert(strcmp(relative_path, "") == 0);
+    assert(vfs_find_mountpoint("/etc/passwd", &relative_path) == 0);
+    assert(strcmp(relative_path, "/etc/passwd") == 0);
+}
+
+void test_dcache() {
+    vfs_resolved_path_t resolved;
+    fs_file_operations_t operations;
+    memset(&operations, 0, sizeof(fs_file_operations_t));
+    operations.lookup = test_driver_lookup;
+    int id = mount_fs("/test", "TestFS", operations);
+    assert(id == 4);
+
+    printf("\t [test_vfs](test_dcache): The first resolution calls the driver lookup\n");
+    assert(vfs_resolve_path("/test/bin/sh", &resolved) == id);
+    assert(resolved.negative == false);
+    assert(strcmp(resolved.relative_path, "/bin/sh") == 0);
+    assert(strcmp(resolved.node, "/bin/sh") == 0);
+    assert(test_driver_lookups == 1);
+
+    printf("\t [test_vfs](test_dcache): The next resolutions are served by the cache\n");
+    size_t hits = vfs_dcache.stats.hits;
+    assert(vfs_resolve_path("/test//bin/sh/", &resolved) == id);
+    assert(resolved.negative == false && resolved.node != NULL);
+    assert(test_driver_lookups == 1);
+    assert(vfs_dcache.stats.hits == hits + 3);
+
+    printf("\t [test_vfs](test_dcache): Missing paths are cached as negative entries\n");
+    assert(vfs_resolve_path("/test/missing", &resolved) == id);
+    assert(resolved.negative == true);
+    assert(test_driver_lookups == 2);
+    assert(vfs_resolve_path("/test/missing", &resolved) == id && resolved.negative == true);
+    assert(vfs_resolve_path("/test/missing/child", &resolved) == id && resolved.negative == true);
+    assert(test_driver_lookups == 2);
+
+    printf("\t [test_vfs](test_dcache): Paths in a filesystem without lookup are never negative\n");
+    assert(vfs_resolve_path("/usr/lib", &resolved) == 2);
+    assert(resolved.negative == false && resolved.node == NULL);
+    assert(strcmp(resolved.relative_path, "/lib") == 0);
+
+    printf("\t [test_vfs](test_dcache): The cache is flushed when it is invalidated\n");
+    vfs_dcache_invalidate();
+    assert(vfs_resolve_path("/test/bin/sh", &resolved) == id);
+    assert(test_driver_lookups == 3);
+
+    printf("\t [test_vfs](test_dcache): When the cache is full the entries are replaced\n");
+    char path[32];
+    for (int i = 0; i < VFS_DCACHE_SIZE * 2; i++) {
+        snprintf(path, sizeof(path), "/test/file%d", i);
+        assert(vfs_resolve_path(path, &resolved) == id && resolved.negative == true);
+    }
+    assert(vfs_dcache.stats.evictions > 0);
+    assert(vfs_resolve_path("/test/bin/sh", &resolved) == id);
+    assert(resolved.negative == false && strcmp(resolved.node, "/bin/sh") == 0);
+}
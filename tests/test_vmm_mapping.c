@@ -0,0 +1,146 @@
+#include <test_common.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <kernel.h>
+#include <vm.h>
+
+#define TEST_TABLES_MAX 16
+
+typedef enum {
+    VMM_FLAGS_NONE = 0,
+    VMM_FLAGS_PRESENT = (1 << 0),
+    VMM_FLAGS_WRITE_ENABLE = (1 << 1),
+    VMM_FLAGS_USER_LEVEL = (1 << 2),
+    VMM_FLAGS_ADDRESS_ONLY = (1 << 7)
+} paging_flags_t;
+
+kernel_status_t kernel_settings;
+
+// test_common.c is not linked, it has its own stubs of the mapping functions, and vmm_mapping.h can't be included
+// since test_common.h declares map_phys_to_virt_addr with different arguments
+void *map_phys_to_virt_addr_hh(void* physical_address, void* address, size_t flags, uint64_t *pml4_root);
+void *map_page_table_hh(void *page_table, void *address, uint64_t *pml4_root);
+uint64_t get_page_entry_hh(void *address, uint64_t *pml4_root);
+void *translate_virt_address_hh(void *address, uint64_t *pml4_root);
+size_t free_user_page_tables(uint64_t *pml4_root);
+
+// The page table entries can store only 40 bits addresses, so the tables are taken from the low 4gb
+uint64_t *test_tables;
+size_t allocated_tables = 0;
+size_t freed_frames = 0;
+
+size_t logTrimLevel = 0;
+
+void loglinef(log_level_t level, const char* msg, ...) {
+}
+
+void *hhdm_get_variable(uintptr_t phys_address) {
+    return (void *) phys_address;
+}
+
+void *pmm_prepare_new_pagetable() {
+    assert(allocated_tables < TEST_TABLES_MAX);
+    return &test_tables[VM_PAGES_PER_TABLE * allocated_tables++];
+}
+
+void pmm_free_frame(void *address) {
+    uint64_t *table = address;
+    assert(table >= test_tables && table < test_tables + VM_PAGES_PER_TABLE * allocated_tables);
+    freed_frames++;
+}
+
+void test_translate_virt_address_hh();
+void test_page_entries();
+void test_free_user_page_tables();
+
+int main() {
+    test_tables = mmap(NULL, TEST_TABLES_MAX * VM_PAGES_PER_TABLE * sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    assert(test_tables != MAP_FAILED);
+    test_translate_virt_address_hh();
+    test_page_entries();
+    test_free_user_page_tables();
+}
+
+static uint64_t *new_root() {
+    uint64_t *root = pmm_prepare_new_pagetable();
+    clean_new_table(root);
+    return root;
+}
+
+void test_translate_virt_address_hh() {
+    printf("Testing translate_virt_address_hh\n");
+    allocated_tables = 0;
+    uint64_t *root = new_root();
+    map_phys_to_virt_addr_hh((void *) 0x10000000, (void *) 0x400000, VMM_FLAGS_PRESENT | VMM_FLAGS_WRITE_ENABLE, root);
+    void *phys = translate_virt_address_hh((void *) 0x400000, root);
+    printf("\t [test_vmm_mapping](%s): Should return the mapped frame 0x10000000 - returned: 0x%lx\n", __FUNCTION__, (uintptr_t) phys);
+    assert(phys == (void *) 0x10000000);
+    phys = translate_virt_address_hh((void *) 0x4a1234, root);
+    printf("\t [test_vmm_mapping](%s): Should return the page frame for an address inside the page - returned: 0x%lx\n", __FUNCTION__, (uintptr_t) phys);
+    assert(phys == (void *) 0x10000000);
+    printf("\t [test_vmm_mapping](%s): Should return NULL for a page not mapped in a present table\n", __FUNCTION__);
+    assert(translate_virt_address_hh((void *) 0x600000, root) == NULL);
+    printf("\t [test_vmm_mapping](%s): Should return NULL for a missing pdpr table\n", __FUNCTION__);
+    assert(translate_virt_address_hh((void *) 0x8000000000, root) == NULL);
+    printf("\t [test_vmm_mapping](%s): Should return NULL for a missing pd table\n", __FUNCTION__);
+    assert(translate_virt_address_hh((void *) 0x40000000, root) == NULL);
+}
+
+void test_page_entries() {
+    printf("Testing get_page_entry_hh and map_page_table_hh\n");
+    allocated_tables = 0;
+    uint64_t *root = new_root();
+    map_phys_to_virt_addr_hh((void *) 0x10000000, (void *) 0x400000, VMM_FLAGS_PRESENT | VMM_FLAGS_USER_LEVEL, root);
+    uint64_t entry = get_page_entry_hh((void *) 0x412345, root);
+    printf("\t [test_vmm_mapping](%s): Should return the entry of a 2mb page with its flags - returned: 0x%lx\n", __FUNCTION__, entry);
+    assert((entry & VM_PAGE_TABLE_BASE_ADDRESS_MASK & ~(uint64_t) HUGEPAGE_BIT) == 0x10000000);
+    assert((entry & (PRESENT_BIT | VMM_FLAGS_USER_LEVEL | HUGEPAGE_BIT)) == (PRESENT_BIT | VMM_FLAGS_USER_LEVEL | HUGEPAGE_BIT));
+    assert(!(entry & WRITE_BIT));
+    printf("\t [test_vmm_mapping](%s): Should return 0 for an address not mapped\n", __FUNCTION__);
+    assert(get_page_entry_hh((void *) 0x600000, root) == 0);
+
+    uint64_t *page_table = new_root();
+    printf("\t [test_vmm_mapping](%s): Should map a 2mb area with a table of 4k pages\n", __FUNCTION__);
+    assert(map_page_table_hh(page_table, (void *) 0x800000, root) == (void *) 0x800000);
+    page_table[3] = 0x10003000 | PRESENT_BIT | WRITE_BIT;
+    assert(get_page_entry_hh((void *) 0x803010, root) == (0x10003000 | PRESENT_BIT | WRITE_BIT));
+    assert(translate_virt_address_hh((void *) 0x803abc, root) == (void *) 0x10003000);
+    printf("\t [test_vmm_mapping](%s): Should return 0 for a 4k page not mapped in the table\n", __FUNCTION__);
+    assert(get_page_entry_hh((void *) 0x802000, root) == 0);
+    assert(translate_virt_address_hh((void *) 0x804000, root) == NULL);
+    printf("\t [test_vmm_mapping](%s): Should refuse an area already mapped\n", __FUNCTION__);
+    assert(map_page_table_hh(page_table, (void *) 0x400000, root) == NULL);
+}
+
+void test_free_user_page_tables() {
+    printf("Testing free_user_page_tables\n");
+    allocated_tables = 0;
+    freed_frames = 0;
+    uint64_t *root = new_root();
+    // pml4 entry 0: one pdpr and two pd tables, pml4 entry 1: one pdpr and one pd table
+    map_phys_to_virt_addr_hh((void *) 0x10000000, (void *) 0x200000, VMM_FLAGS_PRESENT, root);
+    map_phys_to_virt_addr_hh((void *) 0x10200000, (void *) 0x400000, VMM_FLAGS_PRESENT, root);
+    map_phys_to_virt_addr_hh((void *) 0x10400000, (void *) 0x40000000, VMM_FLAGS_PRESENT, root);
+    map_phys_to_virt_addr_hh((void *) 0x10600000, (void *) 0x8000000000, VMM_FLAGS_PRESENT, root);
+    assert(allocated_tables == 6);
+    // A higher half entry, shared with the kernel
+    root[300] = 0x20000000 | PRESENT_BIT | WRITE_BIT;
+
+    size_t freed_tables = free_user_page_tables(root);
+    printf("\t [test_vmm_mapping](%s): Should free the 5 lower half tables - freed: %ld\n", __FUNCTION__, freed_tables);
+    assert(freed_tables == 5);
+    assert(freed_frames == 5);
+    printf("\t [test_vmm_mapping](%s): Should clear the lower half entries of the root table\n", __FUNCTION__);
+    for (size_t i = 0; i < VM_PAGES_PER_TABLE / 2; i++) {
+        assert(root[i] == 0);
+    }
+    assert(translate_virt_address_hh((void *) 0x200000, root) == NULL);
+    printf("\t [test_vmm_mapping](%s): Should keep the higher half entries\n", __FUNCTION__);
+    assert(root[300] == (0x20000000 | PRESENT_BIT | WRITE_BIT));
+    printf("\t [test_vmm_mapping](%s): Should free nothing on an empty address space\n", __FUNCTION__);
+    assert(free_user_page_tables(root) == 0);
+    assert(freed_frames == 5);
+}
@@ -0,0 +1,113 @@
+#include <vmm_region.h>
+#include <assert.h>
+#include <bitmap.h>
+#include <stdio.h>
+#include <test_common.h>
+#include <vm.h>
+
+void test_region_add();
+void test_region_find();
+void test_fault_action();
+void test_frame_refcount();
+
+void test_fill(void *source, uintptr_t page_address, uint8_t *destination) {
+    (void) source;
+    (void) page_address;
+    (void) destination;
+}
+
+int main() {
+    printf("Testing vmm regions\n");
+    test_region_add();
+    test_region_find();
+    test_fault_action();
+    test_frame_refcount();
+    return 0;
+}
+
+void test_region_add() {
+    vmm_region_table_t table;
+    vmm_regions_init(&table);
+    printf("\t [test_vmm_region] (add): Regions are kept sorted\n");
+    assert(vmm_region_add(&table, 0x800000, 0xA00000, VMM_REGION_WRITE, 0, NULL, test_fill) == true);
+    assert(vmm_region_add(&table, 0x400000, 0x800000, VMM_REGION_FILE_SHARED, 0x10000000, NULL, NULL) == true);
+    assert(vmm_region_add(&table, 0xC00000, 0xE00000, VMM_REGION_NONE, 0, NULL, test_fill) == true);
+    assert(table.count == 3);
+    assert(table.regions[0].start == 0x400000 && table.regions[1].start == 0x800000 && table.regions[2].start == 0xC00000);
+    printf("\t [test_vmm_region] (add): Overlapping regions are refused\n");
+    assert(vmm_region_add(&table, 0x600000, 0xA00000, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+    assert(vmm_region_add(&table, 0x200000, 0x600000, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+    assert(vmm_region_add(&table, 0x800000, 0xC00000, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+    printf("\t [test_vmm_region] (add): Invalid regions are refused\n");
+    assert(vmm_region_add(&table, 0xA00000, 0xA00000, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+    assert(vmm_region_add(&table, 0xA00010, 0xC00000, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+    assert(vmm_region_add(&table, 0xA00000, 0xC00000, VMM_REGION_NONE, 0, NULL, NULL) == false);
+    assert(vmm_region_add(&table, 0xA00000, 0xC00000, VMM_REGION_NONE, 0, NULL, test_fill) == true);
+    assert(table.count == 4);
+    printf("\t [test_vmm_region] (add): The table has a limited size\n");
+    vmm_regions_init(&table);
+    for (size_t i = 0; i < VMM_MAX_REGIONS; i++) {
+        assert(vmm_region_add(&table, (i + 1) * PAGE_SIZE_IN_BYTES, (i + 2) * PAGE_SIZE_IN_BYTES, VMM_REGION_NONE, 0, NULL, test_fill) == true);
+    }
+    assert(vmm_region_add(&table, 0x100000000, 0x100000000 + PAGE_SIZE_IN_BYTES, VMM_REGION_NONE, 0, NULL, test_fill) == false);
+}
+
+void test_region_find() {
+    vmm_region_table_t table;
+    vmm_regions_init(&table);
+    printf("\t [test_vmm_region] (find): The region containing an address is found\n");
+    assert(vmm_region_find(&table, 0x400000) == NULL);
+    for (size_t i = 0; i < VMM_MAX_REGIONS; i++) {
+        assert(vmm_region_add(&table, (2 * i + 1) * PAGE_SIZE_IN_BYTES, (2 * i + 2) * PAGE_SIZE_IN_BYTES, VMM_REGION_NONE, 0, NULL, test_fill) == true);
+    }
+    for (size_t i = 0; i < VMM_MAX_REGIONS; i++) {
+        uintptr_t start = (2 * i + 1) * PAGE_SIZE_IN_BYTES;
+        assert(vmm_region_find(&table, start) == &table.regions[i]);
+        assert(vmm_region_find(&table, start + PAGE_SIZE_IN_BYTES - 1) == &table.regions[i]);
+        assert(vmm_region_find(&table, start + PAGE_SIZE_IN_BYTES) == NULL);
+    }
+    assert(vmm_region_find(&table, 0) == NULL);
+}
+
+void test_fault_action() {
+    vmm_region_t text = { 0x400000, 0x600000, VMM_REGION_FILE_SHARED, 0x10000000, NULL, NULL };
+    vmm_region_t data = { 0x600000, 0x800000, VMM_REGION_FILE_SHARED | VMM_REGION_WRITE, 0x10200000, NULL, NULL };
+    vmm_region_t bss = { 0x800000, 0xA00000, VMM_REGION_WRITE, 0, NULL, test_fill };
+    vmm_region_t rodata = { 0xA00000, 0xC00000, VMM_REGION_NONE, 0, NULL, test_fill };
+    printf("\t [test_vmm_region] (fault_action): Shared pages are mapped on the first access\n");
+    assert(vmm_region_fault_action(&text, 0) == VMM_FAULT_MAP_SHARED);
+    assert(vmm_region_fault_action(&text, FETCH_VIOLATION) == VMM_FAULT_MAP_SHARED);
+    assert(vmm_region_fault_action(&data, ACCESS_VIOLATION) == VMM_FAULT_MAP_SHARED);
+    printf("\t [test_vmm_region] (fault_action): Writing a shared page makes a copy only if the region is writable\n");
+    assert(vmm_region_fault_action(&data, PRESENT_VIOLATION | WRITE_VIOLATION | ACCESS_VIOLATION) == VMM_FAULT_COPY_ON_WRITE);
+    assert(vmm_region_fault_action(&text, PRESENT_VIOLATION | WRITE_VIOLATION) == VMM_FAULT_INVALID);
+    assert(vmm_region_fault_action(&text, WRITE_VIOLATION) == VMM_FAULT_INVALID);
+    printf("\t [test_vmm_region] (fault_action): Private pages are filled on the first access\n");
+    assert(vmm_region_fault_action(&bss, WRITE_VIOLATION) == VMM_FAULT_FILL_PRIVATE);
+    assert(vmm_region_fault_action(&rodata, 0) == VMM_FAULT_FILL_PRIVATE);
+    assert(vmm_region_fault_action(&rodata, WRITE_VIOLATION) == VMM_FAULT_INVALID);
+    assert(vmm_region_fault_action(&bss, PRESENT_VIOLATION | WRITE_VIOLATION) == VMM_FAULT_INVALID);
+    printf("\t [test_vmm_region] (fault_action): Faults outside of the regions are not solved\n");
+    assert(vmm_region_fault_action(NULL, 0) == VMM_FAULT_INVALID);
+    assert(vmm_region_fault_action(&text, RESERVED_VIOLATION) == VMM_FAULT_INVALID);
+}
+
+void test_frame_refcount() {
+    printf("\t [test_vmm_region] (frame_refcount): Shared frames are counted\n");
+    assert(vmm_frame_refcount(0x10000000) == 0);
+    assert(vmm_frame_ref(0x10000000) == 1);
+    assert(vmm_frame_ref(0x10000000) == 2);
+    assert(vmm_frame_ref(0x10200000) == 1);
+    assert(vmm_frame_refcount(0x10000000) == 2);
+    assert(vmm_frame_unref(0x10000000) == 1);
+    assert(vmm_frame_unref(0x10000000) == 0);
+    assert(vmm_frame_unref(0x10000000) == 0);
+    assert(vmm_frame_refcount(0x10200000) == 1);
+    assert(vmm_frame_unref(0x30000000) == 0);
+    printf("\t [test_vmm_region] (frame_refcount): When the table is full the frames are not tracked\n");
+    for (size_t i = 0; i < VMM_SHARED_FRAMES_MAX; i++) {
+        vmm_frame_ref(0x40000000 + i * PAGE_SIZE_IN_BYTES);
+    }
+    assert(vmm_frame_ref(0x80000000) == 0);
+    assert(vmm_frame_refcount(0x10200000) == 1);
+}
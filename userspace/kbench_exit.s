@@ -0,0 +1,12 @@
+; The smallest user program: it exits right away. It's loaded from the initrd by the spawn benchmark (kbench.c),
+; to measure the creation and the teardown of a user address space.
+%define SYSCALL_VECTOR_NUMBER 0x80
+%define SYSCALL_EXIT 5
+
+section .text
+global _start
+_start:
+    mov rsi, SYSCALL_EXIT
+    int SYSCALL_VECTOR_NUMBER
+    ; Never reached, the thread is not scheduled again after the exit
+    jmp $